@@ -0,0 +1,226 @@
+/*
+ * Adquisicion no bloqueante del magnetometro (ver adquisicion.h)
+ *
+ * Estados (con MAG_READY_BIT, el HMC, BUSY lee antes el estado y sin
+ * RDY vuelve a IDLE como no_data, sin leer el bloque):
+ *   IDLE --trigger--> BUSY --ok + DRDY--> IDLE (on_sample)
+ *                     BUSY --ok sin DRDY--> IDLE (no_data)
+ *                     BUSY --NACK / timeout--> BUSY (reintento)
+ *                                          \--> IDLE (failures)
+ *   acq_stop() --> STOPPED hasta el proximo acq_start()
+ */
+#include "adquisicion.h"
+#include "brujula.h"
+#include "hal.h"
+#include "medida.h"
+#include "tiempo.h"
+
+#include <string.h>
+
+enum { ACQ_IDLE, ACQ_BUSY, ACQ_STOPPED };
+
+static struct acq_config cfg;
+static struct acq_stats st;
+
+static volatile uint8_t state = ACQ_IDLE;
+static uint8_t block[MAG_BLOCK_MAX];
+static uint8_t ready[2];      // estado del HMC y el byte siguiente
+static uint8_t tries;
+static uint16_t busy_ticks;
+static uint16_t idle_ticks;
+static uint64_t trigger_us;   // DRDY (o tick) que disparo la lectura
+#ifdef BRUJULA_MEDIDA
+static uint32_t read_cyc;     // arranque del DMA (MED_I2C)
+#endif
+
+static void ready_done(int status);
+static void read_done(int status);
+
+/* ================= MAQUINA DE ESTADOS ================= */
+
+/* Sin DMA: seguir leyendo por polling desde main */
+static void start_dma(uint8_t reg, uint8_t *buf, uint8_t len,
+                      void (*cb)(int status))
+{
+    if (i2c_read_burst_async(MAG_ADDR, reg, buf, len, cb) != 0) {
+        state = ACQ_IDLE;
+        cfg.mode = ACQ_POLL;
+        st.fallbacks++;
+    }
+}
+
+/*
+ * El estado va en una transaccion aparte, de 2 bytes (el DMA pide al
+ * menos 2): en el HMC el segundo es ID_A, que no limpia nada.
+ */
+static void start_read(void)
+{
+    busy_ticks = 0;
+    state = ACQ_BUSY;
+#ifdef BRUJULA_MEDIDA
+    read_cyc = hal_cycles();
+#endif
+
+    if (MAG_READY_BIT)
+        start_dma(MAG_READY_REG, ready, sizeof(ready), ready_done);
+    else
+        start_dma(MAG_BLOCK_REG, block, MAG_BLOCK_LEN, read_done);
+}
+
+static void read_failed(int timeout)
+{
+    if (timeout)
+        st.timeouts++;
+    else
+        st.nacks++;
+
+    if (tries < cfg.retries) {
+        tries++;
+        st.retries++;
+        start_read();
+        return;
+    }
+
+    st.failures++;
+    st.consec_failures++;
+    state = ACQ_IDLE;
+}
+
+static void ready_done(int status)
+{
+    if (status != 0) {
+        read_failed(0);
+        return;
+    }
+
+    if (!(ready[0] & MAG_READY_BIT)) {
+        MED_END(MED_I2C, read_cyc);
+        state = ACQ_IDLE;
+        st.consec_failures = 0;
+        st.no_data++;
+        return;
+    }
+
+    start_dma(MAG_BLOCK_REG, block, MAG_BLOCK_LEN, read_done);
+}
+
+static void read_done(int status)
+{
+    struct qmc_sample s;
+
+    MED_END(MED_I2C, read_cyc);
+    if (status != 0) {
+        read_failed(0);
+        return;
+    }
+
+    state = ACQ_IDLE;
+    st.consec_failures = 0;
+
+    if (!mag_decode(block, &s.x, &s.y, &s.z)) {
+        st.no_data++;
+        return;
+    }
+
+    s.t_us = trigger_us;
+    st.samples++;
+    if (cfg.on_sample)
+        cfg.on_sample(&s);
+}
+
+/* ================= API ================= */
+
+void acq_start(const struct acq_config *c)
+{
+    cfg = *c;
+    memset(&st, 0, sizeof(st));
+    state = ACQ_IDLE;
+    idle_ticks = 0;
+
+    if (cfg.mode == ACQ_POLL)
+        return;
+
+    hal_tick_irq_init(cfg.tick_hz, acq_tick);
+    if (cfg.mode == ACQ_DRDY)
+        hal_drdy_irq_init(acq_trigger);
+}
+
+/* EXTI de DRDY o tick del timer */
+void acq_trigger(void)
+{
+    if (state == ACQ_STOPPED)
+        return;
+
+    st.triggers++;
+    idle_ticks = 0;
+
+    if (cfg.mode == ACQ_POLL)
+        return;
+
+    if (state == ACQ_BUSY) {
+        st.overruns++;
+        return;
+    }
+
+    tries = 0;
+    trigger_us = time_us();
+    start_read();
+}
+
+void acq_tick(void)
+{
+    if (state == ACQ_STOPPED)
+        return;
+
+    if (state == ACQ_BUSY && ++busy_ticks >= cfg.timeout_ticks) {
+        hal_i2c_abort();
+        read_failed(1);
+    }
+
+    /*
+     * En ACQ_TIMER es el disparo periodico. En ACQ_DRDY es un watchdog:
+     * si una lectura fallo, DRDY queda en 1 y no vuelve a haber flanco.
+     */
+    if (cfg.mode != ACQ_POLL && cfg.trigger_ticks &&
+        ++idle_ticks >= cfg.trigger_ticks)
+        acq_trigger();
+}
+
+void acq_service(void)
+{
+    struct qmc_sample s;
+
+    if (cfg.mode != ACQ_POLL || state == ACQ_STOPPED)
+        return;
+
+    if (qmc_read_sample(&s)) {
+        st.samples++;
+        if (cfg.on_sample)
+            cfg.on_sample(&s);
+    }
+}
+
+/* Sin lecturas ni reintentos hasta acq_start(): el bus queda libre */
+void acq_stop(void)
+{
+    hal_irq_lock();
+    if (state == ACQ_BUSY)
+        hal_i2c_abort();
+    state = ACQ_STOPPED;
+    hal_irq_unlock();
+}
+
+int acq_busy(void)
+{
+    return state == ACQ_BUSY;
+}
+
+enum acq_mode acq_mode(void)
+{
+    return cfg.mode;
+}
+
+void acq_stats_get(struct acq_stats *out)
+{
+    *out = st;
+}
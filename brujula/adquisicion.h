@@ -0,0 +1,55 @@
+#ifndef Adquisicion_H
+#define Adquisicion_H
+
+/*
+ * Adquisicion no bloqueante del magnetometro (magneto.h).
+ *
+ * El flanco de DRDY (EXTI) o un tick de timer dispara una lectura por
+ * DMA del bloque del chip (estado + XYZ; el HMC lee antes el estado
+ * aparte); al terminar, la muestra se entrega por on_sample() desde la
+ * interrupcion y main queda libre mientras tanto.
+ * En ACQ_POLL (o si no hay DMA) acq_service() lee de forma sincrona.
+ */
+
+#include <stdint.h>
+
+#include "brujula.h"
+
+enum acq_mode {
+    ACQ_POLL,   // acq_service() desde main, como antes
+    ACQ_DRDY,   // EXTI en el pin DRDY
+    ACQ_TIMER,  // cada trigger_ticks ticks
+};
+
+struct acq_config {
+    enum acq_mode mode;
+    uint32_t tick_hz;        // tick de timeouts (y de disparo en ACQ_TIMER)
+    uint16_t trigger_ticks;  // ACQ_TIMER: periodo; ACQ_DRDY: watchdog
+    uint16_t timeout_ticks;  // transaccion colgada
+    uint8_t retries;         // reintentos tras NACK / timeout
+    void (*on_sample)(const struct qmc_sample *s);
+};
+
+struct acq_stats {
+    uint32_t triggers;
+    uint32_t samples;
+    uint32_t no_data;         // lectura sin DRDY
+    uint32_t overruns;        // disparo con una lectura en curso
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t retries;
+    uint32_t failures;        // reintentos agotados
+    uint32_t consec_failures;
+    uint32_t fallbacks;       // paso a ACQ_POLL por falta de DMA
+};
+
+void acq_start(const struct acq_config *cfg);
+void acq_stop(void);
+void acq_trigger(void);
+void acq_tick(void);
+void acq_service(void);
+int acq_busy(void);
+enum acq_mode acq_mode(void);
+void acq_stats_get(struct acq_stats *out);
+
+#endif /* Adquisicion_H */
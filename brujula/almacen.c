@@ -0,0 +1,338 @@
+/*
+ * Almacen de registros en flash (ver almacen.h)
+ *
+ * Sector:   [STORE_MAGIC] [seq] [~seq] registro registro ... 0xFF...
+ * Registro: [magic | tipo << 8 | version << 16 | largo << 24] [CRC-32]
+ *           [datos, rellenos con 0xFF a palabras] [REC_COMMIT]
+ */
+#include "almacen.h"
+#include "hal.h"
+
+#include <string.h>
+
+#define STORE_MAGIC 0x014A5242u   // "BRJ" + version del formato
+#define HDR_WORDS   3
+
+#define REC_MAGIC   0xA5u
+#define REC_COMMIT  0x00000000u   // todos los bits bajados: no sale a medias
+#define ERASED      0xFFFFFFFFu
+
+#define REC_WORDS(len) (2u + ((len) + 3u) / 4u + 1u)
+#define REC_MAX_WORDS  REC_WORDS(STORE_MAX_LEN)
+
+static int active = -1;
+static uint32_t index_at[STORE_TYPES];   // palabra del ultimo registro, 0 = no hay
+static uint32_t end;                     // primera palabra libre
+static int dirty;                        // basura despues del ultimo registro
+static struct store_stats st;
+
+/* El sector al que va la proxima compactacion */
+enum { SPARE_UNKNOWN, SPARE_ERASING, SPARE_BLANK };
+static int spare_state;
+
+/* ================= CRC-32 ================= */
+
+/* CRC-32 (el de zlib), de a nibbles: 16 entradas de tabla */
+static uint32_t crc32(uint32_t crc, const uint8_t *p, uint32_t n)
+{
+    static const uint32_t t[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+
+    crc = ~crc;
+    while (n--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ t[crc & 0x0F];
+        crc = (crc >> 4) ^ t[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+/* ================= REGISTROS ================= */
+
+static uint32_t sector_words(void)
+{
+    return hal_flash_sector_size() / 4;
+}
+
+static uint8_t rec_len(uint32_t h)
+{
+    return (uint8_t)(h >> 24);
+}
+
+static uint8_t rec_type(uint32_t h)
+{
+    return (uint8_t)(h >> 8);
+}
+
+static int rec_valid(const uint32_t *r)
+{
+    uint8_t len = rec_len(r[0]);
+
+    return r[REC_WORDS(len) - 1] == REC_COMMIT &&
+           crc32(crc32(0, (const uint8_t *)&r[0], 4),
+                 (const uint8_t *)&r[2], len) == r[1];
+}
+
+static int sector_seq(int s, uint32_t *seq)
+{
+    const uint32_t *w = hal_flash_sector(s);
+
+    if (w[0] != STORE_MAGIC || w[2] != ~w[1])
+        return -1;
+    *seq = w[1];
+    return 0;
+}
+
+/* Ultimo registro valido de 'type' antes de la palabra 'before' */
+static uint32_t find_valid(const uint32_t *w, uint8_t type, uint32_t before)
+{
+    uint32_t found = 0;
+
+    for (uint32_t i = HDR_WORDS; i < before; i += REC_WORDS(rec_len(w[i])))
+        if (rec_type(w[i]) == type && rec_valid(&w[i]))
+            found = i;
+    return found;
+}
+
+/* Indexa el sector activo; para en la primera palabra borrada */
+static void scan(void)
+{
+    const uint32_t *w = hal_flash_sector(active);
+    uint32_t nw = sector_words();
+    uint32_t i = HDR_WORDS;
+
+    memset(index_at, 0, sizeof(index_at));
+    st.records = 0;
+    st.torn = 0;
+    dirty = 0;
+
+    while (i < nw && w[i] != ERASED) {
+        uint32_t h = w[i];
+        uint32_t n = REC_WORDS(rec_len(h));
+
+        /* Cabecera a medias: no se sabe el largo, no se sigue */
+        if ((h & 0xFF) != REC_MAGIC || rec_len(h) > STORE_MAX_LEN ||
+            rec_type(h) == 0 || rec_type(h) >= STORE_TYPES || i + n > nw) {
+            dirty = 1;
+            break;
+        }
+
+        if (w[i + n - 1] == REC_COMMIT) {
+            index_at[rec_type(h)] = i;
+            st.records++;
+        } else {
+            st.torn++;
+        }
+        i += n;
+    }
+    end = i;
+
+    /* Solo se verifica el CRC del ultimo de cada tipo */
+    for (int t = 1; t < STORE_TYPES; t++)
+        if (index_at[t] && !rec_valid(&w[index_at[t]])) {
+            st.torn++;
+            index_at[t] = find_valid(w, (uint8_t)t, index_at[t]);
+        }
+}
+
+/* n palabras libres (borradas) al final del sector activo */
+static int fits(uint32_t n)
+{
+    const uint32_t *w = hal_flash_sector(active);
+
+    if (dirty || end + n > sector_words())
+        return 0;
+    for (uint32_t i = end; i < end + n; i++)
+        if (w[i] != ERASED)
+            return 0;
+    return 1;
+}
+
+static int spare(void)
+{
+    return active < 0 ? 0 : 1 - active;
+}
+
+static int blank(int s)
+{
+    const uint32_t *w = hal_flash_sector(s);
+    uint32_t nw = sector_words();
+
+    for (uint32_t i = 0; i < nw; i++)
+        if (w[i] != ERASED)
+            return 0;
+    return 1;
+}
+
+/* Copia lo vigente al otro sector (ya borrado); la cabecera va al final */
+static int compact(void)
+{
+    int to = spare();
+    uint32_t seq = active < 0 ? 1 : st.seq + 1;
+    uint32_t at = HDR_WORDS, moved[STORE_TYPES] = { 0 };
+    uint32_t rec[REC_MAX_WORDS];
+
+    spare_state = SPARE_UNKNOWN;   // salga bien o no, ya no esta borrado
+
+    for (int t = 1; active >= 0 && t < STORE_TYPES; t++) {
+        if (!index_at[t])
+            continue;
+
+        const uint32_t *r = hal_flash_sector(active) + index_at[t];
+        uint32_t n = REC_WORDS(rec_len(r[0]));
+
+        memcpy(rec, r, n * 4);
+        if (hal_flash_program(to, at * 4, rec, n) != 0)
+            return -1;
+        moved[t] = at;
+        at += n;
+    }
+
+    const uint32_t hdr[HDR_WORDS] = { STORE_MAGIC, seq, ~seq };
+    if (hal_flash_program(to, 4, &hdr[1], 2) != 0 ||
+        hal_flash_program(to, 0, &hdr[0], 1) != 0)
+        return -1;
+
+    active = to;
+    st.seq = seq;
+    st.compactions++;
+    memcpy(index_at, moved, sizeof(index_at));
+    end = at;
+    dirty = 0;
+    return 0;
+}
+
+/* ================= API ================= */
+
+int store_init(void)
+{
+    uint32_t seq[HAL_FLASH_SECTORS];
+    int ok[HAL_FLASH_SECTORS];
+
+    active = -1;
+    memset(index_at, 0, sizeof(index_at));
+    end = 0;
+    dirty = 0;
+    memset(&st, 0, sizeof(st));
+    spare_state = SPARE_UNKNOWN;
+
+    for (int s = 0; s < HAL_FLASH_SECTORS; s++) {
+        ok[s] = sector_seq(s, &seq[s]) == 0;
+        if (ok[s] && (active < 0 || seq[s] > seq[active]))
+            active = s;
+    }
+
+    if (active < 0)
+        return -1;   // flash vacia: el primer store_write() la formatea
+
+    st.seq = seq[active];
+    scan();
+    return 0;
+}
+
+int store_read(uint8_t type, uint8_t version, void *buf, uint8_t len)
+{
+    if (active < 0 || type == 0 || type >= STORE_TYPES || !index_at[type])
+        return -1;
+
+    const uint32_t *r = hal_flash_sector(active) + index_at[type];
+
+    if ((uint8_t)(r[0] >> 16) != version || rec_len(r[0]) != len)
+        return -1;
+
+    memcpy(buf, &r[2], len);
+    return len;
+}
+
+int store_write(uint8_t type, uint8_t version, const void *buf, uint8_t len)
+{
+    uint32_t rec[REC_MAX_WORDS];
+    uint32_t n = REC_WORDS(len);
+
+    if (type == 0 || type >= STORE_TYPES || len > STORE_MAX_LEN)
+        return -1;
+
+    rec[0] = REC_MAGIC | (uint32_t)type << 8 | (uint32_t)version << 16 |
+             (uint32_t)len << 24;
+    rec[n - 2] = ERASED;   // relleno de la ultima palabra de datos
+    memcpy(&rec[2], buf, len);
+    rec[1] = crc32(crc32(0, (const uint8_t *)&rec[0], 4),
+                   (const uint8_t *)&rec[2], len);
+    rec[n - 1] = REC_COMMIT;
+
+    /* Lo mismo que ya hay: no gastar flash */
+    if (active >= 0 && index_at[type] &&
+        !memcmp(hal_flash_sector(active) + index_at[type], rec, n * 4)) {
+        st.skipped++;
+        return 0;
+    }
+
+    /* Con el borrado andando la flash no programa */
+    if (spare_state == SPARE_ERASING && store_poll() > 0)
+        return 1;
+
+    if (active < 0 || !fits(n)) {
+        int r = store_poll();
+
+        if (r != 0)
+            return r;
+        if (compact() != 0 || !fits(n)) {
+            dirty = 1;
+            return -1;
+        }
+    }
+
+    /* Datos primero, commit despues: sin commit el registro no existe */
+    if (hal_flash_program(active, end * 4, rec, n - 1) != 0 ||
+        hal_flash_program(active, (end + n - 1) * 4, &rec[n - 1], 1) != 0) {
+        dirty = 1;
+        return -1;
+    }
+
+    index_at[type] = end;
+    end += n;
+    st.records++;
+    return 0;
+}
+
+int store_poll(void)
+{
+    switch (spare_state) {
+    case SPARE_UNKNOWN:
+        if (hal_flash_erase_poll() > 0)
+            return 1;   // uno que quedo de antes de store_init()
+
+        /* Una pasada por el sector: despues de compactar corta enseguida */
+        if (blank(spare())) {
+            spare_state = SPARE_BLANK;
+            return 0;
+        }
+        if (hal_flash_erase_start(spare()) != 0)
+            return -1;
+        spare_state = SPARE_ERASING;
+        /* fall through */
+    case SPARE_ERASING:
+        switch (hal_flash_erase_poll()) {
+        case 1:
+            return 1;
+        case 0:
+            spare_state = SPARE_BLANK;
+            return 0;
+        default:
+            spare_state = SPARE_UNKNOWN;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void store_stats_get(struct store_stats *out)
+{
+    *out = st;
+    out->sector = active;
+    out->used = end * 4;
+}
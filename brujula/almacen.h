@@ -0,0 +1,48 @@
+#ifndef Almacen_H
+#define Almacen_H
+
+/*
+ * Almacen de registros en la flash interna (los sectores de hal.h).
+ *
+ * Cada escritura agrega un registro al final del sector activo y nunca
+ * reescribe: cabecera (tipo, version, largo), CRC-32, datos y una palabra
+ * de commit que se programa al final. Un corte de energia a mitad de
+ * camino deja un registro sin commit o con CRC malo, que se ignora, y el
+ * anterior del mismo tipo sigue valiendo.
+ *
+ * Cuando el sector se llena se compacta en el otro: se copia el ultimo
+ * registro de cada tipo y recien entonces se escribe la cabecera del
+ * sector con seq + 1. Los dos sectores se borran por turnos.
+ *
+ * El otro sector se borra de fondo (~1 s): store_poll() lo arranca y lo
+ * sigue, y mientras tanto store_write() no programa nada y devuelve 1
+ * (volver a llamar). Nada bloquea; store_poll() va en housekeeping.
+ *
+ * store_init() recorre el sector una vez y deja indexado el ultimo
+ * registro valido de cada tipo; store_read() es una copia.
+ */
+
+#include <stdint.h>
+
+#define STORE_TYPES   8     // tipos 1..STORE_TYPES-1
+#define STORE_MAX_LEN 128   // bytes de datos por registro
+
+struct store_stats {
+    int sector;               // activo, -1 = ninguno (flash vacia)
+    uint32_t seq;
+    uint32_t used;            // bytes ocupados del sector activo
+    uint32_t records;         // registros con commit en el sector activo
+    uint32_t torn;            // sin commit o con CRC malo
+    uint32_t compactions;
+    uint32_t skipped;         // escrituras iguales al ultimo registro
+};
+
+int store_init(void);
+int store_read(uint8_t type, uint8_t version, void *buf, uint8_t len);
+/* 0 = escrito, 1 = borrando (store_poll() y otra vez), -1 = error */
+int store_write(uint8_t type, uint8_t version, const void *buf, uint8_t len);
+/* Borra el otro sector si hace falta: 1 = borrando, 0 = listo, -1 = error */
+int store_poll(void);
+void store_stats_get(struct store_stats *out);
+
+#endif /* Almacen_H */
@@ -0,0 +1,73 @@
+/*
+ * Secuencia de arranque (ver arranque.h)
+ */
+#include "arranque.h"
+#include "brujula.h"
+#include "pantalla.h"
+#include "tiempo.h"
+
+#include <stdio.h>
+
+static uint64_t marks[BOOT_MARKS];
+static uint8_t done;   // bit por hito
+
+static const char *const names[BOOT_MARKS] = {
+    [BOOT_MEMORY] = "sdram",
+    [BOOT_DISPLAY] = "lcd",
+    [BOOT_FRAME] = "splash",
+    [BOOT_SENSOR] = "qmc",
+    [BOOT_HEADING] = "rumbo",
+};
+
+void boot_reset(void)
+{
+    done = 0;
+}
+
+void boot_mark(enum boot_mark m)
+{
+    if (done & (1u << m))
+        return;
+    marks[m] = time_us();
+    done |= (uint8_t)(1u << m);
+}
+
+uint64_t boot_time_us(enum boot_mark m)
+{
+    return done & (1u << m) ? marks[m] : 0;
+}
+
+int boot_run(const struct boot_steps *s)
+{
+    if (s->memory)
+        s->memory();
+    boot_mark(BOOT_MEMORY);
+
+    if (s->display)
+        s->display();
+    boot_mark(BOOT_DISPLAY);
+
+    /* Con tres buffers fb_swap() no espera: el envio sigue por DMA */
+    if (s->splash) {
+        s->splash();
+        fb_swap();
+        boot_mark(BOOT_FRAME);
+    }
+
+    int err = qmc_init();
+    boot_mark(BOOT_SENSOR);
+    return err;
+}
+
+void boot_report(void)
+{
+    printf("arranque (ms):");
+    for (int m = 0; m < BOOT_MARKS; m++) {
+        uint64_t us = boot_time_us((enum boot_mark)m);
+
+        if (us)
+            printf(" %s %lu.%lu", names[m], (unsigned long)(us / 1000),
+                   (unsigned long)(us % 1000 / 100));
+    }
+    printf("\r\n");
+}
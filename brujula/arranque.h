@@ -0,0 +1,42 @@
+#ifndef Arranque_H
+#define Arranque_H
+
+/*
+ * Arranque rapido.
+ *
+ * Antes: qmc_init() dormia 360 ms a ciegas y recien despues se
+ * levantaban la SDRAM y el LCD, uno detras del otro. Ahora boot_run()
+ * levanta primero la SDRAM y el LCD mientras el QMC hace su power-on
+ * (ya tiene corriente desde el reset), manda un splash apenas hay
+ * pantalla (el DMA lo envia mientras tanto) y recien ahi qmc_init(),
+ * que pregunta el chip-ID con espera creciente en vez de dormir.
+ *
+ * Cada hito guarda el primer time_us() en que se marca, contado desde
+ * system_init() (el SysTick arranca ahi). BOOT_HEADING lo marca el que
+ * muestra el primer rumbo.
+ */
+
+#include <stdint.h>
+
+enum boot_mark {
+    BOOT_MEMORY,        // SDRAM lista
+    BOOT_DISPLAY,       // LCD, framebuffers y gfx listos
+    BOOT_FRAME,         // splash al LCD
+    BOOT_SENSOR,        // qmc_init() termino
+    BOOT_HEADING,       // primer rumbo valido
+    BOOT_MARKS
+};
+
+struct boot_steps {
+    void (*memory)(void);     // sdram_init()
+    void (*display)(void);    // lcd_spi_init(), fb_init(), gfx_init()
+    void (*splash)(void);     // dibuja en el buffer de atras
+};
+
+void boot_reset(void);
+int boot_run(const struct boot_steps *s);   // lo que devuelve qmc_init()
+void boot_mark(enum boot_mark m);           // solo cuenta la primera vez
+uint64_t boot_time_us(enum boot_mark m);    // 0 = todavia no
+void boot_report(void);                     // printf
+
+#endif /* Arranque_H */
@@ -1,213 +1,644 @@
 /*
- * STM32F429 + QMC5883L
+ * STM32F429 + QMC5883L (o HMC5883L / LIS3MDL, ver magneto.h)
  * Brújula completa (hard-iron corregido)
+ *
+ * El driver solo usa hal.h, asi que compila igual para la placa
+ * (hal_stm32.c) y para Linux (host/hal_host.c + simulador).
  */
-//#include "brujula.h"
-
- #include <libopencm3/stm32/rcc.h>
- #include <libopencm3/stm32/gpio.h>
- #include <libopencm3/stm32/i2c.h>
- 
- #include <libopencm3-plus/newlib/syscall.h>
- #include <libopencm3-plus/newlib/devices/cdcacm.h>
- 
- #include <stdio.h>
- #include <stdint.h>
- #include <math.h>
- 
- /* ================= CONFIG ================= */
- 
- #define QMC_ADDR 0x0D
- 
- #define QMC_REG_X_LSB     0x00
- #define QMC_REG_STATUS    0x06
- #define QMC_REG_CONTROL   0x09
- #define QMC_REG_SETRESET  0x0B
- 
- /* Hard-iron offsets (tus datos reales) */
- #define OFF_X  400
- #define OFF_Y   66
- #define OFF_Z  100
- #define M_PI 3.14159265358979323846
-
- #define TIMEOUT 1000000
-
- static float fx = 0.0f;   // X filtrado
-static float fz = 0.0f;   // Z filtrado
+#include "brujula.h"
+#include "almacen.h"
+#include "calibracion.h"
+#include "hal.h"
+#include "medida.h"
+#include "rumbo.h"
+#include "tiempo.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/* ================= CONFIG ================= */
+
+/* Hard-iron offsets de fabrica (tus datos reales), hasta que haya
+ * una calibracion (qmc_set_calibration) */
+#define OFF_X  400
+#define OFF_Y   66
+#define OFF_Z  100
+
+/* Arranque del sensor. Antes: delay(15000000) a ciegas (~360 ms a 168 MHz)
+ * y reintentos sin fin cada ~70 ms. Ahora el chip-ID con espera que se
+ * duplica hasta QMC_PROBE_MAX_US, y como mucho QMC_PROBE_BUDGET_US */
+#define QMC_PROBE_FIRST_US     250
+#define QMC_PROBE_MAX_US     20000
+#define QMC_PROBE_BUDGET_US 500000
+#define QMC_RETRY_US          1000
+#define QMC_RETRIES              5
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 static const float ALPHA = 0.01f;  // 0<ALPHA<=1 (más pequeño = más suave)
+#define ALPHA_Q15 328              // ALPHA en Q15 (328/32768 = 0.01001)
+
+/* Filtro con el que arranca (qmc_set_filter() lo cambia en caliente) */
+#ifndef BRUJULA_FILTER
+#define BRUJULA_FILTER QMC_FILTER_ONE_EURO
+#endif
+
+/* Numeros medidos con host/bench (./bench filter), ver README */
+const struct rumbo_filter_cfg qmc_filters[QMC_FILTER_COUNT] = {
+    [QMC_FILTER_EMA] = { "ema", RUMBO_FILTER_EMA, ALPHA_Q15, 0, 0, 0 },
+    [QMC_FILTER_ONE_EURO] =
+        { "1euro", RUMBO_FILTER_ONE_EURO, 0, 0.05f, 5.0f, 1.0f },
+};
+
+/* Filtro del kernel en punto fijo; alpha_q15 == 0: todavia sin configurar */
+static const struct rumbo_filter_cfg *filter_cfg = &qmc_filters[BRUJULA_FILTER];
+static struct rumbo_filter filt;
+static uint32_t pipeline_gen;   // sube con cada cambio que corta el filtro
+
+/* Filtro de la referencia en float */
+static float fx = 0.0f;   // X filtrado
+static float fz = 0.0f;   // Z filtrado
+static int initialized = 0;
+
+static struct i2c_stats stats;
+
+/* Calibracion activa: offsets en cuentas de 8G, W (soft-iron) en Q12 */
+static float cal_off8[3] = { OFF_X, OFF_Y, OFF_Z };
+static float cal_wf[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+static int32_t cal_off[3] = { OFF_X, OFF_Y, OFF_Z };   // rango activo
+static int32_t cal_w[3][3] = {
+    { 1 << CAL_W_Q, 0, 0 }, { 0, 1 << CAL_W_Q, 0 }, { 0, 0, 1 << CAL_W_Q },
+};
 
- 
- /* ================= DELAY ================= */
- 
-  void delay( uint32_t n)
- {
-     while (n--) __asm__("nop");
- }
- 
- /* ================= USB CDC ================= */
- 
-  void system_init(void)
- {
-     rcc_clock_setup_pll(
-         &rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
- 
-     devoptab_list[0] = &dotab_cdcacm;
-     devoptab_list[1] = &dotab_cdcacm;
-     devoptab_list[2] = &dotab_cdcacm;
- 
-     cdcacm_f429_init();
- }
- 
-  void init_console(void)
- {
-     setvbuf(stdout, NULL, _IONBF, 0);
- }
- 
- /* ================= I2C SETUP ================= */
- 
-  void i2c_setup(void)
- {
-     rcc_periph_clock_enable(RCC_GPIOB);
-     rcc_periph_clock_enable(RCC_I2C1);
- 
-     /* PB6=SCL, PB7=SDA */
-     gpio_mode_setup(GPIOB, GPIO_MODE_AF,
-                     GPIO_PUPD_NONE, GPIO6 | GPIO7);
-     gpio_set_output_options(GPIOB, GPIO_OTYPE_OD,
-                             GPIO_OSPEED_50MHZ, GPIO6 | GPIO7);
-     gpio_set_af(GPIOB, GPIO_AF4, GPIO6 | GPIO7);
- 
-     i2c_reset(I2C1);
-     i2c_peripheral_disable(I2C1);
- 
-     i2c_set_speed(I2C1, i2c_speed_sm_100k,
-                   rcc_apb1_frequency / 1000000);
- 
-     i2c_peripheral_enable(I2C1);
- }
- 
- /* ================= I2C WRITE (timeout) ================= */
- 
-  int i2c_write_reg_timeout(uint8_t addr, uint8_t reg, uint8_t val)
- {
-     uint32_t t;
- 
-     i2c_send_start(I2C1);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_SB) break;
-     if (!t) goto err;
- 
-     i2c_send_7bit_address(I2C1, addr, I2C_WRITE);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_ADDR) break;
-     if (!t) goto err;
-     (void)I2C_SR2(I2C1);
- 
-     i2c_send_data(I2C1, reg);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_BTF) break;
-     if (!t) goto err;
- 
-     i2c_send_data(I2C1, val);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_BTF) break;
-     if (!t) goto err;
- 
-     i2c_send_stop(I2C1);
-     return 0;
- 
- err:
-     i2c_send_stop(I2C1);
-     return -1;
- }
- 
- /* ================= I2C READ ================= */
- 
-  uint8_t i2c_read_reg(uint8_t addr, uint8_t reg)
- {
-     uint8_t val = 0;
-     i2c_transfer7(I2C1, addr, &reg, 1, &val, 1);
-     return val;
- }
- 
- /* ================= QMC INIT ================= */
- 
-  void qmc_init(void)
- {
-     //printf("Esperando QMC power-up...\n\r");
-     delay(15000000);
- 
-     //printf("Reset QMC...\n\r");
-     while (i2c_write_reg_timeout(QMC_ADDR,
-                                 QMC_REG_SETRESET, 0x01) != 0)
-         delay(3000000);
- 
-     //printf("Config QMC...\n\r");
-     /* OSR=128, RNG=2G, ODR=10Hz, Continuous */
-     while (i2c_write_reg_timeout(QMC_ADDR,
-                                  QMC_REG_CONTROL, 0x11) != 0)
-         delay(3000000);
- }
- 
- /* ================= READ XYZ ================= */
- 
-  void qmc_read_xyz(int16_t *x, int16_t *y, int16_t *z)
- {
-     uint8_t status;
- 
-     /* Esperar DRDY */
-     do {
-         status = i2c_read_reg(QMC_ADDR, QMC_REG_STATUS);
-     } while (!(status & 0x01));
- 
-     uint8_t xl = i2c_read_reg(QMC_ADDR, 0x00);
-     uint8_t xh = i2c_read_reg(QMC_ADDR, 0x01);
-     uint8_t yl = i2c_read_reg(QMC_ADDR, 0x02);
-     uint8_t yh = i2c_read_reg(QMC_ADDR, 0x03);
-     uint8_t zl = i2c_read_reg(QMC_ADDR, 0x04);
-     uint8_t zh = i2c_read_reg(QMC_ADDR, 0x05);
- 
-     *x = (int16_t)((xh << 8) | xl);
-     *y = (int16_t)((yh << 8) | yl);
-     *z = (int16_t)((zh << 8) | zl);
- }
- 
- float qmc_read_heading(void)
+/* ================= PERFILES ================= */
+
+/* Numeros medidos con host/bench (./bench profiles), ver README */
+const struct qmc_profile qmc_profiles[QMC_PROFILE_COUNT] = {
+    [QMC_PROFILE_LEGACY] =
+        { "legacy", QMC_ODR_10HZ, QMC_RNG_8G, QMC_OSR_512, 100000 },
+    [QMC_PROFILE_LOWNOISE] =
+        { "lownoise", QMC_ODR_10HZ, QMC_RNG_2G, QMC_OSR_512, 100000 },
+    [QMC_PROFILE_50HZ] =
+        { "50hz", QMC_ODR_50HZ, QMC_RNG_8G, QMC_OSR_256, 400000 },
+    [QMC_PROFILE_100HZ] =
+        { "100hz", QMC_ODR_100HZ, QMC_RNG_8G, QMC_OSR_128, 400000 },
+    [QMC_PROFILE_200HZ] =
+        { "200hz", QMC_ODR_200HZ, QMC_RNG_8G, QMC_OSR_64, 400000 },
+};
+
+static const struct qmc_profile *active = &qmc_profiles[QMC_PROFILE_LEGACY];
+
+/* Los offsets hard-iron estan en cuentas de 8G del QMC (3000/G); esto
+ * las pasa a cuentas del chip en el rango activo (QMC 2G: 4x) */
+static float range_scale = 1.0f;
+
+static void cal_load(void);
+
+/* ================= DELAY ================= */
+
+void delay(uint32_t n)
 {
-    int16_t x, y, z;
+    hal_delay(n);
+}
+
+/* ================= I2C ================= */
+
+int i2c_write_reg_timeout(uint8_t addr, uint8_t reg, uint8_t val)
+{
+    stats.transactions++;
+    stats.bytes += 3;   // addr + reg + val
+    return hal_i2c_write(addr, reg, val);
+}
+
+/* Una sola transaccion: START addr reg Sr addr buf[0..len-1] STOP */
+int i2c_read_burst(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    MED_BEGIN(t0);
+    stats.transactions++;
+    stats.bytes += 3u + len;   // addr(W) + reg + addr(R) + datos
+    int err = hal_i2c_read(addr, reg, buf, len);
+    MED_END(MED_I2C, t0);
+    return err;
+}
+
+/* Igual que i2c_read_burst pero por DMA; done() corre en la interrupcion */
+int i2c_read_burst_async(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len,
+                         void (*done)(int status))
+{
+    stats.transactions++;
+    stats.bytes += 3u + len;
+    return hal_i2c_read_async(addr, reg, buf, len, done);
+}
+
+uint8_t i2c_read_reg(uint8_t addr, uint8_t reg)
+{
+    uint8_t val = 0;
+    i2c_read_burst(addr, reg, &val, 1);
+    return val;
+}
+
+void i2c_stats_get(struct i2c_stats *out)
+{
+    *out = stats;
+}
+
+void i2c_stats_reset(void)
+{
+    stats.transactions = 0;
+    stats.bytes = 0;
+}
+
+/* ================= QMC CONFIG ================= */
+
+uint8_t qmc_control_word(const struct qmc_profile *p)
+{
+    return (uint8_t)(p->osr | p->rng | p->odr | QMC_MODE_CONT);
+}
+
+/* El ODR que de verdad da el chip con ese perfil (magneto.c) */
+uint32_t qmc_odr_hz(const struct qmc_profile *p)
+{
+    return MAG_DRV->odr_hz(p);
+}
+
+/* Perfil que va a aplicar el proximo qmc_init(), sin tocar el bus */
+void qmc_set_profile(const struct qmc_profile *p)
+{
+    active = p;
+    range_scale = MAG_DRV->lsb_per_gauss(p) / 3000.0f;
+    cal_load();
+    rumbo_filter_init(&filt, filter_cfg, qmc_odr_hz(p));   // cortes en Hz
+    pipeline_gen++;
+}
+
+/*
+ * Cambia de perfil en caliente: velocidad del bus + los registros de
+ * control del chip (en el QMC, una escritura a 0x09). No hace falta el
+ * reset ni el delay de qmc_init(). No llamar con una lectura por DMA en
+ * curso.
+ */
+int qmc_configure(const struct qmc_profile *p)
+{
+    hal_i2c_set_speed(p->bus_hz);
+
+    if (MAG_DRV->configure(p) != 0)
+        return -1;
+
+    qmc_set_profile(p);
+    return 0;
+}
+
+const struct qmc_profile *qmc_active_profile(void)
+{
+    return active;
+}
+
+/* Filtro del rumbo; arranca de cero con el ODR del perfil activo */
+void qmc_set_filter(const struct rumbo_filter_cfg *cfg)
+{
+    filter_cfg = cfg;
+    rumbo_filter_init(&filt, cfg, qmc_odr_hz(active));
+    pipeline_gen++;
+}
+
+const struct rumbo_filter_cfg *qmc_active_filter(void)
+{
+    return filter_cfg;
+}
+
+static struct rumbo_filter *filter(void)
+{
+    if (!filt.alpha_q15)
+        rumbo_filter_init(&filt, filter_cfg, qmc_odr_hz(active));
+    return &filt;
+}
+
+/* ================= QMC INIT ================= */
+
+/* Chip-ID del chip activo (magneto.c) */
+int qmc_probe(void)
+{
+    return MAG_DRV->probe();
+}
+
+/* Con MAG_AUTO, el primer chip que conteste queda activo */
+static int probe_any(void)
+{
+#if BRUJULA_MAG == MAG_AUTO
+    int chip = mag_detect();
+    return chip >= 0 ? 0 : chip;
+#else
+    return qmc_probe();
+#endif
+}
+
+static int wait_ready(void)
+{
+    uint64_t t0 = time_us();
+    uint32_t wait = QMC_PROBE_FIRST_US;
+    int err;
 
-    qmc_read_xyz(&x, &y, &z);
+    while ((err = probe_any()) == -1) {
+        if (time_us() - t0 >= QMC_PROBE_BUDGET_US)
+            return -1;
+        sleep_us(wait);
+        wait = wait * 2 < QMC_PROBE_MAX_US ? wait * 2 : QMC_PROBE_MAX_US;
+    }
+    return err;
+}
+
+/* Unas pocas escrituras, sin esperas (QMC: tres) */
+int qmc_setup(void)
+{
+    if (MAG_DRV->setup() != 0)
+        return -1;
+
+    /* Perfil activo (por defecto 0x11: OSR=512, RNG=8G, ODR=10Hz, Continuous) */
+    return qmc_configure(active);
+}
+
+/* Registros a los valores de fabrica; despues hay que esperar el chip-ID */
+int qmc_soft_reset(void)
+{
+    return MAG_DRV->soft_reset();
+}
+
+int qmc_init(void)
+{
+    int err = wait_ready();
+
+    if (err)
+        return err;
+
+    /* Ya contesto el chip-ID: un NACK aca es un error del bus */
+    for (int i = 0; qmc_setup() != 0; i++) {
+        if (i == QMC_RETRIES - 1)
+            return -1;
+        sleep_us(QMC_RETRY_US);
+    }
+    return 0;
+}
 
-    /* Hard-iron correction */
-    x -= OFF_X;
-    y -= OFF_Y;
-    z -= OFF_Z;
+/* ================= READ XYZ ================= */
+
+/*
+ * Una transaccion con el bloque del chip (magneto.h). Con BRUJULA_MAG
+ * fijo, direccion, registro y largo son constantes y mag_decode() es
+ * inline: para el QMC queda la misma lectura de 7 bytes desde 0x06. El
+ * HMC lee antes el estado (MAG_READY_BIT; en los otros es 0 y el if no
+ * queda).
+ */
+int qmc_read_xyz(int16_t *x, int16_t *y, int16_t *z)
+{
+    uint8_t b[MAG_BLOCK_MAX];
+
+    if (MAG_READY_BIT &&
+        (i2c_read_burst(MAG_ADDR, MAG_READY_REG, b, 1) != 0 ||
+         !(b[0] & MAG_READY_BIT)))
+        return 0;
+
+    if (i2c_read_burst(MAG_ADDR, MAG_BLOCK_REG, b, MAG_BLOCK_LEN) != 0)
+        return 0;
+
+    return mag_decode(b, x, y, z);
+}
+
+int qmc_read_sample(struct qmc_sample *s)
+{
+    uint64_t t = time_us();
+
+    if (!qmc_read_xyz(&s->x, &s->y, &s->z))
+        return 0;
+
+    s->t_us = t;
+    return 1;
+}
+
+/* Temperatura relativa (100 LSB/°C), opcional; 0 si el chip no tiene */
+int qmc_read_temp(int16_t *t)
+{
+    return MAG_DRV->read_temp ? MAG_DRV->read_temp(t) : 0;
+}
+
+/* ================= CALIBRACION ================= */
+
+/* Offsets al rango activo y W a Q12: con |w| < 2 cada producto entra
+ * en 30 bits y la suma de los tres no desborda */
+static void cal_load(void)
+{
+    for (int i = 0; i < 3; i++) {
+        cal_off[i] = (int32_t)lrintf(cal_off8[i] * range_scale);
+        for (int j = 0; j < 3; j++) {
+            float w = cal_wf[i][j];
+            if (w > 1.999f) w = 1.999f;
+            if (w < -1.999f) w = -1.999f;
+            cal_w[i][j] = (int32_t)lrintf(w * (1 << CAL_W_Q));
+        }
+    }
+}
+
+/* r = resultado de cal_solve() en el rango activo; NULL = de fabrica */
+void qmc_set_calibration(const struct cal_result *r)
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            cal_wf[i][j] = r ? r->soft[i][j] : (float)(i == j);
+
+    cal_off8[0] = r ? r->offset[0] / range_scale : OFF_X;
+    cal_off8[1] = r ? r->offset[1] / range_scale : OFF_Y;
+    cal_off8[2] = r ? r->offset[2] / range_scale : OFF_Z;
+
+    cal_load();
+    qmc_heading_reset();   // el filtro tenia el campo sin corregir
+}
+
+/* La calibracion que usa el kernel: offsets del rango activo, W en Q12 */
+void qmc_calibration_q12(int32_t off[3], int32_t w[3][3])
+{
+    for (int i = 0; i < 3; i++) {
+        off[i] = cal_off[i];
+        for (int j = 0; j < 3; j++)
+            w[i][j] = cal_w[i][j];
+    }
+}
+
+/* ================= HEADING ================= */
+
+/* Hard-iron + soft-iron: campo horizontal corregido (filas X y Z de W) */
+static void cal_apply(int16_t x, int16_t y, int16_t z, int32_t *cx,
+                      int32_t *cz)
+{
+    int32_t dx = x - cal_off[0];
+    int32_t dy = y - cal_off[1];
+    int32_t dz = z - cal_off[2];
+
+    *cx = (cal_w[0][0] * dx + cal_w[0][1] * dy + cal_w[0][2] * dz +
+           (1 << (CAL_W_Q - 1))) >> CAL_W_Q;
+    *cz = (cal_w[2][0] * dx + cal_w[2][1] * dy + cal_w[2][2] * dz +
+           (1 << (CAL_W_Q - 1))) >> CAL_W_Q;
+}
+
+/*
+ * Kernel en punto fijo: rumbo en centesimas de grado (0..35999).
+ * Costo fijo: 3 restas + las filas X y Z de W (6 MAC) por muestra.
+ */
+int32_t qmc_heading_cdeg(int16_t x, int16_t y, int16_t z)
+{
+    int32_t cx, cz;
+    MED_BEGIN(t0);
+
+    cal_apply(x, y, z, &cx, &cz);
+
+    /* Filtro */
+    struct rumbo_filter *f = filter();
+    rumbo_filter_update(f, cx, cz);
+
+    int32_t cdeg = rumbo_atan2_cdeg(f->x.q, f->z.q);
+    MED_END(MED_HEADING, t0);
+    return cdeg;
+}
+
+/* Calibrado pero sin el EMA (entrada de fusion.h), no toca el filtro */
+int32_t qmc_heading_raw_cdeg(int16_t x, int16_t y, int16_t z)
+{
+    int32_t cx, cz;
+
+    cal_apply(x, y, z, &cx, &cz);
+    return rumbo_atan2_cdeg(cx, cz);
+}
+
+float qmc_heading_update(int16_t x, int16_t y, int16_t z)
+{
+    return qmc_heading_cdeg(x, y, z) / 100.0f;
+}
+
+/* Referencia en float (el camino original, EMA), para comparar */
+float qmc_heading_update_ref(int16_t x, int16_t y, int16_t z)
+{
+    /* Hard-iron + soft-iron, la misma calibracion que el kernel */
+    float dx = (float)(x - cal_off[0]);
+    float dy = (float)(y - cal_off[1]);
+    float dz = (float)(z - cal_off[2]);
+    float cx = cal_wf[0][0] * dx + cal_wf[0][1] * dy + cal_wf[0][2] * dz;
+    float cz = cal_wf[2][0] * dx + cal_wf[2][1] * dy + cal_wf[2][2] * dz;
 
     /* Filtro */
-    fx = fx + ALPHA * ((float)x - fx);
-    fz = fz + ALPHA * ((float)z - fz);
-
-    float heading = atan2f(fx, fz) * 180.0f / M_PI;
-    if (heading < 0) heading += 360.0f;
-
-    return heading;
-}
-
- /* ================= MAIN ================= */
- 
- int main(void)
- {
-     system_init();
-     init_console();
-     i2c_setup();
- 
-     qmc_init();
- 
-     while (1) {
-         float heading = qmc_read_heading();
-         printf("Heading = %.2f°\n\r", heading);
-         delay(3000000);
-     }
- }
- 
- 
\ No newline at end of file
+    if (!initialized) {
+        fx = cx;
+        fz = cz;
+        initialized = 1;
+    } else {
+        fx += ALPHA * (cx - fx);
+        fz += ALPHA * (cz - fz);
+    }
+
+    float h = atan2f(fx, fz) * 180.0f / M_PI;
+    if (h < 0) h += 360.0f;
+
+    return h;
+}
+
+void qmc_heading_reset(void)
+{
+    rumbo_filter_reset(filter());
+    initialized = 0;
+    pipeline_gen++;
+}
+
+int qmc_read_heading(float *heading)
+{
+    int16_t x, y, z;
+
+    if (!qmc_read_xyz(&x, &y, &z))
+        return 0;   // Sin dato nuevo
+
+    *heading = qmc_heading_update(x, y, z);
+    return 1;
+}
+
+/* ================= PIPELINE ================= */
+
+void qmc_pipeline_get(struct qmc_pipeline *p)
+{
+    const struct rumbo_filter *f = filter();
+    ptrdiff_t prof = active - qmc_profiles;
+    ptrdiff_t flt = filter_cfg - qmc_filters;
+
+    p->profile = prof >= 0 && prof < QMC_PROFILE_COUNT ? (uint8_t)prof : 0xFF;
+    p->filter = flt >= 0 && flt < QMC_FILTER_COUNT ? (uint8_t)flt : 0xFF;
+    memcpy(p->off8, cal_off8, sizeof(p->off8));
+    memcpy(p->soft, cal_wf, sizeof(p->soft));
+    p->x = f->x;
+    p->z = f->z;
+    p->dx = f->dx;
+    p->dz = f->dz;
+    p->px = f->px;
+    p->pz = f->pz;
+}
+
+/* Sin bus: perfil y filtro de las tablas, calibracion y estado tal cual */
+int qmc_pipeline_set(const struct qmc_pipeline *p)
+{
+    if (p->profile >= QMC_PROFILE_COUNT || p->filter >= QMC_FILTER_COUNT)
+        return -1;
+
+    filter_cfg = &qmc_filters[p->filter];
+    memcpy(cal_off8, p->off8, sizeof(cal_off8));
+    memcpy(cal_wf, p->soft, sizeof(cal_wf));
+    qmc_set_profile(&qmc_profiles[p->profile]);   // cal_load() + filtro
+
+    filt.x = p->x;
+    filt.z = p->z;
+    filt.dx = p->dx;
+    filt.dz = p->dz;
+    filt.px = p->px;
+    filt.pz = p->pz;
+    initialized = 0;
+    return 0;
+}
+
+uint32_t qmc_pipeline_gen(void)
+{
+    return pipeline_gen;
+}
+
+/* ================= ESTADO PERSISTENTE ================= */
+
+/* Registros del almacen (almacen.h); la version cambia con el formato */
+enum { REC_PROFILE = 1, REC_CAL, REC_FILTER };
+#define REC_PROFILE_V 1
+#define REC_CAL_V     1
+#define REC_FILTER_V  1
+
+struct rec_cal {
+    float off8[3];        // cuentas de 8G: no depende del rango
+    float soft[3][3];
+};
+
+struct rec_filter {
+    int32_t qx, qz;       // vector filtrado, Q12 (cualquier filtro)
+};
+
+static unsigned state_pending;   // esperan a que termine un borrado
+
+/*
+ * Perfil, calibracion y filtro desde la flash. Va antes de qmc_init():
+ * no toca el bus, y el primer rumbo ya sale calibrado y asentado.
+ */
+unsigned qmc_state_load(void)
+{
+    unsigned got = 0;
+    uint8_t prof;
+    struct rec_cal cal;
+    struct rec_filter flt;
+
+    store_init();
+    state_pending = 0;
+
+    if (store_read(REC_PROFILE, REC_PROFILE_V, &prof, sizeof(prof)) > 0 &&
+        prof < QMC_PROFILE_COUNT) {
+        qmc_set_profile(&qmc_profiles[prof]);
+        got |= QMC_STATE_PROFILE;
+    }
+
+    if (store_read(REC_CAL, REC_CAL_V, &cal, sizeof(cal)) > 0) {
+        memcpy(cal_off8, cal.off8, sizeof(cal_off8));
+        memcpy(cal_wf, cal.soft, sizeof(cal_wf));
+        cal_load();
+        got |= QMC_STATE_CAL;
+    }
+
+    /* Despues de la calibracion: el filtro esta en valores corregidos */
+    qmc_heading_reset();
+    if (store_read(REC_FILTER, REC_FILTER_V, &flt, sizeof(flt)) > 0) {
+        rumbo_filter_set(filter(), flt.qx, flt.qz);
+        fx = (float)flt.qx / (1 << RUMBO_EMA_Q);
+        fz = (float)flt.qz / (1 << RUMBO_EMA_Q);
+        initialized = 1;
+        got |= QMC_STATE_FILTER;
+    }
+
+    pipeline_gen++;
+
+    return got;
+}
+
+/* store_write() de un tipo: lo que no pudo por el borrado queda pendiente */
+static int state_write(unsigned bit, uint8_t type, uint8_t version,
+                       const void *buf, uint8_t len)
+{
+    int r = store_write(type, version, buf, len);
+
+    if (r > 0)
+        state_pending |= bit;
+    return r < 0 ? -1 : 0;
+}
+
+/*
+ * Guarda lo pedido (y lo pendiente, con los valores de ahora); lo que no
+ * cambio no gasta flash (store_write). 1 si algo espera un borrado.
+ */
+int qmc_state_save(unsigned what)
+{
+    int err = 0;
+
+    what |= state_pending;
+    state_pending = 0;
+
+    if (what & QMC_STATE_PROFILE) {
+        uint8_t prof = (uint8_t)(active - qmc_profiles);
+        err |= state_write(QMC_STATE_PROFILE, REC_PROFILE, REC_PROFILE_V,
+                           &prof, sizeof(prof));
+    }
+
+    if (what & QMC_STATE_CAL) {
+        struct rec_cal cal;
+        memcpy(cal.off8, cal_off8, sizeof(cal.off8));
+        memcpy(cal.soft, cal_wf, sizeof(cal.soft));
+        err |= state_write(QMC_STATE_CAL, REC_CAL, REC_CAL_V, &cal,
+                           sizeof(cal));
+    }
+
+    if ((what & QMC_STATE_FILTER) && filt.x.init) {
+        struct rec_filter flt = { filt.x.q, filt.z.q };
+        err |= state_write(QMC_STATE_FILTER, REC_FILTER, REC_FILTER_V, &flt,
+                           sizeof(flt));
+    }
+
+    return err ? -1 : state_pending ? 1 : 0;
+}
+
+/* Sigue el borrado del almacen y guarda lo pendiente cuando termina */
+int qmc_state_poll(void)
+{
+    int r = store_poll();
+
+    if (r != 0 || !state_pending)
+        return r;
+    return qmc_state_save(0);
+}
+
+/* ================= MAIN ================= */
+
+#ifdef BRUJULA_CONSOLE
+int main(void)
+{
+    system_init();
+    init_console();
+    i2c_setup();
+
+    qmc_init();
+
+    while (1) {
+        float heading;
+        while (!qmc_read_heading(&heading))
+            ;
+        printf("Heading = %.2f°\n\r", heading);
+        sleep_us(70000);
+    }
+}
+#endif
@@ -3,15 +3,151 @@
 
 #include <stdint.h>
 
-/* Sistema */
+#include "magneto.h"
+#include "rumbo.h"
+
+/* Sistema (implementado por la HAL: hal_stm32.c / host/hal_host.c) */
 void system_init(void);
 void init_console(void);
 void i2c_setup(void);
 void delay(uint32_t n);
 
-/* QMC5883L */
-void qmc_init(void);
-void qmc_read_xyz(int16_t *x, int16_t *y, int16_t *z);
-float qmc_read_heading(void);
+/* I2C */
+uint8_t i2c_read_reg(uint8_t addr, uint8_t reg);
+int i2c_read_burst(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+int i2c_read_burst_async(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len,
+                         void (*done)(int status));
+int i2c_write_reg_timeout(uint8_t addr, uint8_t reg, uint8_t val);
+
+/* Contadores del bus (bytes en el cable, incluye direcciones) */
+struct i2c_stats {
+    uint32_t transactions;
+    uint32_t bytes;
+};
+
+void i2c_stats_get(struct i2c_stats *out);
+void i2c_stats_reset(void);
+
+/*
+ * Sensor: el chip sale de BRUJULA_MAG (magneto.h). Las funciones qmc_*
+ * quedan con el nombre de siempre y sirven para los tres chips.
+ */
+
+/* Registro de control 0x09 del QMC: MODE | ODR | RNG | OSR */
+#define QMC_MODE_CONT  0x01
+
+#define QMC_ODR_10HZ   0x00
+#define QMC_ODR_50HZ   0x04
+#define QMC_ODR_100HZ  0x08
+#define QMC_ODR_200HZ  0x0C
+
+#define QMC_RNG_2G     0x00
+#define QMC_RNG_8G     0x10
+
+#define QMC_OSR_512    0x00
+#define QMC_OSR_256    0x40
+#define QMC_OSR_128    0x80
+#define QMC_OSR_64     0xC0
+
+/* Perfil de configuracion del sensor + bus, en codigos del QMC */
+struct qmc_profile {
+    const char *name;
+    uint8_t odr;
+    uint8_t rng;
+    uint8_t osr;
+    uint32_t bus_hz;   // 100000 o 400000
+};
+
+enum {
+    QMC_PROFILE_LEGACY,    // 0x11 de siempre: 10 Hz, 8G, OSR 512, 100 kHz
+    QMC_PROFILE_LOWNOISE,  // 10 Hz, 2G, OSR 512, 100 kHz
+    QMC_PROFILE_50HZ,      // 50 Hz, 8G, OSR 256, 400 kHz
+    QMC_PROFILE_100HZ,     // 100 Hz, 8G, OSR 128, 400 kHz
+    QMC_PROFILE_200HZ,     // 200 Hz, 8G, OSR 64, 400 kHz
+    QMC_PROFILE_COUNT
+};
+
+extern const struct qmc_profile qmc_profiles[QMC_PROFILE_COUNT];
+
+uint8_t qmc_control_word(const struct qmc_profile *p);
+uint32_t qmc_odr_hz(const struct qmc_profile *p);   // el del chip
+void qmc_set_profile(const struct qmc_profile *p);
+int qmc_configure(const struct qmc_profile *p);
+const struct qmc_profile *qmc_active_profile(void);
+
+/* Filtros del rumbo (rumbo.h); BRUJULA_FILTER elige el de arranque */
+enum {
+    QMC_FILTER_EMA,        // alpha 0.01 fijo por muestra (el de siempre)
+    QMC_FILTER_ONE_EURO,   // corte 0.05 Hz quieto, sube con el giro
+    QMC_FILTER_COUNT
+};
+
+extern const struct rumbo_filter_cfg qmc_filters[QMC_FILTER_COUNT];
+
+void qmc_set_filter(const struct rumbo_filter_cfg *cfg);
+const struct rumbo_filter_cfg *qmc_active_filter(void);
+
+/*
+ * Arranque del sensor: pregunta el chip-ID hasta que contesta (el chip da
+ * NACK mientras dura su power-on), con espera creciente y un tope, y
+ * despues setup + perfil activo. -1: no contesto, -2: otro chip. Con
+ * MAG_AUTO pregunta los tres chips y se queda con el que contesta.
+ */
+int qmc_init(void);
+int qmc_probe(void);   // una lectura del chip-ID: 0, -1 o -2
+int qmc_setup(void);   // setup del chip (QMC: SET/RESET, ROL_PNT) y perfil
+int qmc_soft_reset(void);
+/* Muestra cruda con marca de tiempo (time_us() del DRDY) */
+struct qmc_sample {
+    int16_t x, y, z;
+    uint64_t t_us;
+};
+
+int qmc_read_xyz(int16_t *x, int16_t *y, int16_t *z);
+int qmc_read_sample(struct qmc_sample *s);
+int qmc_read_temp(int16_t *t);
+struct cal_result;
+void qmc_set_calibration(const struct cal_result *r);   // NULL: de fabrica
+#define CAL_W_Q 12   // fraccion de W en qmc_calibration_q12()
+void qmc_calibration_q12(int32_t off[3], int32_t w[3][3]);   // |w| < 2
+int32_t qmc_heading_cdeg(int16_t x, int16_t y, int16_t z);
+int32_t qmc_heading_raw_cdeg(int16_t x, int16_t y, int16_t z);
+float qmc_heading_update(int16_t x, int16_t y, int16_t z);
+float qmc_heading_update_ref(int16_t x, int16_t y, int16_t z);
+void qmc_heading_reset(void);
+int qmc_read_heading(float *heading);
+
+/*
+ * Todo lo que decide el rumbo de la proxima muestra: perfil, filtro,
+ * calibracion y el estado del filtro. La telemetria lo manda cuando
+ * cambia (qmc_pipeline_gen() sube) y host/repeticion.h lo repone para
+ * correr una captura por el mismo codigo. Indices 0xFF: fuera de tabla.
+ */
+struct qmc_pipeline {
+    uint8_t profile;
+    uint8_t filter;
+    float off8[3];              // hard-iron, cuentas de 8G
+    float soft[3][3];
+    struct rumbo_ema x, z, dx, dz;
+    int32_t px, pz;
+};
+
+void qmc_pipeline_get(struct qmc_pipeline *p);
+int qmc_pipeline_set(const struct qmc_pipeline *p);
+uint32_t qmc_pipeline_gen(void);
+
+/* Estado en flash (almacen.h): bits de lo que se cargo / hay que guardar */
+#define QMC_STATE_PROFILE 0x01
+#define QMC_STATE_CAL     0x02
+#define QMC_STATE_FILTER  0x04
+#define QMC_STATE_ALL     0x07
+
+/*
+ * qmc_state_save() no espera el borrado de la flash: 1 = quedo algo
+ * pendiente, que guarda qmc_state_poll() (en housekeeping) al terminar.
+ */
+unsigned qmc_state_load(void);
+int qmc_state_save(unsigned what);
+int qmc_state_poll(void);
 
 #endif /* Brujula_H */
@@ -0,0 +1,326 @@
+/*
+ * Calibracion hard-iron + soft-iron en linea (ver calibracion.h)
+ */
+#include "calibracion.h"
+#include "rumbo.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Coordenadas escaladas para que las sumas de x⁴ queden cerca de 1 */
+#define CAL_SCALE 1024.0
+
+/* Pivote de Cholesky relativo a la diagonal: por debajo, sin solucion */
+#define CAL_PIVOT_MIN 1e-12
+
+/* Posicion de (i, j), j >= i, en el triangulo superior empaquetado */
+#define TRI(i, j) ((i) * CAL_NPARAM - (i) * ((i) - 1) / 2 + (j) - (i))
+
+/* Terminos que usa cada modelo (phi = x², y², z², 2xy, 2xz, 2yz, 2x, 2y, 2z) */
+static const uint8_t planar_terms[5] = { 0, 2, 4, 6, 8 };
+static const uint8_t ellipsoid_terms[9] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+
+/* ================= ACUMULACION ================= */
+
+void cal_reset(struct cal_state *st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+static void mark_coverage(struct cal_state *st, int16_t x, int16_t y,
+                          int16_t z)
+{
+    int32_t dx = x - (st->min[0] + st->max[0]) / 2;
+    int32_t dy = y - (st->min[1] + st->max[1]) / 2;
+    int32_t dz = z - (st->min[2] + st->max[2]) / 2;
+
+    if (!dx && !dy && !dz)
+        return;
+
+    int32_t az = rumbo_atan2_cdeg(dx, dz);
+    st->sectors |= 1ull << (az * CAL_SECTORS / 36000);
+
+    /* Bandas iguales de y/|v| = celdas de igual area en la esfera */
+    float r = sqrtf((float)dx * dx + (float)dy * dy + (float)dz * dz);
+    int el = (int)((dy / r + 1.0f) * (CAL_EL_BINS / 2.0f));
+    if (el >= CAL_EL_BINS)
+        el = CAL_EL_BINS - 1;
+
+    int cell = el * CAL_AZ_BINS + az * CAL_AZ_BINS / 36000;
+    st->cells[cell / 8] |= (uint8_t)(1u << (cell % 8));
+}
+
+/* ~45 MAC en double por muestra, sin guardar nada */
+void cal_add(struct cal_state *st, int16_t x, int16_t y, int16_t z)
+{
+    double u = x / CAL_SCALE, v = y / CAL_SCALE, w = z / CAL_SCALE;
+    const double phi[CAL_NPARAM] = {
+        u * u, v * v, w * w, 2 * u * v, 2 * u * w, 2 * v * w,
+        2 * u, 2 * v, 2 * w,
+    };
+    double *a = st->ata;
+
+    for (int i = 0; i < CAL_NPARAM; i++) {
+        for (int j = i; j < CAL_NPARAM; j++)
+            *a++ += phi[i] * phi[j];
+        st->atb[i] += phi[i];
+    }
+
+    const int16_t m[3] = { x, y, z };
+    for (int i = 0; i < 3; i++) {
+        if (!st->n || m[i] < st->min[i])
+            st->min[i] = m[i];
+        if (!st->n || m[i] > st->max[i])
+            st->max[i] = m[i];
+    }
+    st->n++;
+
+    mark_coverage(st, x, y, z);
+}
+
+static int popcount(const uint8_t *b, int nbytes)
+{
+    int n = 0;
+
+    for (int i = 0; i < nbytes; i++)
+        for (uint8_t v = b[i]; v; v &= (uint8_t)(v - 1))
+            n++;
+    return n;
+}
+
+float cal_coverage(const struct cal_state *st, enum cal_model model)
+{
+    if (model == CAL_ELLIPSOID)
+        return (float)popcount(st->cells, sizeof(st->cells)) /
+               (CAL_AZ_BINS * CAL_EL_BINS);
+
+    uint8_t b[8];
+    for (int i = 0; i < 8; i++)
+        b[i] = (uint8_t)(st->sectors >> (8 * i));
+    return (float)popcount(b, sizeof(b)) / CAL_SECTORS;
+}
+
+/* ================= ALGEBRA ================= */
+
+/* m (n x n, simetrica) = L·Lᵀ en el lugar; despues L·Lᵀ·x = b */
+static int cholesky_solve(double *m, double *b, int n)
+{
+    for (int j = 0; j < n; j++) {
+        double d = m[j * n + j];
+        double tiny = fabs(d) * CAL_PIVOT_MIN;
+
+        for (int k = 0; k < j; k++)
+            d -= m[j * n + k] * m[j * n + k];
+        if (!(d > tiny))
+            return -1;
+
+        d = sqrt(d);
+        m[j * n + j] = d;
+        for (int i = j + 1; i < n; i++) {
+            double s = m[i * n + j];
+            for (int k = 0; k < j; k++)
+                s -= m[i * n + k] * m[j * n + k];
+            m[i * n + j] = s / d;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < i; k++)
+            b[i] -= m[i * n + k] * b[k];
+        b[i] /= m[i * n + i];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        for (int k = i + 1; k < n; k++)
+            b[i] -= m[k * n + i] * b[k];
+        b[i] /= m[i * n + i];
+    }
+    return 0;
+}
+
+/* Jacobi ciclico: a queda diagonal, las columnas de v son los autovectores */
+static void jacobi3(double a[3][3], double v[3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            v[i][j] = i == j;
+
+    for (int sweep = 0; sweep < 16; sweep++) {
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] +
+                     a[1][2] * a[1][2];
+        if (off < 1e-30)
+            break;
+
+        for (int p = 0; p < 2; p++)
+            for (int q = p + 1; q < 3; q++) {
+                if (a[p][q] == 0.0)
+                    continue;
+
+                double th = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                double t = (th >= 0 ? 1.0 : -1.0) /
+                           (fabs(th) + sqrt(th * th + 1));
+                double c = 1 / sqrt(t * t + 1), s = t * c;
+
+                for (int k = 0; k < 3; k++) {
+                    double kp = a[k][p], kq = a[k][q];
+                    a[k][p] = c * kp - s * kq;
+                    a[k][q] = s * kp + c * kq;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double pk = a[p][k], qk = a[q][k];
+                    a[p][k] = c * pk - s * qk;
+                    a[q][k] = s * pk + c * qk;
+                }
+                for (int k = 0; k < 3; k++) {
+                    double kp = v[k][p], kq = v[k][q];
+                    v[k][p] = c * kp - s * kq;
+                    v[k][q] = s * kp + c * kq;
+                }
+            }
+    }
+}
+
+static double det3(double m[3][3])
+{
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+/* c = -A⁻¹·b por Cramer */
+static int center3(double a[3][3], const double b[3], double c[3])
+{
+    double d = det3(a);
+
+    if (d == 0.0)
+        return -1;
+
+    for (int k = 0; k < 3; k++) {
+        double t[3][3];
+        memcpy(t, a, sizeof(t));
+        for (int i = 0; i < 3; i++)
+            t[i][k] = -b[i];
+        c[k] = det3(t) / d;
+    }
+    return 0;
+}
+
+/* ================= AJUSTE ================= */
+
+static int solve_model(const struct cal_state *st, enum cal_model model,
+                       struct cal_result *out)
+{
+    const uint8_t *terms = model == CAL_PLANAR ? planar_terms
+                                               : ellipsoid_terms;
+    const int n = model == CAL_PLANAR ? 5 : CAL_NPARAM;
+    double m[CAL_NPARAM * CAL_NPARAM], b[CAL_NPARAM], p[CAL_NPARAM] = { 0 };
+
+    memset(out, 0, sizeof(*out));
+    out->model = model;
+    out->samples = st->n;
+    out->coverage = cal_coverage(st, model);
+
+    if (st->n < (uint32_t)n)
+        return -1;
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int r = terms[i], c = terms[j];
+            m[i * n + j] = r <= c ? st->ata[TRI(r, c)] : st->ata[TRI(c, r)];
+        }
+        b[i] = st->atb[terms[i]];
+    }
+
+    /* Residuo de phi·p = 1 sin volver a ver las muestras: pᵀMp - 2pᵀb + n */
+    double mm[CAL_NPARAM * CAL_NPARAM], sol[CAL_NPARAM];
+    memcpy(mm, m, sizeof(double) * n * n);
+    memcpy(sol, b, sizeof(double) * n);
+    if (cholesky_solve(mm, sol, n) != 0)
+        return -1;
+
+    double res = st->n;
+    for (int i = 0; i < n; i++) {
+        double mp = 0;
+        for (int j = 0; j < n; j++)
+            mp += m[i * n + j] * sol[j];
+        res += sol[i] * (mp - 2 * b[i]);
+        p[terms[i]] = sol[i];
+    }
+    if (res < 0)
+        res = 0;
+
+    /* Forma cuadratica (x-c)ᵀA(x-c) = k; en el plano la Y queda fuera */
+    double a[3][3] = {
+        { p[0], p[3], p[4] },
+        { p[3], p[1], p[5] },
+        { p[4], p[5], p[2] },
+    };
+    const double lin[3] = { p[6], p[7], p[8] };
+    double c[3];
+
+    if (model == CAL_PLANAR)
+        a[1][1] = 1.0;
+    if (center3(a, lin, c) != 0)
+        return -1;
+
+    double k = 1.0;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            k += c[i] * a[i][j] * c[j];
+    if (!(k > 0))
+        return -1;
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            a[i][j] /= k;
+    if (model == CAL_PLANAR)
+        a[1][1] = 1.0;
+
+    /* W = raiz de A por autovalores, escalada a det = 1 (o det 2x2 = 1) */
+    double v[3][3];
+    jacobi3(a, v);
+
+    double prod = 1.0;
+    for (int i = 0; i < 3; i++) {
+        if (!(a[i][i] > 0))
+            return -1;
+        prod *= a[i][i];
+    }
+    double g = model == CAL_PLANAR ? pow(prod, -0.25) : pow(prod, -1.0 / 6);
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            double s = 0;
+            for (int e = 0; e < 3; e++)
+                s += v[i][e] * sqrt(a[e][e]) * v[j][e];
+            if (model == CAL_ELLIPSOID || (i != 1 && j != 1))
+                s *= g;
+            out->soft[i][j] = (float)s;
+        }
+
+    for (int i = 0; i < 3; i++)
+        out->offset[i] = (float)(c[i] * CAL_SCALE);
+    if (model == CAL_PLANAR)
+        out->offset[1] = (st->min[1] + st->max[1]) / 2.0f;
+
+    /* phi·p - 1 = 2kδ para un error radial relativo δ chico */
+    out->radius = (float)(g * CAL_SCALE);
+    out->fit_err = (float)(sqrt(res / st->n) / (2 * k));
+    out->valid = 1;
+    out->converged =
+        st->n >= CAL_MIN_SAMPLES && out->fit_err <= CAL_MAX_FIT_ERR &&
+        out->coverage >= (model == CAL_PLANAR ? CAL_MIN_COVERAGE_2D
+                                              : CAL_MIN_COVERAGE_3D);
+    return 0;
+}
+
+int cal_solve(const struct cal_state *st, enum cal_model model,
+              struct cal_result *out)
+{
+    if (model != CAL_AUTO)
+        return solve_model(st, model, out);
+
+    if (cal_coverage(st, CAL_ELLIPSOID) >= CAL_MIN_COVERAGE_3D &&
+        solve_model(st, CAL_ELLIPSOID, out) == 0)
+        return 0;
+    return solve_model(st, CAL_PLANAR, out);
+}
@@ -0,0 +1,68 @@
+#ifndef Calibracion_H
+#define Calibracion_H
+
+/*
+ * Calibracion hard-iron + soft-iron en linea.
+ *
+ * Cada muestra cruda suma su fila a las ecuaciones normales del ajuste
+ * por minimos cuadrados de la cuadrica
+ *
+ *   a x² + b y² + c z² + 2d xy + 2e xz + 2f yz + 2g x + 2h y + 2i z = 1
+ *
+ * (45 + 9 acumuladores en double, memoria constante, no se guardan
+ * muestras). cal_solve() resuelve cuando se le pide: el centro es el
+ * hard-iron y W, la raiz de la forma cuadratica normalizada a det = 1,
+ * el soft-iron: W·(m - offset) cae sobre una esfera de radio 'radius'.
+ *
+ * CAL_PLANAR usa solo los terminos de X/Z (alcanza con girar la placa
+ * en el plano); CAL_ELLIPSOID necesita moverla en 3D. Los acumuladores
+ * estan en cuentas del rango activo: cal_reset() al cambiar de rango.
+ */
+
+#include <stdint.h>
+
+#define CAL_NPARAM  9
+#define CAL_SECTORS 36   // cobertura plana: sectores de 10° en X/Z
+#define CAL_AZ_BINS 12   // cobertura 3D: 12 x 6 celdas de igual area
+#define CAL_EL_BINS 6
+
+/* Criterio de convergencia */
+#define CAL_MIN_SAMPLES     100
+#define CAL_MIN_COVERAGE_2D 0.75f
+#define CAL_MIN_COVERAGE_3D 0.50f
+#define CAL_MAX_FIT_ERR     0.02f
+
+enum cal_model {
+    CAL_AUTO,        // elipsoide si hay cobertura 3D, si no plano
+    CAL_PLANAR,      // elipse en X/Z, 5 parametros
+    CAL_ELLIPSOID,   // elipsoide completo, 9 parametros
+};
+
+struct cal_state {
+    double ata[CAL_NPARAM * (CAL_NPARAM + 1) / 2];  // triangulo superior
+    double atb[CAL_NPARAM];
+    uint32_t n;
+    int16_t min[3], max[3];   // centro provisorio para la cobertura
+    uint64_t sectors;         // CAL_SECTORS bits
+    uint8_t cells[(CAL_AZ_BINS * CAL_EL_BINS + 7) / 8];
+};
+
+struct cal_result {
+    enum cal_model model;     // el que se resolvio
+    int valid;
+    int converged;            // valid + muestras + cobertura + error
+    float offset[3];          // hard-iron, cuentas
+    float soft[3][3];         // soft-iron, det = 1
+    float radius;             // cuentas
+    float fit_err;            // error radial rms relativo
+    float coverage;           // 0..1
+    uint32_t samples;
+};
+
+void cal_reset(struct cal_state *st);
+void cal_add(struct cal_state *st, int16_t x, int16_t y, int16_t z);
+float cal_coverage(const struct cal_state *st, enum cal_model model);
+int cal_solve(const struct cal_state *st, enum cal_model model,
+              struct cal_result *out);
+
+#endif /* Calibracion_H */
@@ -0,0 +1,59 @@
+/*
+ * Cola SPSC de muestras (ver cola.h)
+ */
+#include "cola.h"
+
+#include <string.h>
+
+#define COLA_MASK (COLA_LEN - 1)
+
+_Static_assert((COLA_LEN & COLA_MASK) == 0, "COLA_LEN potencia de 2");
+
+void cola_init(struct cola *c)
+{
+    memset(c, 0, sizeof(*c));
+}
+
+/* Solo el productor */
+int cola_push(struct cola *c, const struct qmc_sample *s)
+{
+    uint32_t head = __atomic_load_n(&c->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= COLA_LEN) {
+        c->overruns++;
+        return -1;
+    }
+
+    c->buf[head & COLA_MASK] = *s;
+    __atomic_store_n(&c->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Solo el consumidor: hasta max muestras, en orden */
+int cola_drain(struct cola *c, struct qmc_sample *out, int max)
+{
+    uint32_t tail = __atomic_load_n(&c->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&c->head, __ATOMIC_ACQUIRE);
+    uint32_t n = head - tail;
+
+    if (!n) {
+        c->underruns++;
+        return 0;
+    }
+    if (n > c->high_water)
+        c->high_water = n;
+    if (n > (uint32_t)max)
+        n = (uint32_t)max;
+
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = c->buf[(tail + i) & COLA_MASK];
+    __atomic_store_n(&c->tail, tail + n, __ATOMIC_RELEASE);
+    return (int)n;
+}
+
+uint32_t cola_count(const struct cola *c)
+{
+    return __atomic_load_n(&c->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,39 @@
+#ifndef Cola_H
+#define Cola_H
+
+/*
+ * Cola de muestras entre la adquisicion y el loop principal.
+ *
+ * Un productor (on_sample() desde la interrupcion del DMA, o acq_service()
+ * en ACQ_POLL) y un consumidor (main), sin cortar interrupciones: head lo
+ * escribe solo el productor y tail solo el consumidor, publicados con
+ * release/acquire. Los indices corren libres y se enmascaran al usar.
+ *
+ * Si la cola esta llena la muestra nueva se descarta (overruns): el
+ * productor no puede tocar tail. cola_drain() saca en lote lo que haya,
+ * asi el filtro procesa todas las muestras de un frame y no solo la
+ * ultima; si no habia nada cuenta un underrun.
+ */
+
+#include <stdint.h>
+
+#include "brujula.h"
+
+#define COLA_LEN 64   // potencia de 2: 320 ms a 200 Hz, mas que un frame
+
+struct cola {
+    struct qmc_sample buf[COLA_LEN];
+    uint32_t head;        // lo escribe el productor
+    uint32_t tail;        // lo escribe el consumidor
+
+    uint32_t overruns;    // productor: muestras descartadas
+    uint32_t underruns;   // consumidor: drain con la cola vacia
+    uint32_t high_water;  // consumidor: mayor ocupacion vista
+};
+
+void cola_init(struct cola *c);
+int cola_push(struct cola *c, const struct qmc_sample *s);   // 0 o -1 (llena)
+int cola_drain(struct cola *c, struct qmc_sample *out, int max);
+uint32_t cola_count(const struct cola *c);
+
+#endif /* Cola_H */
@@ -0,0 +1,300 @@
+/*
+ * Diezmado del campo para la pantalla (ver diezmado.h)
+ */
+#include "diezmado.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEC_H_Q 15
+#define DEC_POST_Q 2   // entrada del filtro: 1/4 de cuenta, entra en Q12
+
+const struct dec_cfg dec_display = {
+    "display", 50, 60, 10.0f,
+};
+
+/* ================= DSP ================= */
+
+/*
+ * Dos int16 por palabra (el primero abajo). En el M4 son las
+ * instrucciones; en C la misma cuenta: SMLAD suma con vuelta (el flag Q
+ * no se usa), QSUB16 y SSAT saturan.
+ */
+static inline uint32_t pack16(int32_t lo, int32_t hi)
+{
+    return (uint16_t)lo | (uint32_t)(uint16_t)hi << 16;
+}
+
+static inline uint32_t load16x2(const int16_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));   // LDR, el M4 acepta desalineado
+    return v;
+}
+
+#if defined(__ARM_FEATURE_SIMD32)
+
+static inline int32_t smlad(uint32_t a, uint32_t b, int32_t acc)
+{
+    return __smlad(a, b, acc);
+}
+
+static inline uint32_t qsub16(uint32_t a, uint32_t b)
+{
+    return __qsub16(a, b);
+}
+
+#define sat16(v) __ssat((v), 16)
+
+#else
+
+static inline int32_t smlad(uint32_t a, uint32_t b, int32_t acc)
+{
+    int32_t lo = (int16_t)a * (int16_t)b;
+    int32_t hi = (int16_t)(a >> 16) * (int16_t)(b >> 16);
+
+    return (int32_t)((uint32_t)acc + (uint32_t)lo + (uint32_t)hi);
+}
+
+static inline int32_t sat16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+static inline uint32_t qsub16(uint32_t a, uint32_t b)
+{
+    return pack16(sat16((int16_t)a - (int16_t)b),
+                  sat16((int16_t)(a >> 16) - (int16_t)(b >> 16)));
+}
+
+#endif
+
+/* ================= DISENO ================= */
+
+/* Sinc con ventana de Hamming, Q15, la suma justo 1 << 15 */
+static void design(struct dec_filter *d)
+{
+    float fc = d->cfg->cutoff_hz / (float)d->odr_hz;   // ciclos por muestra
+    float c = (d->taps - 1) * 0.5f;
+    float h[DEC_MAX_TAPS];
+    float sum = 0.0f;
+    int32_t isum = 0;
+
+    for (int k = 0; k < d->taps; k++) {
+        float t = k - c;   // nunca 0: taps es par
+        float w = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * k /
+                                       (d->taps - 1));
+        h[k] = sinf(2.0f * (float)M_PI * fc * t) / ((float)M_PI * t) * w;
+        sum += h[k];
+    }
+
+    for (int k = 0; k < d->taps; k++) {
+        d->h[k] = (int16_t)lrintf(h[k] / sum * (1 << DEC_H_Q));
+        isum += d->h[k];
+    }
+
+    /* El redondeo, a los dos del centro (sigue simetrico si es par) */
+    int32_t r = (1 << DEC_H_Q) - isum;
+    d->h[d->taps / 2 - 1] += (int16_t)(r / 2);
+    d->h[d->taps / 2] += (int16_t)(r - r / 2);
+}
+
+/* Calibracion y filtro de salida del pipeline activo */
+static void load_pipeline(struct dec_filter *d)
+{
+    int32_t off[3], w[3][3];
+
+    qmc_calibration_q12(off, w);
+    d->off_xy = pack16(sat16(off[0]), sat16(off[1]));
+    d->off_z = (int16_t)sat16(off[2]);
+    d->w0_xy = pack16(w[0][0], w[0][1]);
+    d->w0_z = (int16_t)w[0][2];
+    d->w2_xy = pack16(w[2][0], w[2][1]);
+    d->w2_z = (int16_t)w[2][2];
+    rumbo_filter_init(&d->post, qmc_active_filter(), d->odr_hz / d->m);
+    d->gen = qmc_pipeline_gen();
+}
+
+static void setup(struct dec_filter *d, uint32_t odr_hz)
+{
+    uint32_t taps = odr_hz * d->cfg->window_ms / 1000u;
+
+    taps &= ~1u;
+    if (taps < 2)
+        taps = 2;
+    if (taps > DEC_MAX_TAPS)
+        taps = DEC_MAX_TAPS;
+
+    d->odr_hz = odr_hz;
+    d->taps = (uint16_t)taps;
+    d->m = (uint16_t)(odr_hz > d->cfg->out_hz ? odr_hz / d->cfg->out_hz : 1);
+    design(d);
+}
+
+int dec_init(struct dec_filter *d, const struct dec_cfg *cfg,
+             uint32_t odr_hz)
+{
+    if (cfg->out_hz == 0)
+        return -1;
+
+    memset(d, 0, sizeof(*d));
+    d->cfg = cfg;
+    setup(d, odr_hz);
+    load_pipeline(d);
+    return 0;
+}
+
+/* La proxima muestra llena la historia (como el EMA con la primera) */
+void dec_reset(struct dec_filter *d)
+{
+    d->primed = 0;
+    rumbo_filter_reset(&d->post);
+}
+
+/* ================= POR MUESTRA ================= */
+
+/* cal_apply() de a pares: QSUB16 resta los offsets de X e Y juntos */
+static inline void calibrate(const struct dec_filter *d,
+                             const struct qmc_sample *s, int16_t *cx,
+                             int16_t *cz)
+{
+    uint32_t dxy = qsub16(pack16(s->x, s->y), d->off_xy);
+    int32_t dz = sat16((int32_t)s->z - d->off_z);
+    const int32_t half = 1 << (CAL_W_Q - 1);
+
+    *cx = (int16_t)sat16(smlad(d->w0_xy, dxy, d->w0_z * dz + half) >>
+                         CAL_W_Q);
+    *cz = (int16_t)sat16(smlad(d->w2_xy, dxy, d->w2_z * dz + half) >>
+                         CAL_W_Q);
+}
+
+/* h es simetrico: da igual que la ventana vaya de la mas vieja primero */
+static inline int32_t fir(const int16_t *v, const int16_t *h, int taps)
+{
+    int32_t acc = 0;
+
+    for (int k = 0; k < taps; k += 2)
+        acc = smlad(load16x2(v + k), load16x2(h + k), acc);
+
+    /* Q15 * cuentas -> Q12 */
+    return (acc + (1 << (DEC_H_Q - RUMBO_EMA_Q - 1))) >>
+           (DEC_H_Q - RUMBO_EMA_Q);
+}
+
+static void push(struct dec_filter *d, int16_t cx, int16_t cz)
+{
+    if (!d->primed) {
+        for (int k = 0; k < 2 * d->taps; k++) {
+            d->hx[k] = cx;
+            d->hz[k] = cz;
+        }
+        d->pos = 0;
+        d->phase = (uint16_t)(d->m - 1);   // sale una ya con la primera
+        d->primed = 1;
+        return;
+    }
+
+    d->hx[d->pos] = d->hx[d->pos + d->taps] = cx;
+    d->hz[d->pos] = d->hz[d->pos + d->taps] = cz;
+    if (++d->pos == d->taps)
+        d->pos = 0;
+}
+
+/* Calibracion, perfil o filtro nuevos: se arranca de nuevo */
+static void sync(struct dec_filter *d)
+{
+    if (qmc_pipeline_gen() == d->gen)
+        return;
+
+    uint32_t odr = qmc_odr_hz(qmc_active_profile());
+
+    if (odr != d->odr_hz)
+        setup(d, odr);
+    load_pipeline(d);
+    dec_reset(d);
+}
+
+int dec_process(struct dec_filter *d, const struct qmc_sample *in, int n,
+                struct dec_out *out, int max)
+{
+    int m = 0;
+
+    sync(d);
+
+    for (int i = 0; i < n; i++) {
+        int16_t cx, cz;
+
+        calibrate(d, &in[i], &cx, &cz);
+        push(d, cx, cz);
+
+        if (++d->phase < d->m)
+            continue;
+        d->phase = 0;
+        if (m == max)
+            continue;
+
+        /* La ventana: de pos (la mas vieja) a pos + taps - 1 */
+        struct dec_out *o = &out[m++];
+        o->x = fir(&d->hx[d->pos], d->h, d->taps);
+        o->z = fir(&d->hz[d->pos], d->h, d->taps);
+        rumbo_filter_update(&d->post, o->x >> (RUMBO_EMA_Q - DEC_POST_Q),
+                            o->z >> (RUMBO_EMA_Q - DEC_POST_Q));
+        o->cdeg = rumbo_atan2_cdeg(d->post.x.q, d->post.z.q);
+        o->t_us = in[i].t_us;
+        d->cdeg = o->cdeg;
+    }
+    return m;
+}
+
+/* ================= ESTADO ================= */
+
+void dec_state_get(struct dec_filter *d, struct dec_state *s)
+{
+    sync(d);
+
+    s->primed = d->primed;
+    s->phase = d->phase;
+    s->taps = d->taps;
+    memcpy(s->hx, &d->hx[d->pos], d->taps * sizeof(s->hx[0]));
+    memcpy(s->hz, &d->hz[d->pos], d->taps * sizeof(s->hz[0]));
+    s->x = d->post.x;
+    s->z = d->post.z;
+    s->dx = d->post.dx;
+    s->dz = d->post.dz;
+    s->px = d->post.px;
+    s->pz = d->post.pz;
+    s->cdeg = d->cdeg;
+}
+
+/* La historia queda con pos = 0: las dos copias iguales */
+int dec_state_set(struct dec_filter *d, const struct dec_state *s)
+{
+    sync(d);
+    if (s->taps != d->taps)
+        return -1;
+
+    d->primed = s->primed;
+    d->phase = s->phase;
+    d->pos = 0;
+    for (int k = 0; k < d->taps; k++) {
+        d->hx[k] = d->hx[k + d->taps] = s->hx[k];
+        d->hz[k] = d->hz[k + d->taps] = s->hz[k];
+    }
+    d->post.x = s->x;
+    d->post.z = s->z;
+    d->post.dx = s->dx;
+    d->post.dz = s->dz;
+    d->post.px = s->px;
+    d->post.pz = s->pz;
+    d->cdeg = s->cdeg;
+    return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef Diezmado_H
+#define Diezmado_H
+
+/*
+ * Diezmado del campo para la pantalla.
+ *
+ * El sensor corre rapido (200 Hz, OSR 64) y un FIR pasabajos lo baja a
+ * out_hz: el ruido de cada muestra es mas alto que a 10 Hz con OSR 512,
+ * pero el FIR promedia ~taps muestras con el retardo fijo de su centro,
+ * (taps - 1) / 2 muestras, sin la cola larga del EMA.
+ *
+ * Trabaja en lotes (lo que saca cola_drain): cada muestra cruda se
+ * calibra (la misma cuenta que cal_apply, Q12) y entra a la historia
+ * de X y Z en int16; el FIR solo se calcula cada M = odr / out_hz
+ * muestras, que es lo mismo que la forma polifasica: taps / M MAC por
+ * muestra de entrada y eje.
+ *
+ * Coeficientes en Q15 (sinc con ventana de Hamming, suma 1.0, simetrico)
+ * calculados una vez en dec_init. Las cuentas van de a dos int16 por
+ * palabra: en el Cortex-M4 con SMLAD / QSUB16 / SSAT, en otro lado con
+ * la misma aritmetica en C, asi el host da los mismos bits que la placa.
+ *
+ * A la salida va el filtro activo (qmc_active_filter(), el One-Euro por
+ * defecto) a out_hz, y de ahi el rumbo: el FIR le saca el ruido que
+ * trae el ODR alto y el One-Euro hace lo de siempre, quieto suaviza y
+ * girando abre.
+ *
+ * dec_display sale a 50 Hz con una ventana de 60 ms: el cuadro (20 por
+ * segundo) toma la salida mas nueva, que tiene a lo sumo 20 ms en vez de
+ * 50. Contra el camino de 10 Hz tiembla un tercio menos, asienta el
+ * escalon en la mitad y atrasa 10 a 20 ms menos. Contra el One-Euro por
+ * muestra a 100 Hz tiembla 40 % menos pero atrasa ~35 ms mas: 200 Hz con
+ * OSR 64 traen la misma informacion por segundo que 100 Hz con OSR 128,
+ * y el temblor de menos se paga con atraso (con 2 taps a 200 Hz sale lo
+ * mismo que el de 100 Hz). ./bench decim.
+ *
+ * Si la calibracion, el perfil o el filtro cambian (qmc_pipeline_gen())
+ * la historia y el filtro arrancan de nuevo con la muestra siguiente, y
+ * si cambio el ODR se recalculan M y los coeficientes.
+ */
+
+#include <stdint.h>
+
+#include "brujula.h"
+#include "rumbo.h"
+
+#define DEC_MAX_TAPS 32   // 160 ms a 200 Hz; entra en un TRAMA_DECIM
+
+struct dec_cfg {
+    const char *name;
+    uint32_t out_hz;       // tasa de salida
+    uint16_t window_ms;    // largo del FIR: taps = odr * window_ms (par)
+    float cutoff_hz;       // -6 dB
+};
+
+extern const struct dec_cfg dec_display;   // 50 Hz, el de impresion.c
+
+struct dec_out {
+    int32_t x, z;       // campo calibrado, salida del FIR, Q12
+    int32_t cdeg;       // rumbo despues del filtro, 0..35999
+    uint64_t t_us;      // muestra mas nueva que entro
+};
+
+struct dec_filter {
+    const struct dec_cfg *cfg;
+    uint32_t odr_hz;
+    uint16_t taps;
+    uint16_t m;            // muestras de entrada por salida
+    uint16_t pos;          // proxima posicion de la historia
+    uint16_t phase;        // muestras desde la ultima salida
+    uint8_t primed;        // hay historia
+    uint32_t gen;          // qmc_pipeline_gen() de la calibracion cargada
+    int32_t cdeg;          // la ultima salida
+
+    /* Calibracion empaquetada: (x, y) en una palabra, z aparte */
+    uint32_t off_xy, w0_xy, w2_xy;
+    int16_t off_z, w0_z, w2_z;
+
+    struct rumbo_filter post;        // a out_hz
+
+    int16_t h[DEC_MAX_TAPS];         // Q15
+    int16_t hx[2 * DEC_MAX_TAPS];    // historia doble: ventana contigua
+    int16_t hz[2 * DEC_MAX_TAPS];
+};
+
+/* M = odr_hz / out_hz (al menos 1); -1 si out_hz es 0 */
+int dec_init(struct dec_filter *d, const struct dec_cfg *cfg,
+             uint32_t odr_hz);
+void dec_reset(struct dec_filter *d);
+/* Salidas que completo el lote (hasta max); la ultima es la mas nueva */
+int dec_process(struct dec_filter *d, const struct qmc_sample *in, int n,
+                struct dec_out *out, int max);
+
+/*
+ * Lo que hace falta para seguir igual en otro lado (la telemetria se lo
+ * pasa a host/repeticion.h): la historia de la mas vieja a la mas nueva,
+ * la fase, el filtro de salida y la ultima salida. dec_state_get() aplica
+ * antes un cambio de pipeline pendiente: es el estado de antes de la
+ * proxima muestra. dec_state_set() da -1 si taps no coincide.
+ */
+struct dec_state {
+    uint8_t primed;
+    uint16_t phase;
+    uint16_t taps;
+    int16_t hx[DEC_MAX_TAPS], hz[DEC_MAX_TAPS];
+    struct rumbo_ema x, z, dx, dz;
+    int32_t px, pz;
+    int32_t cdeg;
+};
+
+void dec_state_get(struct dec_filter *d, struct dec_state *s);
+int dec_state_set(struct dec_filter *d, const struct dec_state *s);
+
+#endif /* Diezmado_H */
@@ -0,0 +1,324 @@
+/*
+ * Escena retenida de la brujula (ver escena.h)
+ */
+#include "escena.h"
+#include "glifos.h"
+#include "interfaz.h"
+#include "pantalla.h"
+#include "polar.h"
+#include "sprites.h"
+#include "hal_gfx.h"
+#include "medida.h"
+#include "tiempo.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/* Lectura "%03d" en (95, 290) */
+#define READOUT_X 95
+#define READOUT_Y 290
+
+/* "!" rojo a la derecha de la lectura: sensor en recuperacion */
+#define FLAG_X (READOUT_X + 4 * GLYPH_W)
+
+#define MAX_RESTORED 40
+
+enum {
+    ITEM_ARROW,   // primero: los glifos van encima
+    ITEM_N, ITEM_S, ITEM_E, ITEM_W,
+    ITEM_D0, ITEM_D1, ITEM_D2,
+    ITEM_FLAG,
+    ITEM_COUNT
+};
+
+struct item {
+    struct scene_rect cur;    // lo que hay en pantalla
+    struct scene_rect next;   // lo que hay que dibujar
+    char c_cur, c_next;       // glifo, o angulo del sprite
+    int16_t deg_cur, deg_next;
+    uint16_t color;
+    uint8_t drawn;
+    const struct sprite_cache *sprite;  // NULL = glifo opaco
+};
+
+static struct item items[ITEM_COUNT];
+static struct glyph_atlas atlas;   // los glifos de los items, sobre blanco
+static struct scene_rect restored[MAX_RESTORED];
+static int nrestored;
+static int full_redraw;
+static struct scene_stats stats;
+
+/* Fondo estatico */
+#ifdef HOST_BUILD
+static uint16_t bg_mem[LCD_WIDTH * LCD_HEIGHT];
+#define SCENE_BG bg_mem
+#else
+/* SDRAM, 4 MB por encima de los frames de lcd-spi */
+#define SCENE_BG ((uint16_t *)(0xD0000000 + 0x400000))
+#endif
+
+/* ================= RECTANGULOS ================= */
+
+static int rect_intersects(const struct scene_rect *a,
+                           const struct scene_rect *b)
+{
+    return a->x < b->x + b->w && b->x < a->x + a->w &&
+           a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static int rect_equal(const struct scene_rect *a, const struct scene_rect *b)
+{
+    return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h;
+}
+
+/* a - b en hasta 4 franjas (arriba, abajo, izquierda, derecha) */
+static int rect_subtract(const struct scene_rect *a,
+                         const struct scene_rect *b, struct scene_rect *out)
+{
+    int n = 0;
+
+    if (!rect_intersects(a, b)) {
+        out[n++] = *a;
+        return n;
+    }
+
+    int16_t top = b->y > a->y ? b->y : a->y;
+    int16_t bot = (b->y + b->h < a->y + a->h) ? b->y + b->h : a->y + a->h;
+
+    if (b->y > a->y)
+        out[n++] = (struct scene_rect){ a->x, a->y, a->w, b->y - a->y };
+    if (b->y + b->h < a->y + a->h)
+        out[n++] = (struct scene_rect){ a->x, bot, a->w,
+                                        a->y + a->h - bot };
+    if (b->x > a->x)
+        out[n++] = (struct scene_rect){ a->x, top, b->x - a->x, bot - top };
+    if (b->x + b->w < a->x + a->w)
+        out[n++] = (struct scene_rect){ b->x + b->w, top,
+                                        a->x + a->w - (b->x + b->w),
+                                        bot - top };
+    return n;
+}
+
+/* ================= FONDO ================= */
+
+static void bg_pixel(int x, int y, uint16_t color)
+{
+    if (x >= 0 && x < LCD_WIDTH && y >= 0 && y < LCD_HEIGHT)
+        SCENE_BG[y * LCD_WIDTH + x] = color;
+}
+
+static uint32_t restore_rect(const struct scene_rect *r)
+{
+    int16_t x0 = r->x < 0 ? 0 : r->x;
+    int16_t y0 = r->y < 0 ? 0 : r->y;
+    int16_t x1 = r->x + r->w > LCD_WIDTH ? LCD_WIDTH : r->x + r->w;
+    int16_t y1 = r->y + r->h > LCD_HEIGHT ? LCD_HEIGHT : r->y + r->h;
+
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    for (int16_t y = y0; y < y1; y++)
+        for (int16_t x = x0; x < x1; x++)
+            fb_draw_pixel(x, y, SCENE_BG[y * LCD_WIDTH + x]);
+
+    if (nrestored < MAX_RESTORED)
+        restored[nrestored++] = *r;
+    else
+        full_redraw = 1;   // no deberia pasar: 9 items x 4 franjas
+
+    return (uint32_t)(x1 - x0) * (uint32_t)(y1 - y0);
+}
+
+/* ================= ITEMS ================= */
+
+static void item_set(int i, int16_t x, int16_t y, char c)
+{
+    items[i].next = (struct scene_rect){ x, y, GLYPH_W, GLYPH_H };
+    items[i].c_next = c;
+}
+
+static int item_dirty(const struct item *it)
+{
+    return !it->drawn || it->c_cur != it->c_next ||
+           it->deg_cur != it->deg_next || !rect_equal(&it->cur, &it->next);
+}
+
+static uint32_t item_draw(struct item *it)
+{
+    uint32_t pixels;
+
+    if (it->sprite) {
+        sprite_blit(it->sprite, it->deg_next);
+        pixels = (uint32_t)it->next.w * (uint32_t)it->next.h;
+    } else {
+        if (!glyph_blit(&atlas, it->next.x, it->next.y, it->c_next,
+                        it->color))
+            gfx_drawChar(it->next.x, it->next.y, it->c_next, it->color,
+                         LCD_WHITE, GLYPH_SIZE);
+        pixels = GLYPH_W * GLYPH_H;
+    }
+    it->cur = it->next;
+    it->c_cur = it->c_next;
+    it->deg_cur = it->deg_next;
+    it->drawn = 1;
+    return pixels;
+}
+
+/* ================= API ================= */
+
+void scene_init(const struct sprite_cache *arrow)
+{
+    /* Lo estatico se rasteriza una vez al fondo */
+    gfx_init(bg_pixel, LCD_WIDTH, LCD_HEIGHT);
+    if (arrow)
+        draw_compass_rose();
+    else
+        draw_compass_UI();
+    gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+
+    memset(items, 0, sizeof(items));
+    if (arrow) {
+        items[ITEM_ARROW].sprite = arrow;
+        items[ITEM_ARROW].c_next = 1;
+        sprite_bounds(arrow, 0, &items[ITEM_ARROW].next);
+    }
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < ITEM_COUNT; i++)
+        items[i].color = LCD_BLACK;
+    items[ITEM_N].color = LCD_GREEN;
+    for (int i = ITEM_D0; i <= ITEM_D2; i++)
+        items[i].color = LCD_GREEN;
+    items[ITEM_FLAG].color = LCD_RED;
+
+    /* Cada glifo de la escena, una vez, en el color de su item */
+    glyph_atlas_init(&atlas, LCD_WHITE);
+    glyph_atlas_add(&atlas, "0123456789N", LCD_GREEN);
+    glyph_atlas_add(&atlas, "SEW", LCD_BLACK);
+    glyph_atlas_add(&atlas, "!", LCD_RED);
+
+    full_redraw = 1;
+}
+
+void scene_invalidate(void)
+{
+    full_redraw = 1;
+}
+
+void scene_set_arrow(int deg)
+{
+    struct item *it = &items[ITEM_ARROW];
+
+    if (!it->sprite)
+        return;
+
+    /* Mismo paso del cache = mismo sprite, no hay nada que redibujar */
+    deg %= 360;
+    if (deg < 0)
+        deg += 360;
+    deg = (deg + it->sprite->step / 2) / it->sprite->step %
+          it->sprite->nframes * it->sprite->step;
+
+    it->deg_next = (int16_t)deg;
+    sprite_bounds(it->sprite, deg, &it->next);
+}
+
+void scene_set_degraded(int on)
+{
+    if (on)
+        item_set(ITEM_FLAG, FLAG_X, READOUT_Y, '!');
+    else
+        items[ITEM_FLAG].c_next = 0;
+}
+
+void scene_set_heading(int north_deg)
+{
+    static const char glyph[4] = { 'N', 'S', 'E', 'W' };
+    static const int offset[4] = { 0, 180, -90, 90 };
+    int16_t x, y;
+
+    for (int i = 0; i < 4; i++) {
+        polar_position(north_deg + offset[i], &x, &y);
+        item_set(ITEM_N + i, x, y, glyph[i]);
+    }
+
+    /* Solo los digitos que cambian quedan sucios */
+    char d[3];
+    glyph_digits3(north_deg, d);
+    for (int i = 0; i < 3; i++)
+        item_set(ITEM_D0 + i, READOUT_X + i * GLYPH_W, READOUT_Y, d[i]);
+}
+
+void scene_render(void)
+{
+    MED_BEGIN(med_t0);
+    uint64_t t0 = time_us();
+    uint32_t pixels = 0;
+    uint8_t draw[ITEM_COUNT] = { 0 };
+    struct scene_rect strips[4];
+
+    nrestored = 0;
+
+    if (full_redraw) {
+        struct scene_rect all = { 0, 0, LCD_WIDTH, LCD_HEIGHT };
+        full_redraw = 0;
+        pixels += restore_rect(&all);
+        memset(draw, 1, sizeof(draw));
+    } else {
+        for (int i = 0; i < ITEM_COUNT; i++) {
+            struct item *it = &items[i];
+
+            if (!item_dirty(it))
+                continue;
+            draw[i] = 1;
+
+            /* Glifo que se apaga: vuelve el fondo */
+            if (it->drawn && !it->c_next && !it->sprite) {
+                pixels += restore_rect(&it->cur);
+                it->drawn = 0;
+                it->c_cur = 0;
+                continue;
+            }
+
+            /* Un sprite tiene transparencias: se devuelve todo el fondo */
+            if (it->drawn && it->sprite) {
+                pixels += restore_rect(&it->cur);
+                continue;
+            }
+
+            /* El glifo es opaco: solo hay que devolver lo que deja libre */
+            if (it->drawn && !rect_equal(&it->cur, &it->next)) {
+                int n = rect_subtract(&it->cur, &it->next, strips);
+                for (int k = 0; k < n; k++)
+                    pixels += restore_rect(&strips[k]);
+            }
+        }
+
+        /* Lo restaurado pudo pisar a un vecino que no cambio */
+        for (int i = 0; i < ITEM_COUNT; i++)
+            for (int k = 0; !draw[i] && k < nrestored; k++)
+                if (rect_intersects(&items[i].cur, &restored[k]))
+                    draw[i] = 1;
+    }
+
+    /* c_next == 0: glifo todavia sin asignar, o flecha sin sprite */
+    for (int i = 0; i < ITEM_COUNT; i++)
+        if (draw[i] && items[i].c_next)
+            pixels += item_draw(&items[i]);
+
+    uint32_t us = (uint32_t)(time_us() - t0);
+
+    stats.frames++;
+    stats.pixels_last = pixels;
+    stats.pixels_total += pixels;
+    if (pixels > stats.pixels_max)
+        stats.pixels_max = pixels;
+    stats.frame_us_last = us;
+    if (us > stats.frame_us_max)
+        stats.frame_us_max = us;
+    MED_END(MED_RENDER, med_t0);
+}
+
+void scene_stats_get(struct scene_stats *out)
+{
+    *out = stats;
+}
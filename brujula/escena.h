@@ -0,0 +1,46 @@
+#ifndef Escena_H
+#define Escena_H
+
+/*
+ * Escena retenida de la brujula.
+ *
+ * Lo estatico (titulo, cruz, circulos, flecha) se dibuja una sola vez en
+ * un fondo guardado en SDRAM. Lo dinamico (N/S/E/W y los tres digitos
+ * del rumbo) recuerda su rectangulo anterior: al cambiar el rumbo solo
+ * se restaura del fondo lo que quedo descubierto y se redibuja lo que
+ * cambio, en vez de gfx_fillScreen() + todo de nuevo. Los glifos se
+ * copian de un atlas pre-rasterizado (glifos.h).
+ *
+ * Con un cache de sprites (sprites.h) la flecha tambien es dinamica:
+ * sale del fondo y se dibuja girada con scene_set_arrow().
+ *
+ * scene_set_degraded(1) pone un "!" rojo junto al rumbo mientras el
+ * sensor se esta recuperando (recuperacion.h).
+ */
+
+#include <stdint.h>
+
+struct scene_rect {
+    int16_t x, y, w, h;
+};
+
+struct scene_stats {
+    uint32_t frames;
+    uint32_t pixels_last;     // pixeles escritos en el ultimo frame
+    uint32_t pixels_max;
+    uint64_t pixels_total;
+    uint32_t frame_us_last;
+    uint32_t frame_us_max;
+};
+
+struct sprite_cache;
+
+void scene_init(const struct sprite_cache *arrow);   // NULL: flecha fija
+void scene_set_heading(int north_deg);
+void scene_set_arrow(int deg);
+void scene_set_degraded(int on);
+void scene_render(void);
+void scene_invalidate(void);
+void scene_stats_get(struct scene_stats *out);
+
+#endif /* Escena_H */
@@ -0,0 +1,91 @@
+/*
+ * Fusion giroscopo + magnetometro (ver fusion.h)
+ */
+#include "fusion.h"
+
+#include <string.h>
+
+/* Un hueco mas largo (SPI ocupado, FIFO pisado) no se integra de una */
+#define FUSION_MAX_DT_S 0.5f
+
+static float wrap360(float d)
+{
+    while (d >= 360.0f)
+        d -= 360.0f;
+    while (d < 0.0f)
+        d += 360.0f;
+    return d;
+}
+
+static float wrap180(float d)
+{
+    while (d >= 180.0f)
+        d -= 360.0f;
+    while (d < -180.0f)
+        d += 360.0f;
+    return d;
+}
+
+static float seconds(uint64_t from_us, uint64_t to_us)
+{
+    return (float)(int64_t)(to_us - from_us) * 1e-6f;
+}
+
+void fusion_init(struct fusion *f, float tau_s)
+{
+    memset(f, 0, sizeof(*f));
+    f->kp = 2.0f / tau_s;
+    f->ki = 1.0f / (tau_s * tau_s);
+}
+
+void fusion_gyro(struct fusion *f, float rate_dps, uint64_t t_us)
+{
+    f->rate_dps = rate_dps - f->bias_dps;
+
+    if (f->init && t_us > f->gyro_us) {
+        float dt = seconds(f->gyro_us, t_us);
+        if (dt > FUSION_MAX_DT_S)
+            dt = FUSION_MAX_DT_S;
+        f->heading = wrap360(f->heading + f->rate_dps * dt);
+    }
+    if (t_us > f->gyro_us)
+        f->gyro_us = t_us;
+}
+
+void fusion_mag(struct fusion *f, float heading_deg, uint64_t t_us)
+{
+    if (!f->init) {
+        f->heading = heading_deg;
+        f->mag_us = t_us;
+        if (f->gyro_us < t_us)
+            f->gyro_us = t_us;
+        f->init = 1;
+        return;
+    }
+
+    float dt = seconds(f->mag_us, t_us);
+    if (dt <= 0.0f)
+        return;
+    if (dt > FUSION_MAX_DT_S)
+        dt = FUSION_MAX_DT_S;
+    f->mag_us = t_us;
+
+    /* La muestra es de t_us; el filtro ya va por gyro_us */
+    float ahead = f->rate_dps * seconds(t_us, f->gyro_us);
+    float e = wrap180(heading_deg + ahead - f->heading);
+
+    f->heading = wrap360(f->heading + f->kp * e * dt);
+    f->bias_dps -= f->ki * e * dt;
+}
+
+/* Extrapolado con la ultima velocidad desde la ultima muestra integrada */
+float fusion_heading(const struct fusion *f, uint64_t t_us)
+{
+    if (t_us <= f->gyro_us)
+        return f->heading;
+
+    float dt = seconds(f->gyro_us, t_us);
+    if (dt > FUSION_MAX_DT_S)
+        dt = FUSION_MAX_DT_S;
+    return wrap360(f->heading + f->rate_dps * dt);
+}
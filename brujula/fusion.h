@@ -0,0 +1,37 @@
+#ifndef Fusion_H
+#define Fusion_H
+
+/*
+ * Fusion giroscopo + magnetometro para el rumbo.
+ *
+ * Filtro complementario de segundo orden: el rumbo se integra con el
+ * giroscopo (190 Hz) y cada muestra del magnetometro corrige el angulo
+ * (kp) y el bias del giroscopo (ki). Con kp = 2/tau y ki = 1/tau² el
+ * lazo es criticamente amortiguado: el magnetometro manda por debajo
+ * de ~1/tau y el giroscopo por encima, sin el retardo del EMA.
+ *
+ * La entrada del magnetometro es el rumbo calibrado sin filtrar
+ * (qmc_heading_raw_cdeg): el EMA le pasaria su retardo a la salida.
+ */
+
+#include <stdint.h>
+
+#define FUSION_TAU_S 2.0f
+
+struct fusion {
+    float heading;        // grados, 0..360
+    float bias_dps;       // bias estimado del giroscopo
+    float rate_dps;       // ultima velocidad corregida
+    float kp, ki;
+    uint64_t gyro_us;     // hasta donde esta integrado
+    uint64_t mag_us;
+    uint8_t init;         // hubo una muestra del magnetometro
+};
+
+void fusion_init(struct fusion *f, float tau_s);
+void fusion_gyro(struct fusion *f, float rate_dps, uint64_t t_us);
+void fusion_mag(struct fusion *f, float heading_deg, uint64_t t_us);
+/* Rumbo en t_us: entre vaciados del FIFO sigue con la ultima velocidad */
+float fusion_heading(const struct fusion *f, uint64_t t_us);
+
+#endif /* Fusion_H */
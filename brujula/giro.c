@@ -0,0 +1,116 @@
+/*
+ * Giroscopo L3GD20 (ver giro.h)
+ */
+#include "giro.h"
+#include "hal.h"
+#include "tiempo.h"
+
+#include <string.h>
+
+/* Muestras por transaccion: ~75 us con las interrupciones cortadas */
+#define GYRO_CHUNK 8
+
+#define GYRO_PERIOD_US (1000000u / GYRO_ODR_HZ)
+
+static struct gyro_stats st;
+
+/* ================= SPI ================= */
+
+static int reg_write(uint8_t reg, uint8_t val)
+{
+    uint8_t tx[2] = { reg, val }, rx[2];
+
+    return hal_gyro_xfer(tx, rx, sizeof(tx));
+}
+
+static int reg_read(uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    uint8_t tx[1 + GYRO_CHUNK * 6] = { 0 }, rx[sizeof(tx)];
+
+    tx[0] = L3GD20_READ | L3GD20_INC | reg;
+    if (hal_gyro_xfer(tx, rx, (uint8_t)(len + 1)) != 0)
+        return -1;
+
+    memcpy(buf, &rx[1], len);
+    return 0;
+}
+
+/* ================= API ================= */
+
+int gyro_init(void)
+{
+    uint8_t id;
+
+    memset(&st, 0, sizeof(st));
+    hal_gyro_setup();
+
+    if (reg_read(L3GD20_WHO_AM_I, &id, 1) != 0 ||
+        (id != L3GD20_ID && id != L3GD20H_ID))
+        return -1;
+
+    if (reg_write(L3GD20_CTRL4, L3GD20_CTRL4_500DPS) != 0 ||
+        reg_write(L3GD20_CTRL5, L3GD20_CTRL5_FIFO) != 0 ||
+        reg_write(L3GD20_FIFO_CTRL, L3GD20_FIFO_STREAM) != 0 ||
+        reg_write(L3GD20_CTRL1, L3GD20_CTRL1_190HZ) != 0)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * Vacia el FIFO (hasta max). Con el FIFO habilitado el auto-incremento
+ * vuelve de OUT_Z_H a OUT_X_L, asi que cada 6 bytes sale otra muestra.
+ * Devuelve cuantas leyo; 0 si no habia o si el SPI estaba ocupado.
+ */
+int gyro_read_fifo(struct gyro_sample *out, int max)
+{
+    uint8_t src, b[GYRO_CHUNK * 6];
+
+    if (reg_read(L3GD20_FIFO_SRC, &src, 1) != 0) {
+        st.busy++;
+        return 0;
+    }
+    if (src & L3GD20_FIFO_EMPTY)
+        return 0;
+
+    int n = (src & L3GD20_FIFO_FSS) + ((src & L3GD20_FIFO_OVRN) ? 1 : 0);
+    if (src & L3GD20_FIFO_OVRN)
+        st.overruns++;
+    if (n > max)
+        n = max;
+
+    /* La ultima del FIFO es de ahora; las anteriores, de a 1/ODR */
+    uint64_t now = time_us();
+    int got = 0;
+
+    while (got < n) {
+        int k = n - got > GYRO_CHUNK ? GYRO_CHUNK : n - got;
+
+        if (reg_read(L3GD20_OUT_X_L, b, (uint8_t)(k * 6)) != 0) {
+            st.busy++;
+            break;   // lo que queda sale en la proxima
+        }
+        for (int i = 0; i < k; i++) {
+            struct gyro_sample *s = &out[got + i];
+            for (int a = 0; a < 3; a++)
+                s->xyz[a] = (int16_t)(b[6 * i + 2 * a] |
+                                      b[6 * i + 2 * a + 1] << 8);
+            s->t_us = now - (uint64_t)(n - 1 - got - i) * GYRO_PERIOD_US;
+        }
+        got += k;
+    }
+
+    st.samples += (uint32_t)got;
+    st.reads++;
+    return got;
+}
+
+float gyro_yaw_dps(const struct gyro_sample *s)
+{
+    return GYRO_YAW_SIGN * s->xyz[GYRO_YAW_AXIS] * (GYRO_MDPS_LSB / 1000.0f);
+}
+
+void gyro_stats_get(struct gyro_stats *out)
+{
+    *out = st;
+}
@@ -0,0 +1,69 @@
+#ifndef Giro_H
+#define Giro_H
+
+/*
+ * Giroscopo L3GD20 de la Discovery (SPI5, ver hal.h).
+ *
+ * 190 Hz, 500 dps (17.5 mdps/LSB), FIFO en modo stream: el sensor junta
+ * hasta 32 muestras (168 ms, mas que un frame del LCD) y
+ * gyro_read_fifo() las saca todas cuando el SPI esta libre. La marca de
+ * tiempo de cada una se reconstruye hacia atras desde la lectura.
+ *
+ * El rumbo (atan2(x, z) del QMC) gira alrededor de la Y del
+ * magnetometro; en el giroscopo ese eje es GYRO_YAW_AXIS, con signo
+ * GYRO_YAW_SIGN (depende de como esta montado el modulo).
+ */
+
+#include <stdint.h>
+
+#define GYRO_ODR_HZ   190
+#define GYRO_FIFO     32
+#define GYRO_MDPS_LSB 17.5f
+#define GYRO_YAW_AXIS 2
+#define GYRO_YAW_SIGN (-1)
+
+/* Registros */
+#define L3GD20_WHO_AM_I  0x0F
+#define L3GD20_CTRL1     0x20
+#define L3GD20_CTRL4     0x23
+#define L3GD20_CTRL5     0x24
+#define L3GD20_OUT_X_L   0x28
+#define L3GD20_FIFO_CTRL 0x2E
+#define L3GD20_FIFO_SRC  0x2F
+
+#define L3GD20_ID   0xD4
+#define L3GD20H_ID  0xD7
+
+/* Primer byte de la transaccion SPI */
+#define L3GD20_READ 0x80
+#define L3GD20_INC  0x40   // auto-incremento
+
+/* Valores de configuracion */
+#define L3GD20_CTRL1_190HZ  0x7F   // DR=01, BW=11 (70 Hz), PD, XYZ
+#define L3GD20_CTRL4_500DPS 0x10
+#define L3GD20_CTRL5_FIFO   0x40
+#define L3GD20_FIFO_STREAM  0x40
+
+/* FIFO_SRC */
+#define L3GD20_FIFO_OVRN  0x40
+#define L3GD20_FIFO_EMPTY 0x20
+#define L3GD20_FIFO_FSS   0x1F
+
+struct gyro_sample {
+    int16_t xyz[3];
+    uint64_t t_us;
+};
+
+struct gyro_stats {
+    uint32_t samples;
+    uint32_t reads;       // vaciados del FIFO
+    uint32_t busy;        // SPI ocupado por el LCD
+    uint32_t overruns;    // el FIFO se lleno y piso muestras
+};
+
+int gyro_init(void);   // 0 = ok, -1 = no contesta el L3GD20
+int gyro_read_fifo(struct gyro_sample *out, int max);
+float gyro_yaw_dps(const struct gyro_sample *s);
+void gyro_stats_get(struct gyro_stats *out);
+
+#endif /* Giro_H */
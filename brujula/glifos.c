@@ -0,0 +1,56 @@
+/*
+ * Atlas de glifos pre-rasterizados (ver glifos.h)
+ */
+#include "glifos.h"
+#include "hal_gfx.h"
+#include "pantalla.h"
+
+#include <string.h>
+
+static uint16_t *building;
+
+static void cell_pixel(int x, int y, uint16_t color)
+{
+    if ((unsigned)x < GLYPH_W && (unsigned)y < GLYPH_H)
+        building[y * GLYPH_W + x] = color;
+}
+
+void glyph_atlas_init(struct glyph_atlas *a, uint16_t bg)
+{
+    memset(a, 0, sizeof(*a));
+    a->bg = bg;
+}
+
+int glyph_atlas_add(struct glyph_atlas *a, const char *chars, uint16_t fg)
+{
+    int ret = 0;
+
+    gfx_init(cell_pixel, GLYPH_W, GLYPH_H);
+    for (; *chars; chars++) {
+        unsigned char c = (unsigned char)*chars;
+
+        if (c >= sizeof(a->cell) || a->n == GLYPH_MAX) {
+            ret = -1;
+            break;
+        }
+        building = a->pixels[a->n];
+        gfx_drawChar(0, 0, c, fg, a->bg, GLYPH_SIZE);
+        a->fg[a->n] = fg;
+        a->cell[c] = ++a->n;
+    }
+    gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+    building = NULL;
+    return ret;
+}
+
+int glyph_blit(const struct glyph_atlas *a, int x, int y, char c,
+               uint16_t fg)
+{
+    unsigned char u = (unsigned char)c;
+
+    if (u >= sizeof(a->cell) || !a->cell[u] || a->fg[a->cell[u] - 1] != fg)
+        return 0;
+
+    fb_blit(x, y, GLYPH_W, GLYPH_H, a->pixels[a->cell[u] - 1]);
+    return 1;
+}
@@ -0,0 +1,55 @@
+#ifndef Glifos_H
+#define Glifos_H
+
+/*
+ * Atlas de glifos pre-rasterizados para la lectura del rumbo.
+ *
+ * glyph_atlas_add() dibuja una vez cada caracter con gfx_drawChar (el
+ * mismo font, a GLYPH_SIZE, con su color y el fondo del atlas) en una
+ * celda RGB565. Despues glyph_blit() copia la celda al buffer de atras
+ * con fb_blit(), fila por fila con un lazo simple (memcpy por fila,
+ * con celdas tan angostas, salio mas lento en el host), en vez de pasar
+ * por el font pixel a pixel: da los mismos pixeles que gfx_drawChar.
+ *
+ * glyph_digits3() saca los tres digitos de "%03d" sin snprintf, para
+ * que la lectura no pase por el formateador de newlib.
+ *
+ * El simbolo de grados es parte del fondo de la escena (un circulo fijo
+ * al lado de la lectura): no cambia con el rumbo y no va en el atlas.
+ */
+
+#include <stdint.h>
+
+/* Glifos a textsize 2: celda de 6x8 del font, opaca */
+#define GLYPH_SIZE 2
+#define GLYPH_W    (6 * GLYPH_SIZE)
+#define GLYPH_H    (8 * GLYPH_SIZE)
+#define GLYPH_MAX  16   // 384 bytes por celda: ~6.2 KB de RAM el atlas
+
+struct glyph_atlas {
+    uint8_t n;
+    uint8_t cell[128];                      // celda + 1; 0 = no esta
+    uint16_t fg[GLYPH_MAX];
+    uint16_t bg;
+    uint16_t pixels[GLYPH_MAX][GLYPH_W * GLYPH_H];
+};
+
+void glyph_atlas_init(struct glyph_atlas *a, uint16_t bg);
+/* Cada caracter de chars en color fg; -1 si no hay lugar */
+int glyph_atlas_add(struct glyph_atlas *a, const char *chars, uint16_t fg);
+/* 0 si c no esta en el atlas con ese color (dibujar con gfx_drawChar) */
+int glyph_blit(const struct glyph_atlas *a, int x, int y, char c,
+               uint16_t fg);
+
+/* Los digitos de "%03d" para 0..999; fuera de rango, modulo 1000 */
+static inline void glyph_digits3(int v, char d[3])
+{
+    v %= 1000;
+    if (v < 0)
+        v += 1000;
+    d[0] = (char)('0' + v / 100);
+    d[1] = (char)('0' + v / 10 % 10);
+    d[2] = (char)('0' + v % 10);
+}
+
+#endif /* Glifos_H */
@@ -0,0 +1,118 @@
+#ifndef HAL_H
+#define HAL_H
+
+/*
+ * Capa de abstraccion de hardware.
+ *
+ * brujula.c solo habla con el bus I2C y con el tiempo a traves de estas
+ * funciones. hal_stm32.c las implementa con libopencm3 y host/hal_host.c
+ * con un QMC5883L simulado, para poder correr el mismo driver en Linux.
+ */
+
+#include <stdint.h>
+
+/* Bus I2C: 0 = ok, -1 = NACK / timeout (HAL_I2C_TIMEOUT_US) */
+int hal_i2c_write(uint8_t addr, uint8_t reg, uint8_t val);
+int hal_i2c_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len);
+
+/* SCL: 100000 (Standard) o 400000 (Fast-mode) */
+void hal_i2c_set_speed(uint32_t hz);
+
+/*
+ * Bus trabado: corta la transaccion en curso, da hasta 9 pulsos de SCL
+ * por GPIO mientras SDA siga en bajo (un esclavo a mitad de un byte lo
+ * suelta), un STOP, y resetea el periferico a la velocidad que tenia.
+ * Tarda ~100 us. Devuelve los pulsos dados, o -1 si SDA sigue en bajo.
+ */
+int hal_i2c_bus_clear(void);
+
+/*
+ * Bus I2C asincrono (DMA): devuelve enseguida y llama a cb desde la
+ * interrupcion con 0 = ok, -1 = NACK / error de bus. len >= 2.
+ * hal_i2c_abort() corta la transaccion en curso sin llamar a cb.
+ */
+typedef void (*hal_i2c_cb)(int status);
+
+int hal_i2c_read_async(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len,
+                       hal_i2c_cb cb);
+void hal_i2c_abort(void);
+
+/* Interrupciones: flanco de DRDY (EXTI) y tick periodico (timer) */
+typedef void (*hal_irq_cb)(void);
+
+void hal_drdy_irq_init(hal_irq_cb cb);
+void hal_tick_irq_init(uint32_t hz, hal_irq_cb cb);
+
+/*
+ * LCD (ILI9341, 240x320 RGB565): manda un frame completo por DMA y
+ * llama a done desde la interrupcion al terminar. El panel tiene su
+ * propia GRAM, asi que el buffer queda libre en cuanto termina el envio.
+ */
+#define HAL_LCD_WIDTH  240
+#define HAL_LCD_HEIGHT 320
+
+void hal_lcd_present(const uint16_t *frame, hal_irq_cb done);
+int hal_lcd_busy(void);
+
+/*
+ * Giroscopo L3GD20 en SPI5 (CS = PC1), el mismo bus que el LCD: una
+ * transaccion full-duplex con CS bajo y sin interrupciones en el medio.
+ * -1 si el LCD esta mandando un frame; el FIFO del giroscopo aguanta
+ * mientras tanto. hal_gyro_setup() despues de lcd_spi_init().
+ */
+void hal_gyro_setup(void);
+int hal_gyro_xfer(const uint8_t *tx, uint8_t *rx, uint8_t len);
+
+/*
+ * Flash interna: HAL_FLASH_SECTORS sectores reservados para el almacen de
+ * registros (almacen.h). Se leen mapeados en memoria; erase deja todo el
+ * sector en 0xFF y program escribe palabras de 32 bits alineadas que
+ * tienen que estar borradas. 0 = ok, -1 = error.
+ *
+ * El borrado tarda ~1 s y no espera: hal_flash_erase_start() lo arranca
+ * y hal_flash_erase_poll() da 1 mientras sigue (FLASH_SR_BSY), despues
+ * 0 o -1 una vez. Mientras tanto program falla.
+ */
+#define HAL_FLASH_SECTORS 2
+
+uint32_t hal_flash_sector_size(void);
+const uint32_t *hal_flash_sector(int s);
+int hal_flash_erase_start(int s);
+int hal_flash_erase_poll(void);
+int hal_flash_program(int s, uint32_t off, const uint32_t *words, uint32_t n);
+
+/*
+ * USB CDC (telemetria.h): manda hasta len bytes (como mucho un paquete de
+ * 64) y devuelve cuantos tomo; 0 si el endpoint esta ocupado o no hay
+ * nadie del otro lado. No espera a que se vacie.
+ */
+int hal_cdc_write(const uint8_t *buf, uint16_t len);
+
+/* Seccion critica contra las interrupciones de arriba */
+void hal_irq_lock(void);
+void hal_irq_unlock(void);
+
+/* Tiempo monotono en us (SysTick 1 ms + DWT CYCCNT en la placa) */
+void hal_time_init(void);
+uint64_t hal_time_us(void);
+void hal_sleep_until_us(uint64_t t_us);
+
+/*
+ * Espera a la proxima interrupcion (WFI), sin pasar de t_us: el SysTick
+ * despierta a mas tardar en 1 ms. Puede volver antes y sin dormir; se
+ * llama con las interrupciones cortadas (la pendiente despierta igual).
+ */
+void hal_idle_until_us(uint64_t t_us);
+
+/* Contador de ciclos libre (medida.h): DWT CYCCNT en la placa, ns de
+ * clock_gettime en Linux. Da la vuelta: solo sirven las diferencias. */
+uint32_t hal_cycles(void);
+uint32_t hal_cycles_hz(void);
+
+/* Tope de una transaccion I2C sincrona */
+#define HAL_I2C_TIMEOUT_US 5000
+
+/* Espera activa de n iteraciones */
+void hal_delay(uint32_t n);
+
+#endif /* HAL_H */
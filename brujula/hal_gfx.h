@@ -0,0 +1,19 @@
+#ifndef HAL_GFX_H
+#define HAL_GFX_H
+
+/*
+ * Capa de abstraccion grafica.
+ *
+ * interfaz.c y escena.c solo usan gfx_* y los colores LCD_*. En la placa
+ * vienen de libopencm3-plus; en Linux los da host/gfx_host.h. En los dos
+ * casos los pixeles terminan en fb_draw_pixel() (pantalla.c).
+ */
+
+#ifdef HOST_BUILD
+#include "host/gfx_host.h"
+#else
+#include <libopencm3-plus/utils/misc.h>
+#include <libopencm3-plus/hw-accesories/lcd/lcd-spi.h>
+#endif
+
+#endif /* HAL_GFX_H */
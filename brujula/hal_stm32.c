@@ -0,0 +1,806 @@
+/*
+ * HAL para el STM32F429-Discovery (libopencm3)
+ */
+#include "hal.h"
+#include "brujula.h"
+#include "tiempo.h"
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/i2c.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/usb/usbd.h>
+
+#include <libopencm3-plus/newlib/syscall.h>
+#include <libopencm3-plus/newlib/devices/cdcacm.h>
+
+#include <stdio.h>
+
+/* DRDY del QMC5883L -> PB4 (EXTI4, flanco de subida) */
+#define DRDY_PORT GPIOB
+#define DRDY_PIN  GPIO4
+#define DRDY_EXTI EXTI4
+
+/* I2C1_RX = DMA1 stream 0, canal 1 */
+#define I2C_DMA        DMA1
+#define I2C_DMA_STREAM DMA_STREAM0
+
+/*
+ * LCD: SPI5 ya configurado por lcd_spi_init(), CS = PC2, D/C (WRX) = PD13.
+ * SPI5_TX = DMA2 stream 4, canal 2. Un frame son 153600 bytes y el NDTR
+ * llega a 65535, asi que va en tres tramos.
+ */
+#define LCD_CS_PORT    GPIOC
+#define LCD_CS_PIN     GPIO2
+#define LCD_DC_PORT    GPIOD
+#define LCD_DC_PIN     GPIO13
+#define LCD_DMA        DMA2
+#define LCD_DMA_STREAM DMA_STREAM4
+#define LCD_FRAME_BYTES (HAL_LCD_WIDTH * HAL_LCD_HEIGHT * 2)
+#define LCD_CHUNK       (LCD_FRAME_BYTES / 3)
+
+/*
+ * Almacen: sectores 22 y 23 (banco 2, 128 KB cada uno), al final de los
+ * 2 MB y lejos del programa. En FLASH_CR.SNB el banco 2 lleva el bit 4.
+ */
+#define FLASH_STORE_SECTOR_SIZE (128u * 1024u)
+
+static const struct {
+    uint32_t addr;
+    uint8_t snb;
+} flash_store[HAL_FLASH_SECTORS] = {
+    { 0x081C0000, 0x10 | 10 },
+    { 0x081E0000, 0x10 | 11 },
+};
+
+/* ================= USB CDC ================= */
+
+void system_init(void)
+{
+    rcc_clock_setup_pll(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
+    hal_time_init();
+
+#ifdef BRUJULA_CONSOLE
+    devoptab_list[0] = &dotab_cdcacm;
+    devoptab_list[1] = &dotab_cdcacm;
+    devoptab_list[2] = &dotab_cdcacm;
+#endif
+#if defined(BRUJULA_CONSOLE) || defined(BRUJULA_TELEMETRY)
+    cdcacm_f429_init();
+#endif
+}
+
+void init_console(void)
+{
+    setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+/*
+ * Telemetria: directo al endpoint bulk IN del CDC, sin stdio ni devoptab
+ * (su write_r() espera a que el endpoint quede libre). Un paquete por
+ * llamada; usbd_ep_write_packet() devuelve 0 si el anterior no salio y
+ * entonces los bytes quedan en la cola de telemetria.c, que descarta
+ * registros si se llena. Con el lock para no cruzarse con el usbd_poll()
+ * de la interrupcion, que tambien escribe el endpoint (consola).
+ */
+#define CDC_EP_IN 0x82   // el IN de datos de cdcacm_f429
+extern usbd_device *cdcacm_usbd_dev;   // de cdcacm_f429_init()
+
+int hal_cdc_write(const uint8_t *buf, uint16_t len)
+{
+#if defined(BRUJULA_CONSOLE) || defined(BRUJULA_TELEMETRY)
+    if (!cdcacm_usbd_dev)
+        return 0;
+    if (len > 64)
+        len = 64;
+    hal_irq_lock();
+    uint16_t n = usbd_ep_write_packet(cdcacm_usbd_dev, CDC_EP_IN, buf, len);
+    hal_irq_unlock();
+    return n;
+#else
+    (void)buf;
+    (void)len;
+    return 0;   // sin USB: la cola se llena y descarta
+#endif
+}
+
+/* ================= I2C SETUP ================= */
+
+void i2c_setup(void)
+{
+    rcc_periph_clock_enable(RCC_GPIOB);
+    rcc_periph_clock_enable(RCC_I2C1);
+
+    /* PB8=SCL, PB9=SDA */
+    gpio_mode_setup(GPIOB, GPIO_MODE_AF,
+                    GPIO_PUPD_NONE, GPIO8 | GPIO9);
+    gpio_set_output_options(GPIOB, GPIO_OTYPE_OD,
+                            GPIO_OSPEED_50MHZ, GPIO8 | GPIO9);
+    gpio_set_af(GPIOB, GPIO_AF4, GPIO8 | GPIO9);
+
+    i2c_reset(I2C1);
+    i2c_peripheral_disable(I2C1);
+
+    i2c_set_speed(I2C1, i2c_speed_sm_100k,
+                  rcc_apb1_frequency / 1000000);
+
+    i2c_peripheral_enable(I2C1);
+}
+
+static uint32_t i2c_hz = 100000;   // para hal_i2c_bus_clear()
+
+void hal_i2c_set_speed(uint32_t hz)
+{
+    i2c_hz = hz;
+    i2c_peripheral_disable(I2C1);
+    i2c_set_speed(I2C1,
+                  hz >= 400000 ? i2c_speed_fm_400k : i2c_speed_sm_100k,
+                  rcc_apb1_frequency / 1000000);
+    i2c_peripheral_enable(I2C1);
+}
+
+/* ================= I2C (timeout) ================= */
+
+/* Espera un flag de SR1; NACK o deadline vencido = -1 */
+static int wait_sr1(uint32_t flag, deadline_t d)
+{
+    while (!(I2C_SR1(I2C1) & flag)) {
+        if (I2C_SR1(I2C1) & I2C_SR1_AF) {
+            I2C_SR1(I2C1) &= ~I2C_SR1_AF;
+            return -1;
+        }
+        if (deadline_expired(d))
+            return -1;
+    }
+    return 0;
+}
+
+int hal_i2c_write(uint8_t addr, uint8_t reg, uint8_t val)
+{
+    deadline_t d = deadline_in_us(HAL_I2C_TIMEOUT_US);
+
+    i2c_send_start(I2C1);
+    if (wait_sr1(I2C_SR1_SB, d)) goto err;
+
+    i2c_send_7bit_address(I2C1, addr, I2C_WRITE);
+    if (wait_sr1(I2C_SR1_ADDR, d)) goto err;
+    (void)I2C_SR2(I2C1);
+
+    i2c_send_data(I2C1, reg);
+    if (wait_sr1(I2C_SR1_BTF, d)) goto err;
+
+    i2c_send_data(I2C1, val);
+    if (wait_sr1(I2C_SR1_BTF, d)) goto err;
+
+    i2c_send_stop(I2C1);
+    return 0;
+
+err:
+    i2c_send_stop(I2C1);
+    return -1;
+}
+
+/* Igual que i2c_transfer7() pero con deadline: no se cuelga con el bus */
+int hal_i2c_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    deadline_t d = deadline_in_us(HAL_I2C_TIMEOUT_US);
+
+    i2c_send_start(I2C1);
+    if (wait_sr1(I2C_SR1_SB, d)) goto err;
+
+    i2c_send_7bit_address(I2C1, addr, I2C_WRITE);
+    if (wait_sr1(I2C_SR1_ADDR, d)) goto err;
+    (void)I2C_SR2(I2C1);
+
+    i2c_send_data(I2C1, reg);
+    if (wait_sr1(I2C_SR1_BTF, d)) goto err;
+
+    i2c_enable_ack(I2C1);
+    i2c_send_start(I2C1);
+    if (wait_sr1(I2C_SR1_SB, d)) goto err;
+
+    i2c_send_7bit_address(I2C1, addr, I2C_READ);
+    if (wait_sr1(I2C_SR1_ADDR, d)) goto err;
+
+    /*
+     * Un solo byte (RM0090, recepcion N = 1): el NACK se programa antes
+     * de limpiar ADDR y el STOP enseguida, sin que una interrupcion se
+     * meta en el medio; si no, el bus pide un byte mas.
+     */
+    if (len == 1) {
+        i2c_disable_ack(I2C1);
+        hal_irq_lock();
+        (void)I2C_SR2(I2C1);
+        i2c_send_stop(I2C1);
+        hal_irq_unlock();
+        if (wait_sr1(I2C_SR1_RxNE, d)) goto err;
+        buf[0] = i2c_get_data(I2C1);
+        return 0;
+    }
+    (void)I2C_SR2(I2C1);
+
+    for (uint8_t i = 0; i < len; i++) {
+        if (i == len - 1)
+            i2c_disable_ack(I2C1);
+        if (wait_sr1(I2C_SR1_RxNE, d)) goto err;
+        buf[i] = i2c_get_data(I2C1);
+    }
+
+    i2c_send_stop(I2C1);
+    return 0;
+
+err:
+    i2c_send_stop(I2C1);
+    return -1;
+}
+
+/* ================= I2C ASINCRONO (DMA) ================= */
+
+/*
+ * START -> addr(W) -> reg -> Sr -> addr(R) -> DMA len bytes -> STOP.
+ * Las fases de direccion van por la interrupcion de eventos; los datos
+ * los mueve el DMA, que con LAST hace el NACK del ultimo byte solo.
+ */
+enum { ASYNC_IDLE, ASYNC_ADDR_W, ASYNC_REG, ASYNC_ADDR_R, ASYNC_DATA };
+
+static volatile uint8_t async_phase = ASYNC_IDLE;
+static uint8_t async_addr;
+static uint8_t async_reg;
+static hal_i2c_cb async_cb;
+
+static void async_finish(int status)
+{
+    hal_i2c_cb cb = async_cb;
+
+    i2c_disable_interrupt(I2C1, I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+    dma_disable_stream(I2C_DMA, I2C_DMA_STREAM);
+    i2c_disable_dma(I2C1);
+    i2c_send_stop(I2C1);
+    async_phase = ASYNC_IDLE;
+
+    if (cb)
+        cb(status);
+}
+
+int hal_i2c_read_async(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len,
+                       hal_i2c_cb cb)
+{
+    if (async_phase != ASYNC_IDLE || len < 2)
+        return -1;
+
+    async_addr = addr;
+    async_reg = reg;
+    async_cb = cb;
+
+    rcc_periph_clock_enable(RCC_DMA1);
+    dma_stream_reset(I2C_DMA, I2C_DMA_STREAM);
+    dma_channel_select(I2C_DMA, I2C_DMA_STREAM, DMA_SxCR_CHSEL_1);
+    dma_set_transfer_mode(I2C_DMA, I2C_DMA_STREAM,
+                          DMA_SxCR_DIR_PERIPHERAL_TO_MEM);
+    dma_set_peripheral_address(I2C_DMA, I2C_DMA_STREAM,
+                               (uint32_t)&I2C_DR(I2C1));
+    dma_set_memory_address(I2C_DMA, I2C_DMA_STREAM, (uint32_t)buf);
+    dma_set_number_of_data(I2C_DMA, I2C_DMA_STREAM, len);
+    dma_set_peripheral_size(I2C_DMA, I2C_DMA_STREAM, DMA_SxCR_PSIZE_8BIT);
+    dma_set_memory_size(I2C_DMA, I2C_DMA_STREAM, DMA_SxCR_MSIZE_8BIT);
+    dma_enable_memory_increment_mode(I2C_DMA, I2C_DMA_STREAM);
+    dma_enable_transfer_complete_interrupt(I2C_DMA, I2C_DMA_STREAM);
+    nvic_enable_irq(NVIC_DMA1_STREAM0_IRQ);
+
+    nvic_enable_irq(NVIC_I2C1_EV_IRQ);
+    nvic_enable_irq(NVIC_I2C1_ER_IRQ);
+    i2c_enable_interrupt(I2C1, I2C_CR2_ITEVTEN | I2C_CR2_ITERREN);
+
+    async_phase = ASYNC_ADDR_W;
+    i2c_enable_ack(I2C1);
+    i2c_send_start(I2C1);
+    return 0;
+}
+
+void hal_i2c_abort(void)
+{
+    async_cb = NULL;
+    async_finish(-1);
+}
+
+/* ================= I2C (bus trabado) ================= */
+
+/* Medio periodo de SCL a 100 kHz */
+static void half_bit(void)
+{
+    uint32_t t0 = DWT_CYCCNT;
+
+    while (DWT_CYCCNT - t0 < rcc_ahb_frequency / 200000)
+        ;
+}
+
+int hal_i2c_bus_clear(void)
+{
+    int pulses = 0;
+
+    hal_i2c_abort();
+    i2c_peripheral_disable(I2C1);
+
+    /* PB8=SCL, PB9=SDA como GPIO open-drain, sueltos */
+    gpio_set(GPIOB, GPIO8 | GPIO9);
+    gpio_mode_setup(GPIOB, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE, GPIO8 | GPIO9);
+    half_bit();
+
+    while (!gpio_get(GPIOB, GPIO9) && pulses < 9) {
+        gpio_clear(GPIOB, GPIO8);
+        half_bit();
+        gpio_set(GPIOB, GPIO8);
+        half_bit();
+        pulses++;
+    }
+
+    /* STOP: SDA sube con SCL en alto */
+    gpio_clear(GPIOB, GPIO8);
+    half_bit();
+    gpio_clear(GPIOB, GPIO9);
+    half_bit();
+    gpio_set(GPIOB, GPIO8);
+    half_bit();
+    gpio_set(GPIOB, GPIO9);
+    half_bit();
+
+    int stuck = !gpio_get(GPIOB, GPIO9);
+
+    /* El periferico pudo quedar con BUSY: reset y a configurar de nuevo */
+    gpio_mode_setup(GPIOB, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO8 | GPIO9);
+    i2c_reset(I2C1);
+    i2c_peripheral_disable(I2C1);
+    i2c_set_speed(I2C1,
+                  i2c_hz >= 400000 ? i2c_speed_fm_400k : i2c_speed_sm_100k,
+                  rcc_apb1_frequency / 1000000);
+    i2c_peripheral_enable(I2C1);
+
+    return stuck ? -1 : pulses;
+}
+
+void i2c1_ev_isr(void)
+{
+    uint32_t sr1 = I2C_SR1(I2C1);
+
+    switch (async_phase) {
+    case ASYNC_ADDR_W:
+        if (sr1 & I2C_SR1_SB) {
+            i2c_send_7bit_address(I2C1, async_addr, I2C_WRITE);
+            async_phase = ASYNC_REG;
+        }
+        break;
+    case ASYNC_REG:
+        if (sr1 & I2C_SR1_ADDR) {
+            (void)I2C_SR2(I2C1);
+            i2c_send_data(I2C1, async_reg);
+        } else if (sr1 & I2C_SR1_BTF) {
+            async_phase = ASYNC_ADDR_R;
+            i2c_send_start(I2C1);
+        }
+        break;
+    case ASYNC_ADDR_R:
+        if (sr1 & I2C_SR1_SB) {
+            i2c_enable_dma(I2C1);
+            i2c_set_dma_last_transfer(I2C1);
+            dma_enable_stream(I2C_DMA, I2C_DMA_STREAM);
+            i2c_send_7bit_address(I2C1, async_addr, I2C_READ);
+        } else if (sr1 & I2C_SR1_ADDR) {
+            (void)I2C_SR2(I2C1);
+            async_phase = ASYNC_DATA;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void i2c1_er_isr(void)
+{
+    I2C_SR1(I2C1) &= ~(I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO |
+                       I2C_SR1_OVR);
+    if (async_phase != ASYNC_IDLE)
+        async_finish(-1);
+}
+
+void dma1_stream0_isr(void)
+{
+    if (dma_get_interrupt_flag(I2C_DMA, I2C_DMA_STREAM, DMA_TCIF)) {
+        dma_clear_interrupt_flags(I2C_DMA, I2C_DMA_STREAM, DMA_TCIF);
+        async_finish(0);
+    }
+}
+
+/* ================= IRQ: DRDY / TICK ================= */
+
+static hal_irq_cb drdy_cb;
+static hal_irq_cb tick_cb;
+
+void hal_drdy_irq_init(hal_irq_cb cb)
+{
+    drdy_cb = cb;
+
+    rcc_periph_clock_enable(RCC_GPIOB);
+    rcc_periph_clock_enable(RCC_SYSCFG);
+    gpio_mode_setup(DRDY_PORT, GPIO_MODE_INPUT, GPIO_PUPD_PULLDOWN,
+                    DRDY_PIN);
+
+    exti_select_source(DRDY_EXTI, DRDY_PORT);
+    exti_set_trigger(DRDY_EXTI, EXTI_TRIGGER_RISING);
+    exti_enable_request(DRDY_EXTI);
+    nvic_enable_irq(NVIC_EXTI4_IRQ);
+}
+
+void exti4_isr(void)
+{
+    exti_reset_request(DRDY_EXTI);
+    if (drdy_cb)
+        drdy_cb();
+}
+
+/* TIM2 a 1 MHz, desborda a hz */
+void hal_tick_irq_init(uint32_t hz, hal_irq_cb cb)
+{
+    tick_cb = cb;
+
+    rcc_periph_clock_enable(RCC_TIM2);
+    rcc_periph_reset_pulse(RST_TIM2);
+    timer_set_prescaler(TIM2, (rcc_apb1_frequency * 2) / 1000000 - 1);
+    timer_set_period(TIM2, 1000000 / hz - 1);
+    timer_enable_irq(TIM2, TIM_DIER_UIE);
+    nvic_enable_irq(NVIC_TIM2_IRQ);
+    timer_enable_counter(TIM2);
+}
+
+void tim2_isr(void)
+{
+    if (timer_get_flag(TIM2, TIM_SR_UIF)) {
+        timer_clear_flag(TIM2, TIM_SR_UIF);
+        if (tick_cb)
+            tick_cb();
+    }
+}
+
+/* ================= LCD (SPI5 + DMA) ================= */
+
+static volatile uint8_t lcd_busy;
+static const uint8_t *lcd_src;
+static uint32_t lcd_left;
+static hal_irq_cb lcd_done;
+
+static void lcd_spi_wait(void)
+{
+    while (!(SPI_SR(SPI5) & SPI_SR_TXE))
+        ;
+    while (SPI_SR(SPI5) & SPI_SR_BSY)
+        ;
+}
+
+/* Comando + parametros por polling (son pocos bytes) */
+static void lcd_cmd(uint8_t cmd, const uint8_t *data, int n)
+{
+    gpio_clear(LCD_CS_PORT, LCD_CS_PIN);
+    gpio_clear(LCD_DC_PORT, LCD_DC_PIN);
+    spi_send(SPI5, cmd);
+    lcd_spi_wait();
+    gpio_set(LCD_DC_PORT, LCD_DC_PIN);
+    while (n--)
+        spi_send(SPI5, *data++);
+    lcd_spi_wait();
+    gpio_set(LCD_CS_PORT, LCD_CS_PIN);
+}
+
+static void lcd_dma_next(void)
+{
+    uint32_t n = lcd_left > LCD_CHUNK ? LCD_CHUNK : lcd_left;
+
+    dma_stream_reset(LCD_DMA, LCD_DMA_STREAM);
+    dma_channel_select(LCD_DMA, LCD_DMA_STREAM, DMA_SxCR_CHSEL_2);
+    dma_set_transfer_mode(LCD_DMA, LCD_DMA_STREAM,
+                          DMA_SxCR_DIR_MEM_TO_PERIPHERAL);
+    dma_set_peripheral_address(LCD_DMA, LCD_DMA_STREAM,
+                               (uint32_t)&SPI_DR(SPI5));
+    dma_set_memory_address(LCD_DMA, LCD_DMA_STREAM, (uint32_t)lcd_src);
+    dma_set_number_of_data(LCD_DMA, LCD_DMA_STREAM, n);
+    dma_set_peripheral_size(LCD_DMA, LCD_DMA_STREAM, DMA_SxCR_PSIZE_8BIT);
+    dma_set_memory_size(LCD_DMA, LCD_DMA_STREAM, DMA_SxCR_MSIZE_8BIT);
+    dma_enable_memory_increment_mode(LCD_DMA, LCD_DMA_STREAM);
+    dma_enable_transfer_complete_interrupt(LCD_DMA, LCD_DMA_STREAM);
+
+    lcd_src += n;
+    lcd_left -= n;
+
+    spi_enable_tx_dma(SPI5);
+    dma_enable_stream(LCD_DMA, LCD_DMA_STREAM);
+}
+
+/* Mismo orden de bytes que lcd_show_frame(): el buffer tal cual en memoria */
+void hal_lcd_present(const uint16_t *frame, hal_irq_cb done)
+{
+    static const uint8_t cols[4] = { 0, 0, 0, HAL_LCD_WIDTH - 1 };
+    static const uint8_t rows[4] = { 0, 0, (HAL_LCD_HEIGHT - 1) >> 8,
+                                     (HAL_LCD_HEIGHT - 1) & 0xff };
+
+    lcd_busy = 1;
+    lcd_done = done;
+    lcd_src = (const uint8_t *)frame;
+    lcd_left = LCD_FRAME_BYTES;
+
+    rcc_periph_clock_enable(RCC_DMA2);
+    nvic_enable_irq(NVIC_DMA2_STREAM4_IRQ);
+
+    lcd_cmd(0x2A, cols, 4);   // column address set
+    lcd_cmd(0x2B, rows, 4);   // page address set
+
+    /* Memory write: CS queda bajo hasta el ultimo tramo */
+    gpio_clear(LCD_CS_PORT, LCD_CS_PIN);
+    gpio_clear(LCD_DC_PORT, LCD_DC_PIN);
+    spi_send(SPI5, 0x2C);
+    lcd_spi_wait();
+    gpio_set(LCD_DC_PORT, LCD_DC_PIN);
+
+    lcd_dma_next();
+}
+
+int hal_lcd_busy(void)
+{
+    return lcd_busy;
+}
+
+void dma2_stream4_isr(void)
+{
+    if (!dma_get_interrupt_flag(LCD_DMA, LCD_DMA_STREAM, DMA_TCIF))
+        return;
+    dma_clear_interrupt_flags(LCD_DMA, LCD_DMA_STREAM, DMA_TCIF);
+
+    if (lcd_left) {
+        lcd_dma_next();
+        return;
+    }
+
+    lcd_spi_wait();
+    spi_disable_tx_dma(SPI5);
+    gpio_set(LCD_CS_PORT, LCD_CS_PIN);
+    lcd_busy = 0;
+
+    if (lcd_done)
+        lcd_done();
+}
+
+void hal_irq_lock(void)
+{
+    cm_disable_interrupts();
+}
+
+void hal_irq_unlock(void)
+{
+    cm_enable_interrupts();
+}
+
+/* ================= GIROSCOPO (SPI5, CS = PC1) ================= */
+
+#define GYRO_CS_PORT GPIOC
+#define GYRO_CS_PIN  GPIO1
+
+/* El L3GD20 va en modo 3 y hasta 10 MHz: APB2 / 16 = 5.25 MHz */
+#define GYRO_CR1_MODE (SPI_CR1_CPOL | SPI_CR1_CPHA | SPI_CR1_BAUDRATE_FPCLK_DIV_16)
+#define GYRO_CR1_MASK (SPI_CR1_CPOL | SPI_CR1_CPHA | (7u << 3))
+
+void hal_gyro_setup(void)
+{
+    rcc_periph_clock_enable(RCC_GPIOC);
+    rcc_periph_clock_enable(RCC_GPIOF);
+
+    gpio_set(GYRO_CS_PORT, GYRO_CS_PIN);
+    gpio_mode_setup(GYRO_CS_PORT, GPIO_MODE_OUTPUT, GPIO_PUPD_NONE,
+                    GYRO_CS_PIN);
+
+    /* MISO (PF8): el LCD solo transmite y puede no haberlo configurado */
+    gpio_mode_setup(GPIOF, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO8);
+    gpio_set_af(GPIOF, GPIO_AF5, GPIO8);
+}
+
+/*
+ * Con las interrupciones cortadas: el DMA del LCD encadena tramos desde
+ * su ISR y no puede arrancar a mitad de la transaccion. Si el LCD esta
+ * enviando, -1 y no se toca nada.
+ */
+int hal_gyro_xfer(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+    hal_irq_lock();
+    if (lcd_busy) {
+        hal_irq_unlock();
+        return -1;
+    }
+
+    uint32_t cr1 = SPI_CR1(SPI5);
+
+    SPI_CR1(SPI5) = cr1 & ~SPI_CR1_SPE;
+    SPI_CR1(SPI5) = (cr1 & ~(GYRO_CR1_MASK | SPI_CR1_SPE)) | GYRO_CR1_MODE;
+    SPI_CR1(SPI5) |= SPI_CR1_SPE;
+
+    /* Lo que dejo el LCD en RX (y el OVR) */
+    (void)SPI_DR(SPI5);
+    (void)SPI_SR(SPI5);
+
+    gpio_clear(GYRO_CS_PORT, GYRO_CS_PIN);
+    for (uint8_t i = 0; i < len; i++) {
+        spi_send(SPI5, tx[i]);
+        while (!(SPI_SR(SPI5) & SPI_SR_RXNE))
+            ;
+        rx[i] = (uint8_t)SPI_DR(SPI5);
+    }
+    lcd_spi_wait();
+    gpio_set(GYRO_CS_PORT, GYRO_CS_PIN);
+
+    SPI_CR1(SPI5) = cr1 & ~SPI_CR1_SPE;
+    SPI_CR1(SPI5) = cr1;
+
+    hal_irq_unlock();
+    return 0;
+}
+
+/* ================= FLASH ================= */
+
+uint32_t hal_flash_sector_size(void)
+{
+    return FLASH_STORE_SECTOR_SIZE;
+}
+
+const uint32_t *hal_flash_sector(int s)
+{
+    return (const uint32_t *)flash_store[s].addr;
+}
+
+static int flash_error(void)
+{
+    uint32_t sr = FLASH_SR;
+
+    FLASH_SR = FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR |
+               FLASH_SR_WRPERR | FLASH_SR_OPERR;
+    return (sr & (FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR |
+                  FLASH_SR_WRPERR | FLASH_SR_OPERR)) ? -1 : 0;
+}
+
+/*
+ * El programa corre del banco 1 y las interrupciones siguen (read while
+ * write). El borrado queda andando: la flash sigue desbloqueada hasta que
+ * hal_flash_erase_poll() ve bajar BSY.
+ */
+static int flash_erasing;
+
+int hal_flash_erase_start(int s)
+{
+    if (flash_erasing || (FLASH_SR & FLASH_SR_BSY))
+        return -1;
+
+    flash_unlock();
+    flash_set_program_size(FLASH_CR_PROGRAM_X32);
+    FLASH_CR &= ~(FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT);
+    FLASH_CR |= (flash_store[s].snb & FLASH_CR_SNB_MASK) << FLASH_CR_SNB_SHIFT;
+    FLASH_CR |= FLASH_CR_SER;
+    FLASH_CR |= FLASH_CR_STRT;
+    flash_erasing = 1;
+    return 0;
+}
+
+int hal_flash_erase_poll(void)
+{
+    if (!flash_erasing)
+        return 0;
+    if (FLASH_SR & FLASH_SR_BSY)
+        return 1;
+
+    FLASH_CR &= ~(FLASH_CR_SER | (FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT));
+    flash_lock();
+    flash_erasing = 0;
+
+    /* El cache de datos del ART puede tener el contenido viejo */
+    flash_dcache_disable();
+    flash_dcache_reset();
+    flash_dcache_enable();
+    return flash_error();
+}
+
+int hal_flash_program(int s, uint32_t off, const uint32_t *words, uint32_t n)
+{
+    uint32_t addr = flash_store[s].addr + off;
+
+    if (flash_erasing)
+        return -1;   // flash_program_word() esperaria el borrado entero
+
+    flash_unlock();
+    for (uint32_t i = 0; i < n; i++) {
+        flash_program_word(addr + 4 * i, words[i]);
+        if (FLASH_SR & (FLASH_SR_PGSERR | FLASH_SR_PGPERR | FLASH_SR_PGAERR |
+                        FLASH_SR_WRPERR))
+            break;
+    }
+    flash_lock();
+    return flash_error();
+}
+
+/* ================= TIEMPO ================= */
+
+/* ms en 64 bits: la palabra baja sola da la vuelta a los 49.7 dias */
+static volatile uint32_t tick_ms;
+static volatile uint32_t tick_hi;    // vueltas de tick_ms
+static volatile uint32_t tick_cyc;   // CYCCNT en el ultimo SysTick
+
+void hal_time_init(void)
+{
+    dwt_enable_cycle_counter();
+
+    /* 1 ms exacto: la cuenta va de reload a 0, son reload+1 ciclos */
+    systick_set_clocksource(STK_CSR_CLKSOURCE_AHB);
+    systick_set_reload(rcc_ahb_frequency / 1000 - 1);
+    systick_clear();
+    systick_counter_enable();
+    systick_interrupt_enable();
+}
+
+void sys_tick_handler(void)
+{
+    tick_cyc = DWT_CYCCNT;
+    if (++tick_ms == 0)
+        tick_hi++;
+}
+
+uint64_t hal_time_us(void)
+{
+    uint32_t hi, ms, cyc, now;
+
+    /* Releer si el SysTick entro en el medio: las cuatro del mismo tick */
+    do {
+        hi = tick_hi;
+        ms = tick_ms;
+        cyc = tick_cyc;
+        now = DWT_CYCCNT;
+    } while (ms != tick_ms || hi != tick_hi);
+
+    uint32_t frac = (now - cyc) / (rcc_ahb_frequency / 1000000);
+    if (frac > 999)
+        frac = 999;
+
+    return ((uint64_t)hi << 32 | ms) * 1000u + frac;
+}
+
+/* Duerme con WFI (el SysTick despierta cada 1 ms) y termina en espera activa */
+void hal_sleep_until_us(uint64_t t_us)
+{
+    while (hal_time_us() + 1000u < t_us)
+        __asm__("wfi");
+    while (hal_time_us() < t_us)
+        ;
+}
+
+uint32_t hal_cycles(void)
+{
+    return DWT_CYCCNT;
+}
+
+uint32_t hal_cycles_hz(void)
+{
+    return rcc_ahb_frequency;
+}
+
+/* Con menos de 1 ms por delante no duerme: el que llama espera activo */
+void hal_idle_until_us(uint64_t t_us)
+{
+    if (hal_time_us() + 1000u < t_us)
+        __asm__("wfi");
+}
+
+/* ================= DELAY ================= */
+
+void hal_delay(uint32_t n)
+{
+    while (n--) __asm__("nop");
+}
@@ -0,0 +1,3430 @@
+/*
+ * Benchmark del pipeline de la brujula en Linux.
+ *
+ * Corre el mismo brujula.c de la placa contra el QMC5883L simulado.
+ * Los tiempos de bus salen del reloj virtual (lo que tardaria en la
+ * placa); los de calculo se miden en el PC con clock_gettime.
+ *
+ * La GUI (interfaz.c, escena.c, sprites.c) corre contra gfx_host.c, un
+ * gfx_* en memoria; los frames se pueden guardar como PPM (-o) o
+ * comparar contra imagenes de referencia (-g).
+ *
+ * Uso: ./bench [-n muestras] [-k kHz] [-o dir] [-g dir] [-t archivo]
+ *              [benchmark ...]
+ *
+ * -t guarda el stream de telemetria de ./bench tlm, o la sesion de
+ * ./bench replay (host/tlm_dump y host/replay la leen).
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "hal_host.h"
+#include "gfx_host.h"
+#include "../brujula.h"
+#include "../adquisicion.h"
+#include "../arranque.h"
+#include "../almacen.h"
+#include "../calibracion.h"
+#include "../cola.h"
+#include "../diezmado.h"
+#include "../fusion.h"
+#include "../giro.h"
+#include "../glifos.h"
+#include "../escena.h"
+#include "../hal.h"
+#include "../interfaz.h"
+#include "../medida.h"
+#include "../pantalla.h"
+#include "../planificador.h"
+#include "../polar.h"
+#include "../recuperacion.h"
+#include "../rumbo.h"
+#include "../sprites.h"
+#include "../telemetria.h"
+#include "../trama.h"
+#include "repeticion.h"
+#include "../tiempo.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static uint32_t n_samples = 1000;
+static uint32_t bus_khz = 100;
+static const char *ppm_out;      // -o: guardar frames
+static const char *ppm_golden;   // -g: comparar contra estos
+static const char *tlm_out;      // -t: stream de telemetria
+static int failures;             // checks en FALLO: main() sale con 1
+
+/* ================= HELPERS ================= */
+
+static const char *check(int ok)
+{
+    if (!ok)
+        failures++;
+    return ok ? "ok" : "FALLO";
+}
+
+/*
+ * Los checks de ruido y asentado del rumbo piden decimas de grado. Con
+ * un chip donde una cuenta del campo horizontal ya pasa de medio grado
+ * (el HMC en 8.1 Ga, 230 LSB/G: ~60 cuentas) no se pueden cumplir, y
+ * salen "-" en vez de ok / FALLO.
+ */
+static const char *check_fine(int ok)
+{
+    double counts = hal_qmc.field_h_gauss *
+                    MAG_DRV->lsb_per_gauss(qmc_active_profile());
+
+    if (180.0 / M_PI / counts > 0.5)
+        return "-";
+    return check(ok);
+}
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double angle_err(double a, double b)
+{
+    double d = fmod(a - b + 540.0, 360.0) - 180.0;
+    return fabs(d);
+}
+
+/* Placa recien encendida: reloj en cero, QMC configurado */
+static void board_boot(void)
+{
+    system_init();
+    i2c_setup();
+    hal_bus.bus_hz = bus_khz * 1000u;
+    qmc_set_profile(&qmc_profiles[QMC_PROFILE_LEGACY]);
+    qmc_init();
+    qmc_set_calibration(NULL);
+}
+
+/* Cola de muestras de la adquisicion (cola.h), como en impresion.c */
+static struct cola ring;
+
+static void ring_push(const struct qmc_sample *s)
+{
+    cola_push(&ring, s);
+}
+
+/* ================= BENCHMARKS ================= */
+
+/* ---- Arranque: chip-ID y secuencia ---- */
+
+/*
+ * Lo que no se simula, supuesto: sdram_init() y lcd_spi_init() (el
+ * ILI9341 pide 120 ms despues del sleep-out). Antes: delay(15000000).
+ */
+#define BOOT_SDRAM_US   1000
+#define BOOT_LCD_US   125000
+#define BOOT_OLD_US   360000
+
+static void boot_sdram(void)
+{
+    hal_host_advance(BOOT_SDRAM_US * 1000ull);
+}
+
+static void boot_lcd(void)
+{
+    hal_host_advance(BOOT_LCD_US * 1000ull);
+    fb_init(NULL, 3);
+    gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+}
+
+static void boot_splash(void)
+{
+    gfx_fillScreen(LCD_GREY);
+}
+
+static const struct boot_steps boot_steps = {
+    .memory = boot_sdram, .display = boot_lcd, .splash = boot_splash,
+};
+
+/* Primer byte del chip-ID del chip simulado (el del build) */
+static uint8_t *sim_chip_id(void)
+{
+    switch (hal_qmc.chip) {
+    case QMC_SIM_HMC5883L:
+        return &hal_qmc.regs[HMC_REG_ID_A];
+    case QMC_SIM_LIS3MDL:
+        return &hal_qmc.regs[LIS_REG_WHO_AM_I];
+    default:
+        return &hal_qmc.regs[QMC_REG_CHIP_ID];
+    }
+}
+
+/* qmc_init() recien encendido: -1 sin chip, -2 con otro chip-ID */
+static void boot_probe(const char *name, uint64_t por_ns, int other_id,
+                       int want)
+{
+    system_init();
+    i2c_setup();
+    hal_bus.bus_hz = bus_khz * 1000u;
+    hal_qmc.por_ns = por_ns;
+    if (other_id)
+        *sim_chip_id() = 0x00;
+    qmc_set_profile(&qmc_profiles[QMC_PROFILE_LEGACY]);
+
+    int err = qmc_init();
+    int good = err == want && hal_bus.now_ns < 600000000u;
+
+    printf("  %-20s %7.1f ms  %3llu txn %3llu NACK  -> %2d  %s\n", name,
+           hal_bus.now_ns / 1e6, (unsigned long long)hal_bus.transactions,
+           (unsigned long long)hal_bus.nacks, err, check(good));
+}
+
+/* Del reset al splash y al primer rumbo, con el orden de antes y el de ahora */
+static void boot_sequence(const char *name, int old, uint64_t *frame_us,
+                          uint64_t *heading_us)
+{
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 150,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = ring_push,
+    };
+    struct qmc_sample s;
+    int err;
+
+    system_init();
+    i2c_setup();
+    hal_bus.bus_hz = bus_khz * 1000u;
+    qmc_set_profile(&qmc_profiles[QMC_PROFILE_LEGACY]);
+    cola_init(&ring);
+    boot_reset();
+
+    if (old) {
+        sleep_us(BOOT_OLD_US);
+        err = qmc_init();
+        boot_mark(BOOT_SENSOR);
+        boot_sdram();
+        boot_mark(BOOT_MEMORY);
+        boot_lcd();
+        boot_mark(BOOT_DISPLAY);
+        boot_splash();
+        fb_swap();
+        boot_mark(BOOT_FRAME);
+    } else {
+        err = boot_run(&boot_steps);
+    }
+
+    acq_start(&cfg);
+    while (!cola_drain(&ring, &s, 1) && time_us() < 2000000)
+        hal_host_advance(1000000);
+    qmc_heading_cdeg(s.x, s.y, s.z);
+    boot_mark(BOOT_HEADING);
+
+    *frame_us = boot_time_us(BOOT_FRAME);
+    *heading_us = boot_time_us(BOOT_HEADING);
+    printf("  %-20s splash %6.1f ms  qmc %6.1f ms  rumbo %6.1f ms  %s\n",
+           name, *frame_us / 1e3, boot_time_us(BOOT_SENSOR) / 1e3,
+           *heading_us / 1e3, check(!err && *heading_us));
+}
+
+static void bench_init(void)
+{
+    system_init();
+    i2c_setup();
+    hal_bus.bus_hz = bus_khz * 1000u;
+    qmc_set_profile(&qmc_profiles[QMC_PROFILE_LEGACY]);
+
+    uint64_t t0 = hal_bus.now_ns;
+    qmc_init();
+
+    printf("  qmc_init            %10.1f ms   %llu txn  %llu bytes  %llu NACK "
+           "(power-on)\n", (hal_bus.now_ns - t0) / 1e6,
+           (unsigned long long)hal_bus.transactions,
+           (unsigned long long)hal_bus.bytes,
+           (unsigned long long)hal_bus.nacks);
+
+    boot_probe("sin chip", UINT64_MAX, 0, -1);
+    boot_probe("otro chip-ID", QMC_SIM_POR_NS, 1, -2);
+
+    uint64_t old_frame, old_heading, frame, heading;
+    boot_sequence("antes (en serie)", 1, &old_frame, &old_heading);
+    boot_sequence("ahora (boot_run)", 0, &frame, &heading);
+    printf("  %-20s splash %5.1fx antes, rumbo %5.1fx antes  %s\n", "",
+           (double)old_frame / frame, (double)old_heading / heading,
+           check(frame < old_frame && heading < old_heading));
+}
+
+static void sensor_run(const char *label, int freerun)
+{
+    board_boot();
+    hal_qmc.freerun = freerun;
+    hal_qmc.heading_deg = 123.0;
+    i2c_stats_reset();
+
+    uint64_t t0 = hal_bus.now_ns;
+    uint64_t poll_ns = 0, read_ns = 0;
+    uint64_t read_bytes = 0;
+    uint32_t got = 0;
+    double err = 0.0;
+    struct i2c_stats st;
+
+    while (got < n_samples) {
+        uint64_t t = hal_bus.now_ns;
+        float h;
+
+        i2c_stats_get(&st);
+        uint32_t by = st.bytes;
+
+        if (qmc_read_heading(&h)) {
+            i2c_stats_get(&st);
+            read_ns += hal_bus.now_ns - t;
+            read_bytes += st.bytes - by;
+            err += angle_err(h, qmc_sim_true_heading(&hal_qmc, t));
+            got++;
+        } else {
+            poll_ns += hal_bus.now_ns - t;
+        }
+    }
+
+    double secs = (hal_bus.now_ns - t0) / 1e9;
+    i2c_stats_get(&st);
+
+    printf("  %s\n", label);
+    printf("    samples/s         %10.1f\n", got / secs);
+    printf("    bus bytes/sample  %10.1f   (%.1f leyendo el dato)\n",
+           (double)st.bytes / got, (double)read_bytes / got);
+    printf("    txn/sample        %10.1f\n", (double)st.transactions / got);
+    printf("    stage poll DRDY   %10.1f us/sample\n", poll_ns / 1e3 / got);
+    printf("    stage read xyz    %10.1f us/sample\n", read_ns / 1e3 / got);
+    printf("    mean |error|      %10.3f deg\n", err / got);
+}
+
+static void bench_sensor(void)
+{
+    sensor_run("ODR del sensor (0x11 = 10 Hz)", 0);
+    sensor_run("freerun (techo del bus)", 1);
+}
+
+/* ---- Drivers de magnetometro (magneto.h) ---- */
+
+static const enum qmc_sim_chip mag_sim_chip[MAG_CHIPS] = {
+    [MAG_QMC5883L] = QMC_SIM_QMC5883L,
+    [MAG_HMC5883L] = QMC_SIM_HMC5883L,
+    [MAG_LIS3MDL] = QMC_SIM_LIS3MDL,
+};
+
+/*
+ * Cada driver contra su chip simulado, por la tabla: deteccion, setup +
+ * perfil de 50 Hz, ODR que sale del chip y rumbo del promedio de 1 s
+ * (offsets de fabrica del simulador, a la escala del chip).
+ */
+static void mag_chip(int chip)
+{
+    const struct mag_driver *d = &mag_drivers[chip];
+    const struct qmc_profile *p = &qmc_profiles[QMC_PROFILE_50HZ];
+    double sx = 0.0, sz = 0.0;
+    uint32_t got = 0;
+    int16_t x, y, z, t;
+
+    system_init();
+    qmc_sim_set_chip(&hal_qmc, mag_sim_chip[chip]);
+    hal_qmc.heading_deg = 123.0;
+    int early = mag_detect();   // todavia en el power-on
+    hal_host_advance(QMC_SIM_POR_NS);
+    int found = mag_detect();
+
+    hal_i2c_set_speed(p->bus_hz);
+    int cfg = d->setup() || d->configure(p);
+    uint32_t s0 = hal_qmc.samples;
+    uint64_t t0 = hal_bus.now_ns;
+
+    while (hal_bus.now_ns - t0 < 1000000000u) {
+        if (mag_read_xyz(d, &x, &y, &z)) {
+            sx += x;
+            sz += z;
+            got++;
+        }
+        hal_host_advance(1000000);
+    }
+    uint32_t odr = hal_qmc.samples - s0;
+
+    double k = d->lsb_per_gauss(p) / 3000.0;
+    double h = atan2(sx / got - hal_qmc.off[0] * k,
+                     sz / got - hal_qmc.off[2] * k) * 180.0 / M_PI;
+    double err = angle_err(h, 123.0);
+    int temp = d->read_temp ? d->read_temp(&t) : -1;
+
+    /* Soft reset: vuelve a contestar el chip-ID despues del power-on */
+    int rst = d->soft_reset();
+    hal_host_advance(QMC_SIM_POR_NS);
+    rst |= d->probe();
+
+    int good = early == -1 && found == chip && !cfg && got > 0 &&
+               odr == d->odr_hz(p) && err < 1.0 && temp != 0 && !rst;
+
+    printf("  %-9s 0x%02X  detecta %-9s %3u Hz (%3u)  rumbo %6.2f deg  "
+           "temp %-3s %s\n",
+           d->name, d->addr, found >= 0 ? mag_drivers[found].name : "nada",
+           odr, d->odr_hz(p), err, temp < 0 ? "no" : "si",
+           check(good));
+}
+
+/* Lo de antes: qmc_read_xyz() escrito a mano para el QMC, afuera del
+ * bench como estaba en brujula.c */
+__attribute__((noinline))
+static int read_xyz_antes(int16_t *x, int16_t *y, int16_t *z)
+{
+    uint8_t b[QMC_BLOCK_LEN];
+
+    if (i2c_read_burst(QMC_ADDR, QMC_REG_STATUS, b, sizeof(b)) != 0)
+        return 0;
+    if (!(b[0] & QMC_ST_DRDY))
+        return 0;
+
+    *x = (int16_t)((b[2] << 8) | b[1]);
+    *y = (int16_t)((b[4] << 8) | b[3]);
+    *z = (int16_t)((b[6] << 8) | b[5]);
+    return 1;
+}
+
+static int read_xyz_tabla(int16_t *x, int16_t *y, int16_t *z)
+{
+    return mag_read_xyz(&mag_drivers[MAG_QMC5883L], x, y, z);
+}
+
+/* ns por lectura, con el simulador del bus adentro; se queda con el
+ * mejor de varias vueltas (ver bench_mag) */
+static void mag_read_ns(int (*rd)(int16_t *, int16_t *, int16_t *),
+                        double *best, uint32_t *sum, uint32_t *bytes)
+{
+    const uint32_t iters = 20000;
+    int16_t x = 0, y = 0, z = 0;
+    struct i2c_stats st;
+
+    board_boot();
+    hal_qmc.freerun = 1;
+    i2c_stats_reset();
+    *sum = 0;
+
+    uint64_t t0 = wall_ns();
+    for (uint32_t i = 0; i < iters; i++)
+        if (rd(&x, &y, &z))
+            *sum += (uint32_t)(x * 3 + y * 5 + z * 7);
+    double ns = (double)(wall_ns() - t0) / iters;
+
+    if (ns < *best)
+        *best = ns;
+    i2c_stats_get(&st);
+    *bytes = st.bytes;
+}
+
+/* Solo el decode: inline (BRUJULA_MAG fijo) contra la tabla (MAG_AUTO) */
+static double mag_decode_ns(const struct mag_driver *d, uint32_t *sum)
+{
+    const uint32_t iters = 10000000;
+    uint8_t blk[16][MAG_BLOCK_MAX];
+    double best = 1e9;
+
+    for (int i = 0; i < 16; i++)
+        for (int j = 0; j < MAG_BLOCK_MAX; j++)
+            blk[i][j] = (uint8_t)(i * 31 + j * 7 + 1);
+
+    for (int r = 0; r < 7; r++) {
+        int16_t x = 0, y = 0, z = 0;
+
+        *sum = 0;
+        uint64_t t0 = wall_ns();
+        if (d) {
+            for (uint32_t i = 0; i < iters; i++)
+                if (d->decode(blk[i & 15], &x, &y, &z))
+                    *sum += (uint32_t)(x * 3 + y * 5 + z * 7);
+        } else {
+            for (uint32_t i = 0; i < iters; i++)
+                if (mag_decode(blk[i & 15], &x, &y, &z))
+                    *sum += (uint32_t)(x * 3 + y * 5 + z * 7);
+        }
+        double ns = (double)(wall_ns() - t0) / iters;
+
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static void bench_mag(void)
+{
+    for (int chip = 0; chip < MAG_CHIPS; chip++)
+        mag_chip(chip);
+
+    /* Con otro BRUJULA_MAG lo de antes no es el mismo chip */
+    if (BRUJULA_MAG != MAG_QMC5883L)
+        return;
+
+    /* Intercaladas, para que el ruido del PC les toque a las tres */
+    uint32_t s_old, s_new, s_tab, b_old, b_new, b_tab;
+    double old_ns = 1e9, new_ns = 1e9, tab_ns = 1e9;
+
+    for (int r = 0; r < 25; r++) {
+        mag_read_ns(read_xyz_antes, &old_ns, &s_old, &b_old);
+        mag_read_ns(qmc_read_xyz, &new_ns, &s_new, &b_new);
+        mag_read_ns(read_xyz_tabla, &tab_ns, &s_tab, &b_tab);
+    }
+
+    printf("  qmc_read_xyz (con el bus simulado)\n");
+    printf("    a mano (antes)    %8.1f ns/lectura\n", old_ns);
+    printf("    BRUJULA_MAG fijo  %8.1f ns/lectura   %+5.1f %%\n", new_ns,
+           100.0 * (new_ns - old_ns) / old_ns);
+    printf("    por la tabla      %8.1f ns/lectura   %+5.1f %%\n", tab_ns,
+           100.0 * (tab_ns - old_ns) / old_ns);
+    printf("    mismas muestras y bytes: %s, fijo <= a mano + 10%%: %s\n",
+           check(s_old == s_new && s_old == s_tab && b_old == b_new &&
+                 b_old == b_tab),
+           check(new_ns <= old_ns * 1.10));
+
+    uint32_t d_inl, d_tab;
+    double inl_ns = mag_decode_ns(NULL, &d_inl);
+    double ind_ns = mag_decode_ns(&mag_drivers[MAG_QMC5883L], &d_tab);
+
+    printf("  decode solo\n");
+    printf("    inline            %8.2f ns\n", inl_ns);
+    printf("    por puntero       %8.2f ns\n", ind_ns);
+    printf("    mismo resultado   %s\n", check(d_inl == d_tab));
+}
+
+/* ns por muestra de un kernel de rumbo, datos como los del sensor */
+static double math_ns(float (*kernel)(int16_t, int16_t, int16_t))
+{
+    const uint32_t iters = 1000000;
+    volatile float sink = 0.0f;
+
+    qmc_heading_reset();
+
+    uint64_t t0 = wall_ns();
+    for (uint32_t i = 0; i < iters; i++) {
+        int16_t x = (int16_t)(400 + (i & 1023));
+        int16_t z = (int16_t)(100 + ((i * 7) & 1023));
+        sink += kernel(x, 66, z);
+    }
+    uint64_t dt = wall_ns() - t0;
+
+    (void)sink;
+    return (double)dt / iters;
+}
+
+/* Peor error de rumbo_atan2_cdeg en 360 grados para un modulo dado (en cuentas) */
+static double atan2_sweep(double mag)
+{
+    double worst = 0.0;
+
+    for (uint32_t i = 0; i < 36000; i++) {
+        double a = (i + 0.37) / 100.0;
+        double r = a * M_PI / 180.0;
+        int32_t y = (int32_t)lround(mag * sin(r));
+        int32_t x = (int32_t)lround(mag * cos(r));
+        double ref = atan2((double)y, (double)x) * 180.0 / M_PI;
+        double e = angle_err(rumbo_atan2_cdeg(y, x) / 100.0, ref);
+
+        if (e > worst)
+            worst = e;
+    }
+    return worst;
+}
+
+static void bench_math(void)
+{
+    static const struct { const char *name; double mag; } mags[] = {
+        { "8G, 1 G (Q12)", 3000.0 * 4096 },
+        { "8G, 0.05 G (Q12)", 150.0 * 4096 },
+        { "fondo de escala (Q12)", 32767.0 * 4096 },
+        { "crudo, 100 cuentas", 100.0 },
+    };
+
+    board_boot();
+    qmc_set_filter(&qmc_filters[QMC_FILTER_EMA]);   // la referencia es el EMA
+
+    double ref_ns = math_ns(qmc_heading_update_ref);
+    double fix_ns = math_ns(qmc_heading_update);
+
+    printf("  stage heading math  %10.1f ns/sample (float atan2f, host)\n",
+           ref_ns);
+    printf("  stage heading math  %10.1f ns/sample (Q12 + poly, host)  \n",
+           fix_ns);
+
+    for (size_t i = 0; i < sizeof(mags) / sizeof(mags[0]); i++)
+        printf("  atan2 max err       %10.4f deg   %s\n",
+               atan2_sweep(mags[i].mag), mags[i].name);
+
+    /*
+     * Camino completo contra la referencia: campo girando 0.01 grados por
+     * muestra, una vuelta entera, los dos filtros con las mismas muestras.
+     */
+    double worst = 0.0, sum = 0.0;
+
+    qmc_heading_reset();
+    for (uint32_t i = 0; i < 36000; i++) {
+        double r = i / 100.0 * M_PI / 180.0;
+        int16_t x = (int16_t)lround(400 + 3000.0 * sin(r));
+        int16_t z = (int16_t)lround(100 + 3000.0 * cos(r));
+        double e = angle_err(qmc_heading_update(x, 66, z),
+                             qmc_heading_update_ref(x, 66, z));
+
+        sum += e;
+        if (e > worst)
+            worst = e;
+    }
+    printf("  fixed vs float      %10.4f deg max  %.4f deg mean (sweep 360)\n",
+           worst, sum / 36000);
+}
+
+/* ---- Puntos cardinales: tabla contra libm ---- */
+
+/* Lo que hacia interfaz.c antes de la tabla */
+static void polar_libm(int deg, int16_t *x, int16_t *y)
+{
+    *x = 120 + (cos(deg * M_PI / 180.0) * 100);
+    *y = 160 - (sin(deg * M_PI / 180.0) * 100);
+}
+
+static void bench_polar(void)
+{
+    static const int offset[4] = { 0, 180, -90, 90 };   // N, S, E, W
+    const uint32_t frames = 1000000;
+    volatile int16_t sink = 0;
+    uint32_t bad = 0;
+    int16_t x, y, lx, ly;
+
+    /*
+     * 0..359 tiene que dar exactamente lo mismo. Fuera de la vuelta
+     * (lo que pasa con N-90 o N+180) libm ve otro angulo en radianes y
+     * puede caer un pixel al otro lado en los multiplos de 90.
+     */
+    int worst = 0;
+    for (int deg = -720; deg < 720; deg++) {
+        polar_position(deg, &x, &y);
+        polar_libm(deg, &lx, &ly);
+        int d = abs(x - lx) > abs(y - ly) ? abs(x - lx) : abs(y - ly);
+        if (deg >= 0 && deg < 360 && d)
+            bad++;
+        if (d > worst)
+            worst = d;
+    }
+    printf("  table vs libm       %10u / 360 distintos, max %d px en "
+           "-720..719  %s\n", bad, worst, check(!bad && worst <= 1));
+
+    uint64_t t0 = wall_ns();
+    for (uint32_t f = 0; f < frames; f++)
+        for (int k = 0; k < 4; k++) {
+            polar_libm((int)(f % 360) + offset[k], &x, &y);
+            sink += x + y;
+        }
+    uint64_t libm_ns = wall_ns() - t0;
+
+    t0 = wall_ns();
+    for (uint32_t f = 0; f < frames; f++)
+        for (int k = 0; k < 4; k++) {
+            polar_position((int)(f % 360) + offset[k], &x, &y);
+            sink += x + y;
+        }
+    uint64_t lut_ns = wall_ns() - t0;
+
+    (void)sink;
+    printf("  stage place N/S/E/W %10.1f ns/frame (libm cos/sin, host)\n",
+           (double)libm_ns / frames);
+    printf("  stage place N/S/E/W %10.1f ns/frame (tabla, host)\n",
+           (double)lut_ns / frames);
+    printf("  table size          %10zu bytes\n", sizeof(polar_lut));
+}
+
+/* ---- Framebuffers: doble / triple buffer contra una sola superficie ---- */
+
+static uint16_t fb_ref[FB_PIXELS];
+
+/* Rectangulo en el back buffer y en la referencia */
+static void fb_rect(int x, int y, int w, int h, uint16_t c)
+{
+    for (int j = y; j < y + h; j++)
+        for (int i = x; i < x + w; i++) {
+            fb_draw_pixel(i, j, c);
+            if (i >= 0 && i < FB_WIDTH && j >= 0 && j < FB_HEIGHT)
+                fb_ref[j * FB_WIDTH + i] = c;
+        }
+}
+
+static void fb_run(uint8_t nbuf, uint32_t render_us)
+{
+    const uint32_t frames = 200;
+    uint32_t in_flight = 0;
+    struct fb_stats st;
+
+    system_init();
+    srand(1);
+    fb_init(NULL, nbuf);
+    memset(fb_ref, 0, sizeof(fb_ref));
+
+    /* Primer frame completo, despues como la brujula: 7 glifos movidos */
+    fb_rect(0, 0, FB_WIDTH, FB_HEIGHT, 0xFFFF);
+    fb_swap();
+
+    uint64_t t0 = hal_bus.now_ns;
+    for (uint32_t f = 0; f < frames; f++) {
+        for (int k = 0; k < 7; k++)
+            fb_rect(rand() % FB_WIDTH, rand() % FB_HEIGHT, 12, 16,
+                    (uint16_t)rand());
+        sleep_us(render_us);
+        fb_swap();
+        if (fb_back() == hal_lcd.sending)
+            in_flight++;
+    }
+    double secs = (hal_bus.now_ns - t0) / 1e9;
+
+    /* Vaciar la cola: el ultimo frame tiene que llegar al panel */
+    while (hal_lcd_busy())
+        sleep_us(100);
+
+    fb_stats_get(&st);
+    int same = !memcmp(hal_lcd.screen, fb_ref, sizeof(fb_ref));
+
+    printf("  %u buffers, render %u ms\n", nbuf, render_us / 1000);
+    printf("    memory            %10u bytes\n", st.bytes);
+    printf("    swaps/s           %10.1f   (%u al LCD, %u descartados)\n",
+           frames / secs, st.presented, st.dropped);
+    printf("    swaps que esperan %10u\n", st.waits);
+    printf("    copy forward      %10.1f px/frame (de %u)\n",
+           (double)st.copy_pixels_total / (frames + 1), FB_PIXELS);
+    printf("    back en el DMA    %10u   %s\n", in_flight,
+           check(!in_flight));
+    printf("    tears             %10llu   %s\n",
+           (unsigned long long)hal_lcd.tears, check(!hal_lcd.tears));
+    printf("    panel == ref      %10s   %s\n", same ? "si" : "no",
+           check(same));
+}
+
+static void bench_fb(void)
+{
+    /* Un frame al LCD son ~117 ms a 10.5 MHz */
+    fb_run(2, 5000);
+    fb_run(3, 5000);
+    fb_run(2, 150000);
+    fb_run(3, 150000);
+}
+
+/* ---- GUI: barrido de rumbos contra gfx_* en memoria ---- */
+
+#define ARROW_STEP 2
+
+static struct sprite_cache arrow_cache;
+static uint32_t frame_ref[360];   // hash de cada rumbo, modo de referencia
+
+static uint32_t frame_hash(const uint16_t *f)
+{
+    const uint8_t *p = (const uint8_t *)f;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < FB_PIXELS * sizeof(uint16_t); i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static void gui_boot(void)
+{
+    system_init();
+    fb_init(NULL, 3);
+    gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+}
+
+/* Paso del cache mas cercano, igual que scene_set_arrow() */
+static int arrow_q(int deg)
+{
+    deg %= 360;
+    if (deg < 0)
+        deg += 360;
+    return (deg + ARROW_STEP / 2) / ARROW_STEP % (360 / ARROW_STEP) *
+           ARROW_STEP;
+}
+
+/* Como antes de la escena: todo de nuevo en cada frame */
+static void immediate_frame(int deg)
+{
+    draw_compass_UI();
+    draw_cardinal_points(deg);
+}
+
+static void scene_setup(void)
+{
+    scene_init(NULL);
+}
+
+static void scene_frame(int deg)
+{
+    scene_set_heading(deg);
+    scene_render();
+}
+
+/* Flecha apuntando al norte, rasterizada en cada frame */
+static void immediate_arrow_frame(int deg)
+{
+    draw_compass_rose();
+    draw_arrow_rotated(arrow_q(deg - 90));
+    draw_cardinal_points(deg);
+}
+
+static void sprite_scene_setup(void)
+{
+    sprite_pool_reset();
+    sprite_cache_build(&arrow_cache, ARROW_STEP, 120, 160,
+                       draw_arrow_rotated);
+    scene_init(&arrow_cache);
+}
+
+static void sprite_scene_frame(int deg)
+{
+    scene_set_heading(deg);
+    scene_set_arrow(deg - 90);
+    scene_render();
+}
+
+struct render_mode {
+    const char *name;
+    void (*setup)(void);
+    void (*frame)(int deg);
+    int reference;            // 1 = guarda hashes, 0 = compara
+};
+
+static const struct render_mode render_modes[] = {
+    { "inmediato (draw_compass_UI + puntos)", NULL, immediate_frame, 1 },
+    { "escena retenida", scene_setup, scene_frame, 0 },
+    { "inmediato, flecha girando", NULL, immediate_arrow_frame, 1 },
+    { "escena, flecha por sprites", sprite_scene_setup, sprite_scene_frame,
+      0 },
+};
+
+/* -o / -g: un frame cada 45 grados */
+static uint32_t golden_frame(const char *mode, int deg, const uint16_t *f)
+{
+    static uint16_t golden[FB_PIXELS];
+    char path[512];
+    uint32_t diff = 0;
+
+    snprintf(path, sizeof(path), "%s/%s_%03d.ppm",
+             ppm_out ? ppm_out : ppm_golden, mode, deg);
+
+    if (ppm_out) {
+        if (gfx_host_write_ppm(path, f))
+            fprintf(stderr, "no se pudo escribir %s\n", path);
+        return 0;
+    }
+
+    if (gfx_host_read_ppm(path, golden))
+        return FB_PIXELS;
+    for (int i = 0; i < FB_PIXELS; i++)
+        diff += golden[i] != f[i];
+    return diff;
+}
+
+static void render_run(const struct render_mode *m, int idx)
+{
+    struct gfx_host_stats g0, g1;
+    struct fb_stats f0, f1;
+    uint64_t ns = 0, ns_max = 0, px_max = 0;
+    uint32_t mismatch = 0, golden_diff = 0;
+    const char *tag = idx < 2 ? "fija" : "gira";
+
+    gui_boot();
+    if (m->setup)
+        m->setup();
+
+    gfx_host_stats_reset();
+    gfx_host_stats_get(&g0);
+    fb_stats_get(&f0);
+
+    for (int deg = 0; deg < 360; deg++) {
+        struct fb_stats fa, fb;
+
+        fb_stats_get(&fa);
+        uint64_t t0 = wall_ns();
+        m->frame(deg);
+        uint64_t dt = wall_ns() - t0;
+        fb_stats_get(&fb);
+
+        ns += dt;
+        if (dt > ns_max)
+            ns_max = dt;
+        if (deg && fb.pixels - fa.pixels > px_max)
+            px_max = fb.pixels - fa.pixels;
+
+        uint32_t h = frame_hash(fb_back());
+        if (m->reference)
+            frame_ref[deg] = h;
+        else if (frame_ref[deg] != h)
+            mismatch++;
+
+        if ((ppm_out || ppm_golden) && deg % 45 == 0)
+            golden_diff += golden_frame(tag, deg, fb_back());
+
+        fb_swap();
+    }
+
+    gfx_host_stats_get(&g1);
+    fb_stats_get(&f1);
+
+    printf("  %s\n", m->name);
+    printf("    frame time        %10.1f us mean  %.1f us max (host)\n",
+           ns / 360 / 1e3, ns_max / 1e3);
+    printf("    pixels/frame      %10.1f mean  %llu max (sin el primero)\n",
+           (double)(f1.pixels - f0.pixels) / 360,
+           (unsigned long long)px_max);
+    for (int p = 0; p < GFX_PRIM_COUNT; p++)
+        if (g1.calls[p] != g0.calls[p])
+            printf("    %-17s %10.1f calls/frame\n", gfx_prim_names[p],
+                   (double)(g1.calls[p] - g0.calls[p]) / 360);
+    if (!m->reference)
+        printf("    igual al inmediato %9u / 360 distintos  %s\n", mismatch,
+               check(!mismatch));
+    if (ppm_golden && !ppm_out)
+        printf("    vs referencia     %10u pixeles distintos  %s\n",
+               golden_diff, check(!golden_diff));
+}
+
+static void bench_render(void)
+{
+    for (size_t i = 0; i < sizeof(render_modes) / sizeof(render_modes[0]);
+         i++)
+        render_run(&render_modes[i], (int)i);
+}
+
+/* ---- Lectura del rumbo: atlas de digitos contra snprintf + font ---- */
+
+#define RO_X 95
+#define RO_Y 290
+#define RO_UPDATES 36000   // 100 vueltas de a un grado
+
+static struct glyph_atlas ro_atlas;
+static char ro_prev[3];
+
+/* Lo de antes (draw_cardinal_points): snprintf y el font a textsize 2 */
+static __attribute__((noinline)) void readout_antes(int deg)
+{
+    char buffer[16];
+
+    gfx_setCursor(RO_X, RO_Y);
+    gfx_setTextColor(LCD_GREEN, LCD_WHITE);
+    gfx_setTextSize(GLYPH_SIZE);   // en la placa lo dejaba main()
+    snprintf(buffer, sizeof(buffer), "%03d", deg);
+    gfx_puts(buffer);
+}
+
+static void readout_font(int deg)
+{
+    char d[3];
+
+    glyph_digits3(deg, d);
+    for (int i = 0; i < 3; i++)
+        gfx_drawChar(RO_X + i * GLYPH_W, RO_Y, d[i], LCD_GREEN, LCD_WHITE,
+                     GLYPH_SIZE);
+}
+
+static void readout_atlas(int deg)
+{
+    char d[3];
+
+    glyph_digits3(deg, d);
+    for (int i = 0; i < 3; i++)
+        glyph_blit(&ro_atlas, RO_X + i * GLYPH_W, RO_Y, d[i], LCD_GREEN);
+}
+
+/* Como la escena: solo los digitos que cambiaron */
+static void readout_changed(int deg)
+{
+    char d[3];
+
+    glyph_digits3(deg, d);
+    for (int i = 0; i < 3; i++)
+        if (d[i] != ro_prev[i]) {
+            glyph_blit(&ro_atlas, RO_X + i * GLYPH_W, RO_Y, d[i], LCD_GREEN);
+            ro_prev[i] = d[i];
+        }
+}
+
+static uint32_t readout_hash(void)
+{
+    const uint16_t *f = fb_back();
+    uint32_t h = 2166136261u;
+
+    for (int y = RO_Y; y < RO_Y + GLYPH_H; y++)
+        for (int x = RO_X; x < RO_X + 3 * GLYPH_W; x++)
+            h = (h ^ f[y * FB_WIDTH + x]) * 16777619u;
+    return h;
+}
+
+static void bench_readout(void)
+{
+    static const struct {
+        const char *name;
+        void (*draw)(int deg);
+    } modes[] = {
+        { "snprintf + gfx_puts", readout_antes },
+        { "digitos + drawChar", readout_font },
+        { "atlas, 3 digitos", readout_atlas },
+        { "atlas, los que cambian", readout_changed },
+    };
+    static uint32_t ref[1000];
+    int bad_digits = 0;
+
+    for (int v = 0; v < 1000; v++) {
+        char s[8], d[3];
+        snprintf(s, sizeof(s), "%03d", v);
+        glyph_digits3(v, d);
+        bad_digits += memcmp(s, d, 3) != 0;
+    }
+    printf("  glyph_digits3 = %%03d   %s (%d distintos de 1000)\n",
+           check(!bad_digits), bad_digits);
+
+    gui_boot();
+    glyph_atlas_init(&ro_atlas, LCD_WHITE);
+    glyph_atlas_add(&ro_atlas, "0123456789", LCD_GREEN);
+    printf("  atlas                %6zu bytes (%u glifos de %dx%d), "
+           "struct %zu bytes\n",
+           sizeof(ro_atlas.pixels[0]) * ro_atlas.n, ro_atlas.n, GLYPH_W,
+           GLYPH_H, sizeof(ro_atlas));
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        struct fb_stats f0, f1;
+        uint32_t mismatch = 0;
+
+        /* Mismos pixeles que lo de antes, en 0..999 */
+        gui_boot();
+        memset(ro_prev, 0, sizeof(ro_prev));
+        for (int v = 0; v < 1000; v++) {
+            modes[m].draw(v);
+            if (m == 0)
+                ref[v] = readout_hash();
+            else if (ref[v] != readout_hash())
+                mismatch++;
+        }
+
+        gui_boot();
+        memset(ro_prev, 0, sizeof(ro_prev));
+        fb_stats_get(&f0);
+        uint64_t t0 = wall_ns();
+        for (int i = 0; i < RO_UPDATES; i++)
+            modes[m].draw(i % 360);
+        uint64_t dt = wall_ns() - t0;
+        fb_stats_get(&f1);
+
+        printf("  %-22s %8.1f ns/update %7.1f px/update (host)  %s\n",
+               modes[m].name, (double)dt / RO_UPDATES,
+               (double)(f1.pixels - f0.pixels) / RO_UPDATES,
+               m == 0 ? "" : check(!mismatch));
+    }
+}
+
+/* ---- Sprites: memoria por paso, blit contra rasterizar ---- */
+
+static void bench_sprites(void)
+{
+    static const uint16_t steps[] = { 1, 2, 5, 10 };
+    static struct sprite_cache c;
+
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        uint64_t raster_ns = 0, blit_ns = 0;
+        uint64_t raster_px = 0, blit_px = 0;
+        uint32_t bad = 0;
+        struct fb_stats a, b;
+
+        gui_boot();
+        sprite_pool_reset();
+
+        uint64_t t0 = wall_ns();
+        sprite_cache_build(&c, steps[s], 120, 160, draw_arrow_rotated);
+        uint64_t build_ns = wall_ns() - t0;
+
+        for (int deg = 0; deg < 360; deg += steps[s]) {
+            memset(fb_back(), 0xFF, FB_PIXELS * sizeof(uint16_t));
+            fb_stats_get(&a);
+            t0 = wall_ns();
+            draw_arrow_rotated(deg);
+            raster_ns += wall_ns() - t0;
+            fb_stats_get(&b);
+            raster_px += b.pixels - a.pixels;
+            uint32_t h = frame_hash(fb_back());
+
+            memset(fb_back(), 0xFF, FB_PIXELS * sizeof(uint16_t));
+            fb_stats_get(&a);
+            t0 = wall_ns();
+            sprite_blit(&c, deg);
+            blit_ns += wall_ns() - t0;
+            fb_stats_get(&b);
+            blit_px += b.pixels - a.pixels;
+            bad += frame_hash(fb_back()) != h;
+        }
+
+        printf("  paso %2u grados (%u frames)\n", steps[s], c.nframes);
+        printf("    memory            %10u bytes  (%u tramos)\n",
+               sprite_cache_bytes(&c), c.nruns);
+        printf("    build             %10.1f ms (host)\n", build_ns / 1e6);
+        printf("    rasterizar        %10.1f us/frame  %.0f px (host)\n",
+               raster_ns / 1e3 / c.nframes, (double)raster_px / c.nframes);
+        printf("    blit              %10.1f us/frame  %.0f px (host)\n",
+               blit_ns / 1e3 / c.nframes, (double)blit_px / c.nframes);
+        printf("    blit == raster    %10u / %u distintos  %s\n", bad,
+               c.nframes, check(!bad));
+    }
+}
+
+/* ---- Adquisicion no bloqueante: transiciones de la maquina ---- */
+
+struct acq_case {
+    const char *name;
+    enum acq_mode mode;
+    uint16_t trigger_ticks;   // 0: 50 en ACQ_TIMER, 150 (watchdog) si no
+    void (*inject)(void);     // se llama a los 500 ms
+    int (*check)(const struct acq_stats *st);
+};
+
+static uint32_t acq_delivered;
+static uint32_t acq_latched;   // muestras que midio el chip en la corrida
+
+static void acq_count(const struct qmc_sample *s)
+{
+    (void)s;
+    acq_delivered++;
+}
+
+static void inj_none(void) { }
+static void inj_nack1(void) { hal_bus.fail_nack = 1; }
+static void inj_nack_all(void) { hal_bus.fail_nack = 3; }
+static void inj_stall(void) { hal_bus.fail_stall = 1; }
+static void inj_no_dma(void) { hal_bus.no_dma = 1; }
+
+static void inj_overrun(void)
+{
+    acq_trigger();
+    acq_trigger();
+}
+
+static int chk_clean(const struct acq_stats *st)
+{
+    return st->samples >= 19 && !st->nacks && !st->timeouts && !st->failures;
+}
+
+static int chk_timer(const struct acq_stats *st)
+{
+    return st->samples >= 19 && st->no_data > 0 && !st->failures;
+}
+
+/* Disparos mas rapidos que el ODR: cada muestra entregada es nueva */
+static int chk_no_repeat(const struct acq_stats *st)
+{
+    return st->samples >= 15 && st->samples <= acq_latched &&
+           st->no_data > 0 && !st->failures;
+}
+
+static int chk_nack1(const struct acq_stats *st)
+{
+    return st->nacks == 1 && st->retries == 1 && !st->failures &&
+           st->samples >= 19;
+}
+
+static int chk_nack_all(const struct acq_stats *st)
+{
+    /* Se pierde el disparo; el watchdog recupera el DRDY que quedo en 1 */
+    return st->nacks == 3 && st->failures == 1 && !st->consec_failures &&
+           st->samples >= 18;
+}
+
+static int chk_stall(const struct acq_stats *st)
+{
+    return st->timeouts == 1 && st->retries == 1 && !st->failures &&
+           st->samples >= 19;
+}
+
+static int chk_overrun(const struct acq_stats *st)
+{
+    return st->overruns >= 1 && !st->failures;
+}
+
+static int chk_no_dma(const struct acq_stats *st)
+{
+    return st->fallbacks == 1 && acq_mode() == ACQ_POLL && st->samples >= 19;
+}
+
+static const struct acq_case acq_cases[] = {
+    { "poll (como antes)", ACQ_POLL, 0, inj_none, chk_clean },
+    { "DRDY + DMA", ACQ_DRDY, 0, inj_none, chk_clean },
+    { "timer 20 Hz + DMA", ACQ_TIMER, 0, inj_none, chk_timer },
+    { "timer 200 Hz sin repetir", ACQ_TIMER, 5, inj_none, chk_no_repeat },
+    { "DRDY, watchdog 5 ms", ACQ_DRDY, 5, inj_none, chk_no_repeat },
+    { "NACK -> reintento", ACQ_DRDY, 0, inj_nack1, chk_nack1 },
+    { "NACK x3 -> falla", ACQ_DRDY, 0, inj_nack_all, chk_nack_all },
+    { "bus colgado -> timeout", ACQ_DRDY, 0, inj_stall, chk_stall },
+    { "disparo en curso", ACQ_DRDY, 0, inj_overrun, chk_overrun },
+    { "sin DMA -> polling", ACQ_DRDY, 0, inj_no_dma, chk_no_dma },
+};
+
+static void bench_acq(void)
+{
+    const uint64_t run_ns = 2000000000u;
+
+    printf("  %-24s %7s %8s %5s %5s %5s %5s %5s  %s\n", "caso", "samples",
+           "main bus", "nack", "tout", "retry", "fail", "ovr", "");
+
+    for (size_t i = 0; i < sizeof(acq_cases) / sizeof(acq_cases[0]); i++) {
+        const struct acq_case *c = &acq_cases[i];
+        struct acq_config cfg = {
+            .mode = c->mode,
+            .tick_hz = 1000,
+            .trigger_ticks = c->trigger_ticks ? c->trigger_ticks
+                             : c->mode == ACQ_TIMER ? 50 : 150,
+            .timeout_ticks = 5,
+            .retries = 2,
+            .on_sample = acq_count,
+        };
+        struct acq_stats st;
+        int injected = 0;
+
+        board_boot();
+        acq_delivered = 0;
+        acq_start(&cfg);
+
+        uint32_t s0 = hal_qmc.samples;
+        uint64_t t0 = hal_bus.now_ns;
+        uint64_t blocked = 0;
+
+        while (hal_bus.now_ns - t0 < run_ns) {
+            if (!injected && hal_bus.now_ns - t0 >= run_ns / 4) {
+                c->inject();
+                injected = 1;
+            }
+
+            /* main: lo que hace en polling bloquea; si no, "trabaja" 1 ms */
+            uint64_t t = hal_bus.now_ns;
+            acq_service();
+            blocked += hal_bus.now_ns - t;
+            if (acq_mode() != ACQ_POLL)
+                hal_host_advance(1000000);
+        }
+
+        acq_stats_get(&st);
+        acq_latched = hal_qmc.samples - s0;
+        printf("  %-24s %7u %6.1f %% %5u %5u %5u %5u %5u  %s\n", c->name,
+               acq_delivered, 100.0 * blocked / run_ns, st.nacks,
+               st.timeouts, st.retries, st.failures, st.overruns,
+               check(c->check(&st) && acq_delivered == st.samples));
+    }
+}
+
+/* ---- Recuperacion del sensor: fallas del bus sin frenar el dibujo ---- */
+
+#define REC_FAULT_MS 1000   // la falla entra aca
+#define REC_RUN_MS   6000
+#define REC_FRAME_MS   50   // render de impresion.c
+
+struct rec_case {
+    const char *name;
+    uint32_t nack;          // hal_bus.fail_nack
+    uint32_t stall;         // hal_bus.fail_stall
+    uint32_t sda;           // hal_bus.sda_stuck
+    uint32_t fix_ms;        // se arregla sola despues de esto; 0 = no
+};
+
+static const struct rec_case rec_cases[] = {
+    { "chip sin responder 1 s", UINT32_MAX, 0, 0, 1000 },
+    { "periferico colgado", 0, UINT32_MAX, 0, 0 },
+    { "SDA trabada, 5 pulsos", 0, 0, 5, 0 },
+    { "SDA trabada, 20 pulsos", 0, 0, 20, 0 },
+    { "SDA en corto 2 s", 0, 0, UINT32_MAX, 2000 },
+};
+
+static void rec_inject(const struct rec_case *c)
+{
+    hal_bus.fail_nack = c->nack;
+    hal_bus.fail_stall = c->stall;
+    hal_bus.sda_stuck = c->sda;
+}
+
+static void rec_fix(void)
+{
+    hal_bus.fail_nack = 0;
+    hal_bus.sda_stuck = 0;
+}
+
+/* Lo de antes: qmc_init() desde el loop, con la pantalla congelada */
+static void rec_blocking(const struct rec_case *c, uint64_t *ms, int *err)
+{
+    board_boot();
+    rec_inject(c);
+    uint64_t t0 = hal_bus.now_ns;
+    *err = qmc_init();
+    *ms = (hal_bus.now_ns - t0) / 1000000u;
+    rec_fix();
+    hal_bus.fail_stall = 0;
+}
+
+/*
+ * Las tareas de impresion.c a mano, de a 1 ms: el perfil de 100 Hz por
+ * DRDY (al ODR del chip, qmc_odr_hz()), el mantenimiento cada 100 ms
+ * (dispara rec_start()), rec_service() cada 5 ms y un cuadro cada 50 ms.
+ * El cuadro que se atrasa es lo que un paso de la recuperacion frena al
+ * dibujo.
+ */
+static void rec_run(const struct rec_case *c)
+{
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 15,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = ring_push,
+    };
+    static struct qmc_sample batch[COLA_LEN];
+    struct acq_stats as;
+    struct rec_stats r0, r1;
+    uint64_t fault_us = 0, detect_us = 0, back_us = 0, frame_us = 0;
+    uint32_t gap_max = 0, step_max = 0, after = 0, frames_flag = 0;
+    int32_t cdeg = 0;
+
+    board_boot();
+    qmc_configure(&qmc_profiles[QMC_PROFILE_100HZ]);
+    hal_qmc.heading_deg = 77.0;
+    cola_init(&ring);
+    rec_stats_get(&r0);
+    acq_start(&cfg);
+
+    for (uint32_t ms = 0; ms < REC_RUN_MS; ms++) {
+        uint64_t now = time_us();
+
+        if (ms == REC_FAULT_MS) {
+            rec_inject(c);
+            fault_us = now;
+        }
+        if (c->fix_ms && ms == REC_FAULT_MS + c->fix_ms)
+            rec_fix();
+
+        int n = cola_drain(&ring, batch, COLA_LEN);
+        for (int i = 0; i < n; i++)
+            cdeg = qmc_heading_cdeg(batch[i].x, batch[i].y, batch[i].z);
+        if (back_us)
+            after += (uint32_t)n;
+
+        if (ms % 100 == 0) {
+            acq_stats_get(&as);
+            if (as.consec_failures > 20 && !rec_degraded()) {
+                rec_start(&cfg);
+                if (!detect_us)
+                    detect_us = time_us();
+            }
+        }
+        if (ms % 5 == 0) {
+            uint64_t t = time_us();
+            int was = rec_degraded();
+            rec_service();
+            if (time_us() - t > step_max)
+                step_max = (uint32_t)(time_us() - t);
+            if (was && !rec_degraded() && !back_us)
+                back_us = time_us();
+        }
+        if (ms % REC_FRAME_MS == 0) {
+            if (frame_us && time_us() - frame_us > gap_max)
+                gap_max = (uint32_t)(time_us() - frame_us);
+            frame_us = time_us();
+            frames_flag += (uint32_t)rec_degraded();
+        }
+
+        /* El paso que bloqueo ya corrio el reloj */
+        if (time_us() - now < 1000)
+            hal_host_advance((1000 - (time_us() - now)) * 1000u);
+    }
+
+    rec_stats_get(&r1);
+    hal_bus.fail_stall = 0;
+    rec_fix();
+
+    /* El perfil volvio al chip: el ODR que da es el de qmc_odr_hz() */
+    uint32_t odr = qmc_odr_hz(&qmc_profiles[QMC_PROFILE_100HZ]);
+    double after_s = back_us ? (time_us() - back_us) / 1e6 : 0.0;
+    int good = r1.recovered == r0.recovered + 1 && !rec_degraded() &&
+               qmc_sim_period_ns(&hal_qmc) == 1000000000u / odr &&
+               after >= 0.9 * odr * after_s && frames_flag > 0 &&
+               gap_max <= REC_FRAME_MS * 1000u + 6000u &&
+               angle_err(cdeg / 100.0, 77.0) < 1.0;
+
+    uint64_t old_ms;
+    int old_err;
+    rec_blocking(c, &old_ms, &old_err);
+
+    printf("  %-24s %9.0f %7.1f %7u %6.1f %6.1f %7.1f   %5llu ms %2d  %s\n",
+           c->name, detect_us ? (detect_us - fault_us) / 1e3 : 0.0,
+           r1.last_us / 1e3, r1.passes - r0.passes, step_max / 1e3,
+           gap_max / 1e3,
+           after_s > 0 ? after / after_s : 0.0,
+           (unsigned long long)old_ms, old_err, check(good));
+}
+
+static void bench_recover(void)
+{
+    printf("  %-24s %9s %7s %7s %6s %6s %7s   %s\n", "falla", "deteccion",
+           "recup", "vueltas", "paso", "cuadro", "mues/s",
+           "qmc_init de antes");
+    printf("  %-24s %9s %7s %7s %6s %6s %7s\n", "", "ms", "ms", "",
+           "max ms", "max ms", "despues");
+    for (size_t i = 0; i < sizeof(rec_cases) / sizeof(rec_cases[0]); i++)
+        rec_run(&rec_cases[i]);
+}
+
+/* ---- Calibracion: ajuste en linea sobre datos distorsionados ---- */
+
+struct cal_case {
+    const char *name;
+    double soft[3][3];
+    int16_t off[3];           // cuentas de 8G
+    double rate_dps;
+    double tilt_deg;
+    uint32_t max_samples;
+    enum cal_model expect;    // CAL_AUTO: no tiene que converger
+};
+
+static const struct cal_case cal_cases[] = {
+    { "3D, elipsoide",
+      { { 1.12, 0.06, -0.04 }, { 0.06, 0.93, 0.05 }, { -0.04, 0.05, 1.00 } },
+      { -250, 310, 520 }, 10.0, 150.0, 12000, CAL_ELLIPSOID },
+    { "plano, elipse",
+      { { 1.10, 0.00, 0.07 }, { 0.00, 1.00, 0.00 }, { 0.07, 0.00, 0.92 } },
+      { 520, 66, -180 }, 20.0, 0.0, 6000, CAL_PLANAR },
+    { "90 grados de giro",
+      { { 1.10, 0.00, 0.07 }, { 0.00, 1.00, 0.00 }, { 0.07, 0.00, 0.92 } },
+      { 520, 66, -180 }, 10.0, 0.0, 900, CAL_AUTO },
+};
+
+/* Una muestra nueva del sensor (100 Hz), esperando el DRDY */
+static void cal_read(int16_t *x, int16_t *y, int16_t *z)
+{
+    while (!qmc_read_xyz(x, y, z))
+        hal_host_advance(1000000);
+}
+
+/* Media de |rumbo - real| sin filtro (reset en cada muestra), en plano */
+static double cal_heading_err(void)
+{
+    double sum = 0.0;
+    int16_t x, y, z;
+
+    hal_qmc.tilt_deg = 0.0;
+    for (int i = 0; i < 1000; i++) {
+        cal_read(&x, &y, &z);
+        qmc_heading_reset();
+        double h = qmc_heading_cdeg(x, y, z) / 100.0;
+        sum += angle_err(h, qmc_sim_true_heading(&hal_qmc,
+                                                 hal_qmc.last_latch_ns));
+    }
+    return sum / 1000;
+}
+
+/* W·S tiene que ser proporcional a la identidad (en el plano, el bloque XZ) */
+static double cal_soft_err(const struct cal_result *r, const struct cal_case *c)
+{
+    double p[3][3], worst = 0.0;
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            p[i][j] = 0.0;
+            for (int k = 0; k < 3; k++)
+                p[i][j] += r->soft[i][k] * c->soft[k][j];
+        }
+
+    double scale = r->model == CAL_PLANAR
+        ? sqrt(p[0][0] * p[2][2] - p[0][2] * p[2][0])
+        : cbrt(p[0][0] * (p[1][1] * p[2][2] - p[1][2] * p[2][1]) -
+               p[0][1] * (p[1][0] * p[2][2] - p[1][2] * p[2][0]) +
+               p[0][2] * (p[1][0] * p[2][1] - p[1][1] * p[2][0]));
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            if (r->model == CAL_PLANAR && (i == 1 || j == 1))
+                continue;
+            double e = fabs(p[i][j] / scale - (i == j));
+            if (e > worst)
+                worst = e;
+        }
+    return worst;
+}
+
+static void bench_cal(void)
+{
+    static struct cal_state st;
+    struct cal_result r;
+    int16_t x, y, z;
+
+    printf("  %-18s %6s %6s %6s %8s %8s %8s %9s %9s\n", "caso", "modelo",
+           "conv", "cober", "fit err", "off err", "W err", "|err| antes",
+           "despues");
+
+    for (size_t i = 0; i < sizeof(cal_cases) / sizeof(cal_cases[0]); i++) {
+        const struct cal_case *c = &cal_cases[i];
+        uint32_t conv_at = 0;
+
+        board_boot();
+        qmc_configure(&qmc_profiles[QMC_PROFILE_100HZ]);
+        memcpy(hal_qmc.soft, c->soft, sizeof(hal_qmc.soft));
+        memcpy(hal_qmc.off, c->off, sizeof(hal_qmc.off));
+        hal_qmc.rate_dps = c->rate_dps;
+        hal_qmc.tilt_deg = c->tilt_deg;
+        hal_qmc.tilt_hz = 0.07;
+
+        /* En linea: una muestra por vez, se resuelve cada 100 */
+        cal_reset(&st);
+        for (uint32_t n = 1; n <= c->max_samples; n++) {
+            cal_read(&x, &y, &z);
+            cal_add(&st, x, y, z);
+            if (n % 100 == 0 && !conv_at &&
+                cal_solve(&st, CAL_AUTO, &r) == 0 && r.converged)
+                conv_at = n;
+        }
+        cal_solve(&st, CAL_AUTO, &r);
+
+        /* El ajuste da cuentas del chip; c->off es de 8G del QMC */
+        double scale = MAG_DRV->lsb_per_gauss(qmc_active_profile()) / 3000.0;
+        double off_err = 0.0;
+        for (int k = 0; r.valid && k < 3; k++) {
+            if (r.model == CAL_PLANAR && k == 1)
+                continue;
+            double e = fabs(r.offset[k] - c->off[k] * scale);
+            if (e > off_err)
+                off_err = e;
+        }
+        double w_err = r.valid ? cal_soft_err(&r, c) : 0.0;
+
+        /* Rumbo con la calibracion de fabrica y con la nueva */
+        char heading[32] = "        -         -";
+        int heading_ok = 0;
+        if (r.converged) {
+            double before = cal_heading_err();
+            qmc_set_calibration(&r);
+            double after = cal_heading_err();
+            snprintf(heading, sizeof(heading), "%7.2f deg %5.2f deg",
+                     before, after);
+            heading_ok = after < 0.5;
+        }
+
+        int good = c->expect == CAL_AUTO
+            ? !conv_at && !r.converged
+            : conv_at && heading_ok && r.model == c->expect &&
+              off_err < 3.0 && w_err < 0.01;
+
+        printf("  %-18s %6s %6u %5.0f %% %8.4f %8.2f %8.4f %s  %s\n",
+               c->name, !r.valid ? "-" : r.model == CAL_PLANAR ? "plano"
+                                                               : "3D",
+               conv_at, 100.0 * r.coverage, r.fit_err, off_err, w_err,
+               heading,
+               c->expect == CAL_AUTO ? check(good) : check_fine(good));
+    }
+
+    /* Costo por muestra y de una resolucion, y memoria */
+    const uint32_t n = 1000000;
+    cal_reset(&st);
+    uint64_t t0 = wall_ns();
+    for (uint32_t i = 0; i < n; i++)
+        cal_add(&st, (int16_t)(400 + (i * 7919) % 3000),
+                (int16_t)(66 + (i * 104729) % 3000),
+                (int16_t)(100 + (i * 1299709) % 3000));
+    uint64_t t1 = wall_ns();
+    for (int i = 0; i < 1000; i++)
+        cal_solve(&st, CAL_ELLIPSOID, &r);
+    uint64_t t2 = wall_ns();
+
+    printf("  cal_add             %10.1f ns/sample (host)\n",
+           (double)(t1 - t0) / n);
+    printf("  cal_solve           %10.1f us (elipsoide, host)\n",
+           (t2 - t1) / 1e3 / 1000);
+    printf("  estado              %10zu bytes, sin muestras guardadas\n",
+           sizeof(st));
+}
+
+/* ---- Almacen en flash: arranque en caliente, desgaste, cortes ---- */
+
+static char flash_path[] = "/tmp/brujula-flash-XXXXXX";
+
+/* Apagar y prender: la flash se vuelve a leer del archivo */
+static void flash_power_cycle(uint32_t sector_size)
+{
+    flash_sim_close(&hal_flash);
+    flash_sim_open(&hal_flash, flash_path, sector_size);
+}
+
+/* Flash nueva (borrada) en el archivo */
+static void flash_fresh(uint32_t sector_size)
+{
+    flash_sim_close(&hal_flash);
+    unlink(flash_path);
+    flash_sim_open(&hal_flash, flash_path, sector_size);
+}
+
+/*
+ * Lo que hace housekeeping: el borrado corre de fondo y lo que no se
+ * pudo escribir se escribe despues. worst_us: la escritura mas larga.
+ */
+static uint64_t worst_us;
+
+static int store_write_wait(uint8_t type, const void *buf, uint8_t len)
+{
+    int r;
+
+    for (;;) {
+        uint64_t t0 = hal_time_us();
+        r = store_write(type, 1, buf, len);
+        if (hal_time_us() - t0 > worst_us)
+            worst_us = hal_time_us() - t0;
+        if (r <= 0)
+            return r;
+        while (store_poll() > 0)
+            hal_sleep_until_us(hal_time_us() + 1000u);
+    }
+}
+
+static int state_save_wait(unsigned what)
+{
+    int r = qmc_state_save(what);
+
+    while (r > 0) {
+        hal_sleep_until_us(hal_time_us() + 1000u);
+        r = qmc_state_poll();
+    }
+    return r;
+}
+
+/* Campo distorsionado y quieto a 123 grados, 100 Hz */
+static void store_sensor(void)
+{
+    static const double soft[3][3] = {
+        { 1.10, 0.00, 0.07 }, { 0.00, 1.00, 0.00 }, { 0.07, 0.00, 0.92 },
+    };
+
+    memcpy(hal_qmc.soft, soft, sizeof(hal_qmc.soft));
+    hal_qmc.off[0] = 520;
+    hal_qmc.off[2] = -180;
+    hal_qmc.heading_deg = 123.0;
+}
+
+/* Error del primer rumbo despues del arranque */
+static double store_first_heading(void)
+{
+    int16_t x, y, z;
+
+    cal_read(&x, &y, &z);
+    return angle_err(qmc_heading_cdeg(x, y, z) / 100.0,
+                     qmc_sim_true_heading(&hal_qmc, hal_qmc.last_latch_ns));
+}
+
+static void store_warm_boot(void)
+{
+    static struct cal_state st;
+    struct cal_result r;
+    int16_t x, y, z;
+
+    /* Primer arranque: se calibra girando en el plano y se guarda todo */
+    flash_fresh(HAL_HOST_FLASH_SECTOR);
+    board_boot();
+    qmc_configure(&qmc_profiles[QMC_PROFILE_100HZ]);
+    store_sensor();
+    hal_qmc.rate_dps = 20.0;
+
+    cal_reset(&st);
+    for (int i = 0; i < 2000; i++) {
+        cal_read(&x, &y, &z);
+        cal_add(&st, x, y, z);
+    }
+    cal_solve(&st, CAL_AUTO, &r);
+    qmc_set_calibration(&r);
+    hal_qmc.rate_dps = 0.0;
+    for (int i = 0; i < 500; i++) {
+        cal_read(&x, &y, &z);
+        qmc_heading_cdeg(x, y, z);
+    }
+    int saved = state_save_wait(QMC_STATE_ALL) == 0;
+
+    /* Sin estado: offsets de fabrica */
+    board_boot();
+    store_sensor();
+    double cold = store_first_heading();
+
+    /* Con estado: se apaga, se prende y se carga antes de qmc_init() */
+    flash_power_cycle(HAL_HOST_FLASH_SECTOR);
+    system_init();
+    store_sensor();
+    uint64_t t0 = wall_ns();
+    unsigned got = qmc_state_load();
+    uint64_t t1 = wall_ns();
+    qmc_init();
+    double warm = store_first_heading();
+
+    struct store_stats ss;
+    store_stats_get(&ss);
+    printf("  warm boot           %10.1f us load (host), %u registros, "
+           "perfil %s\n", (t1 - t0) / 1e3, ss.records,
+           qmc_active_profile()->name);
+    printf("  primer rumbo        %10.2f deg (en frio: %.2f deg)  %s\n", warm,
+           cold, saved && got == QMC_STATE_ALL &&
+                 qmc_active_profile() == &qmc_profiles[QMC_PROFILE_100HZ]
+               ? check_fine(warm < 0.5) : check(0));
+}
+
+static void store_wear(void)
+{
+    const uint32_t writes = 200000;
+    int32_t v[2] = { 0, 0 }, back[2];
+    int bad = 0;
+
+    /* Sectores de 128 KB en memoria, un registro de 8 bytes que cambia */
+    flash_sim_close(&hal_flash);
+    flash_sim_open(&hal_flash, NULL, HAL_HOST_FLASH_SECTOR);
+    store_init();
+    worst_us = 0;
+
+    for (uint32_t i = 0; i < writes; i++) {
+        v[0] = (int32_t)i;
+        v[1] = (int32_t)(i * 2654435761u);
+        bad |= store_write_wait(1, v, sizeof(v)) != 0;
+    }
+    bad |= store_write(1, 1, v, sizeof(v)) != 0;   // igual: no escribe
+
+    struct store_stats ss;
+    store_stats_get(&ss);
+    store_init();
+    bad |= store_read(1, 1, back, sizeof(back)) != sizeof(back) ||
+           memcmp(v, back, sizeof(v));
+
+    uint32_t e0 = hal_flash.erases[0], e1 = hal_flash.erases[1];
+    printf("  desgaste            %10u escrituras, %u compactaciones, "
+           "borrados %u/%u  %s\n", writes, ss.compactions, e0, e1,
+           check(!bad && !hal_flash.overwrites &&
+                 (e0 > e1 ? e0 - e1 : e1 - e0) <= 1));
+    printf("  peor escritura      %10.1f ms (virtual, con compactacion; "
+           "el borrado va de fondo)  %s\n", worst_us / 1e3,
+           check(worst_us < 20000u));
+}
+
+/* Secuencia para los cortes: tres tipos de largos distintos */
+#define PF_WRITES 42   // multiplo de 3: el tipo sale de i % 3
+
+static uint8_t pf_len(int i)
+{
+    static const uint8_t len[3] = { 1, 48, 8 };
+    return len[i % 3];
+}
+
+static void pf_data(int i, uint8_t *buf)
+{
+    for (int j = 0; j < pf_len(i); j++)
+        buf[j] = (uint8_t)(i * 31 + j * 7);
+}
+
+/* El registro de 'type' tiene que ser una de las dos escrituras, o nada */
+static int pf_check(int type, int old, int cur)
+{
+    uint8_t got[STORE_MAX_LEN], want[STORE_MAX_LEN];
+    int len = store_read((uint8_t)type, 1, got, pf_len(type - 1));
+
+    for (int k = 0; k < 2; k++) {
+        int i = k ? cur : old;
+        if (i < 0) {
+            if (len < 0)
+                return 1;
+            continue;
+        }
+        pf_data(i, want);
+        if (len == pf_len(i) && !memcmp(got, want, (size_t)len))
+            return 1;
+    }
+    return 0;
+}
+
+static void store_power_fail(void)
+{
+    const uint32_t sector = 512;   // chico: compacta cada ~15 escrituras
+    uint8_t buf[STORE_MAX_LEN];
+    uint32_t bad = 0, torn = 0;
+
+    /* Operaciones de la secuencia completa, sin cortes */
+    flash_fresh(sector);
+    store_init();
+    for (int i = 0; i < PF_WRITES; i++) {
+        pf_data(i, buf);
+        store_write_wait((uint8_t)(i % 3 + 1), buf, pf_len(i));
+    }
+    uint64_t ops = hal_flash.ops;
+
+    for (uint64_t cut = 0; cut <= ops; cut++) {
+        int done = 0;
+
+        flash_fresh(sector);
+        hal_flash.cut_after = (int64_t)cut;
+        store_init();
+        for (; done < PF_WRITES; done++) {
+            pf_data(done, buf);
+            if (store_write_wait((uint8_t)(done % 3 + 1), buf,
+                                 pf_len(done)) != 0)
+                break;
+        }
+
+        flash_power_cycle(sector);
+        store_init();
+
+        struct store_stats ss;
+        store_stats_get(&ss);
+        torn += ss.torn > 0;
+
+        /* Por tipo: la ultima escritura que termino, o la que se corto */
+        for (int t = 1; t <= 3; t++) {
+            int old = -1, cur;
+            for (int i = 0; i < done; i++)
+                if (i % 3 + 1 == t)
+                    old = i;
+            cur = done < PF_WRITES && done % 3 + 1 == t ? done : old;
+            bad += !pf_check(t, old, cur);
+        }
+
+        /* Y despues del corte se puede seguir escribiendo */
+        for (int i = 0; i < 6; i++) {
+            pf_data(PF_WRITES + i, buf);
+            bad += store_write_wait((uint8_t)(i % 3 + 1), buf,
+                                    pf_len(PF_WRITES + i)) != 0;
+        }
+        flash_power_cycle(sector);
+        store_init();
+        for (int t = 1; t <= 3; t++)
+            bad += !pf_check(t, PF_WRITES + 2 + t, PF_WRITES + 2 + t);
+    }
+
+    printf("  cortes de energia   %10llu puntos de corte, %u con registro "
+           "roto, %u errores  %s\n", (unsigned long long)ops + 1, torn, bad,
+           check(!(bad || hal_flash.overwrites)));
+}
+
+static void bench_store(void)
+{
+    int fd = mkstemp(flash_path);
+
+    if (fd < 0) {
+        printf("  sin archivo temporal  FALLO\n");
+        failures++;
+        return;
+    }
+    close(fd);
+
+    store_warm_boot();
+    store_wear();
+    store_power_fail();
+
+    flash_sim_close(&hal_flash);   // el resto vuelve a la flash en memoria
+    unlink(flash_path);
+}
+
+/* ---- Trazas: rumbo cada 5 ms contra el real ---- */
+
+#define TRACE_WARMUP_S 10.0   // quieto antes de la traza
+#define TRACE_STEP_NS  5000000u
+#define TRACE_POINTS   2000   // 10 s
+#define TRACE_MAX_LAG  200    // pasos de 5 ms: 1 s, medio periodo del seno
+#define TRACE_STEP_END 2.5    // s: fin del giro de mot_step()
+
+static double mot_step(double t)
+{
+    t -= TRACE_WARMUP_S + 2.0;
+    return t < 0.0 ? 0.0 : t < 0.5 ? 180.0 * t : 90.0;
+}
+
+static double mot_sine(double t)
+{
+    t -= TRACE_WARMUP_S;
+    return t < 0.0 ? 0.0 : 45.0 * sin(2.0 * M_PI * 0.5 * t);
+}
+
+static double mot_ramp(double t)
+{
+    t -= TRACE_WARMUP_S;
+    return t < 0.0 ? 0.0 : 30.0 * t;
+}
+
+/*
+ * Caminata con la placa en la mano: giros de distinto tamano y
+ * velocidad (perfil coseno), pausas y temblor de la mano.
+ */
+static double mot_walk(double t)
+{
+    static const struct { double at, dur, deg; } turns[] = {
+        { 0.5, 0.8, 60.0 }, { 2.0, 1.5, -120.0 }, { 4.0, 0.4, 35.0 },
+        { 5.0, 2.0, 200.0 }, { 7.5, 0.6, -80.0 }, { 8.6, 1.0, 25.0 },
+    };
+    double h = 0.0;
+
+    t -= TRACE_WARMUP_S;
+    if (t < 0.0)
+        return 0.0;
+
+    for (size_t i = 0; i < sizeof(turns) / sizeof(turns[0]); i++) {
+        double u = (t - turns[i].at) / turns[i].dur;
+        if (u >= 1.0)
+            h += turns[i].deg;
+        else if (u > 0.0)
+            h += turns[i].deg * 0.5 * (1.0 - cos(M_PI * u));
+    }
+    return h + 0.8 * sin(2.0 * M_PI * 2.3 * t) + 0.3 * sin(2.0 * M_PI * 5.1 * t);
+}
+
+/* rms(out(t) - truth(t - d)) */
+static double trace_rms(const double *out, const double *truth, int d)
+{
+    double sum = 0.0;
+
+    for (int i = TRACE_MAX_LAG; i < TRACE_POINTS; i++) {
+        double e = angle_err(out[i], truth[i - d]);
+        sum += e * e;
+    }
+    return sqrt(sum / (TRACE_POINTS - TRACE_MAX_LAG));
+}
+
+/* El retardo que mejor alinea la salida con el rumbo real (-1: mas de 1 s) */
+static double trace_lag_ms(const double *out, const double *truth)
+{
+    int best = 0;
+    double best_rms = trace_rms(out, truth, 0);
+
+    for (int d = 1; d <= TRACE_MAX_LAG; d++) {
+        double r = trace_rms(out, truth, d);
+        if (r < best_rms) {
+            best_rms = r;
+            best = d;
+        }
+    }
+    return best == TRACE_MAX_LAG ? -1.0 : best * (TRACE_STEP_NS / 1e6);
+}
+
+static const char *trace_ms_str(char *buf, double ms)
+{
+    if (ms < 0.0)
+        return ">1 s";
+    snprintf(buf, 16, "%.0f ms", ms);
+    return buf;
+}
+
+static const char *trace_deg_str(char *buf, double deg)
+{
+    snprintf(buf, 16, "%.3f deg", deg);
+    return buf;
+}
+
+static void trace_errors(const double *out, const double *truth, double *rms,
+                         double *max)
+{
+    *rms = trace_rms(out, truth, 0);
+    *max = 0.0;
+    for (int i = TRACE_MAX_LAG; i < TRACE_POINTS; i++)
+        if (angle_err(out[i], truth[i]) > *max)
+            *max = angle_err(out[i], truth[i]);
+}
+
+static double trace_signed(double a, double b)
+{
+    return fmod(a - b + 540.0, 360.0) - 180.0;
+}
+
+/* Cuanto pasa del rumbo final del escalon */
+static double trace_overshoot(const double *out, double final)
+{
+    double over = 0.0;
+
+    for (int i = 0; i < TRACE_POINTS; i++) {
+        double d = trace_signed(out[i], final);
+        if (i * (TRACE_STEP_NS / 1e9) > TRACE_STEP_END && d > over)
+            over = d;
+    }
+    return over;
+}
+
+/* Desde el fin del giro hasta quedar dentro de +-tol (-1: nunca) */
+static double trace_settle_ms(const double *out, double final, double tol)
+{
+    int first = (int)(TRACE_STEP_END * 1e9 / TRACE_STEP_NS);
+    int last_out = TRACE_POINTS;
+
+    for (int i = TRACE_POINTS - 1; i >= first; i--)
+        if (fabs(trace_signed(out[i], final)) > tol) {
+            last_out = i;
+            break;
+        }
+    if (last_out == TRACE_POINTS - 1)
+        return -1.0;
+    if (last_out == TRACE_POINTS)
+        return 0.0;
+    return (last_out + 1 - first) * (TRACE_STEP_NS / 1e6);
+}
+
+/* Desvio de la salida alrededor de su media (traza quieta) */
+static double trace_jitter(const double *out)
+{
+    double sum = 0.0, sum2 = 0.0;
+    int n = TRACE_POINTS - TRACE_MAX_LAG;
+
+    for (int i = TRACE_MAX_LAG; i < TRACE_POINTS; i++) {
+        double d = trace_signed(out[i], out[TRACE_MAX_LAG]);
+        sum += d;
+        sum2 += d * d;
+    }
+    return sqrt(sum2 / n - (sum / n) * (sum / n));
+}
+
+/* ---- Cola de muestras: loop lento y estres con dos hilos ---- */
+
+static struct qmc_sample slot;       // lo de antes: una muestra y un flag
+static int slot_ready;
+static uint32_t slot_delivered;
+
+static void ring_slot(const struct qmc_sample *s)
+{
+    slot = *s;
+    slot_ready = 1;
+    slot_delivered++;
+}
+
+/*
+ * 200 Hz y un loop que tarda un frame del LCD (117 ms) por vuelta: con
+ * el flag solo se procesa la ultima muestra de cada vuelta.
+ */
+static void ring_slow_loop(void)
+{
+    const uint64_t run_ns = 5000000000ull, loop_ns = 117000000u;
+    static struct qmc_sample batch[COLA_LEN];
+
+    for (int use_ring = 0; use_ring < 2; use_ring++) {
+        struct acq_config cfg = {
+            .mode = ACQ_DRDY,
+            .tick_hz = 1000,
+            .trigger_ticks = 15,
+            .timeout_ticks = 5,
+            .retries = 2,
+            .on_sample = use_ring ? ring_push : ring_slot,
+        };
+        struct acq_stats st;
+        uint32_t done = 0, batches = 0;
+
+        board_boot();
+        qmc_configure(&qmc_profiles[QMC_PROFILE_200HZ]);
+        cola_init(&ring);
+        slot_ready = 0;
+        slot_delivered = 0;
+        acq_start(&cfg);
+
+        uint64_t end = hal_bus.now_ns + run_ns;
+        while (hal_bus.now_ns < end) {
+            if (use_ring) {
+                int n = cola_drain(&ring, batch, COLA_LEN);
+                done += (uint32_t)n;
+                batches += n > 0;
+            } else if (slot_ready) {
+                slot_ready = 0;
+                done++;
+                batches++;
+            }
+            hal_host_advance(loop_ns);
+        }
+        acq_stats_get(&st);
+
+        uint32_t lost = st.samples - done - cola_count(&ring);
+        int good = use_ring ? lost == 0 && ring.overruns == 0
+                            : lost > st.samples / 2;
+        printf("  %-20s %6u entregadas %6u procesadas %6u perdidas  "
+               "%4.1f por frame, ocupacion max %2u  %s\n",
+               use_ring ? "cola (200 Hz)" : "flag (200 Hz)", st.samples,
+               done, lost, batches ? (double)done / batches : 0.0,
+               use_ring ? ring.high_water : 1, check(good));
+    }
+}
+
+/* Dos hilos de verdad; el consumidor se duerme de vez en cuando */
+#define STRESS_N 4000000u
+
+static int stress_done;
+static uint32_t stress_bad, stress_got;
+
+static void stress_fill(uint32_t i, struct qmc_sample *s)
+{
+    s->x = (int16_t)i;
+    s->y = (int16_t)(i >> 16);
+    s->z = (int16_t)(i * 2654435761u >> 16);
+    s->t_us = i;
+}
+
+static void *stress_producer(void *arg)
+{
+    struct qmc_sample s;
+
+    (void)arg;
+    for (uint32_t i = 0; i < STRESS_N; i++) {
+        stress_fill(i, &s);
+        /* Tramos de 256: 7 de cada 8 esperan lugar, el otro entra como
+         * venga (como la ISR) y pierde lo que no entra */
+        while (((i >> 8) & 7) && cola_count(&ring) >= COLA_LEN)
+            sched_yield();
+        cola_push(&ring, &s);   // llena: se pierde, cuenta overrun
+    }
+    __atomic_store_n(&stress_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *stress_consumer(void *arg)
+{
+    struct qmc_sample batch[16], want;
+    uint64_t last = 0;
+    uint32_t drains = 0;
+    int first = 1;
+
+    (void)arg;
+    for (;;) {
+        int done = __atomic_load_n(&stress_done, __ATOMIC_ACQUIRE);
+        int n = cola_drain(&ring, batch, 16);
+
+        for (int i = 0; i < n; i++) {
+            stress_fill((uint32_t)batch[i].t_us, &want);
+            /* En orden (con huecos si hubo overrun) y sin muestras rotas */
+            if ((!first && batch[i].t_us <= last) ||
+                memcmp(&batch[i], &want, sizeof(want)))
+                stress_bad++;
+            last = batch[i].t_us;
+            first = 0;
+        }
+        stress_got += (uint32_t)n;
+
+        if (!n && done)
+            break;
+        if (!n)
+            sched_yield();
+        if ((++drains & 0x3F) == 0) {   // frame lento de vez en cuando
+            struct timespec ts = { 0, 20000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void ring_stress(void)
+{
+    pthread_t prod, cons;
+
+    cola_init(&ring);
+    stress_done = 0;
+    stress_bad = 0;
+    stress_got = 0;
+
+    uint64_t t0 = wall_ns();
+    pthread_create(&cons, NULL, stress_consumer, NULL);
+    pthread_create(&prod, NULL, stress_producer, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    uint64_t t1 = wall_ns();
+
+    int good = stress_bad == 0 && stress_got + ring.overruns == STRESS_N;
+    printf("  %-20s %u push, %u pop, %u overruns, %u underruns, %u malas, "
+           "%.1f Mmuestras/s  %s\n", "estres 2 hilos", STRESS_N, stress_got,
+           ring.overruns, ring.underruns, stress_bad,
+           STRESS_N / ((t1 - t0) / 1e3), check(good));
+}
+
+static void bench_ring(void)
+{
+    ring_slow_loop();
+    ring_stress();
+}
+
+/* ---- Telemetria binaria: formato, costo y stream por el CDC ---- */
+
+static uint32_t tlm_rng = 0x2545F491u;
+
+static uint32_t tlm_rand(void)
+{
+    tlm_rng ^= tlm_rng << 13;
+    tlm_rng ^= tlm_rng >> 17;
+    tlm_rng ^= tlm_rng << 5;
+    return tlm_rng;
+}
+
+/* CRC conocido, ida y vuelta y un byte cambiado en cada registro */
+static void tlm_format(void)
+{
+    uint8_t data[TRAMA_MAX_DATA], back[TRAMA_MAX_DATA], out[TRAMA_MAX];
+    uint8_t type, seq, len;
+    uint32_t round_bad = 0, missed = 0;
+    const uint32_t n = 100000;
+
+    uint16_t crc = trama_crc16(0xFFFF, (const uint8_t *)"123456789", 9);
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t l = (uint8_t)(tlm_rand() % (TRAMA_MAX_DATA + 1));
+        for (uint8_t k = 0; k < l; k++)
+            data[k] = (tlm_rand() & 3) ? (uint8_t)tlm_rand() : 0;   // ceros
+
+        size_t m = trama_encode(TRAMA_SAMPLE, (uint8_t)i, data, l, out);
+        if (memchr(out, 0, m - 1) || out[m - 1] ||
+            trama_decode(out, m - 1, &type, &seq, back, &len) != 0 ||
+            type != TRAMA_SAMPLE || seq != (uint8_t)i || len != l ||
+            memcmp(data, back, l))
+            round_bad++;
+
+        /* Un byte distinto (y no 0x00, que cortaria el registro) */
+        size_t at = tlm_rand() % (m - 1);
+        uint8_t v;
+        do
+            v = (uint8_t)tlm_rand();
+        while (!v || v == out[at]);
+        out[at] = v;
+        if (trama_decode(out, m - 1, &type, &seq, back, &len) == 0)
+            missed++;
+    }
+
+    printf("  crc16(\"123456789\")  %#10x (esperado 0x29b1)\n", crc);
+    printf("  ida y vuelta        %10u registros, %u malos, %u cambios sin "
+           "detectar  %s\n", n, round_bad, missed,
+           check(crc == 0x29B1 && !round_bad && !missed));
+}
+
+/* Lo de antes (printf del rumbo) contra un registro binario */
+static void tlm_cost(void)
+{
+    const uint32_t n = 1000000;
+    struct qmc_sample s = { 1234, 66, -987, 0 };
+    char line[64];
+    int len = 0;
+
+    uint64_t t0 = wall_ns();
+    for (uint32_t i = 0; i < n; i++)
+        len = snprintf(line, sizeof(line), "Heading = %.2f\xc2\xb0\n\r",
+                       (i % 36000) / 100.0f);
+    uint64_t t1 = wall_ns();
+
+    board_boot();
+    hal_cdc.bytes_per_s = 0;   // nadie lee: la cola se llena y descarta
+    tlm_init();
+    uint64_t t2 = wall_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        s.t_us = i;
+        tlm_sample(&s, (int32_t)(i % 36000));
+    }
+    uint64_t t3 = wall_ns();
+
+    struct tlm_stats st;
+    tlm_stats_get(&st);
+    printf("  printf rumbo        %10.1f ns/registro (host)  %2d bytes, solo "
+           "el rumbo\n", (double)(t1 - t0) / n, len);
+    printf("  tlm_sample          %10.1f ns/registro (host)  %2u bytes, "
+           "XYZ + rumbo + t\n", (double)(t3 - t2) / n,
+           st.bytes / (st.records ? st.records : 1));
+}
+
+struct tlm_decoded {
+    uint32_t records, bad, gaps, lost;
+    uint32_t dropped;   // del ultimo registro de estado
+};
+
+static void tlm_decode_all(const uint8_t *p, size_t n, struct tlm_decoded *d)
+{
+    uint8_t type, seq, data[TRAMA_MAX_DATA], len, last = 0;
+    size_t from = 0;
+
+    memset(d, 0, sizeof(*d));
+    for (size_t i = 0; i < n; i++) {
+        if (p[i])
+            continue;
+        if (trama_decode(p + from, i - from, &type, &seq, data, &len) != 0) {
+            d->bad++;
+        } else {
+            if (d->records && seq != (uint8_t)(last + 1)) {
+                d->gaps++;
+                d->lost += (uint8_t)(seq - last - 1);
+            }
+            last = seq;
+            d->records++;
+            if (type == TRAMA_STATUS && len == TRAMA_STATUS_LEN) {
+                struct trama_status e;
+                trama_unpack_status(data, &e);
+                d->dropped = e.dropped;
+            }
+        }
+        from = i + 1;
+    }
+}
+
+/*
+ * Loop de 1 ms con rate registros por vuelta; tlm_service() en cada una.
+ * stall_ms > 0: el PC deja de leer ese tiempo a partir del segundo 1.
+ */
+static void tlm_stream(const char *name, uint32_t rate, uint32_t stall_ms,
+                       int save)
+{
+    const uint32_t run_ms = 5000;
+    struct qmc_sample s = { 0, 0, 0, 0 };
+    uint64_t worst_ns = 0;
+    struct tlm_stats st;
+    struct tlm_decoded d;
+
+    board_boot();
+    tlm_init();
+    uint64_t t0 = hal_bus.now_ns;
+
+    for (uint32_t ms = 0; ms < run_ms; ms++) {
+        hal_cdc.bytes_per_s = ms >= 1000 && ms < 1000 + stall_ms ? 0 : 800000;
+
+        uint64_t a = hal_bus.now_ns;
+        for (uint32_t k = 0; k < rate; k++) {
+            s.t_us = hal_bus.now_ns / 1000u;
+            s.x = (int16_t)(ms * rate + k);
+            s.z = (int16_t)-s.x;
+            tlm_sample(&s, (int32_t)((ms * 7) % 36000));
+        }
+        if (ms % 1000 == 0)
+            tlm_status();
+        tlm_service();
+        uint64_t b = hal_bus.now_ns;
+        if (b - a > worst_ns)
+            worst_ns = b - a;
+
+        hal_sleep_until_us((t0 + (ms + 1) * 1000000ull) / 1000u);
+    }
+    /* Lo que quedo en la cola sale con el loop quieto */
+    for (int i = 0; i < 1000 && tlm_pending(); i++) {
+        tlm_service();
+        hal_host_advance(100000);
+    }
+
+    tlm_stats_get(&st);
+    tlm_decode_all(hal_cdc.capture, hal_cdc.len, &d);
+
+    if (save && tlm_out) {
+        FILE *f = fopen(tlm_out, "wb");
+        if (f) {
+            fwrite(hal_cdc.capture, 1, hal_cdc.len, f);
+            fclose(f);
+        }
+    }
+
+    /* seq es de 8 bits: los huecos se ven modulo 256 */
+    int good = d.bad == 0 && d.records == st.records &&
+               (uint8_t)(d.lost - st.dropped) == 0 &&
+               d.dropped == st.dropped && worst_ns < 100000 &&
+               (stall_ms ? st.dropped > 0 : st.dropped == 0);
+    printf("  %-20s %7u reg %7u desc %6.1f KB/s  cola max %4u B  "
+           "peor vuelta %5.1f us  decod %u rotos %u  %s\n", name,
+           st.records, st.dropped, st.sent / (run_ms / 1000.0) / 1e3,
+           st.high_water, worst_ns / 1e3, d.records, d.bad,
+           check(good));
+}
+
+static void bench_tlm(void)
+{
+    tlm_format();
+    tlm_cost();
+    tlm_stream("1 kHz", 1, 0, 1);
+    tlm_stream("2 kHz", 2, 0, 0);
+    tlm_stream("1 kHz, PC 500 ms", 1, 500, 0);
+}
+
+/* ---- Captura y repeticion de una sesion ---- */
+
+#define REP_RUN_S  20
+#define REP_CAL_S  6    // llega una calibracion
+#define REP_GAP_S  9    // el PC deja de leer REP_GAP_MS
+#define REP_GAP_MS 3000 // la cola de 4 KB dura ~2.3 s a 100 Hz
+#define REP_EMA_S  15   // se cambia el filtro
+
+/*
+ * Sesion como la del loop a 100 Hz: cada muestra pasa por tlm_config(),
+ * qmc_heading_cdeg() y tlm_sample(). A mitad de camino cambian la
+ * calibracion y el filtro, y el USB se traba un rato (hueco de seq).
+ * Con decim, como BRUJULA_DIEZMADO: 200 Hz, el lote por el FIR y la
+ * telemetria con su estado.
+ */
+static struct dec_filter rep_dec;
+
+static uint32_t rep_record(int decim)
+{
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 15,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = ring_push,
+    };
+    struct cal_result r = {
+        .valid = 1,
+        .converged = 1,
+        .offset = { 430, 40, 125 },
+        .soft = { { 1.02f, 0.01f, 0 }, { 0.01f, 1, 0 }, { 0, 0, 0.98f } },
+    };
+    static struct qmc_sample batch[COLA_LEN];
+    static struct dec_out o[COLA_LEN];
+    uint32_t processed = 0;
+    int32_t cdeg = 0;
+    int cal_done = 0, ema_done = 0;
+
+    board_boot();
+    qmc_set_filter(&qmc_filters[QMC_FILTER_ONE_EURO]);
+    qmc_configure(&qmc_profiles[decim ? QMC_PROFILE_200HZ
+                                      : QMC_PROFILE_100HZ]);
+    hal_qmc.motion = mot_walk;
+    cola_init(&ring);
+    tlm_init();
+    if (decim) {
+        dec_init(&rep_dec, &dec_display, qmc_odr_hz(qmc_active_profile()));
+        tlm_set_decim(&rep_dec);
+    }
+    acq_start(&cfg);
+
+    uint64_t t0 = hal_bus.now_ns, status_ns = t0;
+    while (hal_bus.now_ns - t0 < REP_RUN_S * 1000000000ull) {
+        double t = (hal_bus.now_ns - t0) / 1e9;
+        int n = cola_drain(&ring, batch, COLA_LEN);
+
+        if (n && !cal_done && t >= REP_CAL_S) {
+            qmc_set_calibration(&r);
+            cal_done = 1;
+        }
+        if (decim) {
+            /* El orden de sensor_task() con BRUJULA_DIEZMADO */
+            tlm_config();
+            int m = dec_process(&rep_dec, batch, n, o, COLA_LEN);
+
+            for (int i = 0, k = 0; i < n; i++) {
+                while (k < m && o[k].t_us <= batch[i].t_us)
+                    cdeg = o[k++].cdeg;
+                tlm_sample(&batch[i], cdeg);
+            }
+        } else {
+            for (int i = 0; i < n; i++) {
+                const struct qmc_sample *s = &batch[i];
+
+                tlm_config();
+                tlm_sample(s, qmc_heading_cdeg(s->x, s->y, s->z));
+            }
+        }
+        processed += (uint32_t)n;
+        if (!ema_done && t >= REP_EMA_S) {
+            qmc_set_filter(&qmc_filters[QMC_FILTER_EMA]);
+            ema_done = 1;
+        }
+
+        hal_cdc.bytes_per_s =
+            t >= REP_GAP_S && t < REP_GAP_S + REP_GAP_MS / 1e3 ? 0 : 800000;
+        tlm_service();
+        if (hal_bus.now_ns - status_ns >= 1000000000ull) {
+            tlm_status();
+            status_ns = hal_bus.now_ns;
+        }
+        hal_host_advance(10000000);
+    }
+    hal_cdc.bytes_per_s = 800000;
+    for (int i = 0; i < 1000 && tlm_pending(); i++) {
+        tlm_service();
+        hal_host_advance(100000);
+    }
+    hal_qmc.motion = NULL;
+    return processed;
+}
+
+static void bench_replay(void)
+{
+    for (int decim = 0; decim < 2; decim++) {
+        struct rep_opts o = { 0 };
+        struct rep_stats a, b, f;
+        struct tlm_stats tl;
+
+        uint32_t processed = rep_record(decim);
+        tlm_stats_get(&tl);
+
+        const uint8_t *cap = hal_cdc.capture;
+        size_t n = hal_cdc.len;
+
+        if (tlm_out && !decim) {
+            FILE *fp = fopen(tlm_out, "wb");
+            if (fp) {
+                fwrite(cap, 1, n, fp);
+                fclose(fp);
+            }
+        }
+
+        rep_run(cap, n, &o, &a);
+        rep_run(cap, n, &o, &b);
+        o.render = 1;
+        rep_run(cap, n, &o, &f);
+
+        /* Solo se saltean las del hueco: hasta el proximo config */
+        uint32_t hz = decim ? 200 : 100;
+        int good = !a.bad && a.gaps && !a.mismatches && !a.diverged &&
+                   a.configs == 4 && a.samples + a.skipped + tl.dropped >=
+                   processed && a.skipped < hz + tl.dropped &&
+                   a.hash == b.hash && !f.mismatches;
+
+        printf("  sesion %u Hz%s, %2d s   %6u muestras, %u registros "
+               "descartados por el USB, %zu KB\n", hz,
+               decim ? " diezmada" : "", REP_RUN_S, processed, tl.dropped,
+               n / 1024);
+        printf("  repeticion           %6u repetidas %4u salteadas  %u "
+               "configs  %u divergencias  %u distintas al equipo  %s\n",
+               a.samples, a.skipped, a.configs, a.diverged, a.mismatches,
+               check(good));
+        printf("  dos corridas         hash %08x / %08x  %s\n", a.hash,
+               b.hash, check(a.hash == b.hash));
+        printf("  sin dibujar          %10.2f Mmuestras/s (host)\n",
+               a.samples * 1e3 / (double)a.ns);
+        printf("  con la escena        %10.0f muestras/s (host)  %u "
+               "cuadros\n", f.samples * 1e9 / (double)f.ns, f.frames);
+    }
+}
+
+/* ---- Planificador cooperativo sobre el reloj virtual ---- */
+
+#define SCHED_RUN_S 10
+
+/* Tareas de prueba: cada corrida "gasta" cost_us de reloj virtual */
+struct sched_probe {
+    struct sched_task task;
+    uint32_t cost_us;
+    uint32_t long_every;      // cada tantas corridas, long_us
+    uint32_t long_us;
+    uint32_t longs;
+};
+
+static struct sched_probe probes[3];
+static char sched_order[8];
+static int sched_norder;
+
+static void probe_run(struct sched_probe *p)
+{
+    uint32_t us = p->cost_us;
+
+    if (p->long_every && p->task.runs % p->long_every == p->long_every - 1) {
+        us = p->long_us;
+        p->longs++;
+    }
+    if (sched_norder < (int)sizeof(sched_order) - 1)
+        sched_order[sched_norder++] = p->task.name[0];
+    hal_host_advance((uint64_t)us * 1000u);
+}
+
+static void probe0(void) { probe_run(&probes[0]); }
+static void probe1(void) { probe_run(&probes[1]); }
+static void probe2(void) { probe_run(&probes[2]); }
+
+static void sched_until(uint64_t end_ns)
+{
+    while (hal_bus.now_ns < end_ns)
+        sched_step();
+}
+
+static double sched_load(void)
+{
+    struct sched_stats ss;
+
+    sched_stats_get(&ss);
+    return 100.0 * (1.0 - (double)ss.idle_us / (time_us() - ss.start_us));
+}
+
+/*
+ * Tres periodicas al 40 %. Sin desalojo, la que espera a otra que corre
+ * se atrasa a lo sumo lo que esa tarda: los costos entran en los plazos.
+ * Con long_us la de 50 ms a veces se pasa y las otras pierden el plazo.
+ */
+static void sched_periodic(const char *name, uint32_t long_us)
+{
+    static void (*const run[3])(void) = { probe0, probe1, probe2 };
+    static const char *const names[3] = { "a 5 ms", "b 10 ms", "c 50 ms" };
+    static const uint32_t period[3] = { 5000, 10000, 50000 };
+    static const uint32_t cost[3] = { 1000, 1500, 2500 };
+
+    board_boot();
+    sched_init();
+    sched_norder = 0;
+    memset(sched_order, 0, sizeof(sched_order));
+    for (int i = 0; i < 3; i++) {
+        probes[i] = (struct sched_probe){
+            .task = { .name = names[i], .run = run[i],
+                      .period_us = period[i] },
+            .cost_us = cost[i],
+            .long_every = i == 2 && long_us ? 5 : 0,
+            .long_us = long_us,
+        };
+        sched_add(&probes[i].task);
+    }
+    sched_until(hal_bus.now_ns + SCHED_RUN_S * 1000000000ull);
+
+    /* Sin sobrecarga: cada una corre una vez por periodo, sin miss */
+    int good = !strncmp(sched_order, "abc", 3);
+    for (int i = 0; i < 3; i++) {
+        const struct sched_task *t = &probes[i].task;
+        uint32_t want = SCHED_RUN_S * 1000000u / t->period_us;
+        if (!long_us)
+            good &= t->misses == 0 && t->skipped == 0 &&
+                    t->runs + 1 >= want && t->runs <= want + 1;
+    }
+    /* Con sobrecarga: cada corrida larga bloquea a la de 5 ms */
+    if (long_us)
+        good &= probes[0].task.misses >= probes[2].longs &&
+                probes[0].task.skipped > 0 && probes[2].longs > 0;
+
+    printf("  %-20s orden %.3s  carga %4.1f %%  %s\n", name, sched_order,
+           sched_load(), check(good));
+    for (int i = 0; i < 3; i++) {
+        const struct sched_task *t = &probes[i].task;
+        printf("    %-8s %5u corridas %4u miss %4u salteadas  "
+               "atraso max %5u us  corrida max %5u us\n", t->name, t->runs,
+               t->misses, t->skipped, t->late_max_us, t->run_max_us);
+    }
+}
+
+/* Esporadica despertada desde el tick (200 Hz) mas una periodica */
+static struct sched_task sched_spor;
+static uint32_t sched_ticks;
+
+static void spor_tick(void)
+{
+    sched_ticks++;
+    sched_wake(&sched_spor);
+}
+
+static void spor_run(void)
+{
+    hal_host_advance(500000);
+}
+
+static void sched_sporadic(void)
+{
+    board_boot();
+    sched_init();
+    sched_ticks = 0;
+    probes[0] = (struct sched_probe){
+        .task = { .name = "a 5 ms", .run = probe0, .period_us = 5000 },
+        .cost_us = 1000,
+    };
+    sched_spor = (struct sched_task){ .name = "irq", .run = spor_run,
+                                      .deadline_us = 2000 };
+    sched_add(&probes[0].task);
+    sched_add(&sched_spor);
+    hal_tick_irq_init(200, spor_tick);
+    sched_until(hal_bus.now_ns + SCHED_RUN_S * 1000000000ull);
+    hal_tick_irq_init(200, NULL);
+
+    int good = sched_spor.runs + 1 >= sched_ticks && !sched_spor.misses &&
+               !probes[0].task.misses && sched_spor.late_max_us <= 1000;
+    printf("  %-20s %5u ticks %5u corridas  atraso max %4u us  %u miss  "
+           "carga %4.1f %%  %s\n", "esporadica 200 Hz", sched_ticks,
+           sched_spor.runs, sched_spor.late_max_us, sched_spor.misses,
+           sched_load(), check(good));
+}
+
+/*
+ * Las tareas de impresion.c con el driver de verdad a 200 Hz: 'sensor'
+ * despertada por la adquisicion, telemetria y mantenimiento. El dibujo
+ * no tiene costo en el reloj virtual; se carga SCHED_FRAME_US por cuadro
+ * (supuesto holgado para la escena retenida mas la copia de tiles).
+ */
+#define SCHED_FRAME_US 2000
+
+static struct sched_task sched_sensor;
+static struct qmc_sample sched_batch[COLA_LEN];
+static uint32_t sched_done;
+
+static void fw_on_sample(const struct qmc_sample *s)
+{
+    cola_push(&ring, s);
+    sched_wake(&sched_sensor);
+}
+
+static void fw_sensor(void)
+{
+    int n = cola_drain(&ring, sched_batch, COLA_LEN);
+
+    for (int i = 0; i < n; i++) {
+        const struct qmc_sample *s = &sched_batch[i];
+        tlm_config();
+        tlm_sample(s, qmc_heading_cdeg(s->x, s->y, s->z));
+    }
+    sched_done += (uint32_t)n;
+}
+
+static void fw_render(void)
+{
+    hal_host_advance(SCHED_FRAME_US * 1000ull);
+}
+
+static void fw_tlm(void)
+{
+    tlm_service();
+}
+
+static void fw_house(void)
+{
+    static uint32_t n;
+
+    if (++n % 10 == 0)
+        tlm_status();
+}
+
+static void sched_firmware(void)
+{
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 15,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = fw_on_sample,
+    };
+    static struct sched_task tasks[3];
+    struct acq_stats as;
+    struct tlm_stats ts;
+
+    board_boot();
+    qmc_configure(&qmc_profiles[QMC_PROFILE_200HZ]);
+    cola_init(&ring);
+    tlm_init();
+    sched_init();
+    sched_done = 0;
+    sched_sensor = (struct sched_task){ .name = "sensor", .run = fw_sensor,
+                                        .deadline_us = 5000 };
+    tasks[0] = (struct sched_task){ .name = "render", .run = fw_render,
+                                    .period_us = 50000 };
+    tasks[1] = (struct sched_task){ .name = "tlm", .run = fw_tlm,
+                                    .period_us = 5000 };
+    tasks[2] = (struct sched_task){ .name = "house", .run = fw_house,
+                                    .period_us = 100000 };
+    sched_add(&sched_sensor);
+    for (int i = 0; i < 3; i++)
+        sched_add(&tasks[i]);
+    acq_start(&cfg);
+    sched_until(hal_bus.now_ns + SCHED_RUN_S * 1000000000ull);
+
+    acq_stats_get(&as);
+    tlm_stats_get(&ts);
+    struct sched_stats ss;
+    sched_stats_get(&ss);
+
+    uint32_t lost = as.samples - sched_done - cola_count(&ring);
+    int good = lost == 0 && ring.overruns == 0 && ts.dropped == 0 &&
+               !sched_sensor.misses && !tasks[1].misses;
+    printf("  %-20s %5u muestras %u perdidas  sensor: atraso max %4u us, "
+           "%u miss  carga %4.1f %%  %s\n", "tareas de la placa", as.samples,
+           lost, sched_sensor.late_max_us, sched_sensor.misses, sched_load(),
+           check(good));
+    for (int i = 0; i < 3; i++)
+        printf("    %-8s %5u corridas %4u miss  atraso max %5u us\n",
+               tasks[i].name, tasks[i].runs, tasks[i].misses,
+               tasks[i].late_max_us);
+}
+
+static void bench_sched(void)
+{
+    sched_periodic("3 periodicas", 0);
+    sched_periodic("c a veces 20 ms", 20000);
+    sched_sporadic();
+    sched_firmware();
+}
+
+/* ---- Fusion con el giroscopo: retardo y error contra el EMA ---- */
+
+#define FUS_GYRO_NS 20000000u   // cada cuanto se vacia el FIFO (impresion.c)
+
+struct fus_case {
+    const char *name;
+    double (*motion)(double t_s);
+    int lcd;   // LCD mandando frames: el SPI esta ocupado ~117 ms de cada 150
+};
+
+static const struct fus_case fus_cases[] = {
+    { "escalon 90 deg", mot_step, 0 },
+    { "seno 45 deg 0.5 Hz", mot_sine, 0 },
+    { "rampa 30 dps", mot_ramp, 0 },
+    { "seno + LCD", mot_sine, 1 },
+};
+
+static struct fusion fus;
+static double fus_ema;   // grados, salida de qmc_heading_cdeg()
+
+static void fus_sample(const struct qmc_sample *s)
+{
+    fus_ema = qmc_heading_cdeg(s->x, s->y, s->z) / 100.0;
+    fusion_mag(&fus, qmc_heading_raw_cdeg(s->x, s->y, s->z) / 100.0f,
+               s->t_us);
+}
+
+static void bench_fusion(void)
+{
+    static double truth[TRACE_POINTS], ema[TRACE_POINTS], fused[TRACE_POINTS];
+    static uint16_t frame[HAL_LCD_WIDTH * HAL_LCD_HEIGHT];
+    static struct gyro_sample buf[GYRO_FIFO];
+    const struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 150,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = fus_sample,
+    };
+    const double bias = 1.5;   // dps, en el eje del rumbo
+
+    printf("  %-20s %10s %10s %9s %10s %9s %9s %7s %7s\n", "caso", "EMA rms",
+           "max", "lag", "fusion rms", "max", "lag", "bias", "overrun");
+
+    for (size_t c = 0; c < sizeof(fus_cases) / sizeof(fus_cases[0]); c++) {
+        const struct fus_case *fc = &fus_cases[c];
+        struct gyro_stats gs;
+
+        board_boot();
+        qmc_set_filter(&qmc_filters[QMC_FILTER_EMA]);
+        hal_qmc.heading_deg = 200.0;
+        hal_qmc.motion = fc->motion;
+        hal_gyro.bias_dps[GYRO_YAW_AXIS] = GYRO_YAW_SIGN * bias;
+        hal_gyro.noise_dps = 0.1;
+        int gyro = gyro_init() == 0;
+
+        fusion_init(&fus, FUSION_TAU_S);
+        acq_start(&cfg);
+
+        /* La traza arranca en TRACE_WARMUP_S, en un paso de 5 ms */
+        uint64_t t0 = (uint64_t)(TRACE_WARMUP_S * 1e9);
+        uint64_t next_read = 0, next_frame = 0;
+
+        hal_host_advance((t0 - hal_bus.now_ns) % TRACE_STEP_NS);
+        for (int i = -(int)((t0 - hal_bus.now_ns) / TRACE_STEP_NS);
+             i < TRACE_POINTS; i++) {
+            hal_host_advance(TRACE_STEP_NS);
+
+            if (fc->lcd && hal_bus.now_ns >= next_frame &&
+                !hal_lcd_busy()) {
+                hal_lcd_present(frame, NULL);
+                next_frame = hal_bus.now_ns + 150000000u;
+            }
+            if (hal_bus.now_ns >= next_read) {
+                int n = gyro_read_fifo(buf, GYRO_FIFO);
+                for (int k = 0; k < n; k++)
+                    fusion_gyro(&fus, gyro_yaw_dps(&buf[k]), buf[k].t_us);
+                next_read = hal_bus.now_ns + FUS_GYRO_NS;
+            }
+
+            if (i < 0)
+                continue;
+            truth[i] = qmc_sim_true_heading(&hal_qmc, hal_bus.now_ns);
+            ema[i] = fus_ema;
+            fused[i] = fusion_heading(&fus, hal_bus.now_ns / 1000u);
+        }
+        gyro_stats_get(&gs);
+        hal_lcd.sending = NULL;   // el frame en curso no importa
+
+        double e_rms, e_max, f_rms, f_max;
+        trace_errors(ema, truth, &e_rms, &e_max);
+        trace_errors(fused, truth, &f_rms, &f_max);
+        double e_lag = trace_lag_ms(ema, truth);
+        double f_lag = trace_lag_ms(fused, truth);
+        double bias_err = fabs(fus.bias_dps - bias);
+
+        int good = gyro && gs.overruns == 0 && f_rms < e_rms / 3.0 &&
+                   f_lag >= 0.0 && f_lag <= 20.0 && bias_err < 0.2;
+        double over = 0.0;
+        if (fc->motion == mot_step) {
+            over = trace_overshoot(fused, 290.0);
+            good = good && over < 2.0;
+        }
+
+        char lag_e[16], lag_f[16];
+        printf("  %-20s %6.2f deg %6.2f deg %9s %6.2f deg %5.2f deg %9s "
+               "%7.3f %7u  %s\n", fc->name, e_rms, e_max,
+               trace_ms_str(lag_e, e_lag), f_rms, f_max,
+               trace_ms_str(lag_f, f_lag), fus.bias_dps, gs.overruns,
+               check(good));
+        if (fc->motion == mot_step)
+            printf("  %-20s overshoot de la fusion: %.2f deg\n", "", over);
+    }
+}
+
+/* ---- Filtro del rumbo: EMA fijo contra One-Euro ---- */
+
+struct flt_trace {
+    const char *name;
+    double (*motion)(double t_s);
+};
+
+static const struct flt_trace flt_traces[] = {
+    { "quieto", NULL },
+    { "escalon 90 deg", mot_step },
+    { "seno 45 deg 0.5 Hz", mot_sine },
+    { "caminata", mot_walk },
+};
+
+static double flt_out;
+
+static void flt_sample(const struct qmc_sample *s)
+{
+    flt_out = qmc_heading_cdeg(s->x, s->y, s->z) / 100.0;
+}
+
+/* Una traza con el perfil y el filtro dados; out[] cada 5 ms */
+static void flt_run(int prof, int filter, double (*motion)(double),
+                    double *truth, double *out)
+{
+    const struct qmc_profile *p = &qmc_profiles[prof];
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = (uint16_t)(3000 / qmc_odr_hz(p)),
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = flt_sample,
+    };
+
+    board_boot();
+    qmc_configure(p);
+    qmc_set_filter(&qmc_filters[filter]);
+    hal_qmc.heading_deg = 200.0;
+    hal_qmc.motion = motion;
+    acq_start(&cfg);
+
+    hal_sleep_until_us((uint64_t)(TRACE_WARMUP_S * 1e6));
+    for (int i = 0; i < TRACE_POINTS; i++) {
+        hal_host_advance(TRACE_STEP_NS);
+        truth[i] = qmc_sim_true_heading(&hal_qmc, hal_bus.now_ns);
+        out[i] = flt_out;
+    }
+}
+
+static void bench_filter(void)
+{
+    static const int profs[] = { QMC_PROFILE_LEGACY, QMC_PROFILE_100HZ };
+    static double truth[TRACE_POINTS], out[QMC_FILTER_COUNT][TRACE_POINTS];
+    char b0[16], b1[16], b2[16];
+
+    printf("  %-8s %-20s %-6s %9s %9s %9s %9s %10s\n", "perfil", "traza",
+           "filtro", "rms", "max", "lag", "asentado", "jitter");
+
+    for (size_t pi = 0; pi < sizeof(profs) / sizeof(profs[0]); pi++) {
+        for (size_t t = 0; t < sizeof(flt_traces) / sizeof(flt_traces[0]);
+             t++) {
+            const struct flt_trace *tr = &flt_traces[t];
+            double rms[QMC_FILTER_COUNT], max[QMC_FILTER_COUNT];
+            double lag[QMC_FILTER_COUNT], settle[QMC_FILTER_COUNT];
+            double jitter[QMC_FILTER_COUNT];
+
+            for (int f = 0; f < QMC_FILTER_COUNT; f++) {
+                flt_run(profs[pi], f, tr->motion, truth, out[f]);
+                trace_errors(out[f], truth, &rms[f], &max[f]);
+                lag[f] = tr->motion ? trace_lag_ms(out[f], truth) : 0.0;
+                settle[f] = tr->motion == mot_step
+                    ? trace_settle_ms(out[f], 290.0, 1.0) : 0.0;
+                jitter[f] = trace_jitter(out[f]);
+            }
+
+            /* El One-Euro tiene que atrasar mucho menos sin temblar mas */
+            const int E = QMC_FILTER_EMA, O = QMC_FILTER_ONE_EURO;
+            int good;
+            if (!tr->motion)
+                good = jitter[O] < 0.1;
+            else if (tr->motion == mot_step)
+                good = settle[O] >= 0.0 && settle[O] < 1000.0 &&
+                       (settle[E] < 0.0 || settle[O] < settle[E]);
+            else
+                good = lag[O] >= 0.0 && lag[O] <= 150.0 &&
+                       (lag[E] < 0.0 || lag[O] < lag[E] / 3.0) &&
+                       rms[O] < rms[E];
+
+            for (int f = 0; f < QMC_FILTER_COUNT; f++) {
+                printf("  %-8s %-20s %-6s %5.2f deg %5.2f deg %9s %9s "
+                       "%10s  %s\n", f ? "" : qmc_profiles[profs[pi]].name,
+                       f ? "" : tr->name, qmc_filters[f].name, rms[f], max[f],
+                       tr->motion ? trace_ms_str(b0, lag[f]) : "-",
+                       tr->motion == mot_step ? trace_ms_str(b1, settle[f])
+                                              : "-",
+                       tr->motion ? "-" : trace_deg_str(b2, jitter[f]),
+                       f == O ? check_fine(good) : "");
+            }
+        }
+    }
+
+    /* Costo por muestra (calibracion + filtro + atan2) */
+    board_boot();
+    for (int f = 0; f < QMC_FILTER_COUNT; f++) {
+        qmc_set_filter(&qmc_filters[f]);
+        printf("  %-6s              %10.1f ns/sample (host)\n",
+               qmc_filters[f].name, math_ns(qmc_heading_update));
+    }
+}
+
+/* ---- Diezmado: 200 Hz por el FIR a la tasa de la pantalla ---- */
+
+static struct dec_filter dec;
+static double dec_out_deg;
+
+static void dec_sample(const struct qmc_sample *s)
+{
+    struct dec_out o;
+
+    if (dec_process(&dec, s, 1, &o, 1))
+        dec_out_deg = o.cdeg / 100.0;
+}
+
+/* Como flt_run(), con el sensor rapido y el FIR en vez del filtro */
+static void dec_run(int prof, double (*motion)(double), double *truth,
+                    double *out)
+{
+    const struct qmc_profile *p = &qmc_profiles[prof];
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = (uint16_t)(3000 / qmc_odr_hz(p)),
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = dec_sample,
+    };
+
+    board_boot();
+    qmc_configure(p);
+    dec_init(&dec, &dec_display, qmc_odr_hz(p));
+    hal_qmc.heading_deg = 200.0;
+    hal_qmc.motion = motion;
+    acq_start(&cfg);
+
+    hal_sleep_until_us((uint64_t)(TRACE_WARMUP_S * 1e6));
+    for (int i = 0; i < TRACE_POINTS; i++) {
+        hal_host_advance(TRACE_STEP_NS);
+        truth[i] = qmc_sim_true_heading(&hal_qmc, hal_bus.now_ns);
+        out[i] = dec_out_deg;
+    }
+}
+
+/* Con la historia llena de una sola muestra el FIR da la muestra: el
+ * rumbo del FIR tiene que ser el de qmc_heading_raw_cdeg (cal_apply) */
+static int dec_cal_exact(void)
+{
+    struct cal_result r = {
+        .valid = 1,
+        .converged = 1,
+        .offset = { 430, -40, 125 },
+        .soft = { { 1.02f, 0.01f, -0.03f }, { 0.01f, 1, 0 },
+                  { -0.03f, 0.02f, 0.98f } },
+    };
+    struct qmc_sample s = { 0 };
+    struct dec_out o;
+    int bad = 0;
+
+    board_boot();
+    qmc_set_calibration(&r);
+    dec_init(&dec, &dec_display, 200);
+    for (uint32_t i = 0; i < 100000; i++) {
+        s.x = (int16_t)((i * 2654435761u) >> 19) - 4096;
+        s.y = (int16_t)((i * 40503u) & 8191) - 4096;
+        s.z = (int16_t)((i * 2246822519u) >> 19) - 4096;
+        dec_reset(&dec);
+        if (dec_process(&dec, &s, 1, &o, 1) != 1 ||
+            rumbo_atan2_cdeg(o.x, o.z) != qmc_heading_raw_cdeg(s.x, s.y, s.z))
+            bad++;
+    }
+    return bad;
+}
+
+/* ns por muestra de entrada, en lotes como los de la tarea del sensor */
+static double dec_ns(void)
+{
+    static struct qmc_sample in[COLA_LEN];
+    struct dec_out o[COLA_LEN];
+    const uint32_t rounds = 20000;
+    volatile int32_t sink = 0;
+
+    board_boot();
+    dec_init(&dec, &dec_display, 200);
+    for (int i = 0; i < COLA_LEN; i++) {
+        in[i].x = (int16_t)(400 + ((i * 37) & 1023));
+        in[i].y = 66;
+        in[i].z = (int16_t)(100 + ((i * 7) & 1023));
+    }
+
+    uint64_t t0 = wall_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        int m = dec_process(&dec, in, COLA_LEN, o, COLA_LEN);
+        sink += o[m - 1].cdeg;
+    }
+    uint64_t dt = wall_ns() - t0;
+
+    (void)sink;
+    return (double)dt / ((double)rounds * COLA_LEN);
+}
+
+static void bench_decim(void)
+{
+    enum { LEGACY, FAST, D100, D200, NROW };
+    static const char *row_name[NROW] = { "legacy 1euro", "100hz 1euro",
+                                          "100hz fir+1euro",
+                                          "200hz fir+1euro" };
+    static double truth[TRACE_POINTS], out[NROW][TRACE_POINTS];
+    char b0[16], b1[16], b2[16];
+
+    printf("  %-20s %-15s %9s %9s %9s %9s %10s\n", "traza", "camino", "rms",
+           "max", "lag", "asentado", "jitter");
+
+    for (size_t t = 0; t < sizeof(flt_traces) / sizeof(flt_traces[0]); t++) {
+        const struct flt_trace *tr = &flt_traces[t];
+        double rms[NROW], max[NROW], lag[NROW], settle[NROW], jitter[NROW];
+
+        flt_run(QMC_PROFILE_LEGACY, QMC_FILTER_ONE_EURO, tr->motion, truth,
+                out[LEGACY]);
+        flt_run(QMC_PROFILE_100HZ, QMC_FILTER_ONE_EURO, tr->motion, truth,
+                out[FAST]);
+        dec_run(QMC_PROFILE_100HZ, tr->motion, truth, out[D100]);
+        dec_run(QMC_PROFILE_200HZ, tr->motion, truth, out[D200]);
+
+        for (int k = 0; k < NROW; k++) {
+            trace_errors(out[k], truth, &rms[k], &max[k]);
+            lag[k] = tr->motion ? trace_lag_ms(out[k], truth) : 0.0;
+            settle[k] = tr->motion == mot_step
+                ? trace_settle_ms(out[k], 290.0, 1.0) : 0.0;
+            jitter[k] = trace_jitter(out[k]);
+        }
+
+        /*
+         * Con margen, sin comparar lags de a 5 ms contra el camino de
+         * 10 Hz: tiembla 20 % menos que los dos caminos por muestra, y
+         * girando sigue con 15 % menos rms y asienta antes que el de
+         * 10 Hz. Contra el de 100 Hz (la misma informacion por segundo)
+         * el temblor de menos se paga con atraso: a lo sumo 50 ms mas.
+         */
+        int good;
+        if (!tr->motion)
+            good = jitter[D200] < 0.8 * jitter[LEGACY] &&
+                   jitter[D200] < 0.8 * jitter[FAST];
+        else
+            good = lag[D200] >= 0.0 && lag[FAST] >= 0.0 &&
+                   lag[D200] <= lag[FAST] + 50.0 &&
+                   rms[D200] < 0.85 * rms[LEGACY];
+        if (tr->motion == mot_step)
+            good = good && settle[D200] >= 0.0 &&
+                   (settle[LEGACY] < 0.0 ||
+                    settle[D200] < 0.6 * settle[LEGACY]);
+
+        for (int k = 0; k < NROW; k++)
+            printf("  %-20s %-15s %5.2f deg %5.2f deg %9s %9s %10s  %s\n",
+                   k ? "" : tr->name, row_name[k], rms[k], max[k],
+                   tr->motion ? trace_ms_str(b0, lag[k]) : "-",
+                   tr->motion == mot_step ? trace_ms_str(b1, settle[k]) : "-",
+                   tr->motion ? "-" : trace_deg_str(b2, jitter[k]),
+                   k == D200 ? check_fine(good) : "");
+    }
+
+    int bad = dec_cal_exact();
+    printf("  calibracion = cal_apply   %s (%d distintas)\n",
+           check(!bad), bad);
+
+    board_boot();
+    qmc_set_filter(&qmc_filters[QMC_FILTER_ONE_EURO]);
+    double ref_ns = math_ns(qmc_heading_update);
+    double d_ns = dec_ns();
+    printf("  %-24s %8.1f ns/sample (host)\n", "legacy 1euro", ref_ns);
+    printf("  %-24s %8.1f ns/sample (host), %u taps, M %u, "
+           "%.1f SMLAD/sample\n", "200hz fir+1euro", d_ns, dec.taps, dec.m,
+           2.0 + (double)dec.taps / dec.m);
+}
+
+/* ---- Perfiles: latencia, throughput y ruido ---- */
+
+static struct {
+    uint32_t n;
+    double lat_ns;
+    double stamp_ns;    // marca de tiempo - instante real del DRDY
+    double sum, sum2;   // rumbo crudo (sin filtro), grados
+} prof;
+
+static int16_t prof_scale;
+
+static void prof_sample(const struct qmc_sample *s)
+{
+    double fx = s->x - hal_qmc.off[0] * prof_scale;
+    double fz = s->z - hal_qmc.off[2] * prof_scale;
+    double h = atan2(fx, fz) * 180.0 / M_PI;
+
+    prof.n++;
+    prof.lat_ns += (double)(hal_bus.now_ns - hal_qmc.last_latch_ns);
+    prof.stamp_ns += (double)s->t_us * 1000.0 - (double)hal_qmc.last_latch_ns;
+    prof.sum += h;
+    prof.sum2 += h * h;
+}
+
+static void bench_profiles(void)
+{
+    const uint64_t run_ns = 2000000000u;
+
+    printf("  %-9s %5s %6s %10s %9s %8s %9s %10s %9s\n", "perfil", "ODR",
+           "bus", "reconfig", "samples/s", "latency", "stamp err", "noise rms",
+           "bus util");
+
+    for (int i = 0; i < QMC_PROFILE_COUNT; i++) {
+        const struct qmc_profile *p = &qmc_profiles[i];
+        struct acq_config cfg = {
+            .mode = ACQ_DRDY,
+            .tick_hz = 1000,
+            .trigger_ticks = (uint16_t)(3000 / qmc_odr_hz(p)),
+            .timeout_ticks = 5,
+            .retries = 2,
+            .on_sample = prof_sample,
+        };
+
+        board_boot();
+        hal_qmc.heading_deg = 123.0;
+
+        /* Cambio en caliente desde el perfil por defecto */
+        uint64_t t = hal_bus.now_ns;
+        qmc_configure(p);
+        uint64_t reconf_ns = hal_bus.now_ns - t;
+
+        prof_scale = p->rng == QMC_RNG_2G ? 4 : 1;
+        memset(&prof, 0, sizeof(prof));
+        acq_start(&cfg);
+
+        uint64_t t0 = hal_bus.now_ns;
+        uint64_t bus0 = hal_bus.bus_ns;
+        hal_host_advance(run_ns);
+
+        double mean = prof.sum / prof.n;
+        double rms = sqrt(prof.sum2 / prof.n - mean * mean);
+
+        printf("  %-9s %3u Hz %3u k %7.1f us %9.1f %5.0f us %6.1f us "
+               "%6.3f deg %7.1f %%\n",
+               p->name, qmc_odr_hz(p), p->bus_hz / 1000, reconf_ns / 1e3,
+               prof.n / ((hal_bus.now_ns - t0) / 1e9),
+               prof.lat_ns / prof.n / 1e3, prof.stamp_ns / prof.n / 1e3, rms,
+               100.0 * (hal_bus.bus_ns - bus0) / run_ns);
+    }
+}
+
+/* ---- Instrumentacion: histogramas y cronometros por etapa ---- */
+
+/* 100 valores conocidos: 1, 2, ... 100 us */
+static void med_check_hist(void)
+{
+    struct med_hist h;
+    uint32_t total = 0;
+
+    med_reset();
+    for (uint32_t i = 1; i <= 100; i++)
+        med_add_ns(MED_HEADING, i * 1000u);
+    med_add_ns(MED_I2C, 0);
+    med_add_ns(MED_I2C, UINT32_MAX);
+
+    med_get(MED_HEADING, &h);
+    for (int k = 0; k < MED_BUCKETS; k++)
+        total += h.bucket[k];
+    uint32_t p50 = med_percentile(&h, 50), p99 = med_percentile(&h, 99);
+    int good = h.count == 100 && total == 100 && h.min_ns == 1000 &&
+               h.max_ns == 100000 && h.sum_ns == 5050000 &&
+               p50 >= 50000 && p50 < 100000 && p99 == 100000 &&
+               h.bucket[10] == 1 && h.bucket[17] == 35;
+
+    struct med_hist e;
+    med_get(MED_I2C, &e);
+    good &= e.count == 2 && e.bucket[0] == 1 && e.bucket[MED_BUCKETS - 1] == 1;
+
+    printf("  1..100 us            p50 %6u ns  p99 %6u ns  media %6u ns  %s\n",
+           p50, p99, (uint32_t)(h.sum_ns / h.count), check(good));
+}
+
+/* Lo que agrega un MED_BEGIN/MED_END: dos lecturas del reloj y la suma */
+static void med_cost(void)
+{
+    const uint32_t n = 1000000;
+    uint32_t sink = 0;
+
+    med_reset();
+    uint64_t t0 = wall_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t c = hal_cycles();
+        sink += c;
+        med_add_cycles(MED_HEADING, hal_cycles() - c);
+    }
+    uint64_t ns = wall_ns() - t0;
+
+    struct med_hist h;
+    med_get(MED_HEADING, &h);
+    printf("  cronometro           %8.1f ns por etapa (host)  %s\n",
+           (double)ns / n, check(h.count == n && sink));
+}
+
+#define MED_RUN_S 10
+
+static double med_spin(double t)
+{
+    return 30.0 * t;
+}
+
+/*
+ * Como impresion.c: 200 Hz por DRDY + DMA, el rumbo de cada muestra y
+ * un cuadro de la escena cada 50 ms con fb_set_sample(), triple buffer.
+ * El LCD tarda ~117 ms por frame: MED_E2E no puede dar menos.
+ */
+static void med_pipeline(void)
+{
+    struct acq_config cfg = {
+        .mode = ACQ_DRDY,
+        .tick_hz = 1000,
+        .trigger_ticks = 15,
+        .timeout_ticks = 5,
+        .retries = 2,
+        .on_sample = ring_push,
+    };
+    static struct qmc_sample batch[COLA_LEN];
+    int32_t cdeg = 0, drawn = -1;
+    uint64_t t_us = 0, frame_ns;
+
+    board_boot();
+    qmc_configure(&qmc_profiles[QMC_PROFILE_200HZ]);
+    hal_qmc.motion = med_spin;
+    cola_init(&ring);
+    fb_init(NULL, 3);
+    scene_init(NULL);
+    med_reset();
+    acq_start(&cfg);
+
+    uint64_t t0 = hal_bus.now_ns;
+    frame_ns = t0;
+    while (hal_bus.now_ns - t0 < MED_RUN_S * 1000000000ull) {
+        int n = cola_drain(&ring, batch, COLA_LEN);
+
+        for (int i = 0; i < n; i++) {
+            cdeg = qmc_heading_cdeg(batch[i].x, batch[i].y, batch[i].z);
+            t_us = batch[i].t_us;
+        }
+        if (hal_bus.now_ns - frame_ns >= 50000000u && cdeg / 100 != drawn) {
+            drawn = cdeg / 100;
+            scene_set_heading(drawn);
+            scene_render();
+            fb_set_sample(t_us);
+            fb_swap();
+            frame_ns = hal_bus.now_ns;
+        }
+        hal_host_advance(5000000);
+    }
+    for (int i = 0; i < 1000 && hal_lcd_busy(); i++)
+        hal_host_advance(1000000);
+    hal_qmc.motion = NULL;
+
+    /* Sin la escena: la brujula entera en cada frame */
+    for (int deg = 0; deg < 360; deg += 10)
+        immediate_frame(deg);
+
+    struct med_hist h[MED_STAGES];
+    int good = 1;
+    for (int s = 0; s < MED_STAGES; s++) {
+        med_get((enum med_stage)s, &h[s]);
+        good &= h[s].count > 0;
+    }
+    uint32_t lcd_ns = (uint32_t)(FB_PIXELS * 16ull * 1000000000u /
+                                 hal_lcd.spi_hz);
+    good &= h[MED_E2E].min_ns >= lcd_ns && h[MED_E2E].max_ns < 4 * lcd_ns;
+    printf("  200 Hz + escena      %u frames  e2e min %.1f ms  p99 %.1f ms  "
+           "max %.1f ms  %s\n", h[MED_E2E].count, h[MED_E2E].min_ns / 1e6,
+           med_percentile(&h[MED_E2E], 99) / 1e6, h[MED_E2E].max_ns / 1e6,
+           check(good));
+    printf("  (e2e en el reloj virtual; lo demas, reloj del host)\n");
+    med_dump();
+}
+
+static void bench_medida(void)
+{
+    med_check_hist();
+    med_cost();
+#ifdef BRUJULA_MEDIDA
+    med_pipeline();
+#else
+    (void)med_pipeline;
+    printf("  etapas               sin BRUJULA_MEDIDA (make MEDIDA=1)\n");
+#endif
+}
+
+struct bench {
+    const char *name;
+    void (*run)(void);
+};
+
+static const struct bench benches[] = {
+    { "init", bench_init },
+    { "sensor", bench_sensor },
+    { "mag", bench_mag },
+    { "math", bench_math },
+    { "polar", bench_polar },
+    { "acq", bench_acq },
+    { "recover", bench_recover },
+    { "cal", bench_cal },
+    { "store", bench_store },
+    { "ring", bench_ring },
+    { "tlm", bench_tlm },
+    { "replay", bench_replay },
+    { "sched", bench_sched },
+    { "fusion", bench_fusion },
+    { "filter", bench_filter },
+    { "decim", bench_decim },
+    { "fb", bench_fb },
+    { "render", bench_render },
+    { "readout", bench_readout },
+    { "sprites", bench_sprites },
+    { "profiles", bench_profiles },
+    { "medida", bench_medida },
+};
+
+#define NBENCH (sizeof(benches) / sizeof(benches[0]))
+
+/* ================= MAIN ================= */
+
+static void run_one(const struct bench *b)
+{
+    printf("[%s]\n", b->name);
+    b->run();
+}
+
+int main(int argc, char **argv)
+{
+    int ran = 0;
+
+    init_console();
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            n_samples = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+            bus_khz = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            ppm_out = argv[++i];
+        } else if (!strcmp(argv[i], "-g") && i + 1 < argc) {
+            ppm_golden = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            tlm_out = argv[++i];
+        } else {
+            size_t j;
+            for (j = 0; j < NBENCH; j++)
+                if (!strcmp(argv[i], benches[j].name))
+                    break;
+            if (j == NBENCH) {
+                fprintf(stderr, "benchmark desconocido: %s\n", argv[i]);
+                return 1;
+            }
+            run_one(&benches[j]);
+            ran = 1;
+        }
+    }
+
+    if (!ran)
+        for (size_t j = 0; j < NBENCH; j++)
+            run_one(&benches[j]);
+
+    return failures ? 1 : 0;
+}
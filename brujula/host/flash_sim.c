@@ -0,0 +1,145 @@
+/*
+ * Emulador de la flash interna (ver flash_sim.h)
+ */
+#include "flash_sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ERASED 0xFFFFFFFFu
+
+static uint32_t xorshift(struct flash_sim *f)
+{
+    uint32_t x = f->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    f->rng = x;
+    return x;
+}
+
+/* Escribe de vuelta al archivo las palabras [w, w + n) del sector s */
+static void write_back(struct flash_sim *f, int s, uint32_t w, uint32_t n)
+{
+    if (!f->file)
+        return;
+
+    fseek(f->file, (long)s * f->sector_size + (long)w * 4, SEEK_SET);
+    fwrite(&f->mem[s][w], 4, n, f->file);
+    fflush(f->file);
+}
+
+/* Cuenta una operacion: 0 = sale bien, 1 = es la del corte, -1 = muerta */
+static int power(struct flash_sim *f)
+{
+    if (f->dead)
+        return -1;
+    f->ops++;
+    if (f->cut_after >= 0 && f->ops > (uint64_t)f->cut_after) {
+        f->dead = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/* ================= API ================= */
+
+int flash_sim_open(struct flash_sim *f, const char *path, uint32_t sector_size)
+{
+    memset(f, 0, sizeof(*f));
+    f->sector_size = sector_size;
+    f->cut_after = -1;
+    f->rng = 0x9E3779B9u;
+
+    for (int s = 0; s < FLASH_SIM_SECTORS; s++) {
+        f->mem[s] = malloc(sector_size);
+        if (!f->mem[s])
+            return -1;
+        memset(f->mem[s], 0xFF, sector_size);
+    }
+
+    if (!path)
+        return 0;
+
+    f->file = fopen(path, "r+b");
+    if (f->file) {
+        for (int s = 0; s < FLASH_SIM_SECTORS; s++)
+            if (fread(f->mem[s], 1, sector_size, f->file) != sector_size)
+                memset(f->mem[s], 0xFF, sector_size);
+        return 0;
+    }
+
+    f->file = fopen(path, "w+b");
+    if (!f->file)
+        return -1;
+    for (int s = 0; s < FLASH_SIM_SECTORS; s++)
+        write_back(f, s, 0, sector_size / 4);
+    return 0;
+}
+
+void flash_sim_close(struct flash_sim *f)
+{
+    if (f->file)
+        fclose(f->file);
+    for (int s = 0; s < FLASH_SIM_SECTORS; s++)
+        free(f->mem[s]);
+    memset(f, 0, sizeof(*f));
+}
+
+int flash_sim_erase(struct flash_sim *f, int s)
+{
+    uint32_t nw = f->sector_size / 4;
+
+    if (s < 0 || s >= FLASH_SIM_SECTORS)
+        return -1;
+
+    switch (power(f)) {
+    case -1:
+        return -1;
+    case 1:
+        /* Corte a mitad del borrado: queda una parte sin borrar */
+        for (uint32_t i = 0; i < nw; i++)
+            if (xorshift(f) & 1)
+                f->mem[s][i] = ERASED;
+        write_back(f, s, 0, nw);
+        return -1;
+    }
+
+    memset(f->mem[s], 0xFF, f->sector_size);
+    f->erases[s]++;
+    write_back(f, s, 0, nw);
+    return 0;
+}
+
+int flash_sim_program(struct flash_sim *f, int s, uint32_t off,
+                      const uint32_t *words, uint32_t n)
+{
+    uint32_t w = off / 4;
+
+    if (s < 0 || s >= FLASH_SIM_SECTORS || off % 4 ||
+        w + n > f->sector_size / 4)
+        return -1;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t *p = &f->mem[s][w + i];
+
+        switch (power(f)) {
+        case -1:
+            return -1;
+        case 1:
+            /* Corte a mitad de la palabra: solo bajan algunos bits */
+            *p &= words[i] | xorshift(f);
+            write_back(f, s, w + i, 1);
+            return -1;
+        }
+
+        if (*p != ERASED) {
+            f->overwrites++;
+            return -1;
+        }
+        *p = words[i];
+        f->words++;
+        write_back(f, s, w + i, 1);
+    }
+    return 0;
+}
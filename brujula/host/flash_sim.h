@@ -0,0 +1,56 @@
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+/*
+ * Emulador de la flash interna (build de Linux).
+ *
+ * Dos sectores en memoria y, si se abre con un archivo, escritos de
+ * vuelta a disco en cada operacion: cerrar y volver a abrir el archivo
+ * es apagar y prender la placa.
+ *
+ * Igual que el STM32F4: erase deja todo en 0xFF, program escribe
+ * palabras de 32 bits y programar una palabra no borrada es un error.
+ *
+ * Cortes de energia: con cut_after >= 0 las primeras cut_after
+ * operaciones (palabras programadas o borrados) salen bien, la siguiente
+ * queda a medias (algunos bits de la palabra, la mitad del sector) y
+ * todo lo que sigue falla hasta volver a abrir.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define FLASH_SIM_SECTORS 2
+
+struct flash_sim {
+    uint32_t sector_size;     // bytes
+    uint32_t *mem[FLASH_SIM_SECTORS];
+    FILE *file;               // NULL: solo memoria
+
+    int64_t cut_after;        // -1 = sin corte
+    int dead;                 // ya hubo corte
+    uint32_t rng;
+
+    /* Contadores */
+    uint64_t ops;             // palabras programadas + borrados
+    uint64_t words;
+    uint32_t erases[FLASH_SIM_SECTORS];
+    uint32_t overwrites;      // program sobre una palabra no borrada
+
+    /* Borrado en curso: el contenido cambia al arrancar, el tiempo lo
+     * lleva hal_host.c. Cerrar y abrir lo corta, como el reset. */
+    int erasing;
+    int erase_err;
+    uint64_t erase_done_ns;
+};
+
+/* path == NULL: flash nueva en memoria. Si el archivo no existe se crea
+ * borrado; si existe (con ese tamano) se carga. */
+int flash_sim_open(struct flash_sim *f, const char *path, uint32_t sector_size);
+void flash_sim_close(struct flash_sim *f);
+
+int flash_sim_erase(struct flash_sim *f, int s);
+int flash_sim_program(struct flash_sim *f, int s, uint32_t off,
+                      const uint32_t *words, uint32_t n);
+
+#endif /* FLASH_SIM_H */
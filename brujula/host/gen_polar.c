@@ -0,0 +1,41 @@
+/*
+ * Genera ../polar_lut.c (make polar).
+ *
+ * Usa la misma expresion que tenia cardinal_position() en interfaz.c,
+ * incluido el truncado al pasar a int16_t, para que la tabla de los
+ * mismos pixeles que el calculo con libm.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../polar.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static double degrees_to_radians(double deg)
+{
+    return deg * M_PI / 180.0;
+}
+
+int main(void)
+{
+    printf("/*\n"
+           " * Generado por host/gen_polar.c (make -C host polar). No editar.\n"
+           " */\n"
+           "#include \"polar.h\"\n\n"
+           "const struct polar_off polar_lut[360] = {\n");
+
+    for (int deg = 0; deg < 360; deg++) {
+        int16_t x = POLAR_CX + (cos(degrees_to_radians(deg)) * POLAR_R);
+        int16_t y = POLAR_CY - (sin(degrees_to_radians(deg)) * POLAR_R);
+
+        printf("%s{ %4d, %4d },%s", deg % 6 ? " " : "    ",
+               x - POLAR_CX, y - POLAR_CY, deg % 6 == 5 ? "\n" : "");
+    }
+
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,377 @@
+/*
+ * gfx_* en memoria para el build de Linux (ver gfx_host.h)
+ */
+#include "gfx_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Fuente 5x7, columnas con el bit 0 arriba; solo ASCII imprimible */
+static const uint8_t font[96][5] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 },
+    { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7F, 0x14, 0x7F, 0x14 },
+    { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+    { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+    { 0x00, 0x1C, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1C, 0x00 },
+    { 0x14, 0x08, 0x3E, 0x08, 0x14 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+    { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 },
+    { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+    { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 },
+    { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4B, 0x31 },
+    { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+    { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+    { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1E },
+    { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+    { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+    { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+    { 0x32, 0x49, 0x79, 0x41, 0x3E }, { 0x7E, 0x11, 0x11, 0x11, 0x7E },
+    { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+    { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 },
+    { 0x7F, 0x09, 0x09, 0x09, 0x01 }, { 0x3E, 0x41, 0x49, 0x49, 0x7A },
+    { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+    { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 },
+    { 0x7F, 0x40, 0x40, 0x40, 0x40 }, { 0x7F, 0x02, 0x0C, 0x02, 0x7F },
+    { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+    { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E },
+    { 0x7F, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+    { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+    { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F },
+    { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 },
+    { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7F, 0x41, 0x41, 0x00 },
+    { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7F, 0x00 },
+    { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+    { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },
+    { 0x7F, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+    { 0x38, 0x44, 0x44, 0x48, 0x7F }, { 0x38, 0x54, 0x54, 0x54, 0x18 },
+    { 0x08, 0x7E, 0x09, 0x01, 0x02 }, { 0x0C, 0x52, 0x52, 0x52, 0x3E },
+    { 0x7F, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7D, 0x40, 0x00 },
+    { 0x20, 0x40, 0x44, 0x3D, 0x00 }, { 0x7F, 0x10, 0x28, 0x44, 0x00 },
+    { 0x00, 0x41, 0x7F, 0x40, 0x00 }, { 0x7C, 0x04, 0x18, 0x04, 0x78 },
+    { 0x7C, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+    { 0x7C, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7C },
+    { 0x7C, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+    { 0x04, 0x3F, 0x44, 0x40, 0x20 }, { 0x3C, 0x40, 0x40, 0x20, 0x7C },
+    { 0x1C, 0x20, 0x40, 0x20, 0x1C }, { 0x3C, 0x40, 0x30, 0x40, 0x3C },
+    { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0C, 0x50, 0x50, 0x50, 0x3C },
+    { 0x44, 0x64, 0x54, 0x4C, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+    { 0x00, 0x00, 0x7F, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 },
+    { 0x10, 0x08, 0x08, 0x10, 0x08 }, { 0x00, 0x00, 0x00, 0x00, 0x00 },
+};
+
+const char *const gfx_prim_names[GFX_PRIM_COUNT] = {
+    "drawPixel", "drawLine", "drawFastVLine", "drawFastHLine",
+    "fillRect", "drawCircle", "fillTriangle", "drawChar",
+};
+
+static void (*draw_pixel)(int, int, uint16_t);
+static int16_t width, height;
+static int16_t cursor_x, cursor_y;
+static uint16_t text_color = 0xFFFF, text_bg = 0xFFFF;
+static uint8_t text_size = 1;
+static struct gfx_host_stats stats;
+
+#define SWAP(a, b) do { int16_t t_ = (a); (a) = (b); (b) = t_; } while (0)
+
+/* ================= PRIMITIVAS ================= */
+
+void gfx_init(void (*draw)(int, int, uint16_t), int w, int h)
+{
+    draw_pixel = draw;
+    width = (int16_t)w;
+    height = (int16_t)h;
+    cursor_x = cursor_y = 0;
+    text_size = 1;
+    text_color = text_bg = 0xFFFF;
+}
+
+void gfx_drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+    stats.calls[GFX_PIXEL]++;
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return;
+    stats.pixels++;
+    draw_pixel(x, y, color);
+}
+
+void gfx_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                  uint16_t color)
+{
+    stats.calls[GFX_LINE]++;
+
+    int steep = abs(y1 - y0) > abs(x1 - x0);
+    if (steep) {
+        SWAP(x0, y0);
+        SWAP(x1, y1);
+    }
+    if (x0 > x1) {
+        SWAP(x0, x1);
+        SWAP(y0, y1);
+    }
+
+    int16_t dx = x1 - x0;
+    int16_t dy = (int16_t)abs(y1 - y0);
+    int16_t err = dx / 2;
+    int16_t ystep = y0 < y1 ? 1 : -1;
+
+    for (; x0 <= x1; x0++) {
+        if (steep)
+            gfx_drawPixel(y0, x0, color);
+        else
+            gfx_drawPixel(x0, y0, color);
+        err -= dy;
+        if (err < 0) {
+            y0 += ystep;
+            err += dx;
+        }
+    }
+}
+
+void gfx_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+    stats.calls[GFX_VLINE]++;
+    gfx_drawLine(x, y, x, y + h - 1, color);
+}
+
+void gfx_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+    stats.calls[GFX_HLINE]++;
+    gfx_drawLine(x, y, x + w - 1, y, color);
+}
+
+void gfx_fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                  uint16_t color)
+{
+    stats.calls[GFX_RECT]++;
+    for (int16_t i = x; i < x + w; i++)
+        gfx_drawFastVLine(i, y, h, color);
+}
+
+void gfx_fillScreen(uint16_t color)
+{
+    gfx_fillRect(0, 0, width, height, color);
+}
+
+void gfx_drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+    int16_t f = 1 - r;
+    int16_t ddF_x = 1;
+    int16_t ddF_y = -2 * r;
+    int16_t x = 0;
+    int16_t y = r;
+
+    stats.calls[GFX_CIRCLE]++;
+
+    gfx_drawPixel(x0, y0 + r, color);
+    gfx_drawPixel(x0, y0 - r, color);
+    gfx_drawPixel(x0 + r, y0, color);
+    gfx_drawPixel(x0 - r, y0, color);
+
+    while (x < y) {
+        if (f >= 0) {
+            y--;
+            ddF_y += 2;
+            f += ddF_y;
+        }
+        x++;
+        ddF_x += 2;
+        f += ddF_x;
+
+        gfx_drawPixel(x0 + x, y0 + y, color);
+        gfx_drawPixel(x0 - x, y0 + y, color);
+        gfx_drawPixel(x0 + x, y0 - y, color);
+        gfx_drawPixel(x0 - x, y0 - y, color);
+        gfx_drawPixel(x0 + y, y0 + x, color);
+        gfx_drawPixel(x0 - y, y0 + x, color);
+        gfx_drawPixel(x0 + y, y0 - x, color);
+        gfx_drawPixel(x0 - y, y0 - x, color);
+    }
+}
+
+void gfx_fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                      int16_t x2, int16_t y2, uint16_t color)
+{
+    int16_t a, b, y, last;
+
+    stats.calls[GFX_TRIANGLE]++;
+
+    /* Ordenar por y (y2 >= y1 >= y0) */
+    if (y0 > y1) {
+        SWAP(y0, y1);
+        SWAP(x0, x1);
+    }
+    if (y1 > y2) {
+        SWAP(y2, y1);
+        SWAP(x2, x1);
+    }
+    if (y0 > y1) {
+        SWAP(y0, y1);
+        SWAP(x0, x1);
+    }
+
+    /* Todo en una linea */
+    if (y0 == y2) {
+        a = b = x0;
+        if (x1 < a) a = x1;
+        else if (x1 > b) b = x1;
+        if (x2 < a) a = x2;
+        else if (x2 > b) b = x2;
+        gfx_drawFastHLine(a, y0, b - a + 1, color);
+        return;
+    }
+
+    int32_t dx01 = x1 - x0, dy01 = y1 - y0;
+    int32_t dx02 = x2 - x0, dy02 = y2 - y0;
+    int32_t dx12 = x2 - x1, dy12 = y2 - y1;
+    int32_t sa = 0, sb = 0;
+
+    /* Mitad de arriba; incluye y1 solo si la de abajo es plana */
+    last = (y1 == y2) ? y1 : y1 - 1;
+
+    for (y = y0; y <= last; y++) {
+        a = (int16_t)(x0 + sa / dy01);
+        b = (int16_t)(x0 + sb / dy02);
+        sa += dx01;
+        sb += dx02;
+        if (a > b)
+            SWAP(a, b);
+        gfx_drawFastHLine(a, y, b - a + 1, color);
+    }
+
+    /* Mitad de abajo */
+    sa = dx12 * (y - y1);
+    sb = dx02 * (y - y0);
+    for (; y <= y2; y++) {
+        a = (int16_t)(x1 + sa / dy12);
+        b = (int16_t)(x0 + sb / dy02);
+        sa += dx12;
+        sb += dx02;
+        if (a > b)
+            SWAP(a, b);
+        gfx_drawFastHLine(a, y, b - a + 1, color);
+    }
+}
+
+/* ================= TEXTO ================= */
+
+void gfx_drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                  uint16_t bg, uint8_t size)
+{
+    stats.calls[GFX_CHAR]++;
+
+    if (x >= width || y >= height || x + 6 * size - 1 < 0 ||
+        y + 8 * size - 1 < 0)
+        return;
+
+    const uint8_t *glyph = (c >= 0x20 && c < 0x80) ? font[c - 0x20]
+                                                   : font[0];
+
+    for (int8_t i = 0; i < 6; i++) {
+        uint8_t line = i == 5 ? 0 : glyph[i];
+
+        for (int8_t j = 0; j < 8; j++, line >>= 1) {
+            uint16_t px;
+
+            if (line & 1)
+                px = color;
+            else if (bg != color)
+                px = bg;
+            else
+                continue;
+
+            if (size == 1)
+                gfx_drawPixel(x + i, y + j, px);
+            else
+                gfx_fillRect(x + i * size, y + j * size, size, size, px);
+        }
+    }
+}
+
+void gfx_setCursor(int16_t x, int16_t y)
+{
+    cursor_x = x;
+    cursor_y = y;
+}
+
+void gfx_setTextColor(uint16_t c, uint16_t bg)
+{
+    text_color = c;
+    text_bg = bg;
+}
+
+void gfx_setTextSize(uint8_t s)
+{
+    text_size = s > 0 ? s : 1;
+}
+
+void gfx_write(uint8_t c)
+{
+    if (c == '\n') {
+        cursor_y += text_size * 8;
+        cursor_x = 0;
+    } else if (c != '\r') {
+        gfx_drawChar(cursor_x, cursor_y, c, text_color, text_bg, text_size);
+        cursor_x += text_size * 6;
+    }
+}
+
+void gfx_puts(const char *s)
+{
+    while (*s)
+        gfx_write((uint8_t)*s++);
+}
+
+/* ================= SOLO HOST ================= */
+
+void gfx_host_stats_reset(void)
+{
+    stats = (struct gfx_host_stats){ 0 };
+}
+
+void gfx_host_stats_get(struct gfx_host_stats *out)
+{
+    *out = stats;
+}
+
+int gfx_host_write_ppm(const char *path, const uint16_t *frame)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f)
+        return -1;
+
+    fprintf(f, "P6\n%d %d\n255\n", LCD_WIDTH, LCD_HEIGHT);
+    for (int i = 0; i < LCD_WIDTH * LCD_HEIGHT; i++) {
+        uint16_t p = frame[i];
+        uint8_t r = (p >> 11) & 0x1F, g = (p >> 5) & 0x3F, b = p & 0x1F;
+        uint8_t rgb[3] = { (uint8_t)(r << 3 | r >> 2),
+                           (uint8_t)(g << 2 | g >> 4),
+                           (uint8_t)(b << 3 | b >> 2) };
+        fwrite(rgb, 1, 3, f);
+    }
+    return fclose(f) ? -1 : 0;
+}
+
+int gfx_host_read_ppm(const char *path, uint16_t *frame)
+{
+    FILE *f = fopen(path, "rb");
+    int w, h, max, ret = -1;
+
+    if (!f)
+        return -1;
+
+    if (fscanf(f, "P6 %d %d %d", &w, &h, &max) == 3 && fgetc(f) != EOF &&
+        w == LCD_WIDTH && h == LCD_HEIGHT && max == 255) {
+        ret = 0;
+        for (int i = 0; i < LCD_WIDTH * LCD_HEIGHT; i++) {
+            uint8_t rgb[3];
+            if (fread(rgb, 1, 3, f) != 3) {
+                ret = -1;
+                break;
+            }
+            frame[i] = (uint16_t)((rgb[0] >> 3) << 11 | (rgb[1] >> 2) << 5 |
+                                  rgb[2] >> 3);
+        }
+    }
+    fclose(f);
+    return ret;
+}
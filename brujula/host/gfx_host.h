@@ -0,0 +1,77 @@
+#ifndef GFX_HOST_H
+#define GFX_HOST_H
+
+/*
+ * gfx_* de libopencm3-plus para el build de Linux.
+ *
+ * Mismos algoritmos que la libreria (Bresenham, circulo de punto medio,
+ * triangulos por tramos horizontales, fuente 5x7 en celdas de 6x8), asi
+ * que los pixeles salen iguales que en el LCD. Los pixeles van a la
+ * funcion que se pase a gfx_init(), normalmente fb_draw_pixel().
+ *
+ * Ademas cuenta llamadas por primitiva (incluidas las anidadas, p. ej.
+ * fillRect -> drawFastVLine) y pixeles emitidos, y lee/escribe frames
+ * RGB565 como PPM para comparar contra imagenes de referencia.
+ */
+
+#include <stdint.h>
+
+#define LCD_WIDTH  240
+#define LCD_HEIGHT 320
+
+/* RGB565 */
+#define LCD_BLACK   0x0000
+#define LCD_WHITE   0xFFFF
+#define LCD_GREY    0x8410
+#define LCD_RED     0xF800
+#define LCD_GREEN   0x07E0
+#define LCD_BLUE    0x001F
+#define LCD_YELLOW  0xFFE0
+#define LCD_CYAN    0x07FF
+#define LCD_MAGENTA 0xF81F
+
+void gfx_init(void (*draw)(int, int, uint16_t), int width, int height);
+
+void gfx_drawPixel(int16_t x, int16_t y, uint16_t color);
+void gfx_drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                  uint16_t color);
+void gfx_drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+void gfx_drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+void gfx_fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                  uint16_t color);
+void gfx_fillScreen(uint16_t color);
+void gfx_drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+void gfx_fillTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                      int16_t x2, int16_t y2, uint16_t color);
+void gfx_drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color,
+                  uint16_t bg, uint8_t size);
+
+void gfx_setCursor(int16_t x, int16_t y);
+void gfx_setTextColor(uint16_t c, uint16_t bg);
+void gfx_setTextSize(uint8_t s);
+void gfx_write(uint8_t c);
+void gfx_puts(const char *s);
+
+/* ================= SOLO HOST ================= */
+
+enum gfx_prim {
+    GFX_PIXEL, GFX_LINE, GFX_VLINE, GFX_HLINE, GFX_RECT,
+    GFX_CIRCLE, GFX_TRIANGLE, GFX_CHAR,
+    GFX_PRIM_COUNT
+};
+
+struct gfx_host_stats {
+    uint64_t calls[GFX_PRIM_COUNT];
+    uint64_t pixels;          // llamadas a la funcion de gfx_init()
+};
+
+extern const char *const gfx_prim_names[GFX_PRIM_COUNT];
+
+void gfx_host_stats_reset(void);
+void gfx_host_stats_get(struct gfx_host_stats *out);
+
+/* frame de LCD_WIDTH x LCD_HEIGHT en RGB565; 0 = ok, -1 = error */
+int gfx_host_write_ppm(const char *path, const uint16_t *frame);
+int gfx_host_read_ppm(const char *path, uint16_t *frame);
+
+#endif /* GFX_HOST_H */
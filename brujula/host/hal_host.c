@@ -0,0 +1,520 @@
+/*
+ * HAL de Linux (ver hal_host.h)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "hal_host.h"
+#include "../hal.h"
+#include "../brujula.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* 168 MHz, ~4 ciclos por vuelta del nop loop */
+#define NOP_NS_X100 2381
+
+/* Una transaccion sincrona colgada sale por el deadline del driver */
+#define SYNC_STALL_NS (HAL_I2C_TIMEOUT_US * 1000ull)
+
+/* SPI5 del LCD: APB2 (84 MHz) / 8 */
+#define LCD_SPI_HZ 10500000
+
+/* SPI5 del giroscopo: APB2 / 16, mas CS y el cambio de modo */
+#define GYRO_SPI_HZ      5250000
+#define GYRO_OVERHEAD_NS 1500u
+
+/* USB full-speed, CDC bulk: ~800 KB/s utiles; cada llamada cuesta ~2 us */
+#define CDC_BYTES_PER_S 800000u
+#define CDC_WRITE_NS    2000u
+
+/* Flash del F429 a 3.3 V, x32: 16 us por palabra, ~1 s por 128 KB */
+#define FLASH_WORD_NS     16000u
+#define FLASH_ERASE_NS_KB 8000000u
+
+struct hal_host_bus hal_bus;
+struct hal_host_lcd hal_lcd;
+struct qmc_sim hal_qmc;
+struct gyro_sim hal_gyro;
+struct hal_host_cdc hal_cdc;
+struct flash_sim hal_flash;
+
+/* Transaccion DMA en curso */
+static struct {
+    int pending;
+    int stalled;
+    int status;
+    uint64_t done_ns;
+    hal_i2c_cb cb;
+} async;
+
+static hal_irq_cb lcd_cb;
+static uint64_t lcd_done_ns;
+
+static hal_irq_cb drdy_cb;
+static hal_irq_cb tick_cb;
+static uint64_t tick_period_ns;
+static uint64_t next_tick_ns;
+static uint32_t drdy_seen;
+static int in_irq;
+
+/* ================= RELOJ / BUS ================= */
+
+void hal_host_reset(void)
+{
+    hal_bus = (struct hal_host_bus){
+        .bus_hz = 100000,
+        .txn_overhead_ns = 2000,
+        .nop_ns_x100 = NOP_NS_X100,
+    };
+    qmc_sim_reset(&hal_qmc);
+#if BRUJULA_MAG == MAG_HMC5883L
+    qmc_sim_set_chip(&hal_qmc, QMC_SIM_HMC5883L);   // el chip del build
+#elif BRUJULA_MAG == MAG_LIS3MDL
+    qmc_sim_set_chip(&hal_qmc, QMC_SIM_LIS3MDL);
+#endif
+    gyro_sim_reset(&hal_gyro, &hal_qmc);
+
+    hal_cdc.bytes_per_s = CDC_BYTES_PER_S;
+    hal_cdc.busy_until_ns = 0;
+    hal_cdc.len = 0;          // el buffer se reusa
+    hal_cdc.writes = 0;
+    hal_cdc.refused = 0;
+
+    memset(&hal_lcd, 0, sizeof(hal_lcd));
+    hal_lcd.spi_hz = LCD_SPI_HZ;
+    lcd_cb = NULL;
+
+    async.pending = 0;
+    drdy_cb = NULL;
+    tick_cb = NULL;
+    drdy_seen = 0;
+    in_irq = 0;
+}
+
+/* Proximo evento (tick, fin de DMA, DRDY) antes de 'limit', o limit */
+static uint64_t next_event(uint64_t limit)
+{
+    uint64_t t = limit;
+
+    if (tick_cb && next_tick_ns < t)
+        t = next_tick_ns;
+    if (async.pending && !async.stalled && async.done_ns < t)
+        t = async.done_ns;
+    if (hal_lcd.sending && lcd_done_ns < t)
+        t = lcd_done_ns;
+    if (drdy_cb && hal_qmc.next_sample_ns > hal_bus.now_ns &&
+        hal_qmc.next_sample_ns < t)
+        t = hal_qmc.next_sample_ns;
+    return t;
+}
+
+/* Corre las "interrupciones" que tocan en hal_bus.now_ns */
+static void run_irqs(void)
+{
+    in_irq = 1;
+
+    if (async.pending && !async.stalled && async.done_ns <= hal_bus.now_ns) {
+        hal_i2c_cb cb = async.cb;
+        async.pending = 0;
+        cb(async.status);
+    }
+
+    if (hal_lcd.sending && lcd_done_ns <= hal_bus.now_ns) {
+        if (memcmp(hal_lcd.sending, hal_lcd.screen, sizeof(hal_lcd.screen)))
+            hal_lcd.tears++;
+        hal_lcd.sending = NULL;
+        hal_lcd.frames++;
+        if (lcd_cb)
+            lcd_cb();
+    }
+
+    if (drdy_cb && hal_qmc.drdy_edges != drdy_seen) {
+        drdy_seen = hal_qmc.drdy_edges;
+        drdy_cb();
+    }
+
+    if (tick_cb && next_tick_ns <= hal_bus.now_ns) {
+        next_tick_ns += tick_period_ns;
+        tick_cb();
+    }
+
+    in_irq = 0;
+}
+
+void hal_host_advance(uint64_t ns)
+{
+    uint64_t target = hal_bus.now_ns + ns;
+
+    /* Dentro de una interrupcion el tiempo corre, pero no se anida */
+    if (in_irq) {
+        hal_bus.now_ns = target;
+        qmc_sim_advance(&hal_qmc, target);
+        return;
+    }
+
+    for (;;) {
+        uint64_t t = next_event(target);
+        hal_bus.now_ns = t;
+        qmc_sim_advance(&hal_qmc, t);
+        run_irqs();
+        if (t >= target)
+            break;
+    }
+}
+
+static uint64_t bits_ns(uint32_t bits)
+{
+    return (uint64_t)bits * 1000000000u / hal_bus.bus_hz;
+}
+
+/* bits = clocks de SCL; cada START/Sr/STOP cuenta como uno */
+static void bus_transaction(uint32_t bits, uint32_t bytes)
+{
+    uint64_t ns = bits_ns(bits);
+
+    hal_bus.transactions++;
+    hal_bus.bytes += bytes;
+    hal_bus.bus_ns += ns;
+    hal_host_advance(ns + hal_bus.txn_overhead_ns);
+}
+
+/* Fallas inyectadas: 0 = ok, 1 = NACK, 2 = bus colgado */
+static int inject(uint8_t addr)
+{
+    if (hal_bus.sda_stuck)
+        return 2;
+    if (hal_bus.fail_stall) {
+        hal_bus.fail_stall--;
+        return 2;
+    }
+    if (hal_bus.fail_nack || addr != qmc_sim_addr(&hal_qmc) ||
+        hal_bus.now_ns < hal_qmc.por_ns) {
+        if (hal_bus.fail_nack)
+            hal_bus.fail_nack--;
+        hal_bus.nacks++;
+        return 1;
+    }
+    return 0;
+}
+
+/* ================= SISTEMA ================= */
+
+void system_init(void)
+{
+    hal_host_reset();
+}
+
+void init_console(void)
+{
+    setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+void i2c_setup(void)
+{
+}
+
+/* ================= I2C ================= */
+
+void hal_i2c_set_speed(uint32_t hz)
+{
+    hal_bus.bus_hz = hz;
+}
+
+int hal_i2c_write(uint8_t addr, uint8_t reg, uint8_t val)
+{
+    uint8_t data[2] = { reg, val };
+
+    qmc_sim_advance(&hal_qmc, hal_bus.now_ns);
+
+    switch (inject(addr)) {
+    case 1:
+        /* START + direccion + NACK + STOP */
+        bus_transaction(1 + 9 + 1, 1);
+        return -1;
+    case 2:
+        hal_host_advance(SYNC_STALL_NS);
+        return -1;
+    }
+
+    /* START + addr + reg + val + STOP */
+    bus_transaction(1 + 3 * 9 + 1, 3);
+    return qmc_sim_write(&hal_qmc, data, 2);
+}
+
+int hal_i2c_read(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len)
+{
+    qmc_sim_advance(&hal_qmc, hal_bus.now_ns);
+
+    switch (inject(addr)) {
+    case 1:
+        bus_transaction(1 + 9 + 1, 1);
+        return -1;
+    case 2:
+        hal_host_advance(SYNC_STALL_NS);
+        return -1;
+    }
+
+    /* Los registros de datos quedan bloqueados durante la transaccion */
+    qmc_sim_write(&hal_qmc, &reg, 1);
+    qmc_sim_read(&hal_qmc, buf, len);
+
+    /* START + addr(W) + reg + Sr + addr(R) + len + STOP */
+    bus_transaction(1 + 2 * 9 + 1 + 9 + len * 9u + 1, 3u + len);
+    return 0;
+}
+
+/* ================= I2C ASINCRONO ================= */
+
+int hal_i2c_read_async(uint8_t addr, uint8_t reg, uint8_t *buf, uint8_t len,
+                       hal_i2c_cb cb)
+{
+    uint32_t bits;
+
+    if (async.pending || len < 2 || hal_bus.no_dma)
+        return -1;
+
+    qmc_sim_advance(&hal_qmc, hal_bus.now_ns);
+
+    async.pending = 1;
+    async.stalled = 0;
+    async.cb = cb;
+
+    switch (inject(addr)) {
+    case 1:
+        async.status = -1;
+        bits = 1 + 9 + 1;
+        break;
+    case 2:
+        async.stalled = 1;
+        return 0;
+    default:
+        qmc_sim_write(&hal_qmc, &reg, 1);
+        qmc_sim_read(&hal_qmc, buf, len);
+        async.status = 0;
+        bits = 1 + 2 * 9 + 1 + 9 + len * 9u + 1;
+        break;
+    }
+
+    hal_bus.transactions++;
+    hal_bus.bytes += async.status ? 1u : 3u + len;
+    hal_bus.bus_ns += bits_ns(bits);
+    async.done_ns = hal_bus.now_ns + bits_ns(bits);
+    return 0;
+}
+
+void hal_i2c_abort(void)
+{
+    async.pending = 0;
+}
+
+/* Pulsos + STOP a 100 kHz y el reset del periferico */
+#define BUS_CLEAR_BIT_NS   10000u
+#define BUS_CLEAR_RESET_NS 20000u
+
+int hal_i2c_bus_clear(void)
+{
+    uint32_t pulses = hal_bus.sda_stuck < 9 ? hal_bus.sda_stuck : 9;
+
+    hal_i2c_abort();
+    hal_bus.bus_clears++;
+    hal_bus.fail_stall = 0;   // el reset del periferico saca el BUSY
+    if (hal_bus.sda_stuck != UINT32_MAX)
+        hal_bus.sda_stuck -= pulses;
+    hal_host_advance((pulses + 2) * BUS_CLEAR_BIT_NS + BUS_CLEAR_RESET_NS);
+    return hal_bus.sda_stuck ? -1 : (int)pulses;
+}
+
+/* ================= IRQ: DRDY / TICK ================= */
+
+void hal_drdy_irq_init(hal_irq_cb cb)
+{
+    drdy_cb = cb;
+    drdy_seen = hal_qmc.drdy_edges;
+}
+
+void hal_tick_irq_init(uint32_t hz, hal_irq_cb cb)
+{
+    tick_cb = cb;
+    tick_period_ns = 1000000000u / hz;
+    next_tick_ns = hal_bus.now_ns + tick_period_ns;
+}
+
+/* ================= LCD ================= */
+
+void hal_lcd_present(const uint16_t *frame, hal_irq_cb done)
+{
+    uint64_t ns = (uint64_t)sizeof(hal_lcd.screen) * 8u * 1000000000u /
+                  hal_lcd.spi_hz;
+
+    memcpy(hal_lcd.screen, frame, sizeof(hal_lcd.screen));
+    hal_lcd.sending = frame;
+    hal_lcd.busy_ns += ns;
+    lcd_cb = done;
+    lcd_done_ns = hal_bus.now_ns + ns;
+}
+
+int hal_lcd_busy(void)
+{
+    return hal_lcd.sending != NULL;
+}
+
+/* Las "interrupciones" solo corren dentro de hal_host_advance() */
+void hal_irq_lock(void)
+{
+}
+
+void hal_irq_unlock(void)
+{
+}
+
+/* ================= GIROSCOPO ================= */
+
+void hal_gyro_setup(void)
+{
+}
+
+int hal_gyro_xfer(const uint8_t *tx, uint8_t *rx, uint8_t len)
+{
+    if (hal_lcd.sending)
+        return -1;
+
+    /* El FIFO se llena solo; se pone al dia antes de mirarlo */
+    gyro_sim_advance(&hal_gyro, hal_bus.now_ns);
+    gyro_sim_xfer(&hal_gyro, tx, rx, len);
+    hal_host_advance((uint64_t)len * 8u * 1000000000u / GYRO_SPI_HZ +
+                     GYRO_OVERHEAD_NS);
+    return 0;
+}
+
+/* ================= USB CDC ================= */
+
+int hal_cdc_write(const uint8_t *buf, uint16_t len)
+{
+    if (!hal_cdc.bytes_per_s || hal_bus.now_ns < hal_cdc.busy_until_ns) {
+        hal_cdc.refused++;
+        hal_host_advance(CDC_WRITE_NS / 4);
+        return 0;
+    }
+
+    if (len > 64)
+        len = 64;
+    if (hal_cdc.len + len > hal_cdc.cap) {
+        size_t cap = hal_cdc.cap ? hal_cdc.cap * 2 : 65536;
+        uint8_t *p = realloc(hal_cdc.capture, cap);
+        if (!p)
+            return 0;
+        hal_cdc.capture = p;
+        hal_cdc.cap = cap;
+    }
+    memcpy(hal_cdc.capture + hal_cdc.len, buf, len);
+    hal_cdc.len += len;
+    hal_cdc.writes++;
+    hal_cdc.busy_until_ns = hal_bus.now_ns +
+                            (uint64_t)len * 1000000000u / hal_cdc.bytes_per_s;
+    hal_host_advance(CDC_WRITE_NS);
+    return len;
+}
+
+/* ================= FLASH ================= */
+
+static struct flash_sim *flash(void)
+{
+    if (!hal_flash.sector_size)
+        flash_sim_open(&hal_flash, NULL, HAL_HOST_FLASH_SECTOR);
+    return &hal_flash;
+}
+
+uint32_t hal_flash_sector_size(void)
+{
+    return flash()->sector_size;
+}
+
+const uint32_t *hal_flash_sector(int s)
+{
+    return flash()->mem[s];
+}
+
+int hal_flash_erase_start(int s)
+{
+    if (flash()->erasing)
+        return -1;
+
+    hal_flash.erase_err = flash_sim_erase(&hal_flash, s);
+    hal_flash.erase_done_ns = hal_bus.now_ns +
+                              (uint64_t)hal_flash.sector_size / 1024u *
+                              FLASH_ERASE_NS_KB;
+    hal_flash.erasing = 1;
+    return 0;
+}
+
+int hal_flash_erase_poll(void)
+{
+    if (!flash()->erasing)
+        return 0;
+    if (hal_bus.now_ns < hal_flash.erase_done_ns)
+        return 1;
+
+    hal_flash.erasing = 0;
+    return hal_flash.erase_err;
+}
+
+int hal_flash_program(int s, uint32_t off, const uint32_t *words, uint32_t n)
+{
+    if (flash()->erasing)
+        return -1;
+    hal_host_advance((uint64_t)n * FLASH_WORD_NS);
+    return flash_sim_program(flash(), s, off, words, n);
+}
+
+/* ================= TIEMPO ================= */
+
+void hal_time_init(void)
+{
+}
+
+uint64_t hal_time_us(void)
+{
+    return hal_bus.now_ns / 1000u;
+}
+
+void hal_sleep_until_us(uint64_t t_us)
+{
+    uint64_t t_ns = t_us * 1000u;
+
+    if (t_ns > hal_bus.now_ns)
+        hal_host_advance(t_ns - hal_bus.now_ns);
+}
+
+/* Reloj del PC, no el virtual: lo que tarda el codigo en el host */
+uint32_t hal_cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+uint32_t hal_cycles_hz(void)
+{
+    return 1000000000u;
+}
+
+/* Hasta la proxima interrupcion, o el proximo ms (el SysTick de la placa) */
+void hal_idle_until_us(uint64_t t_us)
+{
+    uint64_t limit = (hal_bus.now_ns / 1000000u + 1) * 1000000u;
+
+    if (t_us < limit / 1000u)
+        limit = t_us * 1000u;
+    if (limit <= hal_bus.now_ns)
+        return;
+    hal_host_advance(next_event(limit) - hal_bus.now_ns);
+}
+
+/* ================= DELAY ================= */
+
+void hal_delay(uint32_t n)
+{
+    hal_host_advance((uint64_t)n * hal_bus.nop_ns_x100 / 100);
+}
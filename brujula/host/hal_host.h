@@ -0,0 +1,102 @@
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+/*
+ * HAL de Linux: reloj virtual + modelo de tiempos del bus I2C.
+ *
+ * Cada transaccion avanza el reloj virtual lo que tardaria en el cable
+ * (9 clocks por byte, START/Sr/STOP, overhead del driver), asi que los
+ * numeros del benchmark son los de la placa, no los del PC.
+ *
+ * hal_host_advance() es tambien el "NVIC": al avanzar el reloj corre en
+ * orden los fines de DMA, los flancos de DRDY y los ticks del timer.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flash_sim.h"
+#include "l3gd20_sim.h"
+#include "qmc_sim.h"
+
+struct hal_host_bus {
+    uint32_t bus_hz;          // SCL (100 kHz = i2c_speed_sm_100k)
+    uint32_t txn_overhead_ns; // software por transaccion
+    uint32_t nop_ns_x100;     // duracion de una vuelta de delay() *100
+
+    uint64_t now_ns;          // reloj virtual
+
+    /* Contadores */
+    uint64_t transactions;
+    uint64_t bytes;           // bytes en el cable (incluye direcciones)
+    uint64_t bus_ns;          // tiempo con el bus ocupado
+    uint64_t nacks;
+    uint32_t bus_clears;      // hal_i2c_bus_clear()
+
+    /* Fallas inyectadas (se consumen una por transaccion) */
+    uint32_t fail_nack;       // proximas N transacciones con NACK
+    uint32_t fail_stall;      // proximas N transacciones que no terminan
+                              // (hasta un hal_i2c_bus_clear())
+    int no_dma;               // hal_i2c_read_async() no disponible
+
+    /* SDA en bajo (esclavo trabado a mitad de un byte): nada termina
+     * hasta que hal_i2c_bus_clear() da estos pulsos de SCL (9 por
+     * llamada); UINT32_MAX = la linea no se suelta nunca */
+    uint32_t sda_stuck;
+};
+
+/*
+ * LCD: el envio de un frame tarda 16 bits por pixel a spi_hz. Al empezar
+ * se copia el buffer a screen (lo que termina mostrando el panel); si al
+ * terminar el buffer ya no es igual, alguien dibujo encima: tear.
+ */
+struct hal_host_lcd {
+    uint32_t spi_hz;
+    uint64_t frames;          // envios terminados
+    uint64_t tears;
+    uint64_t busy_ns;
+    const uint16_t *sending;  // buffer en el DMA, o NULL
+    uint16_t screen[240 * 320];
+};
+
+extern struct hal_host_bus hal_bus;
+extern struct hal_host_lcd hal_lcd;
+extern struct qmc_sim hal_qmc;
+
+/*
+ * Giroscopo: comparte SPI5 con el LCD. hal_gyro_xfer() devuelve -1
+ * mientras hal_lcd.sending y cada transaccion avanza el reloj lo que
+ * tarda en el cable (SPI5 / 16, modo 3).
+ */
+extern struct gyro_sim hal_gyro;
+
+/*
+ * USB CDC: el PC saca bytes_per_s (0 = nadie leyendo). Cada
+ * hal_cdc_write() toma un paquete si el anterior ya salio, y lo que
+ * llega se junta en capture.
+ */
+struct hal_host_cdc {
+    uint32_t bytes_per_s;
+    uint64_t busy_until_ns;
+    uint8_t *capture;         // lo que llego al PC (crece)
+    size_t len, cap;
+    uint64_t writes;          // llamadas que tomaron algo
+    uint64_t refused;         // endpoint ocupado o sin PC
+};
+
+extern struct hal_host_cdc hal_cdc;
+
+/*
+ * Flash: hal_host_reset() no la toca (sobrevive al reinicio). Si nadie
+ * la abrio, el primer acceso abre una en memoria con sectores de 128 KB
+ * como los 22 y 23 de la placa.
+ */
+#define HAL_HOST_FLASH_SECTOR (128u * 1024u)
+
+extern struct flash_sim hal_flash;
+
+/* Vuelve a cero el reloj, los contadores y el simulador */
+void hal_host_reset(void);
+void hal_host_advance(uint64_t ns);
+
+#endif /* HAL_HOST_H */
@@ -0,0 +1,175 @@
+/*
+ * Simulador del L3GD20 (ver l3gd20_sim.h)
+ */
+#include "l3gd20_sim.h"
+#include "../giro.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static const uint32_t odr_hz[4] = { 95, 190, 380, 760 };
+static const double mdps_lsb[4] = { 8.75, 17.5, 70.0, 70.0 };
+
+/* ================= HELPERS ================= */
+
+static uint32_t xorshift(struct gyro_sim *g)
+{
+    uint32_t x = g->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    g->rng = x;
+    return x;
+}
+
+static double gauss(struct gyro_sim *g)
+{
+    double u1 = (xorshift(g) + 1.0) / 4294967297.0;
+    double u2 = (xorshift(g) + 1.0) / 4294967297.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static int powered(const struct gyro_sim *g)
+{
+    return g->regs[L3GD20_CTRL1] & 0x08;
+}
+
+static int fifo_on(const struct gyro_sim *g)
+{
+    return (g->regs[L3GD20_CTRL5] & L3GD20_CTRL5_FIFO) &&
+           (g->regs[L3GD20_FIFO_CTRL] & 0xE0) == L3GD20_FIFO_STREAM;
+}
+
+static int16_t clamp16(double v)
+{
+    if (v > 32767.0)
+        return 32767;
+    if (v < -32768.0)
+        return -32768;
+    return (int16_t)lrint(v);
+}
+
+/* Registros de salida: la muestra mas vieja del FIFO (o la ultima) */
+static void load_out(struct gyro_sim *g, const int16_t *v)
+{
+    for (int a = 0; a < 3; a++) {
+        g->regs[L3GD20_OUT_X_L + 2 * a] = (uint8_t)(v[a] & 0xFF);
+        g->regs[L3GD20_OUT_X_L + 2 * a + 1] = (uint8_t)((uint16_t)v[a] >> 8);
+    }
+}
+
+static void latch_sample(struct gyro_sim *g, uint64_t t_ns)
+{
+    const uint64_t h_ns = 1000000;   // derivada centrada, +-1 ms
+    double yaw = (qmc_sim_heading(g->field, t_ns + h_ns) -
+                  qmc_sim_heading(g->field, t_ns > h_ns ? t_ns - h_ns : 0)) /
+                 ((t_ns > h_ns ? 2 * h_ns : h_ns + t_ns) * 1e-9);
+    double lsb = mdps_lsb[(g->regs[L3GD20_CTRL4] >> 4) & 0x03] / 1000.0;
+    int16_t v[3];
+
+    for (int a = 0; a < 3; a++) {
+        double w = a == GYRO_YAW_AXIS ? GYRO_YAW_SIGN * yaw * g->scale : 0.0;
+        v[a] = clamp16((w + g->bias_dps[a] + g->noise_dps * gauss(g)) / lsb);
+    }
+
+    if (fifo_on(g)) {
+        if (g->count == GYRO_SIM_FIFO) {
+            g->head = (uint8_t)((g->head + 1) % GYRO_SIM_FIFO);
+            g->count--;
+            g->ovrn = 1;
+            g->overwritten++;
+        }
+        memcpy(g->fifo[(g->head + g->count) % GYRO_SIM_FIFO], v, sizeof(v));
+        g->count++;
+        load_out(g, g->fifo[g->head]);
+    } else {
+        load_out(g, v);
+    }
+    g->samples++;
+}
+
+static uint8_t fifo_src(const struct gyro_sim *g)
+{
+    uint8_t fss = g->count >= GYRO_SIM_FIFO ? 31 : g->count;
+
+    return (uint8_t)(fss | (g->ovrn ? L3GD20_FIFO_OVRN : 0) |
+                     (g->count ? 0 : L3GD20_FIFO_EMPTY));
+}
+
+/* Se leyo OUT_Z_H con el FIFO prendido: sale la muestra */
+static void fifo_pop(struct gyro_sim *g)
+{
+    if (!g->count)
+        return;
+    g->head = (uint8_t)((g->head + 1) % GYRO_SIM_FIFO);
+    g->count--;
+    g->ovrn = 0;
+    if (g->count)
+        load_out(g, g->fifo[g->head]);
+}
+
+/* ================= API ================= */
+
+void gyro_sim_reset(struct gyro_sim *g, const struct qmc_sim *field)
+{
+    memset(g, 0, sizeof(*g));
+    g->regs[L3GD20_WHO_AM_I] = L3GD20_ID;
+    g->regs[L3GD20_CTRL1] = 0x07;   // power-down, XYZ habilitados
+    g->field = field;
+    g->scale = 1.0;
+    g->rng = 0x1234567u;
+}
+
+uint32_t gyro_sim_period_ns(const struct gyro_sim *g)
+{
+    return 1000000000u / odr_hz[(g->regs[L3GD20_CTRL1] >> 6) & 0x03];
+}
+
+void gyro_sim_advance(struct gyro_sim *g, uint64_t now_ns)
+{
+    if (!powered(g))
+        return;
+
+    if (!g->next_sample_ns)
+        g->next_sample_ns = now_ns + gyro_sim_period_ns(g);
+
+    while (g->next_sample_ns <= now_ns) {
+        latch_sample(g, g->next_sample_ns);
+        g->next_sample_ns += gyro_sim_period_ns(g);
+    }
+}
+
+void gyro_sim_xfer(struct gyro_sim *g, const uint8_t *tx, uint8_t *rx,
+                   uint8_t len)
+{
+    uint8_t reg = tx[0] & 0x3F;
+    int read = tx[0] & L3GD20_READ;
+    int inc = tx[0] & L3GD20_INC;
+
+    rx[0] = 0xFF;
+    for (uint8_t i = 1; i < len; i++) {
+        if (read) {
+            rx[i] = reg == L3GD20_FIFO_SRC ? fifo_src(g) : g->regs[reg];
+            if (reg == L3GD20_OUT_X_L + 5 && fifo_on(g))
+                fifo_pop(g);
+        } else {
+            rx[i] = 0xFF;
+            if (reg != L3GD20_WHO_AM_I && reg != L3GD20_FIFO_SRC)
+                g->regs[reg] = tx[i];
+            if (reg == L3GD20_CTRL1 && !powered(g))
+                g->next_sample_ns = 0;
+        }
+
+        if (!inc)
+            continue;
+        /* Con el FIFO, OUT_Z_H vuelve a OUT_X_L */
+        if (reg == L3GD20_OUT_X_L + 5 && fifo_on(g))
+            reg = L3GD20_OUT_X_L;
+        else
+            reg = (uint8_t)((reg + 1) & 0x3F);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef L3GD20_SIM_H
+#define L3GD20_SIM_H
+
+/*
+ * Simulador del giroscopo L3GD20 a nivel de registros (build de Linux).
+ *
+ * Modela WHO_AM_I, CTRL1 (PD + ODR), CTRL4 (escala), CTRL5 (FIFO_EN),
+ * FIFO_CTRL (modo stream), FIFO_SRC y el FIFO de 32 muestras, con el
+ * auto-incremento que vuelve de OUT_Z_H a OUT_X_L.
+ *
+ * La velocidad de giro sale del rumbo real del QMC simulado (derivada),
+ * en el eje GYRO_YAW_AXIS de giro.h, mas bias y ruido gaussiano.
+ */
+
+#include <stdint.h>
+
+#include "qmc_sim.h"
+
+#define GYRO_SIM_NREGS 0x40
+#define GYRO_SIM_FIFO  32
+
+struct gyro_sim {
+    uint8_t regs[GYRO_SIM_NREGS];
+    int16_t fifo[GYRO_SIM_FIFO][3];
+    uint8_t head, count;
+    uint8_t ovrn;
+
+    uint64_t next_sample_ns;
+    const struct qmc_sim *field;   // de donde sale el rumbo real
+
+    double bias_dps[3];
+    double noise_dps;              // sigma por muestra
+    double scale;                  // error de escala (1.0 = exacto)
+    uint32_t rng;
+
+    /* Contadores */
+    uint32_t samples;
+    uint32_t overwritten;
+};
+
+void gyro_sim_reset(struct gyro_sim *g, const struct qmc_sim *field);
+void gyro_sim_advance(struct gyro_sim *g, uint64_t now_ns);
+
+/* Una transaccion SPI con CS bajo: tx[0] es R/W | MS | registro */
+void gyro_sim_xfer(struct gyro_sim *g, const uint8_t *tx, uint8_t *rx,
+                   uint8_t len);
+
+uint32_t gyro_sim_period_ns(const struct gyro_sim *g);
+
+#endif /* L3GD20_SIM_H */
@@ -0,0 +1,454 @@
+/*
+ * Simulador del QMC5883L, HMC5883L y LIS3MDL (ver qmc_sim.h)
+ */
+#include "qmc_sim.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define REG_STATUS   0x06
+#define REG_TOUT_LSB 0x07
+#define REG_CONTROL1 0x09
+#define REG_CONTROL2 0x0A
+#define REG_SETRESET 0x0B
+#define REG_CHIP_ID  0x0D
+
+static const uint32_t odr_hz[4] = { 10, 50, 100, 200 };
+static const uint32_t osr_val[4] = { 512, 256, 128, 64 };
+
+/* HMC5883L */
+#define HMC_CRA      0x00
+#define HMC_CRB      0x01
+#define HMC_MODE     0x02
+#define HMC_DATA     0x03   // X, Z, Y big endian
+#define HMC_DATA_END 0x08
+#define HMC_STATUS   0x09
+#define HMC_ID       0x0A
+#define HMC_RDY      0x01
+
+static const uint32_t hmc_odr_mhz[8] = {
+    750, 1500, 3000, 7500, 15000, 30000, 75000, 75000,
+};
+static const uint32_t hmc_gain[8] = {
+    1370, 1090, 820, 660, 440, 390, 330, 230,
+};
+
+/* LIS3MDL */
+#define LIS_WHO_AM_I 0x0F
+#define LIS_CTRL1    0x20
+#define LIS_CTRL2    0x21
+#define LIS_CTRL3    0x22
+#define LIS_CTRL4    0x23
+#define LIS_CTRL5    0x24
+#define LIS_STATUS   0x27
+#define LIS_DATA     0x28   // X, Y, Z little endian
+#define LIS_DATA_END 0x2D
+#define LIS_TEMP     0x2E
+#define LIS_ZYXDA    0x08
+#define LIS_ZYXOR    0x80
+#define LIS_FAST_ODR 0x02
+#define LIS_SOFT_RST 0x04
+#define LIS_AUTO_INC 0x80
+
+static const uint32_t lis_odr_mhz[8] = {
+    625, 1250, 2500, 5000, 10000, 20000, 40000, 80000,
+};
+static const uint32_t lis_fast_hz[4] = { 1000, 560, 300, 155 };   // por OM
+static const uint32_t lis_gain[4] = { 6842, 3421, 2281, 1711 };
+
+/* Direccion, registro de estado y sus bits de dato nuevo / pisado */
+static const struct chip_map {
+    uint8_t addr;
+    uint8_t nregs;
+    uint8_t status;
+    uint8_t drdy;
+    uint8_t dor;
+} maps[] = {
+    [QMC_SIM_QMC5883L] = { 0x0D, 0x0E, REG_STATUS, QMC_ST_DRDY, QMC_ST_DOR },
+    [QMC_SIM_HMC5883L] = { 0x1E, 0x0D, HMC_STATUS, HMC_RDY, 0 },
+    [QMC_SIM_LIS3MDL] = { 0x1C, QMC_SIM_NREGS, LIS_STATUS, LIS_ZYXDA,
+                          LIS_ZYXOR },
+};
+
+/* ================= HELPERS ================= */
+
+static uint32_t xorshift(struct qmc_sim *s)
+{
+    uint32_t x = s->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->rng = x;
+    return x;
+}
+
+static double gauss(struct qmc_sim *s)
+{
+    double u1 = (xorshift(s) + 1.0) / 4294967297.0;
+    double u2 = (xorshift(s) + 1.0) / 4294967297.0;
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static int continuous(const struct qmc_sim *s)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        return (s->regs[HMC_MODE] & 0x03) == 0x00;
+    case QMC_SIM_LIS3MDL:
+        return (s->regs[LIS_CTRL3] & 0x03) == 0x00;
+    default:
+        return (s->regs[REG_CONTROL1] & 0x03) == 0x01;
+    }
+}
+
+static double gain_lsb_per_gauss(const struct qmc_sim *s)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        return hmc_gain[s->regs[HMC_CRB] >> 5];
+    case QMC_SIM_LIS3MDL:
+        return lis_gain[(s->regs[LIS_CTRL2] >> 5) & 0x03];
+    default:
+        return (s->regs[REG_CONTROL1] & 0x30) ? 3000.0 : 12000.0;
+    }
+}
+
+/* Ruido relativo al promediado mas alto (QMC: OSR, HMC: MA, LIS: OM) */
+static double noise_scale(const struct qmc_sim *s)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        return sqrt(8.0 / (1 << ((s->regs[HMC_CRA] >> 5) & 0x03)));
+    case QMC_SIM_LIS3MDL:
+        return sqrt(8.0 / (1 << ((s->regs[LIS_CTRL1] >> 5) & 0x03)));
+    default:
+        return sqrt(512.0 / osr_val[(s->regs[REG_CONTROL1] >> 6) & 0x03]);
+    }
+}
+
+static void soft_reset(struct qmc_sim *s)
+{
+    memset(s->regs, 0, sizeof(s->regs));
+    s->ptr = 0;
+    s->autoinc = 0;
+
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        s->regs[HMC_CRA] = 0x10;    // 15 Hz, sin promedio
+        s->regs[HMC_CRB] = 0x20;    // 1.3 G
+        s->regs[HMC_MODE] = 0x01;   // una sola medicion
+        s->regs[HMC_ID] = 'H';
+        s->regs[HMC_ID + 1] = '4';
+        s->regs[HMC_ID + 2] = '3';
+        break;
+    case QMC_SIM_LIS3MDL:
+        s->regs[LIS_WHO_AM_I] = 0x3D;
+        s->regs[LIS_CTRL1] = 0x10;   // 10 Hz
+        s->regs[LIS_CTRL3] = 0x03;   // apagado
+        break;
+    default:
+        s->regs[REG_CHIP_ID] = 0xFF;
+        break;
+    }
+}
+
+static int16_t clamp_axis(struct qmc_sim *s, double v)
+{
+    if (s->chip == QMC_SIM_HMC5883L) {
+        if (v > 2047.0 || v < -2048.0)
+            return -4096;   // el HMC marca el desborde asi
+    } else if (v > 32767.0 || v < -32768.0) {
+        if (s->chip == QMC_SIM_QMC5883L)
+            s->regs[REG_STATUS] |= QMC_ST_OVL;
+        return v > 0 ? 32767 : -32768;
+    }
+    return (int16_t)lrint(v);
+}
+
+static void put16_be(struct qmc_sim *s, uint8_t reg, int16_t v)
+{
+    s->regs[reg] = (uint8_t)((uint16_t)v >> 8);
+    s->regs[reg + 1] = (uint8_t)(v & 0xFF);
+}
+
+static void put16(struct qmc_sim *s, uint8_t reg, int16_t v)
+{
+    s->regs[reg] = (uint8_t)(v & 0xFF);
+    s->regs[reg + 1] = (uint8_t)((uint16_t)v >> 8);
+}
+
+static void put_axis(struct qmc_sim *s, int i, int16_t v)
+{
+    static const uint8_t hmc_reg[3] = { HMC_DATA, HMC_DATA + 4, HMC_DATA + 2 };
+
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        put16_be(s, hmc_reg[i], v);
+        break;
+    case QMC_SIM_LIS3MDL:
+        put16(s, (uint8_t)(LIS_DATA + 2 * i), v);
+        break;
+    default:
+        put16(s, (uint8_t)(2 * i), v);
+        break;
+    }
+}
+
+/* Latchea una medicion nueva en los registros de datos del chip */
+static void latch_sample(struct qmc_sim *s, uint64_t t_ns)
+{
+    const struct chip_map *map = &maps[s->chip];
+    double th = qmc_sim_true_heading(s, t_ns) * M_PI / 180.0;
+    double g = gain_lsb_per_gauss(s);
+    double sigma = s->noise_lsb * noise_scale(s);
+
+    if (s->regs[map->status] & map->drdy) {
+        s->regs[map->status] |= map->dor;
+        s->skipped++;
+    } else {
+        s->drdy_edges++;
+    }
+    if (s->chip == QMC_SIM_QMC5883L)
+        s->regs[REG_STATUS] &= (uint8_t)~QMC_ST_OVL;
+
+    double k = g / 3000.0; // offsets en cuentas de 8G
+
+    /* Campo en el marco del sensor: balanceo en X, despues soft-iron */
+    double f[3] = {
+        s->field_h_gauss * sin(th) * g,
+        s->field_v_gauss * g,
+        s->field_h_gauss * cos(th) * g,
+    };
+    double tilt = s->tilt_deg * M_PI / 180.0 *
+                  sin(2 * M_PI * s->tilt_hz * ((double)t_ns * 1e-9));
+    double fy = f[1] * cos(tilt) - f[2] * sin(tilt);
+    double fz = f[1] * sin(tilt) + f[2] * cos(tilt);
+    f[1] = fy;
+    f[2] = fz;
+
+    for (int i = 0; i < 3; i++) {
+        double m = s->soft[i][0] * f[0] + s->soft[i][1] * f[1] +
+                   s->soft[i][2] * f[2];
+        put_axis(s, i, clamp_axis(s, m + s->off[i] * k + sigma * gauss(s)));
+    }
+    if (s->chip == QMC_SIM_QMC5883L)
+        put16(s, REG_TOUT_LSB, 2500); // 100 LSB/°C, relativo
+    else if (s->chip == QMC_SIM_LIS3MDL)
+        put16(s, LIS_TEMP, 0);        // 8 LSB/°C, 0 = 25 °C
+
+    s->regs[map->status] |= map->drdy;
+    s->last_latch_ns = t_ns;
+    s->samples++;
+}
+
+/* ================= API ================= */
+
+void qmc_sim_reset(struct qmc_sim *s)
+{
+    memset(s, 0, sizeof(*s));
+    soft_reset(s);
+
+    s->field_h_gauss = 0.25;
+    s->field_v_gauss = 0.40;
+    s->off[0] = 400;
+    s->off[1] = 66;
+    s->off[2] = 100;
+    s->noise_lsb = 2.0;
+    for (int i = 0; i < 3; i++)
+        s->soft[i][i] = 1.0;
+    s->rng = 0x2545F491u;
+    s->por_ns = QMC_SIM_POR_NS;
+}
+
+void qmc_sim_set_chip(struct qmc_sim *s, enum qmc_sim_chip chip)
+{
+    s->chip = (uint8_t)chip;
+    soft_reset(s);
+}
+
+uint8_t qmc_sim_addr(const struct qmc_sim *s)
+{
+    return maps[s->chip].addr;
+}
+
+uint32_t qmc_sim_period_ns(const struct qmc_sim *s)
+{
+    uint8_t c1 = s->regs[LIS_CTRL1];
+
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        return (uint32_t)(1000000000000ull /
+                          hmc_odr_mhz[(s->regs[HMC_CRA] >> 2) & 0x07]);
+    case QMC_SIM_LIS3MDL:
+        if (c1 & LIS_FAST_ODR)
+            return 1000000000u / lis_fast_hz[(c1 >> 5) & 0x03];
+        return (uint32_t)(1000000000000ull / lis_odr_mhz[(c1 >> 2) & 0x07]);
+    default:
+        return 1000000000u / odr_hz[(s->regs[REG_CONTROL1] >> 2) & 0x03];
+    }
+}
+
+double qmc_sim_heading(const struct qmc_sim *s, uint64_t t_ns)
+{
+    double t = (double)t_ns * 1e-9;
+    double h = s->heading_deg + s->rate_dps * t;
+
+    if (s->motion)
+        h += s->motion(t);
+    return h;
+}
+
+double qmc_sim_true_heading(const struct qmc_sim *s, uint64_t t_ns)
+{
+    double h = fmod(qmc_sim_heading(s, t_ns), 360.0);
+    if (h < 0) h += 360.0;
+    return h;
+}
+
+void qmc_sim_advance(struct qmc_sim *s, uint64_t now_ns)
+{
+    s->now_ns = now_ns;
+
+    if (!continuous(s))
+        return;
+
+    if (s->freerun) {
+        if (!(s->regs[maps[s->chip].status] & maps[s->chip].drdy))
+            latch_sample(s, now_ns);
+        return;
+    }
+
+    uint64_t period = qmc_sim_period_ns(s);
+
+    /* Saltos largos del reloj (delay de arranque): no simular cada muestra */
+    if (now_ns > s->next_sample_ns + 16 * period)
+        s->next_sample_ns = now_ns - (now_ns - s->next_sample_ns) % period;
+
+    while (s->next_sample_ns <= now_ns) {
+        latch_sample(s, s->next_sample_ns);
+        s->next_sample_ns += period;
+    }
+}
+
+/* Registros escribibles; 1 = soft reset (corta la escritura) */
+static int write_reg(struct qmc_sim *s, uint8_t reg, uint8_t val)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        if (reg == HMC_CRA)
+            s->regs[reg] = val & 0x7F;
+        else if (reg == HMC_CRB)
+            s->regs[reg] = val & 0xE0;
+        else if (reg == HMC_MODE)
+            s->regs[reg] = val & 0x83;
+        return 0;
+    case QMC_SIM_LIS3MDL:
+        if (reg == LIS_CTRL2 && (val & LIS_SOFT_RST))
+            return 1;
+        if (reg >= LIS_CTRL1 && reg <= LIS_CTRL5)
+            s->regs[reg] = val;
+        return 0;
+    default:
+        break;
+    }
+
+    switch (reg) {
+    case REG_CONTROL1:
+        s->regs[reg] = val;
+        break;
+    case REG_CONTROL2:
+        if (val & QMC_CTRL2_SOFT_RST)
+            return 1;
+        s->regs[reg] = val & (QMC_CTRL2_ROL_PNT | QMC_CTRL2_INT_ENB);
+        break;
+    case REG_SETRESET:
+        s->regs[reg] = val;
+        break;
+    default:
+        break; // solo lectura
+    }
+    return 0;
+}
+
+/* Puntero despues de tocar 'reg' (read: con las reglas de lectura) */
+static uint8_t next_ptr(const struct qmc_sim *s, uint8_t reg, int read)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        if (reg == HMC_DATA_END)
+            return HMC_DATA;
+        return (uint8_t)((reg + 1) % maps[s->chip].nregs);
+    case QMC_SIM_LIS3MDL:
+        return s->autoinc ? (uint8_t)((reg + 1) % QMC_SIM_NREGS) : reg;
+    default:
+        if (read && reg == REG_STATUS &&
+            (s->regs[REG_CONTROL2] & QMC_CTRL2_ROL_PNT))
+            return 0x00;
+        return (uint8_t)((reg + 1) % maps[s->chip].nregs);
+    }
+}
+
+/* Leer un registro de datos limpia el dato nuevo (y DOR / ZYXOR) */
+static int is_data(const struct qmc_sim *s, uint8_t reg)
+{
+    switch (s->chip) {
+    case QMC_SIM_HMC5883L:
+        return reg >= HMC_DATA && reg <= HMC_DATA_END;
+    case QMC_SIM_LIS3MDL:
+        return reg >= LIS_DATA && reg <= LIS_DATA_END;
+    default:
+        return reg <= 0x05;
+    }
+}
+
+int qmc_sim_write(struct qmc_sim *s, const uint8_t *data, uint8_t len)
+{
+    if (len == 0)
+        return 0;
+
+    if (s->chip == QMC_SIM_LIS3MDL) {
+        s->autoinc = (data[0] & LIS_AUTO_INC) != 0;
+        s->ptr = (data[0] & (uint8_t)~LIS_AUTO_INC) % QMC_SIM_NREGS;
+    } else {
+        s->ptr = data[0] % maps[s->chip].nregs;
+    }
+
+    for (uint8_t i = 1; i < len; i++) {
+        uint8_t reg = s->ptr;
+        int was_cont = continuous(s);
+        uint32_t old_period = qmc_sim_period_ns(s);
+
+        if (write_reg(s, reg, data[i])) {
+            soft_reset(s);
+            s->por_ns = s->now_ns + QMC_SIM_POR_NS;   // arranca de nuevo
+            return 0;
+        }
+        if (continuous(s) &&
+            (!was_cont || old_period != qmc_sim_period_ns(s)))
+            s->next_sample_ns = s->now_ns + qmc_sim_period_ns(s);
+
+        s->ptr = next_ptr(s, reg, 0);
+    }
+    return 0;
+}
+
+int qmc_sim_read(struct qmc_sim *s, uint8_t *buf, uint8_t len)
+{
+    const struct chip_map *map = &maps[s->chip];
+
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t reg = s->ptr;
+
+        buf[i] = s->regs[reg];
+
+        if (is_data(s, reg))
+            s->regs[map->status] &= (uint8_t)~(map->drdy | map->dor);
+
+        s->ptr = next_ptr(s, reg, 1);
+    }
+    return 0;
+}
@@ -0,0 +1,95 @@
+#ifndef QMC_SIM_H
+#define QMC_SIM_H
+
+/*
+ * Simulador del QMC5883L a nivel de registros (build de Linux).
+ *
+ * Modela el mapa de registros 0x00..0x0D, DRDY/OVL/DOR en 0x06, el
+ * puntero con auto-incremento (y roll-over 0x06 -> 0x00 con ROL_PNT),
+ * el registro de control 0x09 (MODE/ODR/RNG/OSR), SOFT_RST en 0x0A,
+ * el periodo SET/RESET en 0x0B y el chip ID en 0x0D. Durante el power-on
+ * (hasta por_ns) el chip no contesta: hal_host.c da NACK.
+ *
+ * qmc_sim_set_chip() cambia el mapa de registros: el HMC5883L (0x1E:
+ * CRA/CRB/MODE, X/Z/Y en big endian desde 0x03, RDY en 0x09, ID "H43",
+ * puntero que vuelve de 0x08 a 0x03) o el LIS3MDL (0x1C: CTRL1..5 en
+ * 0x20, estado + XYZ desde 0x27, WHO_AM_I 0x3D, auto-incremento solo
+ * con el bit 7 de la direccion). El modelo del campo es el mismo.
+ *
+ * Las muestras salen de un campo horizontal que gira a rate_dps (mas el
+ * recorrido de motion(), si hay) y que se puede balancear alrededor de X
+ * (tilt_deg / tilt_hz), pasado por una matriz soft-iron, con offsets
+ * hard-iron y ruido gaussiano, y se latchean cada 1/ODR del reloj
+ * virtual que le pasa hal_host.c.
+ */
+
+#include <stdint.h>
+
+#define QMC_SIM_NREGS 0x40   // el LIS3MDL llega a 0x33
+
+/* Power-on: la hoja de datos no da un numero firme; supuesto holgado */
+#define QMC_SIM_POR_NS 5000000u
+
+/* Bits del registro de estado 0x06 */
+#define QMC_ST_DRDY 0x01
+#define QMC_ST_OVL  0x02
+#define QMC_ST_DOR  0x04
+
+/* Bits del registro de control 2 (0x0A) */
+#define QMC_CTRL2_INT_ENB  0x01
+#define QMC_CTRL2_ROL_PNT  0x40
+#define QMC_CTRL2_SOFT_RST 0x80
+
+enum qmc_sim_chip {
+    QMC_SIM_QMC5883L,         // el de qmc_sim_reset()
+    QMC_SIM_HMC5883L,
+    QMC_SIM_LIS3MDL,
+};
+
+struct qmc_sim {
+    uint8_t regs[QMC_SIM_NREGS];
+    uint8_t ptr;              // puntero de registro
+    uint8_t chip;             // enum qmc_sim_chip
+    uint8_t autoinc;          // LIS3MDL: bit 7 de la ultima direccion
+
+    uint64_t now_ns;          // ultimo instante visto
+    uint64_t next_sample_ns;  // proxima medicion en modo continuo
+    uint64_t last_latch_ns;   // instante de la ultima medicion
+    uint64_t por_ns;          // NACK antes de esto (power-on)
+
+    /* Modelo del campo */
+    double heading_deg;       // rumbo en t = 0
+    double rate_dps;          // velocidad de giro
+    double (*motion)(double t_s);   // giro extra en grados, o NULL
+    double field_h_gauss;     // componente horizontal (X/Z)
+    double field_v_gauss;     // componente vertical (Y)
+    double tilt_deg;          // amplitud del balanceo alrededor de X
+    double tilt_hz;
+    double soft[3][3];        // soft-iron (identidad tras el reset)
+    int16_t off[3];           // hard-iron en cuentas de 8G del QMC (X, Y, Z)
+    double noise_lsb;         // sigma con OSR=512 (o el promedio mas alto)
+    uint32_t rng;
+
+    int freerun;              // DRDY siempre en 1 (mide techo del bus)
+
+    /* Contadores */
+    uint32_t samples;         // mediciones latcheadas
+    uint32_t skipped;         // mediciones sin leer (DOR)
+    uint32_t drdy_edges;      // flancos de subida del pin DRDY
+};
+
+void qmc_sim_reset(struct qmc_sim *s);
+void qmc_sim_set_chip(struct qmc_sim *s, enum qmc_sim_chip chip);
+uint8_t qmc_sim_addr(const struct qmc_sim *s);   // direccion I2C del chip
+void qmc_sim_advance(struct qmc_sim *s, uint64_t now_ns);
+
+/* data[0] es el registro, el resto se escribe con auto-incremento */
+int qmc_sim_write(struct qmc_sim *s, const uint8_t *data, uint8_t len);
+int qmc_sim_read(struct qmc_sim *s, uint8_t *buf, uint8_t len);
+
+/* Rumbo real (grados) en el instante t: 0..360, o sin dar la vuelta */
+double qmc_sim_true_heading(const struct qmc_sim *s, uint64_t t_ns);
+double qmc_sim_heading(const struct qmc_sim *s, uint64_t t_ns);
+uint32_t qmc_sim_period_ns(const struct qmc_sim *s);
+
+#endif /* QMC_SIM_H */
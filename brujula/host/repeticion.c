@@ -0,0 +1,246 @@
+/*
+ * Repeticion de capturas (ver repeticion.h)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include "repeticion.h"
+#include "gfx_host.h"
+#include "../brujula.h"
+#include "../diezmado.h"
+#include "../escena.h"
+#include "../pantalla.h"
+
+#include <string.h>
+#include <time.h>
+
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t fnv(uint32_t h, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+
+    while (n--)
+        h = (h ^ *b++) * FNV_PRIME;
+    return h;
+}
+
+static void to_pipeline(const struct trama_config *c, struct qmc_pipeline *p)
+{
+    p->profile = c->profile;
+    p->filter = c->filter;
+    memcpy(p->off8, c->off8, sizeof(p->off8));
+    memcpy(p->soft, c->soft, sizeof(p->soft));
+    p->x = (struct rumbo_ema){ c->q[0], c->init & 1 };
+    p->z = (struct rumbo_ema){ c->q[1], (c->init >> 1) & 1 };
+    p->dx = (struct rumbo_ema){ c->q[2], (c->init >> 2) & 1 };
+    p->dz = (struct rumbo_ema){ c->q[3], (c->init >> 3) & 1 };
+    p->px = c->px;
+    p->pz = c->pz;
+}
+
+/* Perfil, filtro y calibracion: lo que el equipo cambia a proposito */
+static int same_config(const struct qmc_pipeline *a,
+                       const struct qmc_pipeline *b)
+{
+    return a->profile == b->profile && a->filter == b->filter &&
+           !memcmp(a->off8, b->off8, sizeof(a->off8)) &&
+           !memcmp(a->soft, b->soft, sizeof(a->soft));
+}
+
+static int same_ema(struct rumbo_ema a, struct rumbo_ema b)
+{
+    return a.q == b.q && a.init == b.init;
+}
+
+static int same_state(const struct qmc_pipeline *a,
+                      const struct qmc_pipeline *b)
+{
+    return same_ema(a->x, b->x) && same_ema(a->z, b->z) &&
+           same_ema(a->dx, b->dx) && same_ema(a->dz, b->dz) &&
+           a->px == b->px && a->pz == b->pz;
+}
+
+/* ================= DIEZMADO ================= */
+
+static struct dec_cfg dec_cfg = { "repeticion", 0, 0, 0.0f };
+static struct dec_filter dec;
+
+static void to_dec_state(const struct trama_decim *r, struct dec_state *s)
+{
+    s->primed = r->primed;
+    s->phase = r->phase;
+    s->taps = r->taps;
+    memcpy(s->hx, r->hx, r->taps * sizeof(s->hx[0]));
+    memcpy(s->hz, r->hz, r->taps * sizeof(s->hz[0]));
+    s->x = (struct rumbo_ema){ r->q[0], r->init & 1 };
+    s->z = (struct rumbo_ema){ r->q[1], (r->init >> 1) & 1 };
+    s->dx = (struct rumbo_ema){ r->q[2], (r->init >> 2) & 1 };
+    s->dz = (struct rumbo_ema){ r->q[3], (r->init >> 3) & 1 };
+    s->px = r->px;
+    s->pz = r->pz;
+    s->cdeg = r->cdeg;
+}
+
+static int same_dec_state(const struct dec_state *a,
+                          const struct dec_state *b)
+{
+    return a->primed == b->primed && a->phase == b->phase &&
+           a->taps == b->taps &&
+           !memcmp(a->hx, b->hx, a->taps * sizeof(a->hx[0])) &&
+           !memcmp(a->hz, b->hz, a->taps * sizeof(a->hz[0])) &&
+           same_ema(a->x, b->x) && same_ema(a->z, b->z) &&
+           same_ema(a->dx, b->dx) && same_ema(a->dz, b->dz) &&
+           a->px == b->px && a->pz == b->pz && a->cdeg == b->cdeg;
+}
+
+/* El FIR del equipo con su estado; -1 si la historia no entra */
+static int dec_apply(const struct trama_decim *r)
+{
+    struct dec_state s;
+
+    if (r->out_hz != dec_cfg.out_hz || r->window_ms != dec_cfg.window_ms ||
+        r->cutoff_hz != dec_cfg.cutoff_hz || !dec.cfg) {
+        dec_cfg.out_hz = r->out_hz;
+        dec_cfg.window_ms = r->window_ms;
+        dec_cfg.cutoff_hz = r->cutoff_hz;
+        if (dec_init(&dec, &dec_cfg, qmc_odr_hz(qmc_active_profile())) != 0)
+            return -1;
+    }
+    to_dec_state(r, &s);
+    return dec_state_set(&dec, &s);
+}
+
+/* Como el loop: solo se dibuja cuando cambia el grado */
+static void render(int heading, struct rep_stats *st)
+{
+    scene_set_heading(heading);
+    scene_set_arrow(heading - 90);
+    scene_render();
+    st->hash = fnv(st->hash, fb_back(),
+                   (size_t)LCD_WIDTH * LCD_HEIGHT * sizeof(uint16_t));
+    st->frames++;
+}
+
+int rep_run(const uint8_t *buf, size_t n, const struct rep_opts *o,
+            struct rep_stats *st)
+{
+    uint8_t type, seq, data[TRAMA_MAX_DATA], len, last = 0;
+    int synced = 0, prev_heading = -1;
+    int decim = 0;        // el config vigente va por el FIR
+    int decim_wait = 0;   // falta su TRAMA_DECIM
+    size_t from = 0;
+
+    memset(st, 0, sizeof(*st));
+    st->hash = FNV_BASIS;
+    memset(&dec, 0, sizeof(dec));
+
+    if (o->render) {
+        fb_init(NULL, 3);
+        gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+        scene_init(NULL);
+    }
+
+    uint64_t t0 = wall_ns();
+    for (size_t i = 0; i < n; i++) {
+        if (buf[i])
+            continue;
+        size_t at = from;
+        from = i + 1;
+
+        if (trama_decode(buf + at, i - at, &type, &seq, data, &len) != 0) {
+            st->bad++;
+            synced = 0;   // pudo ser una muestra
+            continue;
+        }
+        if (st->records && seq != (uint8_t)(last + 1)) {
+            st->gaps++;
+            synced = 0;
+        }
+        last = seq;
+        st->records++;
+
+        if (type == TRAMA_CONFIG && len == TRAMA_CONFIG_LEN) {
+            struct trama_config c;
+            struct qmc_pipeline p, cur;
+
+            trama_unpack_config(data, &c);
+            to_pipeline(&c, &p);
+            qmc_pipeline_get(&cur);
+
+            if (synced && same_config(&p, &cur) && c.decim == decim) {
+                st->diverged += !same_state(&p, &cur);
+            } else if (qmc_pipeline_set(&p) == 0) {
+                st->configs++;
+                synced = 1;
+                decim = c.decim;
+                decim_wait = decim;
+            } else {
+                st->unsupported++;
+                synced = 0;
+            }
+        } else if (type == TRAMA_DECIM) {
+            struct trama_decim r;
+            struct dec_state s, cur;
+
+            if (!synced || !decim)
+                continue;
+            if (trama_unpack_decim(data, len, &r) != 0) {
+                st->unsupported++;
+                synced = 0;
+            } else if (decim_wait) {
+                if (dec_apply(&r) == 0) {
+                    decim_wait = 0;
+                } else {
+                    st->unsupported++;
+                    synced = 0;
+                }
+            } else {
+                to_dec_state(&r, &s);
+                dec_state_get(&dec, &cur);
+                st->diverged += !same_dec_state(&s, &cur);
+            }
+        } else if (type == TRAMA_SAMPLE && len == TRAMA_SAMPLE_LEN) {
+            struct trama_sample s;
+
+            trama_unpack_sample(data, &s);
+            if (!synced || decim_wait) {
+                st->skipped++;
+                continue;
+            }
+
+            int32_t cdeg;
+            if (decim) {
+                struct qmc_sample in = { s.x, s.y, s.z, s.t_us };
+                struct dec_out o;
+
+                dec_process(&dec, &in, 1, &o, 1);
+                cdeg = dec.cdeg;
+            } else {
+                cdeg = qmc_heading_cdeg(s.x, s.y, s.z);
+            }
+            uint16_t out = (uint16_t)cdeg;
+
+            st->samples++;
+            st->mismatches += out != s.heading_cdeg;
+            st->hash = fnv(st->hash, &out, sizeof(out));
+            if (o->out)
+                o->out(o->ctx, &s, cdeg);
+
+            if (o->render && cdeg / 100 != prev_heading) {
+                prev_heading = cdeg / 100;
+                render(prev_heading, st);
+            }
+        }
+    }
+    st->ns = wall_ns() - t0;
+
+    return st->bad ? -1 : 0;
+}
@@ -0,0 +1,56 @@
+#ifndef REPETICION_H
+#define REPETICION_H
+
+/*
+ * Repeticion de capturas (build de Linux).
+ *
+ * Una captura es el stream de telemetria tal cual sale del USB
+ * (tlm_dump -w, ./bench -t): registros de config (trama.h) y muestras
+ * crudas con el rumbo que dio el equipo. rep_run() repone el pipeline con
+ * cada config y pasa cada muestra por qmc_heading_cdeg(), el mismo codigo
+ * del loop, lo mas rapido que puede; con render, ademas, cada rumbo nuevo
+ * por la escena (escena.h) como en el loop. Si el config dice que el
+ * equipo diezmaba, el TRAMA_DECIM que lo sigue repone el FIR (historia,
+ * fase y filtro) y las muestras van por dec_process() en vez de
+ * qmc_heading_cdeg(): el rumbo es la ultima salida.
+ *
+ * Antes del primer config, y despues de un hueco de seq hasta el
+ * proximo, las muestras se saltean: el filtro del equipo vio muestras que
+ * aca faltan. Un config con el mismo perfil, filtro y calibracion no se
+ * aplica, solo se compara el estado del filtro (divergencias).
+ *
+ * La salida (rumbo por muestra y el hash de cada cuadro) entra en un
+ * FNV-1a: dos builds con el mismo hash dan lo mismo bit a bit. 'out'
+ * recibe cada muestra repetida para un diff linea a linea.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../trama.h"
+
+struct rep_opts {
+    int render;
+    void (*out)(void *ctx, const struct trama_sample *s, int32_t cdeg);
+    void *ctx;
+};
+
+struct rep_stats {
+    uint32_t records;
+    uint32_t bad;          // COBS o CRC rotos
+    uint32_t gaps;         // huecos de seq
+    uint32_t samples;      // repetidas
+    uint32_t skipped;      // sin config vigente
+    uint32_t configs;      // aplicados (arranque, cambio o despues de hueco)
+    uint32_t unsupported;  // perfil, filtro o diezmado que no entra
+    uint32_t diverged;     // config igual, estado del filtro o FIR distinto
+    uint32_t mismatches;   // rumbo distinto al del equipo
+    uint32_t frames;
+    uint32_t hash;
+    uint64_t ns;           // reloj de pared
+};
+
+int rep_run(const uint8_t *buf, size_t n, const struct rep_opts *o,
+            struct rep_stats *st);
+
+#endif /* REPETICION_H */
@@ -0,0 +1,123 @@
+/*
+ * Repite una captura de la telemetria por el pipeline del rumbo
+ * (repeticion.h), lo mas rapido que da el PC.
+ *
+ * En stderr: muestras repetidas, cuantas dan distinto que en el equipo,
+ * muestras/s y el hash de la salida. Dos builds se comparan por el hash
+ * o, linea a linea, con -o: t_us,x,y,z,rumbo del equipo,rumbo repetido
+ * (centesimas).
+ *
+ *   ./tlm_dump -q -w sesion.bin /dev/ttyACM0   captura
+ *   ./replay -o a.csv sesion.bin               build A
+ *   ./replay -o b.csv sesion.bin && diff a.csv b.csv
+ *
+ * Uso: ./replay [-r] [-n veces] [-o salida.csv] captura
+ *
+ * -r dibuja la escena con cada rumbo nuevo (entra en el hash); -n repite
+ * la captura entera n veces para medir.
+ */
+#include "repeticion.h"
+#include "../brujula.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void csv_line(void *ctx, const struct trama_sample *s, int32_t cdeg)
+{
+    fprintf(ctx, "%u,%d,%d,%d,%u,%d\n", s->t_us, s->x, s->y, s->z,
+            s->heading_cdeg, cdeg);
+}
+
+static uint8_t *load(const char *path, size_t *n)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    size_t cap = 0;
+
+    if (!f)
+        return NULL;
+    *n = 0;
+    for (;;) {
+        if (*n == cap) {
+            uint8_t *p = realloc(buf, cap = cap ? cap * 2 : 65536);
+            if (!p) {
+                free(buf);
+                fclose(f);
+                return NULL;
+            }
+            buf = p;
+        }
+        size_t got = fread(buf + *n, 1, cap - *n, f);
+        if (!got)
+            break;
+        *n += got;
+    }
+    fclose(f);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    struct rep_opts o = { 0 };
+    struct rep_stats st;
+    const char *path = NULL, *csv = NULL;
+    unsigned times = 1;
+    uint64_t ns = 0;
+    size_t n;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r"))
+            o.render = 1;
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            times = (unsigned)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            csv = argv[++i];
+        else
+            path = argv[i];
+    }
+    if (!path || !times) {
+        fprintf(stderr, "uso: %s [-r] [-n veces] [-o salida.csv] captura\n",
+                argv[0]);
+        return 1;
+    }
+
+    uint8_t *buf = load(path, &n);
+    if (!buf) {
+        perror(path);
+        return 1;
+    }
+
+    system_init();
+    for (unsigned k = 0; k < times; k++) {
+        FILE *f = NULL;
+
+        if (csv && k == 0) {
+            f = fopen(csv, "w");
+            if (!f) {
+                perror(csv);
+                return 1;
+            }
+            o.out = csv_line;
+            o.ctx = f;
+        }
+        rep_run(buf, n, &o, &st);
+        ns += st.ns;
+        if (f) {
+            fclose(f);
+            o.out = NULL;
+        }
+    }
+    free(buf);
+
+    fprintf(stderr,
+            "%u registros, %u rotos, %u huecos\n"
+            "%u muestras repetidas, %u salteadas, %u configs "
+            "(%u fuera de tabla), %u divergencias\n"
+            "%u rumbos distintos al equipo, %u cuadros\n"
+            "hash %08x, %.0f muestras/s\n",
+            st.records, st.bad, st.gaps, st.samples, st.skipped, st.configs,
+            st.unsupported, st.diverged, st.mismatches, st.frames, st.hash,
+            ns ? (double)st.samples * times * 1e9 / ns : 0.0);
+    return st.bad ? 2 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Decodificador de la telemetria binaria (trama.h).
+ *
+ * Lee el stream de la placa de un archivo, de stdin o del puerto del CDC
+ * (/dev/ttyACM0, un pty) y escribe un CSV por registro en stdout; al
+ * final, en stderr, cuantos registros, cuantos rotos y los huecos de seq
+ * (registros que la placa descarto o que se perdieron en el camino).
+ *
+ * -w guarda los bytes tal cual (desde el primer registro entero): es la
+ * captura que repite host/replay.
+ *
+ * Uso: ./tlm_dump [-q] [-w captura] [archivo | /dev/ttyACM0]
+ *      (sin archivo: stdin)
+ */
+#define _DEFAULT_SOURCE
+
+#include "../trama.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+struct dump {
+    int quiet;
+    uint8_t frame[TRAMA_MAX * 2];
+    size_t n;
+    int overflow;      // frame mas largo que cualquier registro
+
+    int have_seq;
+    uint8_t last_seq;
+    uint64_t t_hi;     // t_us de 32 bits desenrollado
+    uint32_t t_last;
+
+    unsigned long records, bad, gaps, lost;
+    int have_status;
+    uint32_t dropped;  // contador de la placa, del ultimo registro de estado
+};
+
+static uint64_t unwrap(struct dump *d, uint32_t t)
+{
+    if (t < d->t_last)
+        d->t_hi += 1ull << 32;
+    d->t_last = t;
+    return d->t_hi | t;
+}
+
+static void record(struct dump *d)
+{
+    uint8_t type, seq, data[TRAMA_MAX_DATA], len;
+
+    if (d->overflow || !d->n ||
+        trama_decode(d->frame, d->n, &type, &seq, data, &len) != 0) {
+        d->bad++;
+        return;
+    }
+
+    if (d->have_seq && seq != (uint8_t)(d->last_seq + 1)) {
+        d->gaps++;
+        d->lost += (uint8_t)(seq - d->last_seq - 1);
+    }
+    d->have_seq = 1;
+    d->last_seq = seq;
+    d->records++;
+
+    if (type == TRAMA_SAMPLE && len == TRAMA_SAMPLE_LEN) {
+        struct trama_sample s;
+        trama_unpack_sample(data, &s);
+        if (!d->quiet)
+            printf("S,%llu,%d,%d,%d,%u.%02u\n",
+                   (unsigned long long)unwrap(d, s.t_us), s.x, s.y, s.z,
+                   s.heading_cdeg / 100u, s.heading_cdeg % 100u);
+    } else if (type == TRAMA_STATUS && len == TRAMA_STATUS_LEN) {
+        struct trama_status s;
+        trama_unpack_status(data, &s);
+        d->have_status = 1;
+        d->dropped = s.dropped;
+        if (!d->quiet)
+            printf("E,%llu,%u,%u,%u,%u\n",
+                   (unsigned long long)unwrap(d, s.t_us), s.dropped,
+                   s.high_water, s.profile, s.filter);
+    } else if (type == TRAMA_CONFIG && len == TRAMA_CONFIG_LEN) {
+        struct trama_config c;
+        trama_unpack_config(data, &c);
+        if (!d->quiet)
+            printf("C,%u,%u,%u\n", c.profile, c.filter, c.decim);
+    } else if (type == TRAMA_DECIM) {
+        struct trama_decim r;
+        if (trama_unpack_decim(data, len, &r) != 0)
+            d->bad++;
+        else if (!d->quiet)
+            printf("D,%u,%u,%u\n", r.out_hz, r.taps, r.cdeg);
+    } else {
+        d->bad++;
+    }
+}
+
+static void feed(struct dump *d, const uint8_t *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (!p[i]) {
+            record(d);
+            d->n = 0;
+            d->overflow = 0;
+        } else if (d->n < sizeof(d->frame)) {
+            d->frame[d->n++] = p[i];
+        } else {
+            d->overflow = 1;
+        }
+    }
+}
+
+/* Puerto serie: crudo, sin eco ni traduccion de fin de linea */
+static void raw_tty(int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static struct dump d;
+    const char *path = NULL;
+    FILE *cap = NULL;
+    uint8_t buf[4096];
+    int fd = 0;
+    ssize_t n;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-q")) {
+            d.quiet = 1;
+        } else if (!strcmp(argv[i], "-w") && i + 1 < argc) {
+            cap = fopen(argv[++i], "wb");
+            if (!cap) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (path) {
+        fd = open(path, O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            perror(path);
+            return 1;
+        }
+    }
+    if (isatty(fd))
+        raw_tty(fd);
+
+    if (!d.quiet)
+        printf("# S,t_us,x,y,z,heading  E,t_us,dropped,high_water,profile,"
+               "filter  C,profile,filter\n");
+
+    /* Enchufado a la placa se puede empezar a mitad de un registro: hasta
+     * el primer 0x00 se descarta. Un archivo empieza en un registro. */
+    int synced = !isatty(fd);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        size_t from = 0;
+        if (!synced) {
+            while (from < (size_t)n && buf[from])
+                from++;
+            if (from == (size_t)n)
+                continue;
+            from++;
+            synced = 1;
+        }
+        feed(&d, buf + from, (size_t)n - from);
+        if (cap)
+            fwrite(buf + from, 1, (size_t)n - from, cap);
+    }
+    if (cap)
+        fclose(cap);
+
+    /* seq es de 8 bits: un hueco de mas de 255 registros se ve modulo
+     * 256; el contador de la placa es el que vale */
+    fprintf(stderr, "%lu registros, %lu rotos, %lu huecos (%lu perdidos)",
+            d.records, d.bad, d.gaps, d.lost);
+    if (d.have_status)
+        fprintf(stderr, ", la placa descarto %u", d.dropped);
+    fputc('\n', stderr);
+    return d.bad ? 2 : 0;
+}
@@ -17,11 +17,11 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
- #include <math.h>
+
  #include <stdint.h>
  #include <stdio.h>
 
-
+ #include <libopencm3/cm3/cortex.h>
  #include <libopencm3/cm3/nvic.h>
  #include <libopencm3/cm3/systick.h>
  #include <libopencm3/stm32/rcc.h>
@@ -34,338 +34,336 @@
  #include <libopencm3-plus/hw-accesories/lcd/lcd-spi.h>
  #include <libopencm3-plus/hw-accesories/sdram_stm32f429idiscovery.h>
 
- #include <libopencm3/stm32/gpio.h>
- #include <libopencm3/stm32/i2c.h>
- 
- #include <libopencm3-plus/newlib/syscall.h>
- #include <libopencm3-plus/newlib/devices/cdcacm.h>
+ #include "brujula.h"
+ #include "adquisicion.h"
+ #include "arranque.h"
+ #include "calibracion.h"
+ #include "cola.h"
+ #include "diezmado.h"
+ #include "escena.h"
+ #include "fusion.h"
+ #include "giro.h"
+ #include "pantalla.h"
+ #include "planificador.h"
+ #include "recuperacion.h"
+ #include "interfaz.h"
+ #include "medida.h"
+ #include "sprites.h"
+ #include "telemetria.h"
+ #include "tiempo.h"
 
+ #define SLEEP_TIME 2000
 
-//----- I2C------
- /* ================= CONFIG ================= */
- 
- #define QMC_ADDR 0x0D
- 
- #define QMC_REG_X_LSB     0x00
- #define QMC_REG_STATUS    0x06
- #define QMC_REG_CONTROL   0x09
- #define QMC_REG_SETRESET  0x0B
- 
- /* Hard-iron offsets (tus datos reales) */
- #define OFF_X  400
- #define OFF_Y   66
- #define OFF_Z  100
- #define M_PI 3.14159265358979323846
+ /*
+  * Con BRUJULA_SPRITE_ARROW la flecha apunta al norte y gira con el
+  * rumbo, pre-rasterizada cada ARROW_STEP grados (ver sprites.h).
+  */
+ #ifdef BRUJULA_SPRITE_ARROW
+ #define ARROW_STEP 2
+ static struct sprite_cache arrow;
+ #endif
 
- #define TIMEOUT 1000000
+ /*
+  * Calibracion en linea: cada muestra entra al ajuste y cada CAL_EVERY
+  * se resuelve; si convergio y ajusta mejor que la vigente, se aplica.
+  */
+ #define CAL_EVERY 100
 
- static float fx = 0.0f;   // X filtrado
-static float fz = 0.0f;   // Z filtrado
-static const float ALPHA = 0.01f;  // 0<ALPHA<=1 (más pequeño = más suave)
+ /*
+  * Telemetria (telemetria.h): cada muestra va al USB en binario; con
+  * BRUJULA_TELEMETRY system_init() levanta el CDC. Host: host/tlm_dump.
+  */
+ #define TLM_STATUS_US 1000000u
 
- 
- /* ================= DELAY ================= */
- 
-  void delay( uint32_t n)
- {
-     while (n--) __asm__("nop");
+ /* El filtro se guarda cada minuto (si cambio): ~4 dias por sector */
+ #define FILTER_SAVE_US 60000000u
+
+ /* Con BRUJULA_MEDIDA: tabla de medida.h por la consola del USB */
+ #define MEDIDA_DUMP_US 10000000u
+
+ static struct cal_state cal;
+ static float cal_err_applied = 1.0f;
+ static int cal_dirty;  // la guarda housekeeping: el almacen puede tardar
+
+ static void calibrate(const struct qmc_sample *s) {
+   struct cal_result r;
+
+   cal_add(&cal, s->x, s->y, s->z);
+   if (cal.n % CAL_EVERY)
+     return;
+
+   if (cal_solve(&cal, CAL_AUTO, &r) == 0 && r.converged &&
+       r.fit_err < cal_err_applied) {
+     qmc_set_calibration(&r);
+     cal_dirty = 1;
+     cal_err_applied = r.fit_err;
+   }
  }
- 
- /* ================= USB CDC ================= */
- 
-  void system_init(void)
- {
-     rcc_clock_setup_pll(
-         &rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
- 
+
+ /*
+  * Con el giroscopo el rumbo que se muestra es el de la fusion (fusion.h):
+  * el FIFO se vacia cada GYRO_READ_US y cada muestra del magnetometro lo
+  * corrige. Sin giroscopo queda el EMA de qmc_heading_cdeg().
+  */
+ #define GYRO_READ_US 20000u
+ static int gyro_ok;
+ static struct fusion fus;
+ static struct gyro_sample gyro_buf[GYRO_FIFO];
+
+ static void gyro_service(void) {
+   int n = gyro_read_fifo(gyro_buf, GYRO_FIFO);
+
+   for (int i = 0; i < n; i++)
+     fusion_gyro(&fus, gyro_yaw_dps(&gyro_buf[i]), gyro_buf[i].t_us);
  }
- 
-  void init_console(void)
- {
-     setvbuf(stdout, NULL, _IONBF, 0);
+
+ /*
+  * Muestras de la adquisicion (desde la interrupcion) a la tarea 'sensor':
+  * cola SPSC, sin cortar interrupciones. La tarea las saca todas juntas.
+  */
+ static struct cola samples;
+ static struct qmc_sample batch[COLA_LEN];
+
+ /*
+  * Tareas (planificador.h). El DRDY despierta a 'sensor'; lo demas es
+  * periodico y el plazo es el periodo. Sin nada listo, WFI.
+  */
+ #define SENSOR_DEADLINE_US 5000u    // antes de la proxima muestra a 200 Hz
+ #define POLL_US            5000u    // acq_service(): solo si cayo a ACQ_POLL
+ #define FRAME_US          50000u    // 20 cuadros/s como mucho
+ #define TLM_US             5000u    // 4 KB de cola: sobra
+ #define HOUSEKEEPING_US  100000u
+ #define REC_US             5000u    // rec_service(): nada si no hay falla
+
+ static int heading = -999;  // nada que mostrar hasta la primera muestra
+ static int prev_heading = -999;
+ static int prev_degraded;
+ static uint64_t tlm_status_us;
+ static uint64_t filter_saved_us;
+ static uint64_t heading_t_us;  // DRDY de la muestra del rumbo (MED_E2E)
+ static const struct acq_config acq_cfg;
+
+ /*
+  * Con BRUJULA_DIEZMADO el sensor corre a 200 Hz y el lote entero pasa
+  * por el FIR de diezmado.h, que saca un rumbo cada 20 ms (dec_display);
+  * el cuadro (FRAME_US) dibuja el mas nuevo. Cada muestra va a la
+  * telemetria con la ultima salida hasta ella, y el config (con el
+  * estado del FIR) sale antes del lote: la calibracion va primero, asi
+  * el lote entero corre con el mismo pipeline y host/repeticion.h lo
+  * repite bit a bit.
+  */
+ #ifdef BRUJULA_DIEZMADO
+ static struct dec_filter dec;
+ static struct dec_out dec_out[COLA_LEN];
+ static int32_t dec_cdeg;
+
+ static void sensor_task(void) {
+   int n = cola_drain(&samples, batch, COLA_LEN);
+
+   for (int i = 0; i < n; i++)
+     calibrate(&batch[i]);
+   tlm_config();
+
+   int m = dec_process(&dec, batch, n, dec_out, COLA_LEN);
+   if (m) {
+     heading = dec_out[m - 1].cdeg / 100;
+     heading_t_us = dec_out[m - 1].t_us;
+     boot_mark(BOOT_HEADING);
+   }
+
+   for (int i = 0, k = 0; i < n; i++) {
+     const struct qmc_sample *s = &batch[i];
+
+     while (k < m && dec_out[k].t_us <= s->t_us)
+       dec_cdeg = dec_out[k++].cdeg;
+     tlm_sample(s, dec_cdeg);
+
+     if (gyro_ok)
+       fusion_mag(&fus, qmc_heading_raw_cdeg(s->x, s->y, s->z) / 100.0f,
+                  s->t_us);
+   }
  }
- 
- /* ================= I2C SETUP ================= */
+ #else
+ /* Todas las muestras pasan por el filtro; se dibuja la ultima */
+ static void sensor_task(void) {
+   int n = cola_drain(&samples, batch, COLA_LEN);
 
-  void i2c_setup(void)
- {
-     rcc_periph_clock_enable(RCC_GPIOB);
-     rcc_periph_clock_enable(RCC_I2C1);
- 
-     /* PB6=SCL, PB7=SDA */
-     gpio_mode_setup(GPIOB, GPIO_MODE_AF,
-                     GPIO_PUPD_NONE, GPIO8 | GPIO9);
-     gpio_set_output_options(GPIOB, GPIO_OTYPE_OD,
-                             GPIO_OSPEED_50MHZ, GPIO8 | GPIO9);
-     gpio_set_af(GPIOB, GPIO_AF4, GPIO8 | GPIO9);
- 
-     i2c_reset(I2C1);
-     i2c_peripheral_disable(I2C1);
- 
-     i2c_set_speed(I2C1, i2c_speed_sm_100k,
-                   rcc_apb1_frequency / 1000000);
- 
-     i2c_peripheral_enable(I2C1);
+   for (int i = 0; i < n; i++) {
+     const struct qmc_sample *s = &batch[i];
+
+     calibrate(s);
+     tlm_config();  // si cambio el pipeline, antes de la muestra
+     int32_t cdeg = qmc_heading_cdeg(s->x, s->y, s->z);
+     heading = cdeg / 100;
+     heading_t_us = s->t_us;
+     boot_mark(BOOT_HEADING);
+     tlm_sample(s, cdeg);  // a la cola del USB, no espera
+
+     if (gyro_ok)
+       fusion_mag(&fus, qmc_heading_raw_cdeg(s->x, s->y, s->z) / 100.0f,
+                  s->t_us);
+   }
  }
- 
- /* ================= I2C WRITE (timeout) ================= */
- 
-  int i2c_write_reg_timeout(uint8_t addr, uint8_t reg, uint8_t val)
- {
-     uint32_t t;
- 
-     i2c_send_start(I2C1);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_SB) break;
-     if (!t) goto err;
- 
-     i2c_send_7bit_address(I2C1, addr, I2C_WRITE);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_ADDR) break;
-     if (!t) goto err;
-     (void)I2C_SR2(I2C1);
- 
-     i2c_send_data(I2C1, reg);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_BTF) break;
-     if (!t) goto err;
- 
-     i2c_send_data(I2C1, val);
-     for (t = TIMEOUT; t; t--)
-         if (I2C_SR1(I2C1) & I2C_SR1_BTF) break;
-     if (!t) goto err;
- 
-     i2c_send_stop(I2C1);
-     return 0;
- 
- err:
-     i2c_send_stop(I2C1);
-     return -1;
+ #endif
+
+ static void poll_task(void) {
+   acq_service();
  }
- 
- /* ================= I2C READ ================= */
- 
-  uint8_t i2c_read_reg(uint8_t addr, uint8_t reg)
- {
-     uint8_t val = 0;
-     i2c_transfer7(I2C1, addr, &reg, 1, &val, 1);
-     return val;
+
+ static void gyro_task(void) {
+   gyro_service();
  }
- 
- /* ================= QMC INIT ================= */
- 
-  void qmc_init(void)
- {
-     
-     delay(15000000);
- 
 
-     while (i2c_write_reg_timeout(QMC_ADDR,
-                                 QMC_REG_SETRESET, 0x01) != 0)
-         delay(3000000);
- 
-    
-     while (i2c_write_reg_timeout(QMC_ADDR,
-                                  QMC_REG_CONTROL, 0x11) != 0)
-         delay(3000000);
+ static void render_task(void) {
+   if (gyro_ok && fus.init)
+     heading = (int)fusion_heading(&fus, time_us());
+   if (heading == prev_heading && rec_degraded() == prev_degraded)
+     return;
+
+   if (heading != -999) {  // sin muestra todavia: solo la marca
+     scene_set_heading(heading);
+     scene_set_arrow(heading - 90);  // solo con sprites
+   }
+   scene_set_degraded(rec_degraded());
+   scene_render();  // solo lo que cambio
+   fb_set_sample(heading_t_us);
+   fb_swap();
+   prev_heading = heading;
+   prev_degraded = rec_degraded();
  }
- 
- /* ================= READ XYZ ================= */
- 
- 
 
- int qmc_read_xyz(int16_t *x, int16_t *y, int16_t *z)
- {
-     uint8_t status = i2c_read_reg(QMC_ADDR, QMC_REG_STATUS);
- 
-     if (!(status & 0x01))
-         return 0; // No hay dato nuevo
- 
-     uint8_t xl = i2c_read_reg(QMC_ADDR, 0x00);
-     uint8_t xh = i2c_read_reg(QMC_ADDR, 0x01);
-     uint8_t yl = i2c_read_reg(QMC_ADDR, 0x02);
-     uint8_t yh = i2c_read_reg(QMC_ADDR, 0x03);
-     uint8_t zl = i2c_read_reg(QMC_ADDR, 0x04);
-     uint8_t zh = i2c_read_reg(QMC_ADDR, 0x05);
- 
-     *x = (int16_t)((xh << 8) | xl);
-     *y = (int16_t)((yh << 8) | yl);
-     *z = (int16_t)((zh << 8) | zl);
- 
-     return 1;
+ static void tlm_task(void) {
+   tlm_service();
  }
 
- qmc_read_heading(int *heading)
-{
-    int16_t x, y, z;
-    static int initialized = 0;
-
-    if (!qmc_read_xyz(&x, &y, &z))
-        return 0;   // Sin dato nuevo
-
-    x -= OFF_X;
-    y -= OFF_Y;
-    z -= OFF_Z;
-
-    if (!initialized) {
-        fx = x;
-        fz = z;
-        initialized = 1;
-    } else {
-        fx += ALPHA * ((float)x - fx);
-        fz += ALPHA * ((float)z - fz);
-    }
-
-    float h = atan2f(fx, fz) * 180.0f / M_PI;
-    if (h < 0) h += 360.0f;
-
-    *heading = (int)h;
-    return 1;
-}
- #define SLEEP_TIME 2000
- 
- // Draw arrow
- void draw_arrow_center(int16_t ax, int16_t ay, int16_t bx, int16_t by, int16_t cx, int16_t cy, uint16_t color){
-   // Draw triangle0
-   gfx_fillTriangle(ax, ay, cx-30, cy, cx+30, cy, color);
-   // Draw triangle1
-   gfx_fillTriangle(bx, by, cx-30, cy, cx, cy, color);
-   // Draw triangle2
-   gfx_fillTriangle(bx+84, by, cx+30, cy, cx, cy, color);
- 
-   // Draw left line
-   gfx_drawLine(ax, ay, bx, by, LCD_BLACK);
-   gfx_drawLine(ax-1, ay, bx-1, by+1, LCD_BLACK);
-   gfx_drawLine(ax-2, ay, bx-2, by+1, LCD_BLACK);
-   gfx_drawLine(ax-3, ay, bx-3, by+1, LCD_BLACK);
- 
-   // Draw middle line
-   gfx_drawLine(ax, ay-2, cx, cy, LCD_BLACK);
-   gfx_drawLine(ax-1, ay-1, cx-1, cy, LCD_BLACK);
-   gfx_drawLine(ax+1, ay-1, cx+1, cy, LCD_BLACK);
-  
-   // Draw right line
-   gfx_drawLine(ax, ay, bx+84, by, LCD_BLACK);
-   gfx_drawLine(ax+1, ay, bx+85, by+1, LCD_BLACK);
-   gfx_drawLine(ax+2, ay, bx+86, by+1, LCD_BLACK);
-   gfx_drawLine(ax+3, ay, bx+87, by+1, LCD_BLACK);
- 
-   // Draw down left line
-   gfx_drawLine(bx, by, cx, cy, LCD_BLACK);
-   gfx_drawLine(bx+1, by, cx, cy+1, LCD_BLACK);
-   gfx_drawLine(bx+2, by, cx, cy+2, LCD_BLACK);
-   gfx_drawLine(bx+3, by, cx, cy+3, LCD_BLACK);
- 
-   // Draw down right line
-   gfx_drawLine(bx+84, by, cx, cy,   LCD_BLACK);
-   gfx_drawLine(bx+83, by, cx, cy+1, LCD_BLACK);
-   gfx_drawLine(bx+82, by, cx, cy+2, LCD_BLACK);
-   gfx_drawLine(bx+81, by, cx, cy+3, LCD_BLACK);
+ static void rec_task(void) {
+   rec_service();
  }
- 
- 
- void draw_compass_UI(void){
-   // Set display color
-   gfx_fillScreen(LCD_WHITE);
- 
-   // BUSSOLA!!
-   gfx_setTextColor(LCD_BLACK, LCD_WHITE);
-   gfx_setCursor(60, 10);
-   gfx_puts("BUSSOLA!");
- 
-   // Made by Josue & Gabriel
-   gfx_setTextColor(LCD_YELLOW, LCD_WHITE);
-   gfx_setCursor(20, 40);
-   gfx_setTextSize(1);
-   gfx_puts("Fatto da Josue & Gabriel");
- 
-   gfx_setTextSize(2);
- 
-   // Draw centered cross
-   gfx_drawFastVLine(120, 55, 210, LCD_GREEN);
-   gfx_drawFastHLine(15, 160, 210, LCD_GREEN);
- 
-   // Draw centered circles
-   gfx_drawCircle(120, 160, 85, LCD_BLACK);
-   gfx_drawCircle(120, 160, 100, LCD_BLACK);
- 
-   // Draw arrows
-   draw_arrow_center(120, 105, 78, 200, 120, 170, LCD_GREEN);
- 
-   // Draw angle symbol
-   gfx_drawCircle(150, 290, 2, LCD_GREEN);
-   
+
+ static void housekeeping_task(void) {
+   struct acq_stats acq;
+
+   if (time_us() - tlm_status_us >= TLM_STATUS_US) {
+     tlm_status();
+     tlm_status_us = time_us();
+   }
+
+   /* El borrado de la flash corre de fondo; lo que espera sale despues */
+   qmc_state_poll();
+   if (cal_dirty) {
+     qmc_state_save(QMC_STATE_CAL);
+     cal_dirty = 0;
+   }
+   if (time_us() - filter_saved_us >= FILTER_SAVE_US) {
+     qmc_state_save(QMC_STATE_FILTER);
+     filter_saved_us = time_us();
+   }
+
+ #ifdef BRUJULA_MEDIDA
+   static uint64_t med_dump_us;
+   if (time_us() - med_dump_us >= MEDIDA_DUMP_US) {
+     med_dump();
+     med_dump_us = time_us();
+   }
+ #endif
+
+   static int boot_reported;
+   if (!boot_reported && boot_time_us(BOOT_HEADING)) {
+     boot_report();
+     boot_reported = 1;
+   }
+
+   acq_stats_get(&acq);
+   if (acq.consec_failures > 20 && !rec_degraded())
+     rec_start(&acq_cfg);  // sigue en t_rec, sin frenar el dibujo
  }
- 
- void draw_cardinal_points(int north_deg_value){
-   int north_deg = north_deg_value; 
-   int south_deg = north_deg + 180;
-   int east_deg = north_deg - 90;
-   int west_deg = north_deg + 90;
- 
-   gfx_drawChar(120 + (cos(degrees_to_radians(north_deg)) * 100),
-               160 - (sin(degrees_to_radians(north_deg)) * 100), 78, LCD_GREEN, LCD_WHITE, 2);
- 
-   // South
-   gfx_drawChar(120 + (cos(degrees_to_radians(south_deg)) * 100),
-                160 - (sin(degrees_to_radians(south_deg)) * 100), 83, LCD_BLACK, LCD_WHITE, 2);
- 
-   // East
-   gfx_drawChar(120 + (cos(degrees_to_radians(east_deg)) * 100),
-               160 - (sin(degrees_to_radians(east_deg)) * 100), 69, LCD_BLACK, LCD_WHITE, 2);
- 
-   // West
-   gfx_drawChar(120 + (cos(degrees_to_radians(west_deg)) * 100),
-                160 - (sin(degrees_to_radians(west_deg)) * 100), 87, LCD_BLACK, LCD_WHITE, 2);
- 
-   // Drawing angle
-   gfx_setCursor(95, 290);
-   gfx_setTextColor(LCD_GREEN, LCD_WHITE);
-   char buffer[16];
-   snprintf(buffer, sizeof(buffer), "%03d", north_deg);
-   gfx_puts(buffer);
- 
- 
+
+ static struct sched_task t_sensor = {
+   .name = "sensor", .run = sensor_task, .deadline_us = SENSOR_DEADLINE_US,
+ };
+ static struct sched_task t_poll = {
+   .name = "poll", .run = poll_task, .period_us = POLL_US,
+ };
+ static struct sched_task t_gyro = {
+   .name = "gyro", .run = gyro_task, .period_us = GYRO_READ_US,
+ };
+ static struct sched_task t_render = {
+   .name = "render", .run = render_task, .period_us = FRAME_US,
+ };
+ static struct sched_task t_tlm = {
+   .name = "tlm", .run = tlm_task, .period_us = TLM_US,
+ };
+ static struct sched_task t_rec = {
+   .name = "rec", .run = rec_task, .period_us = REC_US,
+ };
+ static struct sched_task t_house = {
+   .name = "house", .run = housekeeping_task, .period_us = HOUSEKEEPING_US,
+ };
+
+ static void on_sample(const struct qmc_sample *s) {
+   cola_push(&samples, s);
+   sched_wake(&t_sensor);
  }
+
+ static const struct acq_config acq_cfg = {
+   .mode = ACQ_DRDY,
+   .tick_hz = 1000,
+   .trigger_ticks = 150,   // watchdog: 1.5 periodos a 10 Hz
+   .timeout_ticks = 5,
+   .retries = 2,
+   .on_sample = on_sample,
+ };
  
  
- void clock_setup(void) {
-   const uint32_t one_milisecond_rate = 168000;
-   /* Base board frequency, set to 168Mhz */
-   //rcc_clock_setup_pll(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
- 
-   /* clock rate / 168000 to get 1mS interrupt rate */
-   systick_set_reload(one_milisecond_rate);
-   systick_set_clocksource(STK_CSR_CLKSOURCE_AHB);
-   systick_counter_enable();
- 
-   /* this done last */
-   systick_interrupt_enable();
+ /*
+  * Arranque (arranque.h): la SDRAM y el LCD se levantan mientras el QMC
+  * hace su power-on, y el splash sale antes de tocar el QMC.
+  */
+ static void boot_memory(void) {
+   sdram_init();
  }
- 
+
+ static void boot_display(void) {
+   lcd_spi_init();
+   fb_init(NULL, 3);  // triple buffer: el loop no espera al LCD
+   gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+ }
+
+ static void boot_splash(void) {
+   gfx_fillScreen(LCD_GREY);
+   gfx_setCursor(78, 152);
+   gfx_setTextColor(LCD_BLACK, LCD_GREY);
+   gfx_setTextSize(2);
+   gfx_puts("BRUJULA");
+ }
+
+ static const struct boot_steps boot_steps = {
+   .memory = boot_memory, .display = boot_display, .splash = boot_splash,
+ };
+
  /*
   * This is our example, the heavy lifing is actually in lcd-spi.c but
   * this drives that code.
   */
  int main(void) {
 
-    system_init();
+    system_init();  // 168 MHz + SysTick de 1 ms (tiempo.h)
     //init_console();
     i2c_setup();
 
-    qmc_init();
-
+    /* Perfil, calibracion y filtro de la ultima vez (almacen.h) */
+    qmc_state_load();
+ #ifdef BRUJULA_DIEZMADO
+    /* Forzado por el build: no se guarda, la flash sigue con el elegido */
+    qmc_set_profile(&qmc_profiles[QMC_PROFILE_200HZ]);
+    boot_run(&boot_steps);  // SDRAM y LCD durante el power-on del QMC
+ #else
+    boot_run(&boot_steps);  // SDRAM y LCD durante el power-on del QMC
+    qmc_state_save(QMC_STATE_PROFILE);
+ #endif
 
-   clock_setup();
-  // printf("Antes de sdram_init()\n\r");
-   sdram_init();
-  // delay(3000000);
-
-   //printf("Despues de sdram_init()\n\r");
-   lcd_spi_init();
-   //msleep(SLEEP_TIME);
-   gfx_init(lcd_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
-   gfx_fillScreen(LCD_GREY);
+   gyro_ok = gyro_init() == 0;  // comparte SPI5 con el LCD
+   fusion_init(&fus, FUSION_TAU_S);
    //msleep(SLEEP_TIME);
    
    // original cardinal point degrees
@@ -378,38 +376,37 @@ static const float ALPHA = 0.01f;  // 0<ALPHA<=1 (más pequeño = más suave)
    gfx_setTextColor(LCD_BLACK, LCD_WHITE);
    gfx_setTextSize(2);
 
-   int heading;
-   int prev_heading = -999;
-   int fail_count = 0;
-
-
-   draw_compass_UI();  // DIBUJAR FONDO UNA SOLA VEZ
-   lcd_show_frame();
-   
-   while (1)
-   
-   {draw_compass_UI();
+#ifdef BRUJULA_SPRITE_ARROW
+   sprite_cache_build(&arrow, ARROW_STEP, 120, 160, draw_arrow_rotated);
+   scene_init(&arrow);
+#else
+   scene_init(NULL);  // DIBUJAR FONDO UNA SOLA VEZ
+#endif
+   scene_set_heading(0);
+   scene_set_arrow(-90);
+   scene_render();
+   fb_swap();
 
+   cal_reset(&cal);
+   cola_init(&samples);
+   tlm_init();
+ #ifdef BRUJULA_DIEZMADO
+   dec_init(&dec, &dec_display, qmc_odr_hz(qmc_active_profile()));
+   tlm_set_decim(&dec);
+ #endif
+   filter_saved_us = time_us();
+   tlm_status_us = time_us();
 
-      
-       if (qmc_read_heading(&heading)) {
+   sched_init();
+   sched_add(&t_sensor);
+   sched_add(&t_poll);
+   if (gyro_ok)
+     sched_add(&t_gyro);
+   sched_add(&t_render);
+   sched_add(&t_tlm);
+   sched_add(&t_house);
+   sched_add(&t_rec);
 
-           fail_count = 0;
-
-        
-           if (heading != prev_heading) {
-               draw_cardinal_points(heading);
-               lcd_show_frame(); 
-               prev_heading = heading;
-           }
-
-       } else {
-           
-           fail_count++;
-           if (fail_count > 20) {   
-               qmc_init();
-               fail_count = 0;
-           }
-       }
-   }
- } 
\ No newline at end of file
+   acq_start(&acq_cfg);
+   sched_run();
+ }
@@ -0,0 +1,166 @@
+/*
+ * GUI de la brujula: rosa, flecha y puntos cardinales.
+ *
+ * Solo depende de hal_gfx.h, asi que se puede compilar para la placa
+ * o para el framebuffer en memoria del build de Linux.
+ */
+#include "interfaz.h"
+#include "glifos.h"
+#include "hal_gfx.h"
+#include "medida.h"
+#include "polar.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+ // Rotation applied by draw_arrow_center around the compass center
+ // (identity unless draw_arrow_rotated is drawing)
+ static float rot_cos = 1.0f;
+ static float rot_sin = 0.0f;
+
+ static void rot_point(int16_t *x, int16_t *y){
+   float dx = *x - POLAR_CX;
+   float dy = *y - POLAR_CY;
+   *x = POLAR_CX + (int16_t)floorf(dx * rot_cos + dy * rot_sin + 0.5f);
+   *y = POLAR_CY + (int16_t)floorf(dy * rot_cos - dx * rot_sin + 0.5f);
+ }
+
+ static void arrow_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color){
+   rot_point(&x0, &y0);
+   rot_point(&x1, &y1);
+   gfx_drawLine(x0, y0, x1, y1, color);
+ }
+
+ static void arrow_triangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1, int16_t x2, int16_t y2, uint16_t color){
+   rot_point(&x0, &y0);
+   rot_point(&x1, &y1);
+   rot_point(&x2, &y2);
+   gfx_fillTriangle(x0, y0, x1, y1, x2, y2, color);
+ }
+
+ // Draw arrow
+ void draw_arrow_center(int16_t ax, int16_t ay, int16_t bx, int16_t by, int16_t cx, int16_t cy, uint16_t color){
+   // Draw triangle0
+   arrow_triangle(ax, ay, cx-30, cy, cx+30, cy, color);
+   // Draw triangle1
+   arrow_triangle(bx, by, cx-30, cy, cx, cy, color);
+   // Draw triangle2
+   arrow_triangle(bx+84, by, cx+30, cy, cx, cy, color);
+ 
+   // Draw left line
+   arrow_line(ax, ay, bx, by, LCD_BLACK);
+   arrow_line(ax-1, ay, bx-1, by+1, LCD_BLACK);
+   arrow_line(ax-2, ay, bx-2, by+1, LCD_BLACK);
+   arrow_line(ax-3, ay, bx-3, by+1, LCD_BLACK);
+ 
+   // Draw middle line
+   arrow_line(ax, ay-2, cx, cy, LCD_BLACK);
+   arrow_line(ax-1, ay-1, cx-1, cy, LCD_BLACK);
+   arrow_line(ax+1, ay-1, cx+1, cy, LCD_BLACK);
+  
+   // Draw right line
+   arrow_line(ax, ay, bx+84, by, LCD_BLACK);
+   arrow_line(ax+1, ay, bx+85, by+1, LCD_BLACK);
+   arrow_line(ax+2, ay, bx+86, by+1, LCD_BLACK);
+   arrow_line(ax+3, ay, bx+87, by+1, LCD_BLACK);
+ 
+   // Draw down left line
+   arrow_line(bx, by, cx, cy, LCD_BLACK);
+   arrow_line(bx+1, by, cx, cy+1, LCD_BLACK);
+   arrow_line(bx+2, by, cx, cy+2, LCD_BLACK);
+   arrow_line(bx+3, by, cx, cy+3, LCD_BLACK);
+ 
+   // Draw down right line
+   arrow_line(bx+84, by, cx, cy,   LCD_BLACK);
+   arrow_line(bx+83, by, cx, cy+1, LCD_BLACK);
+   arrow_line(bx+82, by, cx, cy+2, LCD_BLACK);
+   arrow_line(bx+81, by, cx, cy+3, LCD_BLACK);
+ }
+ 
+ 
+ // Same arrow, turned deg degrees counterclockwise around the center
+ void draw_arrow_rotated(int deg){
+   float rad = deg * (float)M_PI / 180.0f;
+   rot_cos = cosf(rad);
+   rot_sin = sinf(rad);
+   draw_arrow_center(120, 105, 78, 200, 120, 170, LCD_GREEN);
+   rot_cos = 1.0f;
+   rot_sin = 0.0f;
+ }
+
+ // Everything static except the arrow
+ void draw_compass_rose(void){
+   // Set display color
+   gfx_fillScreen(LCD_WHITE);
+ 
+   // BUSSOLA!! (size 2, as main always left it; gfx_init resets it to 1)
+   gfx_setTextSize(2);
+   gfx_setTextColor(LCD_BLACK, LCD_WHITE);
+   gfx_setCursor(60, 10);
+   gfx_puts("BUSSOLA!");
+ 
+   // Made by Josue & Gabriel
+   gfx_setTextColor(LCD_YELLOW, LCD_WHITE);
+   gfx_setCursor(20, 40);
+   gfx_setTextSize(1);
+   gfx_puts("Fatto da Josue & Gabriel");
+ 
+   gfx_setTextSize(2);
+ 
+   // Draw centered cross
+   gfx_drawFastVLine(120, 55, 210, LCD_GREEN);
+   gfx_drawFastHLine(15, 160, 210, LCD_GREEN);
+ 
+   // Draw centered circles
+   gfx_drawCircle(120, 160, 85, LCD_BLACK);
+   gfx_drawCircle(120, 160, 100, LCD_BLACK);
+ 
+   // Draw angle symbol
+   gfx_drawCircle(150, 290, 2, LCD_GREEN);
+ }
+
+ void draw_compass_UI(void){
+   MED_BEGIN(t0);
+   draw_compass_rose();
+
+   // Draw arrows
+   draw_arrow_center(120, 105, 78, 200, 120, 170, LCD_GREEN);
+   MED_END(MED_UI, t0);
+ }
+ 
+ void draw_cardinal_points(int north_deg_value){
+   MED_BEGIN(t0);
+   int north_deg = north_deg_value; 
+   int south_deg = north_deg + 180;
+   int east_deg = north_deg - 90;
+   int west_deg = north_deg + 90;
+   int16_t x, y;
+ 
+   // North
+   polar_position(north_deg, &x, &y);
+   gfx_drawChar(x, y, 78, LCD_GREEN, LCD_WHITE, 2);
+ 
+   // South
+   polar_position(south_deg, &x, &y);
+   gfx_drawChar(x, y, 83, LCD_BLACK, LCD_WHITE, 2);
+ 
+   // East
+   polar_position(east_deg, &x, &y);
+   gfx_drawChar(x, y, 69, LCD_BLACK, LCD_WHITE, 2);
+ 
+   // West
+   polar_position(west_deg, &x, &y);
+   gfx_drawChar(x, y, 87, LCD_BLACK, LCD_WHITE, 2);
+ 
+   // Drawing angle: "%03d" sin snprintf
+   char digits[3];
+   glyph_digits3(north_deg, digits);
+   for (int i = 0; i < 3; i++)
+     gfx_drawChar(95 + i * GLYPH_W, 290, digits[i], LCD_GREEN, LCD_WHITE,
+                  GLYPH_SIZE);
+   MED_END(MED_CARDINAL, t0);
+ }
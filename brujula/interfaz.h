@@ -0,0 +1,14 @@
+#ifndef Interfaz_H
+#define Interfaz_H
+
+#include <stdint.h>
+
+/* GUI de la brujula */
+void draw_arrow_center(int16_t ax, int16_t ay, int16_t bx, int16_t by,
+                       int16_t cx, int16_t cy, uint16_t color);
+void draw_arrow_rotated(int deg);
+void draw_compass_rose(void);
+void draw_compass_UI(void);
+void draw_cardinal_points(int north_deg_value);
+
+#endif /* Interfaz_H */
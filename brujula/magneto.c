@@ -0,0 +1,295 @@
+/*
+ * Drivers de los magnetometros (ver magneto.h)
+ *
+ * Solo lo que corre una vez o al cambiar de perfil; el decode de cada
+ * chip es inline en magneto.h.
+ */
+#include "magneto.h"
+#include "brujula.h"
+
+#include <stddef.h>
+
+/* Promediado del perfil: OSR 512 / 256 / 128 / 64 -> 3 / 2 / 1 / 0 */
+static unsigned osr_level(const struct qmc_profile *p)
+{
+    return 3u - ((p->osr >> 6) & 0x03);
+}
+
+/* ================= QMC5883L ================= */
+
+/* Dos bytes (0x0C y el chip-ID), de cuando hal_i2c_read() no tenia la
+ * secuencia de un byte; pasar de 0x0D volveria a 0x00 (limpia DRDY) */
+static int qmc5883l_probe(void)
+{
+    uint8_t b[2];
+
+    if (i2c_read_burst(QMC_ADDR, QMC_REG_CHIP_ID - 1, b, sizeof(b)) != 0)
+        return -1;
+    return b[1] == QMC_CHIP_ID ? 0 : -2;
+}
+
+static int qmc5883l_setup(void)
+{
+    if (i2c_write_reg_timeout(QMC_ADDR, QMC_REG_SETRESET, 0x01) != 0)
+        return -1;
+
+    /* Roll-over del puntero: 0x06 -> 0x00, para leer estado + XYZ de una */
+    return i2c_write_reg_timeout(QMC_ADDR, QMC_REG_CONTROL2,
+                                 QMC_CTRL2_ROL_PNT);
+}
+
+/* Una escritura a 0x09 (por defecto 0x11: OSR=512, RNG=8G, ODR=10Hz) */
+static int qmc5883l_configure(const struct qmc_profile *p)
+{
+    return i2c_write_reg_timeout(QMC_ADDR, QMC_REG_CONTROL,
+                                 qmc_control_word(p));
+}
+
+/* Registros a los valores de fabrica */
+static int qmc5883l_soft_reset(void)
+{
+    return i2c_write_reg_timeout(QMC_ADDR, QMC_REG_CONTROL2,
+                                 QMC_CTRL2_SOFT_RST);
+}
+
+/* Temperatura relativa (100 LSB/°C): 2 bytes en otra lectura */
+static int qmc5883l_read_temp(int16_t *t)
+{
+    uint8_t b[2];
+
+    if (i2c_read_burst(QMC_ADDR, QMC_REG_TOUT_LSB, b, sizeof(b)) != 0)
+        return 0;
+
+    *t = (int16_t)((b[1] << 8) | b[0]);
+    return 1;
+}
+
+static uint32_t qmc5883l_odr_hz(const struct qmc_profile *p)
+{
+    static const uint32_t hz[4] = { 10, 50, 100, 200 };
+    return hz[(p->odr >> 2) & 0x03];
+}
+
+static uint16_t qmc5883l_lsb_per_gauss(const struct qmc_profile *p)
+{
+    return p->rng == QMC_RNG_2G ? 12000 : 3000;
+}
+
+/* ================= HMC5883L ================= */
+
+/* Continuo llega a 75 Hz: los perfiles de 50 a 200 Hz quedan en 75 */
+#define HMC_DO_15HZ 0x10
+#define HMC_DO_75HZ 0x18
+#define HMC_GN_1_9G 0x40   // 820 LSB/G
+#define HMC_GN_8_1G 0xE0   // 230 LSB/G
+
+static int hmc5883l_probe(void)
+{
+    uint8_t b[3];
+
+    if (i2c_read_burst(HMC_ADDR, HMC_REG_ID_A, b, sizeof(b)) != 0)
+        return -1;
+    return b[0] == 'H' && b[1] == '4' && b[2] == '3' ? 0 : -2;
+}
+
+static int hmc5883l_setup(void)
+{
+    return 0;   // todo va en CRA/CRB/MODE
+}
+
+/* CRA (promedio + ODR), CRB (ganancia) y modo continuo */
+static int hmc5883l_configure(const struct qmc_profile *p)
+{
+    uint8_t cra = (uint8_t)(osr_level(p) << 5 |
+                            (qmc5883l_odr_hz(p) > 10 ? HMC_DO_75HZ
+                                                     : HMC_DO_15HZ));
+    uint8_t crb = p->rng == QMC_RNG_2G ? HMC_GN_1_9G : HMC_GN_8_1G;
+
+    if (i2c_write_reg_timeout(HMC_ADDR, HMC_REG_CRA, cra) != 0 ||
+        i2c_write_reg_timeout(HMC_ADDR, HMC_REG_CRB, crb) != 0)
+        return -1;
+    return i2c_write_reg_timeout(HMC_ADDR, HMC_REG_MODE, HMC_MODE_CONT);
+}
+
+/* No tiene soft reset: a reposo, con los valores de fabrica */
+static int hmc5883l_soft_reset(void)
+{
+    if (i2c_write_reg_timeout(HMC_ADDR, HMC_REG_CRA, 0x10) != 0 ||
+        i2c_write_reg_timeout(HMC_ADDR, HMC_REG_CRB, 0x20) != 0)
+        return -1;
+    return i2c_write_reg_timeout(HMC_ADDR, HMC_REG_MODE, HMC_MODE_IDLE);
+}
+
+static uint32_t hmc5883l_odr_hz(const struct qmc_profile *p)
+{
+    return qmc5883l_odr_hz(p) > 10 ? 75 : 15;
+}
+
+static uint16_t hmc5883l_lsb_per_gauss(const struct qmc_profile *p)
+{
+    return p->rng == QMC_RNG_2G ? 820 : 230;
+}
+
+/* ================= LIS3MDL ================= */
+
+/* DO hasta 80 Hz; arriba FAST_ODR, donde el modo (OM) da el ODR */
+#define LIS_DO_10HZ 0x10
+#define LIS_DO_80HZ 0x1C
+#define LIS_OM_UHP  3   // 155 Hz con FAST_ODR
+#define LIS_OM_HP   2   // 300 Hz con FAST_ODR
+#define LIS_FS_4G   0x00   // 6842 LSB/G
+#define LIS_FS_8G   0x20   // 3421 LSB/G
+
+static int lis3mdl_probe(void)
+{
+    uint8_t b[2];
+
+    /* Sin LIS_AUTO_INC: los dos bytes son WHO_AM_I */
+    if (i2c_read_burst(LIS_ADDR, LIS_REG_WHO_AM_I, b, sizeof(b)) != 0)
+        return -1;
+    return b[1] == LIS_WHO_AM_I ? 0 : -2;
+}
+
+static int lis3mdl_setup(void)
+{
+    return i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL5, LIS_CTRL5_BDU);
+}
+
+static int lis3mdl_configure(const struct qmc_profile *p)
+{
+    uint32_t hz = qmc5883l_odr_hz(p);
+    unsigned om = osr_level(p);
+    uint8_t ctrl1 = LIS_CTRL1_TEMP_EN;
+
+    if (hz <= 10) {
+        ctrl1 |= LIS_DO_10HZ;
+    } else if (hz <= 50) {
+        ctrl1 |= LIS_DO_80HZ;
+    } else {
+        om = hz <= 100 ? LIS_OM_UHP : LIS_OM_HP;
+        ctrl1 |= LIS_CTRL1_FAST_ODR;
+    }
+    ctrl1 |= (uint8_t)(om << 5);
+
+    if (i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL1, ctrl1) != 0 ||
+        i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL2,
+                              p->rng == QMC_RNG_2G ? LIS_FS_4G
+                                                   : LIS_FS_8G) != 0 ||
+        i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL4,
+                              (uint8_t)(om << 2)) != 0)
+        return -1;
+    return i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL3, LIS_CTRL3_CONT);
+}
+
+static int lis3mdl_soft_reset(void)
+{
+    return i2c_write_reg_timeout(LIS_ADDR, LIS_REG_CTRL2,
+                                 LIS_CTRL2_SOFT_RST);
+}
+
+/* 8 LSB/°C, 0 = 25 °C */
+static int lis3mdl_read_temp(int16_t *t)
+{
+    uint8_t b[2];
+
+    if (i2c_read_burst(LIS_ADDR, LIS_REG_TEMP_L | LIS_AUTO_INC, b,
+                       sizeof(b)) != 0)
+        return 0;
+
+    *t = (int16_t)((int16_t)((b[1] << 8) | b[0]) * 25 / 2);
+    return 1;
+}
+
+static uint32_t lis3mdl_odr_hz(const struct qmc_profile *p)
+{
+    uint32_t hz = qmc5883l_odr_hz(p);
+
+    if (hz <= 10)
+        return 10;
+    if (hz <= 50)
+        return 80;
+    return hz <= 100 ? 155 : 300;
+}
+
+static uint16_t lis3mdl_lsb_per_gauss(const struct qmc_profile *p)
+{
+    return p->rng == QMC_RNG_2G ? 6842 : 3421;
+}
+
+/* ================= TABLA ================= */
+
+const struct mag_driver mag_drivers[MAG_CHIPS] = {
+    [MAG_QMC5883L] = {
+        .name = "QMC5883L", .addr = QMC_ADDR,
+        .block_reg = QMC_REG_STATUS, .block_len = QMC_BLOCK_LEN,
+        .probe = qmc5883l_probe, .setup = qmc5883l_setup,
+        .configure = qmc5883l_configure, .soft_reset = qmc5883l_soft_reset,
+        .decode = qmc5883l_decode, .read_temp = qmc5883l_read_temp,
+        .odr_hz = qmc5883l_odr_hz, .lsb_per_gauss = qmc5883l_lsb_per_gauss,
+    },
+    [MAG_HMC5883L] = {
+        .name = "HMC5883L", .addr = HMC_ADDR,
+        .block_reg = HMC_REG_X_MSB, .block_len = HMC_BLOCK_LEN,
+        .ready_reg = HMC_REG_STATUS, .ready_bit = HMC_ST_RDY,
+        .probe = hmc5883l_probe, .setup = hmc5883l_setup,
+        .configure = hmc5883l_configure, .soft_reset = hmc5883l_soft_reset,
+        .decode = hmc5883l_decode, .read_temp = NULL,
+        .odr_hz = hmc5883l_odr_hz, .lsb_per_gauss = hmc5883l_lsb_per_gauss,
+    },
+    [MAG_LIS3MDL] = {
+        .name = "LIS3MDL", .addr = LIS_ADDR,
+        .block_reg = LIS_REG_STATUS | LIS_AUTO_INC,
+        .block_len = LIS_BLOCK_LEN,
+        .probe = lis3mdl_probe, .setup = lis3mdl_setup,
+        .configure = lis3mdl_configure, .soft_reset = lis3mdl_soft_reset,
+        .decode = lis3mdl_decode, .read_temp = lis3mdl_read_temp,
+        .odr_hz = lis3mdl_odr_hz, .lsb_per_gauss = lis3mdl_lsb_per_gauss,
+    },
+};
+
+/* ================= DETECCION ================= */
+
+#if BRUJULA_MAG == MAG_AUTO
+const struct mag_driver *mag_drv = &mag_drivers[MAG_QMC5883L];
+#endif
+
+/*
+ * Una pasada por los tres chip-ID: el indice del primero que contesta
+ * con su ID (MAG_QMC5883L...), -1 si nadie contesta, -2 si algo contesta
+ * con otro ID. Con MAG_AUTO ese chip queda activo.
+ */
+int mag_detect(void)
+{
+    int err = -1;
+
+    for (int i = 0; i < MAG_CHIPS; i++) {
+        int r = mag_drivers[i].probe();
+
+        if (r == 0) {
+#if BRUJULA_MAG == MAG_AUTO
+            mag_drv = &mag_drivers[i];
+#endif
+            return i;
+        }
+        if (r == -2)
+            err = -2;
+    }
+    return err;
+}
+
+/* La misma lectura que qmc_read_xyz(), con todo sacado de la tabla */
+int mag_read_xyz(const struct mag_driver *d, int16_t *x, int16_t *y,
+                 int16_t *z)
+{
+    uint8_t b[MAG_BLOCK_MAX];
+
+    if (d->ready_bit &&
+        (i2c_read_burst(d->addr, d->ready_reg, b, 1) != 0 ||
+         !(b[0] & d->ready_bit)))
+        return 0;
+
+    if (i2c_read_burst(d->addr, d->block_reg, b, d->block_len) != 0)
+        return 0;
+
+    return d->decode(b, x, y, z);
+}
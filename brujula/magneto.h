@@ -0,0 +1,240 @@
+#ifndef Magneto_H
+#define Magneto_H
+
+/*
+ * Drivers de los magnetometros: QMC5883L, HMC5883L y LIS3MDL.
+ *
+ * Cada chip da probe (chip-ID), setup (una vez despues del power-on),
+ * configure (el perfil, en caliente), soft_reset y la lectura en rafaga:
+ * block_len bytes desde block_reg, que decode() pasa a X/Y/Z (0 = no hay
+ * dato nuevo o no sirve). Si el estado no entra en el bloque (el HMC),
+ * ready_reg / ready_bit: un byte que se lee antes y dice si hay dato.
+ * El perfil (brujula.h) va en codigos del QMC; los otros chips lo
+ * traducen al ODR, rango y promediado mas parecidos.
+ *
+ * BRUJULA_MAG elige el chip al compilar (-DBRUJULA_MAG=MAG_LIS3MDL, por
+ * defecto el QMC5883L). Asi MAG_ADDR, MAG_BLOCK_REG, MAG_BLOCK_LEN y
+ * mag_decode() son constantes y funciones inline del chip: la lectura de
+ * cada muestra no pasa por punteros y compila igual que el
+ * qmc_read_xyz() escrito a mano. Lo que corre una vez (probe, setup,
+ * configure) va por la tabla mag_drivers[].
+ *
+ * Con -DBRUJULA_MAG=MAG_AUTO, mag_detect() pregunta los chip-ID al
+ * arrancar y todo, la lectura incluida, pasa por la tabla del chip que
+ * contesto.
+ *
+ * Ejes y unidades: X/Y/Z del chip, con el chip montado como el QMC de la
+ * placa (el rumbo sale de X y Z). Cuentas del chip en el rango del
+ * perfil; lsb_per_gauss() las pasa a gauss. La calibracion guardada en
+ * flash es de un chip: si se cambia el chip hay que recalibrar.
+ */
+
+#include <stdint.h>
+
+struct qmc_profile;
+
+#define MAG_QMC5883L 0
+#define MAG_HMC5883L 1
+#define MAG_LIS3MDL  2
+#define MAG_CHIPS    3
+#define MAG_AUTO     (-1)
+
+#ifndef BRUJULA_MAG
+#define BRUJULA_MAG MAG_QMC5883L
+#endif
+
+#define MAG_BLOCK_MAX 7   // el bloque mas largo de los tres
+
+/* ================= QMC5883L ================= */
+
+#define QMC_ADDR 0x0D
+
+#define QMC_REG_X_LSB     0x00
+#define QMC_REG_STATUS    0x06
+#define QMC_REG_TOUT_LSB  0x07
+#define QMC_REG_CONTROL   0x09
+#define QMC_REG_CONTROL2  0x0A
+#define QMC_REG_SETRESET  0x0B
+#define QMC_REG_CHIP_ID   0x0D
+
+#define QMC_CHIP_ID       0xFF
+
+#define QMC_ST_DRDY       0x01
+#define QMC_BLOCK_LEN     7     // estado + XYZ (desde 0x06 con ROL_PNT)
+#define QMC_CTRL2_ROL_PNT 0x40
+#define QMC_CTRL2_SOFT_RST 0x80
+
+/*
+ * Estado + XYZ en una sola transaccion: con ROL_PNT el puntero va
+ * 0x06, 0x00, 0x01 ... 0x05, asi que 7 bytes desde QMC_REG_STATUS traen
+ * el DRDY y el dato que corresponde a ese DRDY (el chip bloquea los
+ * registros de datos mientras dura la lectura).
+ */
+static inline int qmc5883l_decode(const uint8_t *b, int16_t *x, int16_t *y,
+                                  int16_t *z)
+{
+    if (!(b[0] & QMC_ST_DRDY))
+        return 0; // No hay dato nuevo
+
+    *x = (int16_t)((b[2] << 8) | b[1]);
+    *y = (int16_t)((b[4] << 8) | b[3]);
+    *z = (int16_t)((b[6] << 8) | b[5]);
+
+    return 1;
+}
+
+/* ================= HMC5883L ================= */
+
+#define HMC_ADDR 0x1E
+
+#define HMC_REG_CRA     0x00   // MA (promedio) | DO (ODR)
+#define HMC_REG_CRB     0x01   // GN (ganancia)
+#define HMC_REG_MODE    0x02
+#define HMC_REG_X_MSB   0x03   // X, Z, Y en big endian
+#define HMC_REG_STATUS  0x09
+#define HMC_REG_ID_A    0x0A   // 'H', '4', '3'
+
+#define HMC_BLOCK_LEN   6
+#define HMC_MODE_CONT   0x00
+#define HMC_MODE_IDLE   0x03
+#define HMC_ST_RDY      0x01
+#define HMC_OVERFLOW    (-4096)   // el eje desbordo el rango
+
+/*
+ * El estado (0x09) va despues de los datos y leerlos lo limpia, y
+ * despues de 0x08 el puntero vuelve a 0x03: no entra en la rafaga.
+ * Se lee antes (ready_reg), por polling y por DMA (adquisicion.c): sin
+ * RDY no hay rafaga, si no el timer o el watchdog de DRDY repetirian la
+ * muestra anterior. Un eje en -4096 es desborde: la muestra entera no
+ * sirve.
+ */
+static inline int hmc5883l_decode(const uint8_t *b, int16_t *x, int16_t *y,
+                                  int16_t *z)
+{
+    int16_t vx = (int16_t)((b[0] << 8) | b[1]);
+    int16_t vz = (int16_t)((b[2] << 8) | b[3]);
+    int16_t vy = (int16_t)((b[4] << 8) | b[5]);
+
+    if (vx == HMC_OVERFLOW || vy == HMC_OVERFLOW || vz == HMC_OVERFLOW)
+        return 0;
+
+    *x = vx;
+    *y = vy;
+    *z = vz;
+    return 1;
+}
+
+/* ================= LIS3MDL ================= */
+
+#ifndef LIS_ADDR
+#define LIS_ADDR 0x1C   // SA1 a GND; 0x1E con SA1 a VDD
+#endif
+
+#define LIS_REG_WHO_AM_I 0x0F
+#define LIS_REG_CTRL1    0x20   // TEMP_EN | OM | DO | FAST_ODR
+#define LIS_REG_CTRL2    0x21   // FS | SOFT_RST
+#define LIS_REG_CTRL3    0x22   // MD
+#define LIS_REG_CTRL4    0x23   // OMZ
+#define LIS_REG_CTRL5    0x24   // BDU
+#define LIS_REG_STATUS   0x27
+#define LIS_REG_TEMP_L   0x2E
+
+#define LIS_WHO_AM_I     0x3D
+#define LIS_AUTO_INC     0x80   // en la direccion: rafaga con auto-incremento
+#define LIS_ST_ZYXDA     0x08
+#define LIS_BLOCK_LEN    7      // estado + XYZ, igual que el QMC
+
+#define LIS_CTRL1_TEMP_EN  0x80
+#define LIS_CTRL1_FAST_ODR 0x02
+#define LIS_CTRL2_SOFT_RST 0x04
+#define LIS_CTRL3_CONT     0x00
+#define LIS_CTRL5_BDU      0x40
+
+/* Con BDU el chip no mezcla mitades de dos muestras */
+static inline int lis3mdl_decode(const uint8_t *b, int16_t *x, int16_t *y,
+                                 int16_t *z)
+{
+    if (!(b[0] & LIS_ST_ZYXDA))
+        return 0;
+
+    *x = (int16_t)((b[2] << 8) | b[1]);
+    *y = (int16_t)((b[4] << 8) | b[3]);
+    *z = (int16_t)((b[6] << 8) | b[5]);
+
+    return 1;
+}
+
+/* ================= INTERFAZ ================= */
+
+struct mag_driver {
+    const char *name;
+    uint8_t addr;
+    uint8_t block_reg;
+    uint8_t block_len;
+    uint8_t ready_reg;                            // con ready_bit != 0
+    uint8_t ready_bit;
+    int (*probe)(void);                           // 0, -1 NACK, -2 otro chip
+    int (*setup)(void);                           // sin el perfil
+    int (*configure)(const struct qmc_profile *p);
+    int (*soft_reset)(void);                      // despues, esperar probe()
+    int (*decode)(const uint8_t *b, int16_t *x, int16_t *y, int16_t *z);
+    int (*read_temp)(int16_t *t);                 // 100 LSB/°C, relativa
+    uint32_t (*odr_hz)(const struct qmc_profile *p);
+    uint16_t (*lsb_per_gauss)(const struct qmc_profile *p);
+};
+
+extern const struct mag_driver mag_drivers[MAG_CHIPS];
+
+int mag_detect(void);   // chip que contesto (MAG_*), -1 o -2
+int mag_read_xyz(const struct mag_driver *d, int16_t *x, int16_t *y,
+                 int16_t *z);   // por la tabla, sin inline
+
+#if BRUJULA_MAG == MAG_AUTO
+
+extern const struct mag_driver *mag_drv;   // el de mag_detect()
+
+#define MAG_DRV       mag_drv
+#define MAG_ADDR      (mag_drv->addr)
+#define MAG_BLOCK_REG (mag_drv->block_reg)
+#define MAG_BLOCK_LEN (mag_drv->block_len)
+#define MAG_READY_REG (mag_drv->ready_reg)
+#define MAG_READY_BIT (mag_drv->ready_bit)
+
+static inline int mag_decode(const uint8_t *b, int16_t *x, int16_t *y,
+                             int16_t *z)
+{
+    return mag_drv->decode(b, x, y, z);
+}
+
+#else
+
+#define MAG_DRV (&mag_drivers[BRUJULA_MAG])
+
+#if BRUJULA_MAG == MAG_QMC5883L
+#define MAG_ADDR      QMC_ADDR
+#define MAG_BLOCK_REG QMC_REG_STATUS
+#define MAG_BLOCK_LEN QMC_BLOCK_LEN
+#define MAG_READY_REG 0
+#define MAG_READY_BIT 0
+#define mag_decode    qmc5883l_decode
+#elif BRUJULA_MAG == MAG_HMC5883L
+#define MAG_ADDR      HMC_ADDR
+#define MAG_BLOCK_REG HMC_REG_X_MSB
+#define MAG_BLOCK_LEN HMC_BLOCK_LEN
+#define MAG_READY_REG HMC_REG_STATUS
+#define MAG_READY_BIT HMC_ST_RDY
+#define mag_decode    hmc5883l_decode
+#elif BRUJULA_MAG == MAG_LIS3MDL
+#define MAG_ADDR      LIS_ADDR
+#define MAG_BLOCK_REG (LIS_REG_STATUS | LIS_AUTO_INC)
+#define MAG_BLOCK_LEN LIS_BLOCK_LEN
+#define MAG_READY_REG 0
+#define MAG_READY_BIT 0
+#define mag_decode    lis3mdl_decode
+#else
+#error "BRUJULA_MAG: MAG_QMC5883L, MAG_HMC5883L, MAG_LIS3MDL o MAG_AUTO"
+#endif
+
+#endif
+
+#endif /* Magneto_H */
@@ -0,0 +1,108 @@
+/*
+ * Instrumentacion (ver medida.h)
+ */
+#include "medida.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static struct med_hist hist[MED_STAGES];
+static uint32_t ns_q16;   // ns por ciclo en Q16
+
+static const char *const names[MED_STAGES] = {
+    [MED_I2C] = "i2c",
+    [MED_HEADING] = "heading",
+    [MED_UI] = "ui",
+    [MED_CARDINAL] = "cardinal",
+    [MED_RENDER] = "render",
+    [MED_SWAP] = "swap",
+    [MED_LCD] = "lcd",
+    [MED_E2E] = "e2e",
+};
+
+void med_reset(void)
+{
+    memset(hist, 0, sizeof(hist));
+    ns_q16 = (uint32_t)((1000000000ull << 16) / hal_cycles_hz());
+}
+
+void med_add_ns(enum med_stage s, uint32_t ns)
+{
+    struct med_hist *h = &hist[s];
+    uint32_t k = ns ? 32u - (uint32_t)__builtin_clz(ns) : 0;
+
+    if (k >= MED_BUCKETS)
+        k = MED_BUCKETS - 1;
+    if (!h->count || ns < h->min_ns)
+        h->min_ns = ns;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+    h->count++;
+    h->sum_ns += ns;
+    h->bucket[k]++;
+}
+
+void med_add_cycles(enum med_stage s, uint32_t cycles)
+{
+    if (!ns_q16)
+        med_reset();
+    med_add_ns(s, (uint32_t)(((uint64_t)cycles * ns_q16) >> 16));
+}
+
+void med_get(enum med_stage s, struct med_hist *out)
+{
+    *out = hist[s];
+}
+
+uint32_t med_percentile(const struct med_hist *h, uint32_t pct)
+{
+    uint64_t want = ((uint64_t)h->count * pct + 99) / 100;
+    uint64_t seen = 0;
+
+    if (!h->count)
+        return 0;
+    for (int k = 0; k < MED_BUCKETS; k++) {
+        seen += h->bucket[k];
+        if (seen >= want) {
+            uint32_t top = k ? (uint32_t)((1ull << k) - 1) : 0;
+            return top < h->max_ns ? top : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
+
+const char *med_name(enum med_stage s)
+{
+    return names[s];
+}
+
+/* us con un decimal, sin floats */
+static void put_us(uint32_t ns)
+{
+    uint32_t tenths = (ns + 50) / 100;
+    printf(" %7lu.%lu", (unsigned long)(tenths / 10),
+           (unsigned long)(tenths % 10));
+}
+
+void med_dump(void)
+{
+    printf("etapa          n      min      p50      p99      max    media"
+           "  (us)\r\n");
+    for (int s = 0; s < MED_STAGES; s++) {
+        const struct med_hist *h = &hist[s];
+
+        if (!h->count)
+            continue;
+        printf("%-8s %7lu", names[s], (unsigned long)h->count);
+        put_us(h->min_ns);
+        put_us(med_percentile(h, 50));
+        put_us(med_percentile(h, 99));
+        put_us(h->max_ns);
+        put_us((uint32_t)(h->sum_ns / h->count));
+        printf("\r\n        ");
+        for (int k = 0; k < MED_BUCKETS; k++)
+            if (h->bucket[k])
+                printf(" ns<2^%d:%lu", k, (unsigned long)h->bucket[k]);
+        printf("\r\n");
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef Medida_H
+#define Medida_H
+
+/*
+ * Instrumentacion: cronometros por etapa e histogramas de latencia.
+ *
+ * MED_BEGIN(t) / MED_END(etapa, t) leen el contador de ciclos de la HAL
+ * (DWT CYCCNT en la placa, clock_gettime en Linux) y suman la duracion al
+ * histograma de la etapa: dos lecturas, una multiplicacion y un clz.
+ * Sin BRUJULA_MEDIDA las macros no generan nada.
+ *
+ * Histograma en nanosegundos con cubetas log2: la cubeta k tiene
+ * [2^(k-1), 2^k) ns, la 0 solo el 0. min, max y la media son exactos;
+ * los percentiles salen del borde de arriba de la cubeta (a lo sumo el
+ * doble), recortados a max.
+ *
+ * MED_E2E es de punta a punta: del DRDY de la muestra (qmc_sample.t_us)
+ * a que el LCD termina de recibir el frame que la muestra (pantalla.h,
+ * fb_set_sample()). Va en el reloj de time_us().
+ */
+
+#include <stdint.h>
+
+#include "hal.h"
+
+enum med_stage {
+    MED_I2C,        // lectura del QMC (sincrona, o del disparo al DMA)
+    MED_HEADING,    // qmc_heading_cdeg(): calibracion + filtro + atan2
+    MED_UI,         // draw_compass_UI()
+    MED_CARDINAL,   // draw_cardinal_points()
+    MED_RENDER,     // scene_render()
+    MED_SWAP,       // fb_swap(): copia de tiles y cola del LCD
+    MED_LCD,        // envio del frame por SPI/DMA
+    MED_E2E,        // DRDY -> pixeles en el panel
+    MED_STAGES
+};
+
+#define MED_BUCKETS 32   // hasta 2^31 ns, ~2 s
+
+struct med_hist {
+    uint32_t count;
+    uint32_t min_ns, max_ns;
+    uint64_t sum_ns;
+    uint32_t bucket[MED_BUCKETS];
+};
+
+#ifdef BRUJULA_MEDIDA
+#define MED_BEGIN(t)      uint32_t t = hal_cycles()
+#define MED_END(stage, t) med_add_cycles((stage), hal_cycles() - (t))
+#else
+#define MED_BEGIN(t)      ((void)0)
+#define MED_END(stage, t) ((void)0)
+#endif
+
+void med_reset(void);
+void med_add_cycles(enum med_stage s, uint32_t cycles);
+void med_add_ns(enum med_stage s, uint32_t ns);
+void med_get(enum med_stage s, struct med_hist *out);
+uint32_t med_percentile(const struct med_hist *h, uint32_t pct);
+const char *med_name(enum med_stage s);
+void med_dump(void);   // printf: la consola del CDC en la placa
+
+#endif /* Medida_H */
@@ -0,0 +1,285 @@
+/*
+ * Framebuffers del LCD (ver pantalla.h)
+ *
+ * Cada buffer esta en uno de estos estados:
+ *   back    -> se dibuja en el
+ *   pending -> terminado, esperando al LCD (solo con 3 buffers)
+ *   sending -> el DMA lo esta mandando
+ *   libre   -> candidato a ser el proximo back
+ *
+ * stale[i] son los tiles que cambiaron en otros buffers desde la ultima
+ * vez que se dibujo en i; se copian desde 'latest' al tomarlo como back.
+ */
+#include "pantalla.h"
+#include "hal.h"
+#include "medida.h"
+#include "tiempo.h"
+
+#include <string.h>
+
+#define TILE_BYTES ((FB_TILES + 7) / 8)
+
+/* Espera entre consultas al LCD (en la placa duerme con WFI) */
+#define FB_WAIT_US 100
+
+#ifdef HOST_BUILD
+static uint16_t fb_mem[FB_MAX_BUFFERS * FB_PIXELS];
+#define FB_DEFAULT_MEM fb_mem
+#else
+/* SDRAM, 1 MB por encima de los frames de lcd-spi */
+#define FB_DEFAULT_MEM ((uint16_t *)(0xD0000000 + 0x100000))
+#endif
+
+static uint16_t *buf[FB_MAX_BUFFERS];
+static uint8_t nbuf;
+static uint8_t back;
+static int8_t latest = -1;
+static volatile int8_t pending = -1;
+static volatile int8_t sending = -1;
+
+static uint8_t dirty[TILE_BYTES];
+static uint8_t stale[FB_MAX_BUFFERS][TILE_BYTES];
+static struct fb_stats stats;
+static uint64_t sample_us[FB_MAX_BUFFERS];   // fb_set_sample(), 0 = sin marca
+#ifdef BRUJULA_MEDIDA
+static uint32_t lcd_cyc;                     // arranque del envio en curso
+#endif
+
+/* ================= LCD ================= */
+
+static void lcd_done(void);
+
+static void lcd_start(uint8_t i)
+{
+#ifdef BRUJULA_MEDIDA
+    lcd_cyc = hal_cycles();
+#endif
+    stats.presented++;
+    hal_lcd_present(buf[i], lcd_done);
+}
+
+static void lcd_done(void)
+{
+    MED_END(MED_LCD, lcd_cyc);
+#ifdef BRUJULA_MEDIDA
+    if (sample_us[sending]) {
+        uint64_t us = time_us() - sample_us[sending];
+        med_add_ns(MED_E2E, us < 4000000u ? (uint32_t)us * 1000u : UINT32_MAX);
+    }
+#endif
+    sending = -1;
+    if (pending >= 0) {
+        sending = pending;
+        pending = -1;
+        lcd_start((uint8_t)sending);
+    }
+}
+
+static void present(uint8_t i)
+{
+    hal_irq_lock();
+    if (sending < 0) {
+        sending = i;
+        lcd_start(i);
+    } else {
+        if (pending >= 0)
+            stats.dropped++;
+        pending = i;
+    }
+    hal_irq_unlock();
+}
+
+static int find_free(void)
+{
+    for (uint8_t k = 1; k <= nbuf; k++) {
+        uint8_t i = (back + k) % nbuf;
+        if (i != pending && i != sending)
+            return i;
+    }
+    return -1;
+}
+
+/* ================= TILES ================= */
+
+static void copy_tile(uint16_t *dst, const uint16_t *src, int t)
+{
+    uint32_t off = (uint32_t)(t / FB_TILES_X) * FB_TILE * FB_WIDTH +
+                   (uint32_t)(t % FB_TILES_X) * FB_TILE;
+
+    for (int r = 0; r < FB_TILE; r++, off += FB_WIDTH)
+        memcpy(&dst[off], &src[off], FB_TILE * sizeof(uint16_t));
+}
+
+/* Trae a 'back' lo que cambio en los otros buffers */
+static uint32_t copy_forward(void)
+{
+    uint32_t pixels = 0;
+
+    if (latest < 0 || latest == back)
+        return 0;
+
+    for (int t = 0; t < FB_TILES; t++)
+        if (stale[back][t >> 3] & (1u << (t & 7))) {
+            copy_tile(buf[back], buf[latest], t);
+            pixels += FB_TILE * FB_TILE;
+        }
+    memset(stale[back], 0, TILE_BYTES);
+    return pixels;
+}
+
+/* ================= API ================= */
+
+int fb_init(uint16_t *mem, uint8_t n)
+{
+    if (n < 2 || n > FB_MAX_BUFFERS)
+        return -1;
+    if (!mem)
+        mem = FB_DEFAULT_MEM;
+
+    /* Un envio de antes de fb_init() podria estar usando la memoria */
+    while (hal_lcd_busy())
+        sleep_us(FB_WAIT_US);
+
+    nbuf = n;
+    for (uint8_t i = 0; i < n; i++) {
+        buf[i] = mem + (uint32_t)i * FB_PIXELS;
+        memset(buf[i], 0, FB_PIXELS * sizeof(uint16_t));
+    }
+
+    back = 0;
+    latest = -1;
+    pending = -1;
+    sending = -1;
+    memset(dirty, 0, sizeof(dirty));
+    memset(stale, 0, sizeof(stale));
+    memset(&stats, 0, sizeof(stats));
+    memset(sample_us, 0, sizeof(sample_us));
+    stats.bytes = (uint32_t)n * FB_PIXELS * sizeof(uint16_t);
+    return 0;
+}
+
+void fb_draw_pixel(int x, int y, uint16_t color)
+{
+    if ((unsigned)x >= FB_WIDTH || (unsigned)y >= FB_HEIGHT)
+        return;
+
+    int t = (y / FB_TILE) * FB_TILES_X + x / FB_TILE;
+
+    buf[back][y * FB_WIDTH + x] = color;
+    dirty[t >> 3] |= 1u << (t & 7);
+    stats.pixels++;
+}
+
+/* Tramo horizontal: un tile marcado cada 16 pixeles, no uno por pixel */
+void fb_draw_hline(int x, int y, int w, uint16_t color)
+{
+    if ((unsigned)y >= FB_HEIGHT)
+        return;
+    if (x < 0) {
+        w += x;
+        x = 0;
+    }
+    if (x + w > FB_WIDTH)
+        w = FB_WIDTH - x;
+    if (w <= 0)
+        return;
+
+    uint16_t *p = &buf[back][y * FB_WIDTH + x];
+    for (int i = 0; i < w; i++)
+        p[i] = color;
+    stats.pixels += (uint32_t)w;
+
+    int row = (y / FB_TILE) * FB_TILES_X;
+    for (int tx = x / FB_TILE; tx <= (x + w - 1) / FB_TILE; tx++) {
+        int t = row + tx;
+        dirty[t >> 3] |= 1u << (t & 7);
+    }
+}
+
+/* Rectangulo opaco (glifos.h): fila por fila, los tiles una vez */
+void fb_blit(int x, int y, int w, int h, const uint16_t *src)
+{
+    int sx = 0, sy = 0, sw = w;
+
+    if (x < 0) {
+        sx = -x;
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        sy = -y;
+        h += y;
+        y = 0;
+    }
+    if (x + w > FB_WIDTH)
+        w = FB_WIDTH - x;
+    if (y + h > FB_HEIGHT)
+        h = FB_HEIGHT - y;
+    if (w <= 0 || h <= 0)
+        return;
+
+    for (int r = 0; r < h; r++) {
+        uint16_t *p = &buf[back][(y + r) * FB_WIDTH + x];
+        const uint16_t *q = &src[(sy + r) * sw + sx];
+        for (int i = 0; i < w; i++)
+            p[i] = q[i];
+    }
+    stats.pixels += (uint32_t)(w * h);
+
+    for (int ty = y / FB_TILE; ty <= (y + h - 1) / FB_TILE; ty++)
+        for (int tx = x / FB_TILE; tx <= (x + w - 1) / FB_TILE; tx++) {
+            int t = ty * FB_TILES_X + tx;
+            dirty[t >> 3] |= 1u << (t & 7);
+        }
+}
+
+uint16_t *fb_back(void)
+{
+    return buf[back];
+}
+
+void fb_set_sample(uint64_t t_us)
+{
+    sample_us[back] = t_us;
+}
+
+void fb_swap(void)
+{
+    uint32_t ntiles = 0;
+    int next;
+    MED_BEGIN(t0);
+
+    /* Lo que se dibujo en este frame les falta a los demas */
+    for (int b = 0; b < TILE_BYTES; b++) {
+        for (uint8_t i = 0; i < nbuf; i++)
+            if (i != back)
+                stale[i][b] |= dirty[b];
+        ntiles += (uint32_t)__builtin_popcount(dirty[b]);
+    }
+    memset(dirty, 0, sizeof(dirty));
+
+    latest = back;
+    present(back);
+
+    /* Con 2 buffers, el otro se libera cuando el LCD termina */
+    if ((next = find_free()) < 0) {
+        stats.waits++;
+        while ((next = find_free()) < 0)
+            sleep_us(FB_WAIT_US);
+    }
+    back = (uint8_t)next;
+    sample_us[back] = 0;
+
+    uint32_t copied = copy_forward();
+
+    stats.frames++;
+    stats.dirty_tiles_last = ntiles;
+    stats.copy_pixels_last = copied;
+    stats.copy_pixels_total += copied;
+    MED_END(MED_SWAP, t0);
+}
+
+void fb_stats_get(struct fb_stats *out)
+{
+    *out = stats;
+}
@@ -0,0 +1,56 @@
+#ifndef Pantalla_H
+#define Pantalla_H
+
+/*
+ * Framebuffers del LCD en SDRAM (doble o triple buffer).
+ *
+ * Se dibuja siempre en el buffer de atras (fb_draw_pixel, que es lo que
+ * recibe gfx_init) y fb_swap() lo manda al LCD. Nunca se dibuja en el
+ * buffer que el DMA esta enviando, asi que no hay tearing, y no hace
+ * falta redibujar todo: cada pixel marca su tile de 16x16 y al pasar a
+ * un buffer nuevo solo se copian los tiles que cambiaron desde la ultima
+ * vez que se dibujo en el.
+ *
+ * Con dos buffers fb_swap() espera a que termine el envio anterior; con
+ * tres deja el frame en cola (si ya habia uno en cola, lo reemplaza) y
+ * sigue dibujando.
+ */
+
+#include <stdint.h>
+
+#define FB_WIDTH  240
+#define FB_HEIGHT 320
+#define FB_PIXELS (FB_WIDTH * FB_HEIGHT)
+
+#define FB_MAX_BUFFERS 3
+
+#define FB_TILE    16
+#define FB_TILES_X (FB_WIDTH / FB_TILE)
+#define FB_TILES_Y (FB_HEIGHT / FB_TILE)
+#define FB_TILES   (FB_TILES_X * FB_TILES_Y)
+
+struct fb_stats {
+    uint32_t frames;            // fb_swap()
+    uint32_t presented;         // envios al LCD
+    uint32_t dropped;           // reemplazados en la cola (triple)
+    uint32_t waits;             // fb_swap() que tuvo que esperar al LCD
+    uint32_t dirty_tiles_last;
+    uint32_t copy_pixels_last;  // copiados al buffer nuevo
+    uint64_t copy_pixels_total;
+    uint32_t bytes;             // memoria de los buffers
+    uint64_t pixels;            // escritos con fb_draw_pixel / fb_draw_hline
+};
+
+/* mem = NULL: SDRAM en la placa, memoria estatica en Linux */
+int fb_init(uint16_t *mem, uint8_t nbuf);
+void fb_draw_pixel(int x, int y, uint16_t color);
+void fb_draw_hline(int x, int y, int w, uint16_t color);
+void fb_blit(int x, int y, int w, int h, const uint16_t *src);  // w x h
+uint16_t *fb_back(void);
+void fb_swap(void);
+/* Marca el frame de atras con el time_us() de la muestra que dibuja: al
+ * terminar de mandarlo, medida.h suma la latencia MED_E2E */
+void fb_set_sample(uint64_t t_us);
+void fb_stats_get(struct fb_stats *out);
+
+#endif /* Pantalla_H */
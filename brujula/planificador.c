@@ -0,0 +1,145 @@
+/*
+ * Planificador cooperativo (ver planificador.h)
+ */
+#include "planificador.h"
+#include "hal.h"
+#include "tiempo.h"
+
+#include <stddef.h>
+
+static struct sched_task *tasks[SCHED_MAX_TASKS];
+static int ntasks;
+static struct sched_stats st;
+
+void sched_init(void)
+{
+    ntasks = 0;
+    st = (struct sched_stats){ .start_us = time_us() };
+}
+
+/* La primera activacion de una periodica es ya */
+int sched_add(struct sched_task *t)
+{
+    if (ntasks == SCHED_MAX_TASKS)
+        return -1;
+
+    t->release_us = time_us();
+    t->woken = 0;
+    t->runs = 0;
+    t->misses = 0;
+    t->skipped = 0;
+    t->late_max_us = 0;
+    t->run_max_us = 0;
+    t->run_total_us = 0;
+    tasks[ntasks++] = t;
+    return 0;
+}
+
+void sched_wake(struct sched_task *t)
+{
+    /* Si ya estaba despierta queda la primera marca: el atraso se mide
+     * desde ahi */
+    if (__atomic_load_n(&t->woken, __ATOMIC_ACQUIRE))
+        return;
+    t->woken_us = time_us();
+    __atomic_store_n(&t->woken, 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t deadline_of(const struct sched_task *t)
+{
+    return t->deadline_us ? t->deadline_us : t->period_us;
+}
+
+/* Activacion vigente, o UINT64_MAX si no esta lista en 'now' */
+static uint64_t released_at(const struct sched_task *t, uint64_t now)
+{
+    if (!t->period_us)
+        return __atomic_load_n(&t->woken, __ATOMIC_ACQUIRE) ? t->woken_us
+                                                            : UINT64_MAX;
+    return t->release_us <= now ? t->release_us : UINT64_MAX;
+}
+
+static void run_task(struct sched_task *t, uint64_t release, uint64_t now)
+{
+    if (!t->period_us)
+        __atomic_store_n(&t->woken, 0, __ATOMIC_RELEASE);   // antes de correr
+
+    t->run();
+
+    uint64_t end = time_us();
+    uint32_t ran = (uint32_t)(end - now);
+
+    t->runs++;
+    t->run_total_us += ran;
+    if (ran > t->run_max_us)
+        t->run_max_us = ran;
+    if (now - release > t->late_max_us)
+        t->late_max_us = (uint32_t)(now - release);
+    if (end > release + deadline_of(t)) {
+        t->misses++;
+        st.misses++;
+    }
+
+    if (t->period_us) {
+        t->release_us += t->period_us;
+        if (end >= t->release_us + t->period_us) {
+            uint64_t lost = (end - t->release_us) / t->period_us;
+            t->release_us += lost * t->period_us;
+            t->skipped += (uint32_t)lost;
+        }
+    }
+}
+
+int sched_step(void)
+{
+    uint64_t now = time_us();
+    uint64_t next = UINT64_MAX, best_deadline = UINT64_MAX, best_release = 0;
+    struct sched_task *best = NULL;
+
+    for (int i = 0; i < ntasks; i++) {
+        struct sched_task *t = tasks[i];
+        uint64_t r = released_at(t, now);
+
+        if (r == UINT64_MAX) {
+            if (t->period_us && t->release_us < next)
+                next = t->release_us;
+            continue;
+        }
+        if (r + deadline_of(t) < best_deadline) {
+            best = t;
+            best_deadline = r + deadline_of(t);
+            best_release = r;
+        }
+    }
+
+    if (best) {
+        run_task(best, best_release, now);
+        return 1;
+    }
+
+    /* Con las interrupciones cortadas: un sched_wake() que entre ahora
+     * despierta el WFI igual y no se pierde */
+    hal_irq_lock();
+    int pending = 0;
+    for (int i = 0; i < ntasks; i++)
+        pending |= !tasks[i]->period_us &&
+                   __atomic_load_n(&tasks[i]->woken, __ATOMIC_ACQUIRE);
+    if (!pending) {
+        hal_idle_until_us(next);
+        st.idles++;
+    }
+    hal_irq_unlock();
+    st.idle_us += time_us() - now;
+    return 0;
+}
+
+void sched_run(void)
+{
+    for (;;)
+        sched_step();
+}
+
+void sched_stats_get(struct sched_stats *out)
+{
+    *out = st;
+}
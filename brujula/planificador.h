@@ -0,0 +1,61 @@
+#ifndef Planificador_H
+#define Planificador_H
+
+/*
+ * Planificador cooperativo con plazos.
+ *
+ * Cada tarea corre hasta terminar (no hay desalojo). Entre las que estan
+ * listas va primero la de plazo absoluto mas cercano (EDF). Una tarea
+ * periodica se activa cada period_us. Una esporadica (period_us == 0)
+ * solo se activa con sched_wake(), que se puede llamar desde una
+ * interrupcion. El plazo se cuenta desde la activacion: si la tarea
+ * termina despues, es un miss.
+ *
+ * Una periodica que se atraso mas de un periodo no corre de mas para
+ * ponerse al dia: las activaciones perdidas se cuentan (skipped) y sigue
+ * desde la ultima.
+ *
+ * Sin nada listo duerme con WFI (hal_idle_until_us()) hasta la proxima
+ * activacion o la proxima interrupcion. El tiempo es time_us(): el
+ * SysTick en la placa, el reloj virtual en Linux.
+ */
+
+#include <stdint.h>
+
+#define SCHED_MAX_TASKS 8
+
+struct sched_task {
+    const char *name;
+    void (*run)(void);
+    uint32_t period_us;       // 0 = esporadica
+    uint32_t deadline_us;     // desde la activacion; 0 = el periodo
+
+    /* Estado */
+    uint64_t release_us;      // proxima activacion (periodicas)
+    uint64_t woken_us;        // ultima sched_wake() (esporadicas)
+    uint8_t woken;
+
+    /* Contadores */
+    uint32_t runs;
+    uint32_t misses;          // terminaron despues del plazo
+    uint32_t skipped;         // activaciones perdidas por atraso
+    uint32_t late_max_us;     // activacion -> arranque
+    uint32_t run_max_us;
+    uint64_t run_total_us;
+};
+
+struct sched_stats {
+    uint64_t start_us;        // sched_init()
+    uint64_t idle_us;         // sin nada listo
+    uint32_t idles;           // vueltas sin nada listo
+    uint32_t misses;          // todas las tareas
+};
+
+void sched_init(void);
+int sched_add(struct sched_task *t);        // -1 si no hay lugar
+void sched_wake(struct sched_task *t);      // tambien desde una interrupcion
+int sched_step(void);                       // 1 = corrio una tarea, 0 = nada listo
+void sched_run(void);                       // no vuelve
+void sched_stats_get(struct sched_stats *out);
+
+#endif /* Planificador_H */
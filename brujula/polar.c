@@ -0,0 +1,14 @@
+/*
+ * Posicion de los puntos cardinales por tabla (ver polar.h)
+ */
+#include "polar.h"
+
+void polar_position(int deg, int16_t *x, int16_t *y)
+{
+    deg %= 360;
+    if (deg < 0)
+        deg += 360;
+
+    *x = POLAR_CX + polar_lut[deg].dx;
+    *y = POLAR_CY + polar_lut[deg].dy;
+}
@@ -0,0 +1,28 @@
+#ifndef Polar_H
+#define Polar_H
+
+/*
+ * Posicion de los glifos N/S/E/W sobre el circulo exterior (radio 100
+ * alrededor de (120, 160)), por grado entero.
+ *
+ * La tabla (polar_lut.c) la genera host/gen_polar.c con la misma cuenta
+ * en double que hacia interfaz.c, asi que da los mismos pixeles sin
+ * cos()/sin() en software por cada frame. El rumbo que llega a la GUI
+ * es entero, por eso no hace falta resolucion de decimas.
+ */
+
+#include <stdint.h>
+
+#define POLAR_CX 120
+#define POLAR_CY 160
+#define POLAR_R  100
+
+struct polar_off {
+    int8_t dx, dy;   // respecto de (POLAR_CX, POLAR_CY)
+};
+
+extern const struct polar_off polar_lut[360];
+
+void polar_position(int deg, int16_t *x, int16_t *y);
+
+#endif /* Polar_H */
@@ -0,0 +1,67 @@
+/*
+ * Generado por host/gen_polar.c (make -C host polar). No editar.
+ */
+#include "polar.h"
+
+const struct polar_off polar_lut[360] = {
+    {  100,    0 }, {   99,   -2 }, {   99,   -4 }, {   99,   -6 }, {   99,   -7 }, {   99,   -9 },
+    {   99,  -11 }, {   99,  -13 }, {   99,  -14 }, {   98,  -16 }, {   98,  -18 }, {   98,  -20 },
+    {   97,  -21 }, {   97,  -23 }, {   97,  -25 }, {   96,  -26 }, {   96,  -28 }, {   95,  -30 },
+    {   95,  -31 }, {   94,  -33 }, {   93,  -35 }, {   93,  -36 }, {   92,  -38 }, {   92,  -40 },
+    {   91,  -41 }, {   90,  -43 }, {   89,  -44 }, {   89,  -46 }, {   88,  -47 }, {   87,  -49 },
+    {   86,  -50 }, {   85,  -52 }, {   84,  -53 }, {   83,  -55 }, {   82,  -56 }, {   81,  -58 },
+    {   80,  -59 }, {   79,  -61 }, {   78,  -62 }, {   77,  -63 }, {   76,  -65 }, {   75,  -66 },
+    {   74,  -67 }, {   73,  -69 }, {   71,  -70 }, {   70,  -71 }, {   69,  -72 }, {   68,  -74 },
+    {   66,  -75 }, {   65,  -76 }, {   64,  -77 }, {   62,  -78 }, {   61,  -79 }, {   60,  -80 },
+    {   58,  -81 }, {   57,  -82 }, {   55,  -83 }, {   54,  -84 }, {   52,  -85 }, {   51,  -86 },
+    {   50,  -87 }, {   48,  -88 }, {   46,  -89 }, {   45,  -90 }, {   43,  -90 }, {   42,  -91 },
+    {   40,  -92 }, {   39,  -93 }, {   37,  -93 }, {   35,  -94 }, {   34,  -94 }, {   32,  -95 },
+    {   30,  -96 }, {   29,  -96 }, {   27,  -97 }, {   25,  -97 }, {   24,  -98 }, {   22,  -98 },
+    {   20,  -98 }, {   19,  -99 }, {   17,  -99 }, {   15,  -99 }, {   13, -100 }, {   12, -100 },
+    {   10, -100 }, {    8, -100 }, {    6, -100 }, {    5, -100 }, {    3, -100 }, {    1, -100 },
+    {    0, -100 }, {   -2, -100 }, {   -4, -100 }, {   -6, -100 }, {   -7, -100 }, {   -9, -100 },
+    {  -11, -100 }, {  -13, -100 }, {  -14, -100 }, {  -16,  -99 }, {  -18,  -99 }, {  -20,  -99 },
+    {  -21,  -98 }, {  -23,  -98 }, {  -25,  -98 }, {  -26,  -97 }, {  -28,  -97 }, {  -30,  -96 },
+    {  -31,  -96 }, {  -33,  -95 }, {  -35,  -94 }, {  -36,  -94 }, {  -38,  -93 }, {  -40,  -93 },
+    {  -41,  -92 }, {  -43,  -91 }, {  -44,  -90 }, {  -46,  -90 }, {  -47,  -89 }, {  -49,  -88 },
+    {  -50,  -87 }, {  -52,  -86 }, {  -53,  -85 }, {  -55,  -84 }, {  -56,  -83 }, {  -58,  -82 },
+    {  -59,  -81 }, {  -61,  -80 }, {  -62,  -79 }, {  -63,  -78 }, {  -65,  -77 }, {  -66,  -76 },
+    {  -67,  -75 }, {  -69,  -74 }, {  -70,  -72 }, {  -71,  -71 }, {  -72,  -70 }, {  -74,  -69 },
+    {  -75,  -67 }, {  -76,  -66 }, {  -77,  -65 }, {  -78,  -63 }, {  -79,  -62 }, {  -80,  -61 },
+    {  -81,  -59 }, {  -82,  -58 }, {  -83,  -56 }, {  -84,  -55 }, {  -85,  -53 }, {  -86,  -52 },
+    {  -87,  -50 }, {  -88,  -49 }, {  -89,  -47 }, {  -90,  -46 }, {  -90,  -44 }, {  -91,  -43 },
+    {  -92,  -41 }, {  -93,  -40 }, {  -93,  -38 }, {  -94,  -36 }, {  -94,  -35 }, {  -95,  -33 },
+    {  -96,  -31 }, {  -96,  -30 }, {  -97,  -28 }, {  -97,  -26 }, {  -98,  -25 }, {  -98,  -23 },
+    {  -98,  -21 }, {  -99,  -20 }, {  -99,  -18 }, {  -99,  -16 }, { -100,  -14 }, { -100,  -13 },
+    { -100,  -11 }, { -100,   -9 }, { -100,   -7 }, { -100,   -6 }, { -100,   -4 }, { -100,   -2 },
+    { -100,    0 }, { -100,    1 }, { -100,    3 }, { -100,    5 }, { -100,    6 }, { -100,    8 },
+    { -100,   10 }, { -100,   12 }, { -100,   13 }, {  -99,   15 }, {  -99,   17 }, {  -99,   19 },
+    {  -98,   20 }, {  -98,   22 }, {  -98,   24 }, {  -97,   25 }, {  -97,   27 }, {  -96,   29 },
+    {  -96,   30 }, {  -95,   32 }, {  -94,   34 }, {  -94,   35 }, {  -93,   37 }, {  -93,   39 },
+    {  -92,   40 }, {  -91,   42 }, {  -90,   43 }, {  -90,   45 }, {  -89,   46 }, {  -88,   48 },
+    {  -87,   50 }, {  -86,   51 }, {  -85,   52 }, {  -84,   54 }, {  -83,   55 }, {  -82,   57 },
+    {  -81,   58 }, {  -80,   60 }, {  -79,   61 }, {  -78,   62 }, {  -77,   64 }, {  -76,   65 },
+    {  -75,   66 }, {  -74,   68 }, {  -72,   69 }, {  -71,   70 }, {  -70,   71 }, {  -69,   73 },
+    {  -67,   74 }, {  -66,   75 }, {  -65,   76 }, {  -63,   77 }, {  -62,   78 }, {  -61,   79 },
+    {  -59,   80 }, {  -58,   81 }, {  -56,   82 }, {  -55,   83 }, {  -53,   84 }, {  -52,   85 },
+    {  -51,   86 }, {  -49,   87 }, {  -47,   88 }, {  -46,   89 }, {  -44,   89 }, {  -43,   90 },
+    {  -41,   91 }, {  -40,   92 }, {  -38,   92 }, {  -36,   93 }, {  -35,   93 }, {  -33,   94 },
+    {  -31,   95 }, {  -30,   95 }, {  -28,   96 }, {  -26,   96 }, {  -25,   97 }, {  -23,   97 },
+    {  -21,   97 }, {  -20,   98 }, {  -18,   98 }, {  -16,   98 }, {  -14,   99 }, {  -13,   99 },
+    {  -11,   99 }, {   -9,   99 }, {   -7,   99 }, {   -6,   99 }, {   -4,   99 }, {   -2,   99 },
+    {   -1,  100 }, {    1,   99 }, {    3,   99 }, {    5,   99 }, {    6,   99 }, {    8,   99 },
+    {   10,   99 }, {   12,   99 }, {   13,   99 }, {   15,   98 }, {   17,   98 }, {   19,   98 },
+    {   20,   97 }, {   22,   97 }, {   24,   97 }, {   25,   96 }, {   27,   96 }, {   29,   95 },
+    {   30,   95 }, {   32,   94 }, {   34,   93 }, {   35,   93 }, {   37,   92 }, {   39,   92 },
+    {   40,   91 }, {   42,   90 }, {   43,   89 }, {   45,   89 }, {   46,   88 }, {   48,   87 },
+    {   50,   86 }, {   51,   85 }, {   52,   84 }, {   54,   83 }, {   55,   82 }, {   57,   81 },
+    {   58,   80 }, {   60,   79 }, {   61,   78 }, {   62,   77 }, {   64,   76 }, {   65,   75 },
+    {   66,   74 }, {   68,   73 }, {   69,   71 }, {   70,   70 }, {   71,   69 }, {   73,   68 },
+    {   74,   66 }, {   75,   65 }, {   76,   64 }, {   77,   62 }, {   78,   61 }, {   79,   60 },
+    {   80,   58 }, {   81,   57 }, {   82,   55 }, {   83,   54 }, {   84,   52 }, {   85,   51 },
+    {   86,   50 }, {   87,   48 }, {   88,   46 }, {   89,   45 }, {   89,   43 }, {   90,   42 },
+    {   91,   40 }, {   92,   39 }, {   92,   37 }, {   93,   35 }, {   93,   34 }, {   94,   32 },
+    {   95,   30 }, {   95,   29 }, {   96,   27 }, {   96,   25 }, {   97,   24 }, {   97,   22 },
+    {   97,   20 }, {   98,   19 }, {   98,   17 }, {   98,   15 }, {   99,   13 }, {   99,   12 },
+    {   99,   10 }, {   99,    8 }, {   99,    6 }, {   99,    5 }, {   99,    3 }, {   99,    1 },
+};
@@ -0,0 +1,133 @@
+/*
+ * Recuperacion del sensor (ver recuperacion.h)
+ */
+#include "recuperacion.h"
+#include "brujula.h"
+#include "hal.h"
+#include "tiempo.h"
+
+/* Despues del SOFT_RST el chip no contesta hasta terminar su power-on */
+#define REC_PROBE_FIRST_US    250
+#define REC_PROBE_MAX_US    20000
+#define REC_PROBE_US       500000
+#define REC_BACKOFF_US     250000
+
+static struct acq_config cfg;
+static struct rec_stats st;
+static enum rec_state state = REC_IDLE;
+static uint64_t start_us;     // rec_start()
+static uint64_t phase_us;     // entrada a la fase
+static uint64_t next_us;      // antes de esto no hay nada que hacer
+static uint32_t wait_us;      // espera entre chip-ID
+
+static void enter(enum rec_state s, uint64_t now)
+{
+    state = s;
+    phase_us = now;
+    next_us = now;
+}
+
+static void backoff(uint64_t now)
+{
+    enter(REC_CLEAR, now);
+    next_us = now + REC_BACKOFF_US;
+}
+
+void rec_start(const struct acq_config *c)
+{
+    uint64_t now = time_us();
+
+    acq_stop();
+    cfg = *c;
+    st.started++;
+    start_us = now;
+    enter(REC_CLEAR, now);
+}
+
+static void step(uint64_t now)
+{
+    int err;
+
+    switch (state) {
+    case REC_IDLE:
+        break;
+
+    case REC_CLEAR:
+        st.passes++;
+        err = hal_i2c_bus_clear();
+        if (err < 0) {
+            st.stuck++;
+            backoff(now);
+            break;
+        }
+        st.clocks += (uint32_t)err;
+        enter(REC_RESET, now);
+        break;
+
+    case REC_RESET:
+        if (qmc_soft_reset() != 0) {
+            backoff(now);
+            break;
+        }
+        enter(REC_PROBE, now);
+        wait_us = REC_PROBE_FIRST_US;
+        next_us = now + wait_us;
+        break;
+
+    case REC_PROBE:
+        err = qmc_probe();
+        if (err == 0) {
+            enter(REC_CONFIG, now);
+        } else if (err == -2 || now - phase_us >= REC_PROBE_US) {
+            backoff(now);
+        } else {
+            next_us = now + wait_us;
+            wait_us = wait_us * 2 < REC_PROBE_MAX_US ? wait_us * 2
+                                                     : REC_PROBE_MAX_US;
+        }
+        break;
+
+    case REC_CONFIG:
+        if (qmc_setup() != 0) {
+            backoff(now);
+            break;
+        }
+        acq_start(&cfg);
+        state = REC_IDLE;
+        st.recovered++;
+        st.last_us = (uint32_t)(time_us() - start_us);
+        if (st.last_us > st.max_us)
+            st.max_us = st.last_us;
+        break;
+    }
+}
+
+int rec_service(void)
+{
+    uint64_t now = time_us();
+
+    if (state == REC_IDLE || now < next_us)
+        return state != REC_IDLE;
+
+    step(now);
+
+    uint32_t us = (uint32_t)(time_us() - now);
+    if (us > st.step_max_us)
+        st.step_max_us = us;
+    return state != REC_IDLE;
+}
+
+int rec_degraded(void)
+{
+    return state != REC_IDLE;
+}
+
+enum rec_state rec_state(void)
+{
+    return state;
+}
+
+void rec_stats_get(struct rec_stats *out)
+{
+    *out = st;
+}
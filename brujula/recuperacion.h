@@ -0,0 +1,53 @@
+#ifndef Recuperacion_H
+#define Recuperacion_H
+
+/*
+ * Recuperacion del sensor sin bloquear.
+ *
+ * Antes, con mas de 20 lecturas fallidas seguidas, main llamaba a
+ * qmc_init() y la pantalla se congelaba mientras tanto; un esclavo que
+ * quedo con SDA en bajo no se soltaba nunca. Ahora rec_start() para la
+ * adquisicion y rec_service(), llamada desde una tarea periodica, avanza
+ * de a un paso corto (una transaccion, o los ~100 us de
+ * hal_i2c_bus_clear()) y vuelve:
+ *
+ *   REC_CLEAR   pulsos de SCL, STOP y reset del periferico I2C
+ *   REC_RESET   SOFT_RST del QMC
+ *   REC_PROBE   chip-ID con espera creciente, hasta REC_PROBE_US
+ *   REC_CONFIG  qmc_setup(): SET/RESET, ROL_PNT y el perfil activo
+ *
+ * y al final acq_start() con la configuracion de antes. Un paso que
+ * falla o se pasa de tiempo espera REC_BACKOFF_US y vuelve a REC_CLEAR.
+ * Mientras tanto rec_degraded() es 1 (la escena muestra un "!").
+ */
+
+#include <stdint.h>
+
+#include "adquisicion.h"
+
+enum rec_state {
+    REC_IDLE,
+    REC_CLEAR,
+    REC_RESET,
+    REC_PROBE,
+    REC_CONFIG,
+};
+
+struct rec_stats {
+    uint32_t started;     // rec_start()
+    uint32_t recovered;
+    uint32_t passes;      // vueltas por REC_CLEAR
+    uint32_t clocks;      // pulsos de SCL de los clear que soltaron SDA
+    uint32_t stuck;       // SDA siguio en bajo
+    uint32_t step_max_us; // paso mas largo de rec_service()
+    uint32_t last_us;     // rec_start() -> acq_start()
+    uint32_t max_us;
+};
+
+void rec_start(const struct acq_config *cfg);
+int rec_service(void);          // 1 = sigue recuperando
+int rec_degraded(void);
+enum rec_state rec_state(void);
+void rec_stats_get(struct rec_stats *out);
+
+#endif /* Recuperacion_H */
@@ -0,0 +1,164 @@
+/*
+ * Kernel de rumbo en punto fijo (ver rumbo.h)
+ */
+#include "rumbo.h"
+
+/*
+ * atan(t), 0 <= t <= 1: minimax impar de grado 9 (Abramowitz & Stegun
+ * 4.4.47, error <= 1e-5 rad). Coeficientes en centesimas de grado, Q8.
+ */
+#define ATAN_C1  1466575
+#define ATAN_C3  (-484474)
+#define ATAN_C5  264226
+#define ATAN_C7  (-124871)
+#define ATAN_C9  30560
+
+/* ================= FILTRO ================= */
+
+void rumbo_ema_reset(struct rumbo_ema *f)
+{
+    f->q = 0;
+    f->init = 0;
+}
+
+int32_t rumbo_ema_update(struct rumbo_ema *f, int32_t v, int32_t alpha_q15)
+{
+    int32_t vq = v * (1 << RUMBO_EMA_Q);
+
+    if (!f->init) {
+        f->q = vq;
+        f->init = 1;
+        return f->q;
+    }
+
+    /* q += alpha * (v - q), redondeado; el producto no entra en 32 bits */
+    f->q += (int32_t)(((int64_t)alpha_q15 * (vq - f->q) + (1 << 14)) >> 15);
+    return f->q;
+}
+
+static uint32_t iabs(int32_t v)
+{
+    return v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+}
+
+/* |(x, z)| aproximado: max + 3/8 min, error <= 7 % (alcanza para el corte) */
+static uint32_t norm_approx(int32_t x, int32_t z)
+{
+    uint32_t ax = iabs(x), az = iabs(z);
+    uint32_t hi = ax > az ? ax : az, lo = ax > az ? az : ax;
+
+    return hi + ((3u * lo) >> 3);
+}
+
+/* alpha = r / (1 + r), con r = 2 pi fc / ODR (r en Q15) */
+static int32_t alpha_from_r(int64_t r_q15)
+{
+    return (int32_t)((r_q15 << 15) / ((1 << 15) + r_q15));
+}
+
+static int32_t q15f(float v)
+{
+    return (int32_t)(v * 32768.0f + 0.5f);
+}
+
+void rumbo_filter_init(struct rumbo_filter *f,
+                       const struct rumbo_filter_cfg *cfg, uint32_t odr_hz)
+{
+    const float two_pi = 6.2831853f;
+
+    f->kind = cfg->kind;
+    f->alpha_q15 = cfg->alpha_q15;
+    f->a0_q15 = q15f(two_pi * cfg->min_cutoff_hz / (float)odr_hz);
+    f->b_q15 = q15f(two_pi * cfg->beta);
+    f->d_alpha_q15 = alpha_from_r(q15f(two_pi * cfg->d_cutoff_hz /
+                                       (float)odr_hz));
+    if (f->kind == RUMBO_FILTER_ONE_EURO)
+        f->alpha_q15 = alpha_from_r(f->a0_q15);
+    rumbo_filter_reset(f);
+}
+
+void rumbo_filter_reset(struct rumbo_filter *f)
+{
+    rumbo_ema_reset(&f->x);
+    rumbo_ema_reset(&f->z);
+    rumbo_ema_reset(&f->dx);
+    rumbo_ema_reset(&f->dz);
+}
+
+/* Estado guardado (Q12): sigue desde ahi, quieto */
+void rumbo_filter_set(struct rumbo_filter *f, int32_t qx, int32_t qz)
+{
+    rumbo_filter_reset(f);
+    f->x = (struct rumbo_ema){ qx, 1 };
+    f->z = (struct rumbo_ema){ qz, 1 };
+    f->px = qx >> RUMBO_EMA_Q;
+    f->pz = qz >> RUMBO_EMA_Q;
+}
+
+void rumbo_filter_update(struct rumbo_filter *f, int32_t x, int32_t z)
+{
+    if (f->kind == RUMBO_FILTER_ONE_EURO && f->x.init) {
+        /* Giro por muestra (rad, Q15) = |dv| / |v|, con dv filtrado */
+        int32_t dx = rumbo_ema_update(&f->dx, x - f->px, f->d_alpha_q15);
+        int32_t dz = rumbo_ema_update(&f->dz, z - f->pz, f->d_alpha_q15);
+        uint32_t v = norm_approx(f->x.q, f->z.q);
+        int64_t w = v ? ((int64_t)norm_approx(dx, dz) << 15) / v : 0;
+
+        if (w > (1 << 15))
+            w = 1 << 15;   // mas de un radian por muestra: ya no filtra
+        f->alpha_q15 = alpha_from_r(f->a0_q15 + ((f->b_q15 * w) >> 15));
+    }
+    f->px = x;
+    f->pz = z;
+
+    rumbo_ema_update(&f->x, x, f->alpha_q15);
+    rumbo_ema_update(&f->z, z, f->alpha_q15);
+}
+
+/* ================= ATAN2 ================= */
+
+/* atan(t) en centesimas de grado, t = n / d en [0, 1], d < 2^16 */
+static int32_t atan_unit_cdeg(uint32_t n, uint32_t d)
+{
+    int32_t t = (int32_t)((n << 15) / d);
+    int32_t s = (int32_t)(((int64_t)t * t) >> 15);
+    int64_t p = ATAN_C9;
+
+    p = ATAN_C7 + ((p * s) >> 15);
+    p = ATAN_C5 + ((p * s) >> 15);
+    p = ATAN_C3 + ((p * s) >> 15);
+    p = ATAN_C1 + ((p * s) >> 15);
+    p = (p * t) >> 15;
+
+    return (int32_t)((p + 128) >> 8);
+}
+
+int32_t rumbo_atan2_cdeg(int32_t y, int32_t x)
+{
+    uint32_t ax = iabs(x);
+    uint32_t ay = iabs(y);
+    uint32_t m = ax | ay;
+    int32_t ang;
+
+    if (m == 0)
+        return 0;
+
+    /* Dejar el mayor por debajo de 2^16 para que n << 15 entre en 32 bits */
+    int bits = 32 - __builtin_clz(m);
+    if (bits > 16) {
+        ax >>= bits - 16;
+        ay >>= bits - 16;
+    }
+
+    /* Primer octante y de vuelta */
+    if (ay <= ax)
+        ang = atan_unit_cdeg(ay, ax);
+    else
+        ang = 9000 - atan_unit_cdeg(ax, ay);
+    if (x < 0)
+        ang = 18000 - ang;
+    if (y < 0)
+        ang = 36000 - ang;
+
+    return ang >= 36000 ? ang - 36000 : ang;
+}
@@ -0,0 +1,76 @@
+#ifndef Rumbo_H
+#define Rumbo_H
+
+/*
+ * Kernel de rumbo en punto fijo.
+ *
+ * Reemplaza el EMA en float y atan2f() del camino por muestra: el filtro
+ * guarda el estado en Q12 con alpha en Q15 y el angulo sale de un
+ * polinomio minimax sobre el primer octante, directo en centesimas de
+ * grado (0..35999). Una division y cinco multiplicaciones, sin FPU.
+ *
+ * Error contra atan2() en doble precision, barrido completo de 360
+ * grados: <= 0.01 grados (el redondeo a centesimas ya es 0.005; el resto
+ * es el polinomio y t en Q15). ./bench math lo mide.
+ */
+
+#include <stdint.h>
+
+#define RUMBO_EMA_Q 12   // bits fraccionarios del estado del filtro
+
+struct rumbo_ema {
+    int32_t q;       // valor filtrado, Q12
+    uint8_t init;
+};
+
+void rumbo_ema_reset(struct rumbo_ema *f);
+int32_t rumbo_ema_update(struct rumbo_ema *f, int32_t v, int32_t alpha_q15);
+
+/*
+ * Filtro del vector de campo (X, Z), intercambiable:
+ *
+ *  - RUMBO_FILTER_EMA: alpha fijo por muestra (el de siempre). La
+ *    constante de tiempo depende del ODR: 0.01 son ~10 s a 10 Hz.
+ *  - RUMBO_FILTER_ONE_EURO: One-Euro sobre el vector. El corte sube con
+ *    la velocidad de giro, fc = min_cutoff + beta * w (w en rad/s, de
+ *    |dv| / |v| filtrado a d_cutoff): quieto suaviza como un EMA lento,
+ *    girando casi no atrasa. Esta en Hz, asi que sirve a cualquier ODR.
+ *
+ * Los parametros en float se convierten a Q15 en rumbo_filter_init();
+ * por muestra es todo entero (dos divisiones mas que el EMA).
+ */
+enum rumbo_filter_kind {
+    RUMBO_FILTER_EMA,
+    RUMBO_FILTER_ONE_EURO,
+};
+
+struct rumbo_filter_cfg {
+    const char *name;
+    uint8_t kind;
+    int32_t alpha_q15;     // EMA
+    float min_cutoff_hz;   // One-Euro
+    float beta;            // Hz por rad/s
+    float d_cutoff_hz;
+};
+
+struct rumbo_filter {
+    uint8_t kind;
+    struct rumbo_ema x, z;     // salida, Q12
+    struct rumbo_ema dx, dz;   // diferencia por muestra filtrada, Q12
+    int32_t px, pz;            // muestra anterior
+    int32_t alpha_q15;         // el fijo, o el ultimo del One-Euro
+    int32_t a0_q15;            // 2 pi min_cutoff / ODR
+    int32_t b_q15;             // 2 pi beta
+    int32_t d_alpha_q15;
+};
+
+void rumbo_filter_init(struct rumbo_filter *f,
+                       const struct rumbo_filter_cfg *cfg, uint32_t odr_hz);
+void rumbo_filter_reset(struct rumbo_filter *f);
+void rumbo_filter_set(struct rumbo_filter *f, int32_t qx, int32_t qz);
+void rumbo_filter_update(struct rumbo_filter *f, int32_t x, int32_t z);
+
+/* atan2(y, x) en centesimas de grado, 0..35999. (0, 0) da 0. */
+int32_t rumbo_atan2_cdeg(int32_t y, int32_t x);
+
+#endif /* Rumbo_H */
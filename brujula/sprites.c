@@ -0,0 +1,182 @@
+/*
+ * Cache de sprites rotados (ver sprites.h)
+ */
+#include "sprites.h"
+#include "hal_gfx.h"
+#include "pantalla.h"
+
+#include <string.h>
+
+#define HALF (SPRITE_BOX / 2)
+
+/* Pool de tramos: 2 MB */
+#define SPRITE_POOL_RUNS (0x200000 / sizeof(struct sprite_run))
+
+#ifdef HOST_BUILD
+static struct sprite_run pool_mem[SPRITE_POOL_RUNS];
+#define SPRITE_POOL pool_mem
+#else
+/* SDRAM, 2 MB (despues de los framebuffers de pantalla.c) */
+#define SPRITE_POOL ((struct sprite_run *)(0xD0000000 + 0x200000))
+#endif
+
+static uint32_t pool_used;
+
+/* Lienzo de un frame, en indices de paleta */
+static uint8_t canvas[SPRITE_BOX * SPRITE_BOX];
+static struct sprite_cache *building;
+static int16_t canvas_x0, canvas_y0;
+
+/* ================= RASTERIZADO ================= */
+
+static uint8_t palette_index(uint16_t color)
+{
+    struct sprite_cache *c = building;
+
+    for (uint8_t i = 1; i < c->ncolors; i++)
+        if (c->palette[i] == color)
+            return i;
+    if (c->ncolors == SPRITE_COLORS)
+        return SPRITE_COLORS - 1;   // sin lugar: ultimo color
+    c->palette[c->ncolors] = color;
+    return c->ncolors++;
+}
+
+static void canvas_pixel(int x, int y, uint16_t color)
+{
+    x -= canvas_x0;
+    y -= canvas_y0;
+    if ((unsigned)x < SPRITE_BOX && (unsigned)y < SPRITE_BOX)
+        canvas[y * SPRITE_BOX + x] = palette_index(color);
+}
+
+/* Lienzo -> tramos, y la caja que ocupan */
+static int encode(struct sprite_frame *f)
+{
+    int16_t x0 = SPRITE_BOX, y0 = SPRITE_BOX, x1 = -1, y1 = -1;
+
+    f->first = pool_used;
+    f->nruns = 0;
+
+    for (int y = 0; y < SPRITE_BOX; y++) {
+        const uint8_t *row = &canvas[y * SPRITE_BOX];
+
+        for (int x = 0; x < SPRITE_BOX;) {
+            uint8_t idx = row[x];
+            int start = x;
+
+            while (x < SPRITE_BOX && row[x] == idx && x - start < 255)
+                x++;
+            if (!idx)
+                continue;
+
+            if (pool_used == SPRITE_POOL_RUNS)
+                return -1;
+            SPRITE_POOL[pool_used++] = (struct sprite_run){
+                (uint8_t)start, (uint8_t)y, (uint8_t)(x - start), idx };
+            f->nruns++;
+
+            if (start < x0) x0 = start;
+            if (x - 1 > x1) x1 = x - 1;
+            if (y < y0) y0 = y;
+            y1 = y;
+        }
+    }
+
+    if (f->nruns)
+        f->bounds = (struct scene_rect){ canvas_x0 + x0, canvas_y0 + y0,
+                                         x1 - x0 + 1, y1 - y0 + 1 };
+    else
+        f->bounds = (struct scene_rect){ 0, 0, 0, 0 };
+    return 0;
+}
+
+/* ================= API ================= */
+
+void sprite_pool_reset(void)
+{
+    pool_used = 0;
+}
+
+int sprite_cache_build(struct sprite_cache *c, uint16_t step, int16_t cx,
+                       int16_t cy, void (*draw)(int deg))
+{
+    int ret = 0;
+
+    if (step == 0 || 360 % step)
+        return -1;
+
+    memset(c, 0, sizeof(*c));
+    c->step = step;
+    c->nframes = 360 / step;
+    c->cx = cx;
+    c->cy = cy;
+    c->ncolors = 1;
+    c->runs = &SPRITE_POOL[pool_used];
+
+    building = c;
+    canvas_x0 = cx - HALF;
+    canvas_y0 = cy - HALF;
+    gfx_init(canvas_pixel, LCD_WIDTH, LCD_HEIGHT);
+
+    uint32_t base = pool_used;
+    for (uint16_t i = 0; i < c->nframes && ret == 0; i++) {
+        memset(canvas, 0, sizeof(canvas));
+        draw(i * step);
+        ret = encode(&c->frames[i]);
+        c->frames[i].first -= base;
+    }
+
+    gfx_init(fb_draw_pixel, LCD_WIDTH, LCD_HEIGHT);
+    building = NULL;
+
+    c->nruns = pool_used - base;
+    if (ret) {
+        pool_used = base;
+        c->nframes = 0;
+    }
+    return ret;
+}
+
+static const struct sprite_frame *frame_for(const struct sprite_cache *c,
+                                            int deg)
+{
+    deg %= 360;
+    if (deg < 0)
+        deg += 360;
+
+    /* Paso mas cercano */
+    uint16_t i = (uint16_t)((deg + c->step / 2) / c->step) % c->nframes;
+    return &c->frames[i];
+}
+
+void sprite_blit(const struct sprite_cache *c, int deg)
+{
+    if (!c->nframes)
+        return;
+
+    const struct sprite_frame *f = frame_for(c, deg);
+    const struct sprite_run *r = &c->runs[f->first];
+    int16_t x0 = c->cx - HALF;
+    int16_t y0 = c->cy - HALF;
+
+    for (uint16_t i = 0; i < f->nruns; i++, r++)
+        fb_draw_hline(x0 + r->x, y0 + r->y, r->len, c->palette[r->color]);
+}
+
+void sprite_bounds(const struct sprite_cache *c, int deg,
+                   struct scene_rect *r)
+{
+    if (!c->nframes) {
+        *r = (struct scene_rect){ 0, 0, 0, 0 };
+        return;
+    }
+    *r = frame_for(c, deg)->bounds;
+}
+
+/* Tramos + tabla de frames */
+uint32_t sprite_cache_bytes(const struct sprite_cache *c)
+{
+    return c->nruns * (uint32_t)sizeof(struct sprite_run) +
+           c->nframes * (uint32_t)sizeof(struct sprite_frame);
+}
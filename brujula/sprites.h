@@ -0,0 +1,60 @@
+#ifndef Sprites_H
+#define Sprites_H
+
+/*
+ * Cache de sprites rotados (flecha, rosa).
+ *
+ * sprite_cache_build() rasteriza una vez el dibujo en cada paso angular
+ * (step grados) con las mismas primitivas gfx_* y lo guarda en SDRAM
+ * como tramos horizontales: {x, y, largo, color} en 4 bytes, con una
+ * paleta de hasta 15 colores y el resto transparente. Despues, dibujarlo
+ * en cualquier angulo es un blit de tramos con fb_draw_hline(), en vez
+ * de volver a rasterizar triangulos y lineas gruesas.
+ *
+ * El dibujo tiene que entrar en una caja de SPRITE_BOX x SPRITE_BOX
+ * centrada en (cx, cy); lo de afuera se recorta.
+ */
+
+#include <stdint.h>
+
+#include "escena.h"
+
+#define SPRITE_BOX    128
+#define SPRITE_COLORS 16     // indice 0 = transparente
+#define SPRITE_MAX_FRAMES 360
+
+struct sprite_run {
+    uint8_t x, y;            // dentro de la caja
+    uint8_t len;
+    uint8_t color;           // indice de paleta
+};
+
+struct sprite_frame {
+    uint32_t first;          // primer tramo
+    uint16_t nruns;
+    struct scene_rect bounds;  // en pantalla
+};
+
+struct sprite_cache {
+    uint16_t step;           // grados por paso
+    uint16_t nframes;        // 360 / step
+    int16_t cx, cy;          // centro de giro en pantalla
+    uint8_t ncolors;
+    uint16_t palette[SPRITE_COLORS];
+    struct sprite_frame frames[SPRITE_MAX_FRAMES];
+    struct sprite_run *runs;
+    uint32_t nruns;
+};
+
+/* draw(deg) dibuja con gfx_* el objeto girado deg grados (antihorario) */
+int sprite_cache_build(struct sprite_cache *c, uint16_t step, int16_t cx,
+                       int16_t cy, void (*draw)(int deg));
+void sprite_blit(const struct sprite_cache *c, int deg);
+void sprite_bounds(const struct sprite_cache *c, int deg,
+                   struct scene_rect *r);
+uint32_t sprite_cache_bytes(const struct sprite_cache *c);
+
+/* Los caches salen de un pool en SDRAM; esto lo vacia */
+void sprite_pool_reset(void);
+
+#endif /* Sprites_H */
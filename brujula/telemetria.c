@@ -0,0 +1,201 @@
+/*
+ * Telemetria binaria (ver telemetria.h)
+ */
+#include "telemetria.h"
+#include "diezmado.h"
+#include "hal.h"
+#include "trama.h"
+
+#include <string.h>
+
+#define TLM_MASK (TLM_RING - 1)
+
+_Static_assert((TLM_RING & TLM_MASK) == 0, "TLM_RING potencia de 2");
+_Static_assert(DEC_MAX_TAPS <= TRAMA_DECIM_TAPS, "historia en TRAMA_DECIM");
+
+static uint8_t ring[TLM_RING];
+static uint32_t head;   // lo escribe el productor
+static uint32_t tail;   // lo escribe el consumidor
+static uint8_t seq;
+static struct tlm_stats st;
+static int config_sent;
+static uint32_t config_gen;   // qmc_pipeline_gen() del ultimo enviado
+static struct dec_filter *decim;
+
+void tlm_init(void)
+{
+    head = 0;
+    tail = 0;
+    seq = 0;
+    memset(&st, 0, sizeof(st));
+    config_sent = 0;
+    decim = NULL;
+}
+
+void tlm_set_decim(struct dec_filter *d)
+{
+    decim = d;
+    config_sent = 0;
+}
+
+/* Registro entero o nada: un registro cortado romperia tambien el proximo */
+static int tlm_send(uint8_t type, const uint8_t *data, uint8_t len)
+{
+    uint8_t out[TRAMA_MAX];
+    size_t n = trama_encode(type, seq++, data, len, out);
+    uint32_t h = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    uint32_t used = h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+
+    if (used + n > TLM_RING) {
+        st.dropped++;
+        return -1;
+    }
+
+    uint32_t at = h & TLM_MASK, first = TLM_RING - at;
+    if (first > n)
+        first = (uint32_t)n;
+    memcpy(&ring[at], out, first);
+    memcpy(ring, out + first, n - first);
+    __atomic_store_n(&head, h + (uint32_t)n, __ATOMIC_RELEASE);
+
+    st.records++;
+    st.bytes += (uint32_t)n;
+    if (used + n > st.high_water)
+        st.high_water = used + (uint32_t)n;
+    return 0;
+}
+
+int tlm_sample(const struct qmc_sample *s, int32_t heading_cdeg)
+{
+    struct trama_sample r = {
+        .t_us = (uint32_t)s->t_us,
+        .x = s->x,
+        .y = s->y,
+        .z = s->z,
+        .heading_cdeg = (uint16_t)heading_cdeg,
+    };
+    uint8_t data[TRAMA_SAMPLE_LEN];
+
+    trama_pack_sample(&r, data);
+    return tlm_send(TRAMA_SAMPLE, data, sizeof(data));
+}
+
+/* El FIR de antes de la proxima muestra (dec_state_get() lo pone al dia) */
+static int send_decim(void)
+{
+    struct dec_state ds;
+    struct trama_decim r;
+    uint8_t data[TRAMA_DECIM_LEN(DEC_MAX_TAPS)];
+
+    dec_state_get(decim, &ds);
+    r.out_hz = (uint8_t)decim->cfg->out_hz;
+    r.window_ms = decim->cfg->window_ms;
+    r.cutoff_hz = decim->cfg->cutoff_hz;
+    r.primed = ds.primed;
+    r.phase = ds.phase;
+    r.taps = (uint8_t)ds.taps;
+    r.init = (uint8_t)(ds.x.init | ds.z.init << 1 | ds.dx.init << 2 |
+                       ds.dz.init << 3);
+    r.q[0] = ds.x.q;
+    r.q[1] = ds.z.q;
+    r.q[2] = ds.dx.q;
+    r.q[3] = ds.dz.q;
+    r.px = ds.px;
+    r.pz = ds.pz;
+    r.cdeg = (uint16_t)ds.cdeg;
+    memcpy(r.hx, ds.hx, ds.taps * sizeof(r.hx[0]));
+    memcpy(r.hz, ds.hz, ds.taps * sizeof(r.hz[0]));
+
+    trama_pack_decim(&r, data);
+    return tlm_send(TRAMA_DECIM, data, (uint8_t)TRAMA_DECIM_LEN(r.taps));
+}
+
+static int send_config(void)
+{
+    struct qmc_pipeline p;
+    struct trama_config r;
+    uint8_t data[TRAMA_CONFIG_LEN];
+    uint32_t gen = qmc_pipeline_gen();
+
+    qmc_pipeline_get(&p);
+    r.profile = p.profile;
+    r.filter = p.filter;
+    r.init = (uint8_t)(p.x.init | p.z.init << 1 | p.dx.init << 2 |
+                       p.dz.init << 3);
+    memcpy(r.off8, p.off8, sizeof(r.off8));
+    memcpy(r.soft, p.soft, sizeof(r.soft));
+    r.q[0] = p.x.q;
+    r.q[1] = p.z.q;
+    r.q[2] = p.dx.q;
+    r.q[3] = p.dz.q;
+    r.px = p.px;
+    r.pz = p.pz;
+    r.decim = decim != NULL;
+
+    trama_pack_config(&r, data);
+    if (tlm_send(TRAMA_CONFIG, data, sizeof(data)) != 0 ||
+        (decim && send_decim() != 0))
+        return -1;   // siguen pendientes, los dos
+    config_sent = 1;
+    config_gen = gen;
+    return 0;
+}
+
+int tlm_config(void)
+{
+    if (config_sent && qmc_pipeline_gen() == config_gen)
+        return 0;
+    return send_config();
+}
+
+/* Contadores y, de paso, el pipeline: un PC que se conecta tarde
+ * engancha en el proximo */
+int tlm_status(void)
+{
+    struct trama_status r = {
+        .t_us = (uint32_t)hal_time_us(),
+        .dropped = st.dropped,
+        .high_water = (uint16_t)st.high_water,
+        .profile = (uint8_t)(qmc_active_profile() - qmc_profiles),
+        .filter = (uint8_t)(qmc_active_filter() - qmc_filters),
+    };
+    uint8_t data[TRAMA_STATUS_LEN];
+
+    trama_pack_status(&r, data);
+    int err = tlm_send(TRAMA_STATUS, data, sizeof(data));
+    return send_config() | err;
+}
+
+/* Tramos contiguos de la cola, de a un paquete; para si el USB no toma */
+void tlm_service(void)
+{
+    for (int p = 0; p < TLM_PACKETS; p++) {
+        uint32_t t = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+        uint32_t n = __atomic_load_n(&head, __ATOMIC_ACQUIRE) - t;
+        uint32_t at = t & TLM_MASK;
+
+        if (!n)
+            return;
+        if (n > TLM_RING - at)
+            n = TLM_RING - at;
+        if (n > TLM_PACKET)
+            n = TLM_PACKET;
+
+        int sent = hal_cdc_write(&ring[at], (uint16_t)n);
+        if (sent <= 0)
+            return;
+        __atomic_store_n(&tail, t + (uint32_t)sent, __ATOMIC_RELEASE);
+        st.sent += (uint32_t)sent;
+    }
+}
+
+uint32_t tlm_pending(void)
+{
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+}
+
+void tlm_stats_get(struct tlm_stats *out)
+{
+    *out = st;
+}
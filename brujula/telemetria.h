@@ -0,0 +1,52 @@
+#ifndef Telemetria_H
+#define Telemetria_H
+
+/*
+ * Telemetria binaria por el USB CDC (registros de trama.h).
+ *
+ * tlm_sample() arma el registro y lo copia a una cola de bytes en RAM:
+ * ~1 us, sin printf ni floats. tlm_service() saca hasta TLM_PACKETS
+ * paquetes de 64 bytes por llamada con hal_cdc_write(), que no espera:
+ * si el USB no toma, queda para la proxima. Si la cola se llena (el PC
+ * no lee) el registro se descarta entero y se cuenta; el loop del sensor
+ * nunca se frena por la telemetria.
+ *
+ * tlm_config() manda el pipeline del rumbo (brujula.h) si cambio desde el
+ * ultimo envio y tlm_status() lo repite cada vez: con eso una captura se
+ * puede repetir en el host por el mismo codigo (host/repeticion.h). Va
+ * antes de qmc_heading_cdeg(), para que el estado sea el de antes de la
+ * muestra. Con tlm_set_decim() el rumbo de las muestras es el de ese FIR
+ * (diezmado.h) y detras de cada config va su estado (TRAMA_DECIM).
+ *
+ * Un productor y un consumidor, como cola.h: tlm_sample() desde main (o
+ * una interrupcion) y tlm_service() desde main o un tick.
+ */
+
+#include <stdint.h>
+
+#include "brujula.h"
+
+struct dec_filter;
+
+#define TLM_RING    4096   // potencia de 2: ~220 ms a 1 kHz
+#define TLM_PACKET  64     // endpoint bulk de USB full-speed
+#define TLM_PACKETS 4      // paquetes por tlm_service()
+
+struct tlm_stats {
+    uint32_t records;     // encolados
+    uint32_t dropped;     // no entraron
+    uint32_t bytes;       // encolados
+    uint32_t sent;        // bytes que tomo el USB
+    uint32_t high_water;  // bytes en la cola
+};
+
+void tlm_init(void);
+void tlm_set_decim(struct dec_filter *d);   // despues de tlm_init()
+int tlm_sample(const struct qmc_sample *s, int32_t heading_cdeg);
+int tlm_config(void);
+int tlm_status(void);
+void tlm_service(void);
+uint32_t tlm_pending(void);
+void tlm_stats_get(struct tlm_stats *out);
+
+#endif /* Telemetria_H */
@@ -0,0 +1,41 @@
+/*
+ * Base de tiempo monotona (ver tiempo.h)
+ */
+#include "tiempo.h"
+#include "hal.h"
+
+void time_init(void)
+{
+    hal_time_init();
+}
+
+uint64_t time_us(void)
+{
+    return hal_time_us();
+}
+
+uint32_t time_ms(void)
+{
+    return (uint32_t)(hal_time_us() / 1000u);
+}
+
+void sleep_until(uint64_t t_us)
+{
+    if (hal_time_us() < t_us)
+        hal_sleep_until_us(t_us);
+}
+
+void sleep_us(uint32_t us)
+{
+    sleep_until(hal_time_us() + us);
+}
+
+deadline_t deadline_in_us(uint32_t us)
+{
+    return hal_time_us() + us;
+}
+
+int deadline_expired(deadline_t d)
+{
+    return hal_time_us() >= d;
+}
@@ -0,0 +1,26 @@
+#ifndef Tiempo_H
+#define Tiempo_H
+
+/*
+ * Base de tiempo monotona.
+ *
+ * En la placa: SysTick de 1 ms + DWT CYCCNT para la fraccion, asi que
+ * time_us() no depende del reloj, de -O ni de los wait states de flash
+ * como el nop loop de delay(). En Linux es el reloj virtual de la HAL.
+ */
+
+#include <stdint.h>
+
+typedef uint64_t deadline_t;   // instante absoluto en us
+
+void time_init(void);
+uint64_t time_us(void);
+uint32_t time_ms(void);
+
+void sleep_us(uint32_t us);
+void sleep_until(uint64_t t_us);
+
+deadline_t deadline_in_us(uint32_t us);
+int deadline_expired(deadline_t d);
+
+#endif /* Tiempo_H */
@@ -0,0 +1,268 @@
+/*
+ * Formato de la telemetria (ver trama.h)
+ */
+#include "trama.h"
+
+#include <string.h>
+
+/* ================= CRC-16 ================= */
+
+/* CRC-16/CCITT-FALSE (poly 0x1021, arranca en 0xFFFF), de a nibbles */
+uint16_t trama_crc16(uint16_t crc, const uint8_t *p, size_t n)
+{
+    static const uint16_t t[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+
+    while (n--) {
+        crc = (uint16_t)((crc << 4) ^ t[(crc >> 12) ^ (*p >> 4)]);
+        crc = (uint16_t)((crc << 4) ^ t[(crc >> 12) ^ (*p & 0x0F)]);
+        p++;
+    }
+    return crc;
+}
+
+/* ================= COBS ================= */
+
+static size_t cobs_encode(const uint8_t *in, size_t n, uint8_t *out)
+{
+    size_t code_at = 0, o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < n; i++) {
+        if (in[i]) {
+            out[o++] = in[i];
+            code++;
+        }
+        if (!in[i] || code == 0xFF) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    return o;
+}
+
+static int cobs_decode(const uint8_t *in, size_t n, uint8_t *out, size_t max,
+                       size_t *len)
+{
+    size_t i = 0, o = 0;
+
+    while (i < n) {
+        uint8_t code = in[i++];
+
+        if (!code || i + code - 1 > n)
+            return -1;
+        for (uint8_t k = 1; k < code; k++) {
+            if (o == max || !in[i])
+                return -1;
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < n) {
+            if (o == max)
+                return -1;
+            out[o++] = 0;
+        }
+    }
+    *len = o;
+    return 0;
+}
+
+/* ================= REGISTROS ================= */
+
+size_t trama_encode(uint8_t type, uint8_t seq, const uint8_t *data,
+                    uint8_t len, uint8_t *out)
+{
+    uint8_t raw[TRAMA_MAX_RAW];
+    size_t n = 0;
+
+    if (len > TRAMA_MAX_DATA)
+        len = TRAMA_MAX_DATA;
+
+    raw[n++] = type;
+    raw[n++] = seq;
+    for (uint8_t i = 0; i < len; i++)
+        raw[n++] = data[i];
+    uint16_t crc = trama_crc16(0xFFFF, raw, n);
+    raw[n++] = (uint8_t)crc;
+    raw[n++] = (uint8_t)(crc >> 8);
+
+    n = cobs_encode(raw, n, out);
+    out[n++] = 0;
+    return n;
+}
+
+int trama_decode(const uint8_t *in, size_t n, uint8_t *type, uint8_t *seq,
+                 uint8_t *data, uint8_t *len)
+{
+    uint8_t raw[TRAMA_MAX_RAW];
+    size_t m;
+
+    if (cobs_decode(in, n, raw, sizeof(raw), &m) != 0 || m < 4)
+        return -1;
+
+    uint16_t crc = (uint16_t)(raw[m - 2] | raw[m - 1] << 8);
+    if (trama_crc16(0xFFFF, raw, m - 2) != crc)
+        return -1;
+
+    *type = raw[0];
+    *seq = raw[1];
+    *len = (uint8_t)(m - 4);
+    for (size_t i = 0; i < m - 4; i++)
+        data[i] = raw[2 + i];
+    return 0;
+}
+
+/* ================= DATOS ================= */
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+void trama_pack_sample(const struct trama_sample *s, uint8_t *out)
+{
+    put32(out, s->t_us);
+    put16(out + 4, (uint16_t)s->x);
+    put16(out + 6, (uint16_t)s->y);
+    put16(out + 8, (uint16_t)s->z);
+    put16(out + 10, s->heading_cdeg);
+}
+
+void trama_unpack_sample(const uint8_t *in, struct trama_sample *s)
+{
+    s->t_us = get32(in);
+    s->x = (int16_t)get16(in + 4);
+    s->y = (int16_t)get16(in + 6);
+    s->z = (int16_t)get16(in + 8);
+    s->heading_cdeg = get16(in + 10);
+}
+
+void trama_pack_status(const struct trama_status *s, uint8_t *out)
+{
+    put32(out, s->t_us);
+    put32(out + 4, s->dropped);
+    put16(out + 8, s->high_water);
+    out[10] = s->profile;
+    out[11] = s->filter;
+}
+
+void trama_unpack_status(const uint8_t *in, struct trama_status *s)
+{
+    s->t_us = get32(in);
+    s->dropped = get32(in + 4);
+    s->high_water = get16(in + 8);
+    s->profile = in[10];
+    s->filter = in[11];
+}
+
+static void putf(uint8_t *p, float f)
+{
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    put32(p, v);
+}
+
+static float getf(const uint8_t *p)
+{
+    uint32_t v = get32(p);
+    float f;
+    memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+void trama_pack_config(const struct trama_config *c, uint8_t *out)
+{
+    out[0] = c->profile;
+    out[1] = c->filter;
+    out[2] = c->init;
+    for (int i = 0; i < 3; i++)
+        putf(out + 3 + 4 * i, c->off8[i]);
+    for (int i = 0; i < 9; i++)
+        putf(out + 15 + 4 * i, c->soft[i / 3][i % 3]);
+    for (int i = 0; i < 4; i++)
+        put32(out + 51 + 4 * i, (uint32_t)c->q[i]);
+    put32(out + 67, (uint32_t)c->px);
+    put32(out + 71, (uint32_t)c->pz);
+    out[75] = c->decim;
+}
+
+void trama_unpack_config(const uint8_t *in, struct trama_config *c)
+{
+    c->profile = in[0];
+    c->filter = in[1];
+    c->init = in[2];
+    for (int i = 0; i < 3; i++)
+        c->off8[i] = getf(in + 3 + 4 * i);
+    for (int i = 0; i < 9; i++)
+        c->soft[i / 3][i % 3] = getf(in + 15 + 4 * i);
+    for (int i = 0; i < 4; i++)
+        c->q[i] = (int32_t)get32(in + 51 + 4 * i);
+    c->px = (int32_t)get32(in + 67);
+    c->pz = (int32_t)get32(in + 71);
+    c->decim = in[75];
+}
+
+void trama_pack_decim(const struct trama_decim *d, uint8_t *out)
+{
+    out[0] = d->out_hz;
+    put16(out + 1, d->window_ms);
+    putf(out + 3, d->cutoff_hz);
+    out[7] = d->primed;
+    put16(out + 8, d->phase);
+    out[10] = d->taps;
+    out[11] = d->init;
+    for (int i = 0; i < 4; i++)
+        put32(out + 12 + 4 * i, (uint32_t)d->q[i]);
+    put32(out + 28, (uint32_t)d->px);
+    put32(out + 32, (uint32_t)d->pz);
+    put16(out + 36, d->cdeg);
+    for (int k = 0; k < d->taps; k++) {
+        put16(out + 38 + 2 * k, (uint16_t)d->hx[k]);
+        put16(out + 38 + 2 * (d->taps + k), (uint16_t)d->hz[k]);
+    }
+}
+
+int trama_unpack_decim(const uint8_t *in, uint8_t len, struct trama_decim *d)
+{
+    if (len < TRAMA_DECIM_LEN(0) || in[10] > TRAMA_DECIM_TAPS ||
+        len != TRAMA_DECIM_LEN(in[10]))
+        return -1;
+
+    d->out_hz = in[0];
+    d->window_ms = get16(in + 1);
+    d->cutoff_hz = getf(in + 3);
+    d->primed = in[7];
+    d->phase = get16(in + 8);
+    d->taps = in[10];
+    d->init = in[11];
+    for (int i = 0; i < 4; i++)
+        d->q[i] = (int32_t)get32(in + 12 + 4 * i);
+    d->px = (int32_t)get32(in + 28);
+    d->pz = (int32_t)get32(in + 32);
+    d->cdeg = get16(in + 36);
+    for (int k = 0; k < d->taps; k++) {
+        d->hx[k] = (int16_t)get16(in + 38 + 2 * k);
+        d->hz[k] = (int16_t)get16(in + 38 + 2 * (d->taps + k));
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#ifndef Trama_H
+#define Trama_H
+
+/*
+ * Formato de la telemetria binaria (telemetria.h la manda, host/tlm_dump
+ * la lee).
+ *
+ * Registro: [tipo] [seq] [datos, little-endian] [CRC-16 CCITT] y todo
+ * codificado con COBS, terminado en 0x00: un byte perdido rompe un solo
+ * registro y el decodificador se vuelve a enganchar en el proximo 0x00.
+ * seq sube de a uno tambien con los registros descartados, asi que los
+ * huecos se ven del otro lado.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+    TRAMA_SAMPLE = 1,   // muestra cruda + rumbo filtrado
+    TRAMA_STATUS = 2,   // contadores, cada tanto
+    TRAMA_CONFIG = 3,   // pipeline del rumbo (brujula.h), al cambiar
+    TRAMA_DECIM = 4,    // diezmado (diezmado.h), despues de un config
+};
+
+#define TRAMA_DECIM_TAPS 32
+#define TRAMA_MAX_DATA   TRAMA_DECIM_LEN(TRAMA_DECIM_TAPS)
+#define TRAMA_MAX_RAW  (2 + TRAMA_MAX_DATA + 2)
+#define TRAMA_MAX      (TRAMA_MAX_RAW + TRAMA_MAX_RAW / 254 + 2)   // COBS + 0x00
+
+struct trama_sample {
+    uint32_t t_us;          // los 32 bits de abajo de time_us()
+    int16_t x, y, z;
+    uint16_t heading_cdeg;
+};
+
+struct trama_status {
+    uint32_t t_us;
+    uint32_t dropped;       // registros que no entraron en la cola
+    uint16_t high_water;    // bytes
+    uint8_t profile;
+    uint8_t filter;
+};
+
+/*
+ * Con esto y las muestras que siguen, host/repeticion.h reproduce el
+ * rumbo bit a bit: el estado del filtro es el de antes de la proxima
+ * muestra. Floats en IEEE-754 tal cual.
+ */
+struct trama_config {
+    uint8_t profile;
+    uint8_t filter;
+    uint8_t init;           // bits 0..3: x, z, dx, dz ya arrancados
+    float off8[3];
+    float soft[3][3];
+    int32_t q[4];           // x, z, dx, dz en Q12
+    int32_t px, pz;
+    uint8_t decim;          // 1: el rumbo es el diezmado, sigue un TRAMA_DECIM
+};
+
+/*
+ * Con BRUJULA_DIEZMADO el rumbo de las muestras sale del FIR y su filtro:
+ * la configuracion y el estado de antes de la proxima muestra, la
+ * historia de la mas vieja a la mas nueva. Largo: TRAMA_DECIM_LEN(taps).
+ */
+struct trama_decim {
+    uint8_t out_hz;
+    uint16_t window_ms;
+    float cutoff_hz;
+    uint8_t primed;
+    uint16_t phase;
+    uint8_t taps;           // hasta TRAMA_DECIM_TAPS
+    uint8_t init;           // bits 0..3: x, z, dx, dz ya arrancados
+    int32_t q[4];           // x, z, dx, dz en Q12
+    int32_t px, pz;
+    uint16_t cdeg;          // la ultima salida
+    int16_t hx[TRAMA_DECIM_TAPS], hz[TRAMA_DECIM_TAPS];
+};
+
+#define TRAMA_SAMPLE_LEN 12
+#define TRAMA_STATUS_LEN 12
+#define TRAMA_CONFIG_LEN 76
+#define TRAMA_DECIM_LEN(taps) (38 + 4 * (taps))
+
+uint16_t trama_crc16(uint16_t crc, const uint8_t *p, size_t n);
+
+/* Registro codificado (con el 0x00 final) en out; devuelve el largo */
+size_t trama_encode(uint8_t type, uint8_t seq, const uint8_t *data,
+                    uint8_t len, uint8_t *out);
+
+/* Un registro sin el 0x00; -1 si COBS o el CRC no cierran */
+int trama_decode(const uint8_t *in, size_t n, uint8_t *type, uint8_t *seq,
+                 uint8_t *data, uint8_t *len);
+
+void trama_pack_sample(const struct trama_sample *s, uint8_t *out);
+void trama_unpack_sample(const uint8_t *in, struct trama_sample *s);
+void trama_pack_status(const struct trama_status *s, uint8_t *out);
+void trama_unpack_status(const uint8_t *in, struct trama_status *s);
+void trama_pack_config(const struct trama_config *c, uint8_t *out);
+void trama_unpack_config(const uint8_t *in, struct trama_config *c);
+/* unpack: -1 si len no es el de sus taps */
+void trama_pack_decim(const struct trama_decim *d, uint8_t *out);
+int trama_unpack_decim(const uint8_t *in, uint8_t len, struct trama_decim *d);
+
+#endif /* Trama_H */